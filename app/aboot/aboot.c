@@ -35,8 +35,10 @@
 #include <arch/arm.h>
 #include <string.h>
 #include <stdlib.h>
+#include <strbuild.h>
 #include <limits.h>
 #include <kernel/thread.h>
+#include <kernel/ktrace.h>
 #include <arch/ops.h>
 
 #include <dev/flash.h>
@@ -150,16 +152,19 @@ static const char *auth_kernel = " androidboot.authorized_kernel=true";
 static const char *secondary_gpt_enable = " gpt";
 static const char *mdtp_activated_flag = " mdtp";
 
-static const char *baseband_apq     = " androidboot.baseband=apq";
-static const char *baseband_msm     = " androidboot.baseband=msm";
-static const char *baseband_csfb    = " androidboot.baseband=csfb";
-static const char *baseband_svlte2a = " androidboot.baseband=svlte2a";
-static const char *baseband_mdm     = " androidboot.baseband=mdm";
-static const char *baseband_mdm2    = " androidboot.baseband=mdm2";
-static const char *baseband_sglte   = " androidboot.baseband=sglte";
-static const char *baseband_dsda    = " androidboot.baseband=dsda";
-static const char *baseband_dsda2   = " androidboot.baseband=dsda2";
-static const char *baseband_sglte2  = " androidboot.baseband=sglte2";
+/* androidboot.baseband for each enum baseband, NULL if there's none */
+static const char *baseband_cmdline[] = {
+	[BASEBAND_MSM]     = " androidboot.baseband=msm",
+	[BASEBAND_APQ]     = " androidboot.baseband=apq",
+	[BASEBAND_CSFB]    = " androidboot.baseband=csfb",
+	[BASEBAND_SVLTE2A] = " androidboot.baseband=svlte2a",
+	[BASEBAND_MDM]     = " androidboot.baseband=mdm",
+	[BASEBAND_SGLTE]   = " androidboot.baseband=sglte",
+	[BASEBAND_DSDA]    = " androidboot.baseband=dsda",
+	[BASEBAND_DSDA2]   = " androidboot.baseband=dsda2",
+	[BASEBAND_SGLTE2]  = " androidboot.baseband=sglte2",
+	[BASEBAND_MDM2]    = " androidboot.baseband=mdm2",
+};
 static const char *warmboot_cmdline = " qpnp-power-on.warm_boot=1";
 
 static unsigned page_size = 0;
@@ -215,6 +220,7 @@ char charger_screen_enabled[MAX_RSP_SIZE];
 char sn_buf[13];
 char display_panel_buf[MAX_PANEL_BUF_SIZE];
 char panel_display_mode[MAX_RSP_SIZE];
+char boot_profile_summary[MAX_RSP_SIZE];
 
 extern int emmc_recovery_init(void);
 
@@ -250,292 +256,97 @@ static void ptentry_to_tag(unsigned **ptr, struct ptentry *ptn)
 
 unsigned char *update_cmdline(const char * cmdline)
 {
-	int cmdline_len = 0;
-	int have_cmdline = 0;
+	struct strbuild sb;
 	unsigned char *cmdline_final = NULL;
-	int pause_at_bootup = 0;
-	bool warm_boot = false;
 	bool gpt_exists = partition_gpt_exists();
-	int have_target_boot_params = 0;
 	char *boot_dev_buf = NULL;
+	int have_target_boot_params = 0;
+	unsigned baseband;
+	int ret = 0;
     bool is_mdtp_activated = 0;
 #ifdef MDTP_SUPPORT
     mdtp_activated(&is_mdtp_activated);
 #endif /* MDTP_SUPPORT */
 
-	if (cmdline && cmdline[0]) {
-		cmdline_len = strlen(cmdline);
-		have_cmdline = 1;
-	}
-	else {
+	if (!cmdline || !cmdline[0]) {
 		dprintf(CRITICAL,"cmdline is NULL\n");
 		ASSERT(0);
 	}
+
+	/*
+	 * Queue the fragments in command line order, the builder sizes the
+	 * result once and copies each fragment with a single memcpy.
+	 */
+	strbuild_init(&sb);
+	ret |= strbuild_add(&sb, cmdline);
+
 	if (target_is_emmc_boot()) {
-		cmdline_len += strlen(emmc_cmdline);
+		ret |= strbuild_add(&sb, emmc_cmdline);
 #if USE_BOOTDEV_CMDLINE
 		boot_dev_buf = (char *) malloc(sizeof(char) * BOOT_DEV_MAX_LEN);
 		ASSERT(boot_dev_buf);
-		memset((void *)boot_dev_buf, 0, sizeof(*boot_dev_buf));
+		memset((void *)boot_dev_buf, 0, BOOT_DEV_MAX_LEN);
 		platform_boot_dev_cmdline(boot_dev_buf);
-		cmdline_len += strlen(boot_dev_buf);
+		ret |= strbuild_add(&sb, boot_dev_buf);
 #endif
 	}
 
-	cmdline_len += strlen(usb_sn_cmdline);
-	cmdline_len += strlen(sn_buf);
+	ret |= strbuild_add(&sb, usb_sn_cmdline);
+	ret |= strbuild_add(&sb, sn_buf);
+
+	if (target_warm_boot())
+		ret |= strbuild_add(&sb, warmboot_cmdline);
 
 	if (boot_into_recovery && gpt_exists)
-		cmdline_len += strlen(secondary_gpt_enable);
+		ret |= strbuild_add(&sb, secondary_gpt_enable);
 
-	if(is_mdtp_activated)
-		cmdline_len += strlen(mdtp_activated_flag);
+	if (is_mdtp_activated)
+		ret |= strbuild_add(&sb, mdtp_activated_flag);
 
 	if (boot_into_ffbm) {
-		cmdline_len += strlen(androidboot_mode);
-		cmdline_len += strlen(ffbm_mode_string);
+		ret |= strbuild_add(&sb, androidboot_mode);
+		ret |= strbuild_add(&sb, ffbm_mode_string);
 		/* reduce kernel console messages to speed-up boot */
-		cmdline_len += strlen(loglevel);
+		ret |= strbuild_add(&sb, loglevel);
 	} else if (boot_reason_alarm) {
-		cmdline_len += strlen(alarmboot_cmdline);
+		ret |= strbuild_add(&sb, alarmboot_cmdline);
 	} else if ((target_build_variant_user() || device.charger_screen_enabled)
 			&& target_pause_for_battery_charge()) {
-		pause_at_bootup = 1;
-		cmdline_len += strlen(battchg_pause);
+		ret |= strbuild_add(&sb, battchg_pause);
 	}
 
-	if(target_use_signed_kernel() && auth_kernel_img) {
-		cmdline_len += strlen(auth_kernel);
-	}
+	if (target_use_signed_kernel() && auth_kernel_img)
+		ret |= strbuild_add(&sb, auth_kernel);
+
+	/* Determine correct androidboot.baseband to use */
+	baseband = target_baseband();
+	if (baseband < ARRAY_SIZE(baseband_cmdline))
+		ret |= strbuild_add(&sb, baseband_cmdline[baseband]);
+
+	if ((strstr(cmdline, DISPLAY_DEFAULT_PREFIX) == NULL) &&
+		target_display_panel_node(display_panel_buf,
+		MAX_PANEL_BUF_SIZE))
+		ret |= strbuild_add(&sb, display_panel_buf);
 
 	if (get_target_boot_params(cmdline, boot_into_recovery ? "recoveryfs" :
 								 "system",
 						&target_boot_params) == 0) {
 		have_target_boot_params = 1;
-		cmdline_len += strlen(target_boot_params);
-	}
-
-	/* Determine correct androidboot.baseband to use */
-	switch(target_baseband())
-	{
-		case BASEBAND_APQ:
-			cmdline_len += strlen(baseband_apq);
-			break;
-
-		case BASEBAND_MSM:
-			cmdline_len += strlen(baseband_msm);
-			break;
-
-		case BASEBAND_CSFB:
-			cmdline_len += strlen(baseband_csfb);
-			break;
-
-		case BASEBAND_SVLTE2A:
-			cmdline_len += strlen(baseband_svlte2a);
-			break;
-
-		case BASEBAND_MDM:
-			cmdline_len += strlen(baseband_mdm);
-			break;
-
-		case BASEBAND_MDM2:
-			cmdline_len += strlen(baseband_mdm2);
-			break;
-
-		case BASEBAND_SGLTE:
-			cmdline_len += strlen(baseband_sglte);
-			break;
-
-		case BASEBAND_SGLTE2:
-			cmdline_len += strlen(baseband_sglte2);
-			break;
-
-		case BASEBAND_DSDA:
-			cmdline_len += strlen(baseband_dsda);
-			break;
-
-		case BASEBAND_DSDA2:
-			cmdline_len += strlen(baseband_dsda2);
-			break;
+		ret |= strbuild_add(&sb, target_boot_params);
 	}
 
-	if (cmdline) {
-		if ((strstr(cmdline, DISPLAY_DEFAULT_PREFIX) == NULL) &&
-			target_display_panel_node(display_panel_buf,
-			MAX_PANEL_BUF_SIZE) &&
-			strlen(display_panel_buf)) {
-			cmdline_len += strlen(display_panel_buf);
-		}
-	}
-
-	if (target_warm_boot()) {
-		warm_boot = true;
-		cmdline_len += strlen(warmboot_cmdline);
-	}
+	ASSERT(!ret);
 
-	if (cmdline_len > 0) {
-		const char *src;
-		unsigned char *dst;
-
-		cmdline_final = (unsigned char*) malloc((cmdline_len + 4) & (~3));
-		ASSERT(cmdline_final != NULL);
-		memset((void *)cmdline_final, 0, sizeof(*cmdline_final));
-		dst = cmdline_final;
-
-		/* Save start ptr for debug print */
-		if (have_cmdline) {
-			src = cmdline;
-			while ((*dst++ = *src++));
-		}
-		if (target_is_emmc_boot()) {
-			src = emmc_cmdline;
-			if (have_cmdline) --dst;
-			have_cmdline = 1;
-			while ((*dst++ = *src++));
-#if USE_BOOTDEV_CMDLINE
-			src = boot_dev_buf;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-#endif
-		}
-
-		src = usb_sn_cmdline;
-		if (have_cmdline) --dst;
-		have_cmdline = 1;
-		while ((*dst++ = *src++));
-		src = sn_buf;
-		if (have_cmdline) --dst;
-		have_cmdline = 1;
-		while ((*dst++ = *src++));
-		if (warm_boot) {
-			if (have_cmdline) --dst;
-			src = warmboot_cmdline;
-			while ((*dst++ = *src++));
-		}
-
-		if (boot_into_recovery && gpt_exists) {
-			src = secondary_gpt_enable;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		if (is_mdtp_activated) {
-			src = mdtp_activated_flag;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		if (boot_into_ffbm) {
-			src = androidboot_mode;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-			src = ffbm_mode_string;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-			src = loglevel;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		} else if (boot_reason_alarm) {
-			src = alarmboot_cmdline;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		} else if (pause_at_bootup) {
-			src = battchg_pause;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		if(target_use_signed_kernel() && auth_kernel_img) {
-			src = auth_kernel;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		switch(target_baseband())
-		{
-			case BASEBAND_APQ:
-				src = baseband_apq;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_MSM:
-				src = baseband_msm;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_CSFB:
-				src = baseband_csfb;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_SVLTE2A:
-				src = baseband_svlte2a;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_MDM:
-				src = baseband_mdm;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_MDM2:
-				src = baseband_mdm2;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_SGLTE:
-				src = baseband_sglte;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_SGLTE2:
-				src = baseband_sglte2;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_DSDA:
-				src = baseband_dsda;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-
-			case BASEBAND_DSDA2:
-				src = baseband_dsda2;
-				if (have_cmdline) --dst;
-				while ((*dst++ = *src++));
-				break;
-		}
-
-		if (strlen(display_panel_buf)) {
-			src = display_panel_buf;
-			if (have_cmdline) --dst;
-			while ((*dst++ = *src++));
-		}
-
-		if (have_target_boot_params) {
-			if (have_cmdline) --dst;
-			src = target_boot_params;
-			while ((*dst++ = *src++));
-			free(target_boot_params);
-		}
-	}
+	cmdline_final = (unsigned char *) strbuild_alloc(&sb);
+	ASSERT(cmdline_final != NULL);
 
+	if (have_target_boot_params)
+		free(target_boot_params);
 
 	if (boot_dev_buf)
 		free(boot_dev_buf);
 
-	if (cmdline_final)
-		dprintf(INFO, "cmdline: %s\n", cmdline_final);
-	else
-		dprintf(INFO, "cmdline is NULL\n");
+	dprintf(INFO, "cmdline: %s\n", cmdline_final);
 	return cmdline_final;
 }
 
@@ -590,7 +401,7 @@ unsigned *atag_cmdline(unsigned *ptr, const char *cmdline)
 	*ptr++ = (n / 4) + 2;
 	*ptr++ = 0x54410009;
 	dest = (char *) ptr;
-	while ((*dest++ = *cmdline++));
+	memcpy(dest, cmdline, cmdline_length + 1);
 	ptr += (n / 4);
 
 	return ptr;
@@ -675,6 +486,8 @@ void boot_linux(void *kernel, unsigned *tags,
 	/* Perform target specific cleanup */
 	target_uninit();
 
+	bs_profile_print();
+
 	dprintf(INFO, "booting linux @ %p, ramdisk @ %p (%d), tags/device tree @ %p\n",
 		entry, ramdisk, ramdisk_size, (void *)tags_phys);
 
@@ -687,6 +500,9 @@ void boot_linux(void *kernel, unsigned *tags,
 	/* do any platform specific cleanup before kernel entry */
 	platform_uninit();
 
+	/* nothing runs the deferred log after this */
+	debug_log_flush();
+
 	arch_disable_cache(UCACHE);
 
 #if ARM_WITH_MMU
@@ -732,6 +548,7 @@ BUF_DMA_ALIGN(dt_buf, BOOT_IMG_MAX_PAGE_SIZE);
 static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
 {
 	int ret;
+	int span;
 
 #if !VERIFIED_BOOT
 #if IMAGE_VERIF_ALGO_SHA1
@@ -745,6 +562,7 @@ static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
 	device.is_tampered = 1;
 
 	dprintf(INFO, "Authenticating boot image (%d): start\n", bootimg_size);
+	span = bs_profile_begin("verify");
 
 #if VERIFIED_BOOT
 	if(boot_into_recovery)
@@ -764,6 +582,7 @@ static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
 					   bootimg_size,
 					   auth_algo);
 #endif
+	bs_profile_end(span);
 	dprintf(INFO, "Authenticating boot image: done return value = %d\n", ret);
 
 	if (ret)
@@ -917,6 +736,7 @@ int boot_linux_from_mmc(void)
 	unsigned char *kernel_start_addr = NULL;
 	unsigned int kernel_size = 0;
 	int rc;
+	int span;
 
 #if DEVICE_TREE
 	struct dt_table *table;
@@ -1101,9 +921,11 @@ int boot_linux_from_mmc(void)
 		out_addr = (unsigned char *)(image_addr + imagesize_actual + page_size);
 		out_avai_len = target_get_max_flash_size() - imagesize_actual - page_size;
 		dprintf(INFO, "decompressing kernel image: start\n");
+		span = bs_profile_begin("decompress-kernel");
 		rc = decompress((unsigned char *)(image_addr + page_size),
 				hdr->kernel_size, out_addr, out_avai_len,
 				&dtb_offset, &out_len);
+		bs_profile_end(span);
 		if (rc)
 		{
 			dprintf(CRITICAL, "decompressing kernel image failed!!!\n");
@@ -1175,9 +997,11 @@ int boot_linux_from_mmc(void)
 			out_addr += out_len;
 			out_avai_len -= out_len;
 			dprintf(INFO, "decompressing dtb: start\n");
+			span = bs_profile_begin("decompress-dtb");
 			rc = decompress((unsigned char *)dt_table_offset + dt_entry.offset,
 					dt_entry.size, out_addr, out_avai_len,
 					&compressed_size, &dtb_size);
+			bs_profile_end(span);
 			if (rc)
 			{
 				dprintf(CRITICAL, "decompressing dtb failed!!!\n");
@@ -2939,6 +2763,24 @@ void cmd_oem_devinfo(const char *arg, void *data, unsigned sz)
 	fastboot_okay("");
 }
 
+static void oem_trace_entry(const struct ktrace_entry *entry, void *arg)
+{
+	uint32_t *prev = (uint32_t *)arg;
+	char response[MAX_RSP_SIZE];
+
+	ktrace_format(entry, *prev, response, sizeof(response));
+	*prev = entry->timestamp;
+	fastboot_info(response);
+}
+
+void cmd_oem_trace(const char *arg, void *data, unsigned sz)
+{
+	uint32_t prev = 0;
+
+	ktrace_for_every(oem_trace_entry, &prev);
+	fastboot_okay("");
+}
+
 void cmd_preflash(const char *arg, void *data, unsigned sz)
 {
 	fastboot_okay("");
@@ -2946,6 +2788,9 @@ void cmd_preflash(const char *arg, void *data, unsigned sz)
 
 static uint8_t logo_header[LOGO_IMG_HEADER_SIZE];
 
+/* compressed splash images are read and decoded this much at a time */
+#define SPLASH_CHUNK_SIZE (256 * 1024)
+
 int splash_screen_check_header(logo_img_header *header)
 {
 	if (memcmp(header->magic, LOGO_IMG_MAGIC, 8))
@@ -3073,7 +2918,9 @@ int splash_screen_mmc()
 
 	if (fb_display) {
 		if (header->type && (header->blocks != 0)) { /* 1 RLE24 compressed data */
-			base += LOGO_IMG_OFFSET;
+			struct fbcon_rle_ctx ctx;
+			uint8_t *chunk, *data;
+			uint32_t avail, len;
 
 			realsize =  header->blocks * 512;
 			readsize =  ROUNDUP((realsize + LOGO_IMG_HEADER_SIZE), blocksize) - blocksize;
@@ -3083,12 +2930,42 @@ int splash_screen_mmc()
 						|| (header->height != fb_display->height))
 				fbcon_clear();
 
-			if (mmc_read(ptn + blocksize, (uint32_t *)(base + blocksize), readsize)) {
-				dprintf(CRITICAL, "ERROR: Cannot read splash image from partition\n");
+			if (fbcon_extract_start(&ctx, header))
 				return -1;
-			}
 
-			fbcon_extract_to_screen(header, (base + LOGO_IMG_HEADER_SIZE));
+			/*
+			 * stream the logo through a small staging area instead of reading
+			 * it whole, so decoding a chunk doesn't wait for the whole image to
+			 * be read and the logo needs no image sized buffer. the first block
+			 * is already there, right behind the header. a run cut off at the
+			 * end of a chunk is moved in front of the next one, over the header
+			 * which is no longer needed.
+			 */
+			data = base + LOGO_IMG_OFFSET + LOGO_IMG_HEADER_SIZE;
+			avail = blocksize - LOGO_IMG_HEADER_SIZE;
+			chunk = base + LOGO_IMG_OFFSET + blocksize;
+			ptn += blocksize;
+
+			for (;;) {
+				len = fbcon_extract_chunk(&ctx, data, avail);
+				data += len;
+				avail -= len;
+
+				if (fbcon_extract_done(&ctx) || readsize == 0)
+					break;
+
+				memmove(chunk - avail, data, avail);
+				data = chunk - avail;
+
+				len = MIN(readsize, ROUNDUP(SPLASH_CHUNK_SIZE, blocksize));
+				if (mmc_read(ptn, (uint32_t *)chunk, len)) {
+					dprintf(CRITICAL, "ERROR: Cannot read splash image from partition\n");
+					return -1;
+				}
+				ptn += len;
+				readsize -= len;
+				avail += len;
+			}
 		} else { /* 2 Raw BGR data */
 
 			if ((header->width > fb_display->width) || (header->height > fb_display->height)) {
@@ -3157,6 +3034,18 @@ static void get_partition_size(const char *arg, char *response)
 	return;
 }
 
+/*
+ * fastboot getvar boot-profile: the boot profile as INFO lines and
+ * the number of entries in it as the value.
+ */
+static void report_boot_profile(void)
+{
+	unsigned count;
+
+	count = bs_profile_dump(fastboot_info);
+	snprintf(boot_profile_summary, MAX_RSP_SIZE, "%u entries", count);
+}
+
 /*
  * Publish the partition type & size info
  * fastboot getvar will publish the required information.
@@ -3211,6 +3100,7 @@ void aboot_fastboot_register_commands(void)
 											{"oem lock", cmd_oem_lock},
 											{"oem verified", cmd_oem_verified},
 											{"oem device-info", cmd_oem_devinfo},
+											{"oem trace", cmd_oem_trace},
 											{"preflash", cmd_preflash},
 											{"oem enable-charger-screen", cmd_oem_enable_charger_screen},
 											{"oem disable-charger-screen", cmd_oem_disable_charger_screen},
@@ -3254,6 +3144,8 @@ void aboot_fastboot_register_commands(void)
 			(const char *) panel_display_mode);
 	fastboot_publish("version-bootloader", (const char *) device.bootloader_version);
 	fastboot_publish("version-baseband", (const char *) device.radio_version);
+	fastboot_publish_report("boot-profile", (const char *) boot_profile_summary,
+			report_boot_profile);
 }
 
 void aboot_init(const struct app_descriptor *app)
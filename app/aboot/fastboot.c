@@ -31,6 +31,7 @@
 #include <debug.h>
 #include <string.h>
 #include <stdlib.h>
+#include <strbuild.h>
 #include <platform.h>
 #include <target.h>
 #include <kernel/thread.h>
@@ -60,7 +61,8 @@ typedef struct
 
 usb_controller_interface_t usb_if;
 
-#define MAX_USBFS_BULK_SIZE (32 * 1024)
+/* A hsusb request is a chain of TDs the controller runs through on its own */
+#define MAX_USBHS_BULK_SIZE (4 * 1024 * 1024)
 #define MAX_USBSS_BULK_SIZE (0x1000000)
 
 void boot_linux(void *bootimg, unsigned sz);
@@ -124,6 +126,7 @@ struct fastboot_var {
 	struct fastboot_var *next;
 	const char *name;
 	const char *value;
+	void (*report)(void);
 };
 
 static struct fastboot_cmd *cmdlist;
@@ -145,12 +148,19 @@ void fastboot_register(const char *prefix,
 static struct fastboot_var *varlist;
 
 void fastboot_publish(const char *name, const char *value)
+{
+	fastboot_publish_report(name, value, NULL);
+}
+
+void fastboot_publish_report(const char *name, const char *value,
+			     void (*report)(void))
 {
 	struct fastboot_var *var;
 	var = malloc(sizeof(*var));
 	if (var) {
 		var->name = name;
 		var->value = value;
+		var->report = report;
 		var->next = varlist;
 		varlist = var;
 	}
@@ -310,7 +320,7 @@ static int hsusb_usb_read(void *_buf, unsigned len)
 		goto oops;
 
 	while (len > 0) {
-		xfer = (len > MAX_USBFS_BULK_SIZE) ? MAX_USBFS_BULK_SIZE : len;
+		xfer = (len > MAX_USBHS_BULK_SIZE) ? MAX_USBHS_BULK_SIZE : len;
 		req->buf = (unsigned char *)PA((addr_t)buf);
 		req->length = xfer;
 		req->complete = req_complete;
@@ -356,7 +366,7 @@ static int hsusb_usb_write(void *buf, unsigned len)
 		goto oops;
 
 	while (len > 0) {
-		xfer = (len > MAX_USBFS_BULK_SIZE) ? MAX_USBFS_BULK_SIZE : len;
+		xfer = (len > MAX_USBHS_BULK_SIZE) ? MAX_USBHS_BULK_SIZE : len;
 		req->buf = (unsigned char *)PA((addr_t)_buf);
 		req->length = xfer;
 		req->complete = req_complete;
@@ -431,15 +441,17 @@ void fastboot_okay(const char *info)
 static void getvar_all()
 {
 	struct fastboot_var *var;
+	struct strbuild sb;
 	char getvar_all[64];
 
 	for (var = varlist; var; var = var->next)
 	{
-		strlcpy((char *) getvar_all, var->name, sizeof(getvar_all));
-		strlcat((char *) getvar_all, ":", sizeof(getvar_all));
-		strlcat((char *) getvar_all, var->value, sizeof(getvar_all));
+		strbuild_init(&sb);
+		strbuild_add(&sb, var->name);
+		strbuild_add_len(&sb, ":", 1);
+		strbuild_add(&sb, var->value);
+		strbuild_copy(&sb, getvar_all, sizeof(getvar_all));
 		fastboot_info(getvar_all);
-		memset((void *) getvar_all, '\0', sizeof(getvar_all));
 	}
 	fastboot_okay("");
 }
@@ -456,6 +468,8 @@ static void cmd_getvar(const char *arg, void *data, unsigned sz)
 
 	for (var = varlist; var; var = var->next) {
 		if (!strcmp(var->name, arg)) {
+			if (var->report)
+				var->report();
 			fastboot_okay(var->value);
 			return;
 		}
@@ -48,6 +48,12 @@ void fastboot_register(const char *prefix,
 /* publish a variable readable by the built-in getvar command */
 void fastboot_publish(const char *name, const char *value);
 
+/* publish a variable whose getvar first has report() send INFO lines,
+ * before the value is returned; "getvar all" only lists the value
+ */
+void fastboot_publish_report(const char *name, const char *value,
+			     void (*report)(void));
+
 /* only callable from within a command handler */
 void fastboot_okay(const char *result);
 void fastboot_fail(const char *reason);
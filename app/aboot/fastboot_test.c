@@ -50,6 +50,7 @@ void cmd_oem_runtests()
 {
 	dprintf(INFO, "Running LK tests ... \n");
 
+#if UFS_SUPPORT
 	// Test boot lun enable for UFS
 	if (!platform_boot_dev_isemmc())
 	{
@@ -71,7 +72,7 @@ void cmd_oem_runtests()
 		else
 			dprintf(INFO, "UFS Boot LUN En TEST: [ FAIL ]\n");
 	}
-
+#endif
 
 #if LPAE
 	ramdump_table_map();
@@ -117,5 +118,45 @@ void cmd_oem_runtests()
 
 	printf_tests();
 
+	if (!strbuild_tests())
+		dprintf(INFO, "String builder test: [ PASS ]\n");
+	else
+		dprintf(INFO, "String builder test: [ FAIL ]\n");
+
+#if WITH_LIB_GFX
+	if (!gfx_tests())
+		dprintf(INFO, "GFX surface test: [ PASS ]\n");
+	else
+		dprintf(INFO, "GFX surface test: [ FAIL ]\n");
+#endif
+
+#if MMC_SDHCI_SUPPORT
+	if (!cmdq_tests())
+		dprintf(INFO, "CMDQ engine test: [ PASS ]\n");
+	else
+		dprintf(INFO, "CMDQ engine test: [ FAIL ]\n");
+#endif
+
+#if UBI_TESTS
+	if (!ubi_tests())
+		dprintf(INFO, "UBI test: [ PASS ]\n");
+	else
+		dprintf(INFO, "UBI test: [ FAIL ]\n");
+#endif
+
+#if HSUSB_TESTS
+	if (!hsusb_tests())
+		dprintf(INFO, "HSUSB TD chain test: [ PASS ]\n");
+	else
+		dprintf(INFO, "HSUSB TD chain test: [ FAIL ]\n");
+#endif
+
+#if WITH_LIB_LIBFDT
+	if (!fdt_batch_tests())
+		dprintf(INFO, "FDT batch test: [ PASS ]\n");
+	else
+		dprintf(INFO, "FDT batch test: [ FAIL ]\n");
+#endif
+
 	fastboot_okay("");
 }
@@ -226,6 +226,180 @@ static void validate_memset(void)
 	}
 }
 
+/* simple bytewise reference versions to validate the optimized routines against */
+static void *ref_memmove(void *dst, const void *src, size_t len)
+{
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+
+	if (d < s) {
+		while (len--)
+			*d++ = *s++;
+	} else {
+		while (len--)
+			d[len] = s[len];
+	}
+	return dst;
+}
+
+static int ref_memcmp(const void *a, const void *b, size_t len)
+{
+	const uint8_t *x = a;
+	const uint8_t *y = b;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (x[i] != y[i])
+			return x[i] - y[i];
+	}
+	return 0;
+}
+
+static void validate_memmove(void)
+{
+	size_t srcalign, dstalign, size;
+	const size_t maxsize = 256;
+
+	printf("testing memmove for correctness\n");
+
+	/* src and dst within the same buffer, overlapping in both directions */
+	for (srcalign = 0; srcalign < 64; srcalign++) {
+		for (dstalign = 0; dstalign < 64; dstalign++) {
+			for (size = 0; size < maxsize; size++) {
+				fillbuf(src, maxsize * 2, 567);
+				fillbuf(src2, maxsize * 2, 567);
+
+				memmove(src + dstalign, src + srcalign, size);
+				ref_memmove(src2 + dstalign, src2 + srcalign, size);
+
+				if (ref_memcmp(src, src2, maxsize * 2) != 0) {
+					printf("error! srcalign %zu, dstalign %zu, size %zu\n", srcalign, dstalign, size);
+				}
+			}
+		}
+	}
+}
+
+static void validate_memcmp(void)
+{
+	size_t align1, align2, size, pos;
+	const size_t maxsize = 128;
+	int ret, exp;
+
+	printf("testing memcmp for correctness\n");
+
+	for (align1 = 0; align1 < 8; align1++) {
+		for (align2 = 0; align2 < 8; align2++) {
+			for (size = 0; size < maxsize; size++) {
+				fillbuf(src + align1, size, 567);
+				fillbuf(dst + align2, size, 567);
+
+				if (memcmp(src + align1, dst + align2, size) != 0)
+					printf("error! align %zu/%zu, size %zu: equal buffers differ\n", align1, align2, size);
+
+				/* a difference at every position, in both directions */
+				for (pos = 0; pos < size; pos++) {
+					dst[align2 + pos] ^= 0x80;
+					ret = memcmp(src + align1, dst + align2, size);
+					exp = ref_memcmp(src + align1, dst + align2, size);
+					if ((ret < 0) != (exp < 0) || (ret > 0) != (exp > 0))
+						printf("error! align %zu/%zu, size %zu, pos %zu: ret %d, expected %d\n",
+								align1, align2, size, pos, ret, exp);
+					dst[align2 + pos] ^= 0x80;
+				}
+			}
+		}
+	}
+}
+
+static void validate_strlen(void)
+{
+	size_t align, len;
+	const size_t maxsize = 256;
+
+	printf("testing strlen for correctness\n");
+
+	for (align = 0; align < 8; align++) {
+		for (len = 0; len < maxsize; len++) {
+			memset(src, 'a', maxsize * 2);
+			src[align + len] = 0;
+			if (strlen((char *)src + align) != len)
+				printf("error! align %zu, len %zu, got %zu\n", align, len, strlen((char *)src + align));
+		}
+	}
+}
+
+static void bench_memmove(void)
+{
+	time_t fwd, bkwd;
+	size_t shift;
+	int i;
+
+	printf("memmove speed test\n");
+	thread_sleep(200); // let the debug string clear the serial port
+
+	/* the overlapping cases are what relocating a kernel or ramdisk looks like */
+	for (shift = 4; shift <= 4096; shift <<= 2) {
+		fwd = current_time();
+		for (i = 0; i < ITERATIONS; i++)
+			memmove(src, src + shift, BUFFER_SIZE - shift);
+		fwd = current_time() - fwd;
+
+		bkwd = current_time();
+		for (i = 0; i < ITERATIONS; i++)
+			memmove(src + shift, src, BUFFER_SIZE - shift);
+		bkwd = current_time() - bkwd;
+
+		printf("overlap %zu\n", shift);
+		printf("   down %u msecs, %llu bytes/sec\n", fwd, BUFFER_SIZE * ITERATIONS * 1000ULL / (fwd ? fwd : 1));
+		printf("   up   %u msecs, %llu bytes/sec\n", bkwd, BUFFER_SIZE * ITERATIONS * 1000ULL / (bkwd ? bkwd : 1));
+	}
+}
+
+static void bench_memcmp(void)
+{
+	time_t libc, ref;
+	int i;
+
+	printf("memcmp speed test\n");
+	thread_sleep(200); // let the debug string clear the serial port
+
+	memset(src, 0x5a, BUFFER_SIZE);
+	memset(dst, 0x5a, BUFFER_SIZE);
+
+	libc = current_time();
+	for (i = 0; i < ITERATIONS; i++)
+		memcmp(src, dst, BUFFER_SIZE);
+	libc = current_time() - libc;
+
+	ref = current_time();
+	for (i = 0; i < ITERATIONS; i++)
+		ref_memcmp(src, dst, BUFFER_SIZE);
+	ref = current_time() - ref;
+
+	printf("   libc memcmp %u msecs, %llu bytes/sec\n", libc, BUFFER_SIZE * ITERATIONS * 1000ULL / (libc ? libc : 1));
+	printf("   byte memcmp %u msecs, %llu bytes/sec\n", ref, BUFFER_SIZE * ITERATIONS * 1000ULL / (ref ? ref : 1));
+}
+
+static void bench_strlen(void)
+{
+	time_t t;
+	int i;
+
+	printf("strlen speed test\n");
+	thread_sleep(200); // let the debug string clear the serial port
+
+	memset(src, 'a', BUFFER_SIZE);
+	src[BUFFER_SIZE - 1] = 0;
+
+	t = current_time();
+	for (i = 0; i < ITERATIONS; i++)
+		strlen((char *)src);
+	t = current_time() - t;
+
+	printf("   libc strlen %u msecs, %llu bytes/sec\n", t, BUFFER_SIZE * ITERATIONS * 1000ULL / (t ? t : 1));
+}
+
 #if defined(WITH_LIB_CONSOLE)
 #include <lib/console.h>
 
@@ -254,12 +428,24 @@ usage:
 			validate_memset();
 		} else if (!strcmp(argv[2].str, "memcpy_overlap")) {
 			validate_memcpy_overlap();
+		} else if (!strcmp(argv[2].str, "memmove")) {
+			validate_memmove();
+		} else if (!strcmp(argv[2].str, "memcmp")) {
+			validate_memcmp();
+		} else if (!strcmp(argv[2].str, "strlen")) {
+			validate_strlen();
 		}
 	} else if (!strcmp(argv[1].str, "bench")) {
 		if (!strcmp(argv[2].str, "memcpy")) {
 			bench_memcpy();
 		} else if (!strcmp(argv[2].str, "memset")) {
 			bench_memset();
+		} else if (!strcmp(argv[2].str, "memmove")) {
+			bench_memmove();
+		} else if (!strcmp(argv[2].str, "memcmp")) {
+			bench_memcmp();
+		} else if (!strcmp(argv[2].str, "strlen")) {
+			bench_strlen();
 		}
 	} else {
 		goto usage;
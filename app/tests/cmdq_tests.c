@@ -0,0 +1,314 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <app/tests.h>
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sdhci.h>
+#include <sdhci_cmdq.h>
+
+/*
+ * Register level model of a CQHCI command queue engine & the card behind
+ * it, so the cmdq engine driver can be tested without the hardware.
+ *
+ * Doorbell writes only mark tasks pending; the model runs one pending
+ * task, highest slot first, every time the driver reads TCN or IS.  That
+ * completes tasks out of order & while others are still queued, as the
+ * real engine may.
+ */
+#define CMDQ_MODEL_BLKS     1024
+#define CMDQ_MODEL_BLK_SZ   512
+
+struct cmdq_model {
+	uint32_t regs[CMDQ_REG_SPACE / 4];
+	uint32_t pending;
+	uint8_t *card;
+	uint32_t tasks;
+	uint32_t max_queued;
+	bool bad;             /* Reading or writing bad_blk is a data CRC error */
+	uint32_t bad_blk;
+	uint32_t host_err;    /* The host's error status */
+	uint32_t err_polls;   /* TCN reads while it was set */
+};
+
+#define MODEL_REG(m, r) ((m)->regs[(r) / 4])
+
+static uint32_t bitcount(uint32_t v)
+{
+	uint32_t n = 0;
+
+	for (; v; v &= v - 1)
+		n++;
+
+	return n;
+}
+
+static void cmdq_model_set_is(struct cmdq_model *m, uint32_t bits)
+{
+	MODEL_REG(m, CMDQ_IS_REG) |= bits & MODEL_REG(m, CMDQ_ISTE_REG);
+}
+
+/* Run the task in slot, as the engine would: follow the link to the transfer descriptors */
+static void cmdq_model_run(struct cmdq_model *m, uint32_t slot)
+{
+	bool dma64 = !!(MODEL_REG(m, CMDQ_CFG_REG) & CMDQ_TASK_DESC_SZ_128);
+	uint32_t slot_sz = dma64 ? 32 : 16;
+	uint32_t tran_sz = dma64 ? 16 : 8;
+	uint32_t *task = (uint32_t *) (addr_t) (MODEL_REG(m, CMDQ_TDLBA_REG) + slot * slot_sz);
+	uint32_t *link = task + (slot_sz / 8);
+	uint8_t *tran;
+	uint32_t attr = task[0];
+	uint32_t blk = task[1];
+	uint32_t count = (attr >> 16) & 0xFFFF;
+	uint32_t moved = 0;
+	uint32_t len;
+	uint32_t *d;
+	uint8_t *card;
+
+	m->pending &= ~(1U << slot);
+	MODEL_REG(m, CMDQ_TDBR_REG) &= ~(1U << slot);
+
+	if ((attr & (CMDQ_DESC_VALID | CMDQ_DESC_ACT_MASK)) != (CMDQ_DESC_VALID | CMDQ_DESC_ACT(CMDQ_ACT_TASK)) ||
+		(link[0] & (CMDQ_DESC_VALID | CMDQ_DESC_ACT_MASK)) != (CMDQ_DESC_VALID | CMDQ_DESC_ACT(CMDQ_ACT_LINK)) ||
+		blk + count > CMDQ_MODEL_BLKS) {
+		/* Response error: report the task, the engine stops processing */
+		MODEL_REG(m, CMDQ_TERRI_REG) = CMDQ_TERRI_RESP_VALID | (slot << 8) |
+			((attr & CMDQ_TASK_DATA_DIR_READ) ? 46 : 47);
+		MODEL_REG(m, CMDQ_TDBR_REG) |= (1U << slot);
+		cmdq_model_set_is(m, CMDQ_IS_RED);
+		return;
+	}
+
+	if (m->bad && m->bad_blk >= blk && m->bad_blk < blk + count) {
+		/* Data error: the host reports it, the engine stops processing */
+		MODEL_REG(m, CMDQ_TERRI_REG) = CMDQ_TERRI_DATA_VALID | (slot << 24) |
+			((attr & CMDQ_TASK_DATA_DIR_READ) ? 46 : 47) << 16;
+		MODEL_REG(m, CMDQ_TDBR_REG) |= (1U << slot);
+		m->host_err = SDHCI_DAT_CRC_MASK;
+		return;
+	}
+
+	card = m->card + blk * CMDQ_MODEL_BLK_SZ;
+	tran = (uint8_t *) (addr_t) link[1];
+	do {
+		d = (uint32_t *) tran;
+		len = (d[0] >> 16) ? (d[0] >> 16) : CMDQ_TRAN_LINE_SZ;
+		if (attr & CMDQ_TASK_DATA_DIR_READ)
+			memcpy((void *) (addr_t) d[1], card + moved, len);
+		else
+			memcpy(card + moved, (void *) (addr_t) d[1], len);
+		moved += len;
+		tran += tran_sz;
+	} while (!(d[0] & CMDQ_DESC_END));
+
+	if (moved != count * CMDQ_MODEL_BLK_SZ)
+		dprintf(CRITICAL, "cmdq model: slot %u moved %u bytes for %u blocks\n", slot, moved, count);
+
+	m->tasks++;
+	MODEL_REG(m, CMDQ_TCN_REG) |= (1U << slot);
+	cmdq_model_set_is(m, CMDQ_IS_TCC);
+}
+
+static uint32_t cmdq_model_read(struct cmdq_host *cq, uint32_t reg)
+{
+	struct cmdq_model *m = cq->priv;
+
+	if (reg == CMDQ_TCN_REG && m->host_err && !(MODEL_REG(m, CMDQ_CTL_REG) & CMDQ_HALT))
+		m->err_polls++;
+
+	if ((reg == CMDQ_TCN_REG || reg == CMDQ_IS_REG) && m->pending &&
+		!(MODEL_REG(m, CMDQ_IS_REG) & CMDQ_IS_RED) && !m->host_err &&
+		!(MODEL_REG(m, CMDQ_CTL_REG) & CMDQ_HALT))
+		cmdq_model_run(m, 31 - __builtin_clz(m->pending));
+
+	return MODEL_REG(m, reg);
+}
+
+static uint32_t cmdq_model_host_err(struct cmdq_host *cq)
+{
+	struct cmdq_model *m = cq->priv;
+
+	return m->host_err;
+}
+
+static void cmdq_model_write(struct cmdq_host *cq, uint32_t val, uint32_t reg)
+{
+	struct cmdq_model *m = cq->priv;
+
+	switch (reg) {
+		case CMDQ_TDBR_REG:
+			if (!(MODEL_REG(m, CMDQ_CFG_REG) & CMDQ_ENABLE))
+				break;
+			if (val & MODEL_REG(m, CMDQ_TDBR_REG))
+				dprintf(CRITICAL, "cmdq model: doorbell rung for a busy slot: 0x%08x\n", val);
+			m->pending |= val;
+			MODEL_REG(m, CMDQ_TDBR_REG) |= val;
+			if (bitcount(MODEL_REG(m, CMDQ_TDBR_REG)) > m->max_queued)
+				m->max_queued = bitcount(MODEL_REG(m, CMDQ_TDBR_REG));
+			break;
+		case CMDQ_TCN_REG:
+		case CMDQ_IS_REG:
+			/* Write 1 to clear */
+			MODEL_REG(m, reg) &= ~val;
+			break;
+		case CMDQ_TCLR_REG:
+			m->pending &= ~val;
+			MODEL_REG(m, CMDQ_TDBR_REG) &= ~val;
+			break;
+		case CMDQ_CTL_REG:
+			MODEL_REG(m, reg) = val & CMDQ_HALT;
+			if (val & CMDQ_HALT)
+				cmdq_model_set_is(m, CMDQ_IS_HAC);
+			if ((val & CMDQ_CLEAR_ALL_TASKS) && (val & CMDQ_HALT)) {
+				m->pending = 0;
+				MODEL_REG(m, CMDQ_TDBR_REG) = 0;
+				MODEL_REG(m, CMDQ_TERRI_REG) = 0;
+				cmdq_model_set_is(m, CMDQ_IS_TCL);
+			}
+			break;
+		default:
+			MODEL_REG(m, reg) = val;
+			break;
+	}
+}
+
+static void cmdq_test_fill(uint8_t *buf, uint32_t len, uint32_t seed)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (uint8_t) ((i * 7) ^ (i >> 9) ^ seed);
+}
+
+static int cmdq_test_one(bool dma64, uint32_t depth, uint32_t task_blks)
+{
+	struct cmdq_host cq;
+	struct cmdq_model *m;
+	uint8_t *src, *dst;
+	uint32_t len = CMDQ_MODEL_BLKS * CMDQ_MODEL_BLK_SZ;
+	uint32_t blks = CMDQ_MODEL_BLKS - 24;
+	int fail = 0;
+
+	m = calloc(1, sizeof(*m));
+	src = memalign(CACHE_LINE, len);
+	dst = memalign(CACHE_LINE, len);
+	if (!m || !src || !dst || cmdq_host_init(&cq, 0, depth, dma64)) {
+		dprintf(CRITICAL, "cmdq test: out of memory\n");
+		fail = 1;
+		goto out;
+	}
+
+	m->card = calloc(1, len);
+	if (!m->card) {
+		fail = 1;
+		goto out;
+	}
+
+	cq.read = cmdq_model_read;
+	cq.write = cmdq_model_write;
+	cq.host_err = cmdq_model_host_err;
+	cq.priv = m;
+	cq.max_task_blks = task_blks;
+
+	cmdq_test_fill(src, len, depth);
+
+	/* Write then read back, at an offset, more tasks than there are slots */
+	cmdq_enable(&cq, 1);
+	if (cmdq_transfer(&cq, src, 16, blks, false))
+		fail = 1;
+	if (memcmp(m->card + 16 * CMDQ_MODEL_BLK_SZ, src, blks * CMDQ_MODEL_BLK_SZ))
+		fail = 1;
+
+	memset(dst, 0, len);
+	if (cmdq_transfer(&cq, dst, 16, blks, true))
+		fail = 1;
+	if (memcmp(dst, src, blks * CMDQ_MODEL_BLK_SZ))
+		fail = 1;
+
+	if (m->max_queued != MIN(depth, (blks + task_blks - 1) / task_blks))
+		fail = 1;
+
+	/* A task past the end of the card must fail & leave the engine usable */
+	if (!cmdq_transfer(&cq, dst, CMDQ_MODEL_BLKS - 8, 16, true))
+		fail = 1;
+	if (MODEL_REG(m, CMDQ_TDBR_REG) || m->pending)
+		fail = 1;
+	cmdq_disable(&cq);
+
+	/*
+	 * So must a data error, which only the host reports, as soon as the
+	 * driver next looks rather than after the timeout
+	 */
+	cmdq_enable(&cq, 1);
+	m->bad = true;
+	m->bad_blk = 120;
+	if (!cmdq_transfer(&cq, dst, 100, 64, true) || m->err_polls > 1)
+		fail = 1;
+	if (MODEL_REG(m, CMDQ_TDBR_REG) || m->pending)
+		fail = 1;
+	cmdq_disable(&cq);
+	/* The mmc layer clears the error & resets the host */
+	m->bad = false;
+	m->host_err = 0;
+
+	cmdq_enable(&cq, 1);
+	memset(dst, 0, len);
+	if (cmdq_transfer(&cq, dst, 0, 8, true) || memcmp(dst, m->card, 8 * CMDQ_MODEL_BLK_SZ))
+		fail = 1;
+	cmdq_disable(&cq);
+	if (MODEL_REG(m, CMDQ_CFG_REG) & CMDQ_ENABLE)
+		fail = 1;
+
+	dprintf(INFO, "cmdq test: %s descriptors, depth %u, %u blocks/task: %u tasks, %u queued at most: %s\n",
+			dma64 ? "64 bit" : "32 bit", cq.num_slots, task_blks, m->tasks, m->max_queued,
+			fail ? "FAIL" : "PASS");
+
+out:
+	if (m)
+		free(m->card);
+	free(m);
+	free(src);
+	free(dst);
+	free(cq.task_desc);
+	free(cq.tran_desc);
+
+	return fail;
+}
+
+int cmdq_tests(void)
+{
+	int fail = 0;
+
+	fail |= cmdq_test_one(false, 4, 160);
+	fail |= cmdq_test_one(true, 4, 160);
+	fail |= cmdq_test_one(false, 32, 8);
+	fail |= cmdq_test_one(true, 32, CMDQ_MAX_TASK_BLKS);
+
+	return fail ? -1 : 0;
+}
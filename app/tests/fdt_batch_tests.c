@@ -0,0 +1,425 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <app/tests.h>
+#include <debug.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if WITH_LIB_LIBFDT
+#include <libfdt.h>
+#include <fdt_batch.h>
+
+/*
+ * Every case is applied to one copy of a blob with the plain libfdt calls
+ * and queued on a batch for another copy, then the two are walked node by
+ * node and property by property.  Property order is not compared: libfdt
+ * puts new properties first in a node, the batch puts them last.
+ *
+ * The blob is built the way the msm dtbs look, a few KB of soc nodes
+ * after the nodes update_device_tree() edits, so the commit has to move
+ * most of it.
+ */
+#define FDT_TEST_BUF_SIZE	(32 * 1024)
+#define FDT_TEST_SOC_NODES	48
+
+enum fdt_test_op_type {
+	FDT_TEST_SET,
+	FDT_TEST_APPEND,
+	FDT_TEST_DELETE,
+	FDT_TEST_NODE,
+};
+
+struct fdt_test_op {
+	enum fdt_test_op_type type;
+	const char *path;	/* node, the parent for FDT_TEST_NODE */
+	const char *name;	/* property, the new node for FDT_TEST_NODE */
+	const void *val;
+	int len;
+};
+
+struct fdt_test_case {
+	const char *name;
+	const struct fdt_test_op *ops;
+	int count;
+};
+
+static const uint32_t reg_one[] = { 0x00000080, 0x00000020 };
+static const uint32_t reg_three[] = {
+	0x00000080, 0x00000020, 0x00000090, 0x00000010,
+	0x000000a0, 0x00000040 };
+static const uint32_t initrd[] = { 0x00000082 };
+static const uint32_t log_reg[] = { 0x0000f68f, 0x00004000 };
+static const char bootargs[] = "console=ttyHSL0,115200,n8 androidboot.console=ttyHSL0";
+static const char bootargs_short[] = "quiet";
+static const char bootargs_more[] = " androidboot.serialno=1234abcd";
+static const char model[] = "Qualcomm Technologies, Inc. MSM 8916 MTP";
+static const char profile_names[] = "dt-update\0kernel-load\0splash";
+static const uint32_t profile_timings[] = {
+	0x00001000, 0x00000200, 0x00002000, 0x00080000,
+	0x00000800, 0xffffffff };
+static const char log_compat[] = "lk,log-buffer";
+static const char soc_compat[] = "qcom,msm-test-v2\0qcom,msm-test";
+
+#define FDT_TEST_STR(s)		(s), sizeof(s)
+#define FDT_TEST_VAL(v)		(v), sizeof(v)
+
+/* a new property whose name the strings block already has */
+static const struct fdt_test_op fdt_test_add[] = {
+	{ FDT_TEST_SET, "/chosen", "reg", FDT_TEST_VAL(reg_one) },
+	{ FDT_TEST_SET, "/soc/node@17", "status", FDT_TEST_STR("okay") },
+};
+
+/* a property set again to a value of another length, longer and shorter */
+static const struct fdt_test_op fdt_test_replace[] = {
+	{ FDT_TEST_SET, "/memory", "reg", FDT_TEST_VAL(reg_three) },
+	{ FDT_TEST_SET, "/chosen", "bootargs", FDT_TEST_STR(bootargs_more) },
+	{ FDT_TEST_SET, "/", "model", FDT_TEST_STR(model) },
+	{ FDT_TEST_SET, "/soc/node@2f", "compatible", FDT_TEST_VAL(soc_compat) },
+	{ FDT_TEST_SET, "/soc/node@2f", "reg", FDT_TEST_VAL(reg_one) },
+};
+
+/* appends, a delete, and edits on top of earlier edits */
+static const struct fdt_test_op fdt_test_append[] = {
+	{ FDT_TEST_APPEND, "/chosen", "bootargs", FDT_TEST_STR(bootargs_more) },
+	{ FDT_TEST_DELETE, "/soc/node@0", "status", NULL, 0 },
+	{ FDT_TEST_SET, "/memory", "reg", FDT_TEST_VAL(reg_one) },
+	{ FDT_TEST_APPEND, "/memory", "reg", FDT_TEST_VAL(reg_three) },
+	{ FDT_TEST_APPEND, "/chosen", "bootargs", FDT_TEST_STR(bootargs_short) },
+};
+
+/* new nodes, one of them in a node that already has subnodes */
+static const struct fdt_test_op fdt_test_node[] = {
+	{ FDT_TEST_NODE, "/chosen", "lk-boot-profile", NULL, 0 },
+	{ FDT_TEST_NODE, "/reserved-memory", "lk_log@8f600000", NULL, 0 },
+	{ FDT_TEST_SET, "/reserved-memory/lk_log@8f600000", "reg",
+	  FDT_TEST_VAL(log_reg) },
+	{ FDT_TEST_SET, "/reserved-memory/lk_log@8f600000", "no-map", NULL, 0 },
+	{ FDT_TEST_NODE, "/soc", "empty", NULL, 0 },
+};
+
+/* names the strings block does not have */
+static const struct fdt_test_op fdt_test_string[] = {
+	{ FDT_TEST_SET, "/chosen", "linux,initrd-start", FDT_TEST_VAL(initrd) },
+	{ FDT_TEST_SET, "/chosen", "linux,initrd-end", FDT_TEST_VAL(initrd) },
+	{ FDT_TEST_SET, "/memory", "linux,initrd-end", FDT_TEST_VAL(initrd) },
+	{ FDT_TEST_APPEND, "/soc/node@5", "lk,appended", FDT_TEST_VAL(reg_one) },
+};
+
+/* all of it together, as update_device_tree() queues it */
+static const struct fdt_test_op fdt_test_boot[] = {
+	{ FDT_TEST_SET, "/memory", "reg", FDT_TEST_VAL(reg_three) },
+	{ FDT_TEST_APPEND, "/chosen", "bootargs", FDT_TEST_STR(bootargs_more) },
+	{ FDT_TEST_SET, "/chosen", "linux,initrd-start", FDT_TEST_VAL(initrd) },
+	{ FDT_TEST_SET, "/chosen", "linux,initrd-end", FDT_TEST_VAL(initrd) },
+	{ FDT_TEST_NODE, "/chosen", "lk-boot-profile", NULL, 0 },
+	{ FDT_TEST_SET, "/chosen/lk-boot-profile", "names",
+	  FDT_TEST_VAL(profile_names) },
+	{ FDT_TEST_SET, "/chosen/lk-boot-profile", "timings",
+	  FDT_TEST_VAL(profile_timings) },
+	{ FDT_TEST_NODE, "/reserved-memory", "lk_log@8f600000", NULL, 0 },
+	{ FDT_TEST_SET, "/reserved-memory/lk_log@8f600000", "compatible",
+	  FDT_TEST_STR(log_compat) },
+	{ FDT_TEST_SET, "/reserved-memory/lk_log@8f600000", "reg",
+	  FDT_TEST_VAL(log_reg) },
+	{ FDT_TEST_SET, "/reserved-memory/lk_log@8f600000", "no-map", NULL, 0 },
+};
+
+#define FDT_TEST_CASE(name, ops)	{ name, ops, ARRAY_SIZE(ops) }
+
+static const struct fdt_test_case fdt_test_cases[] = {
+	FDT_TEST_CASE("add", fdt_test_add),
+	FDT_TEST_CASE("replace", fdt_test_replace),
+	FDT_TEST_CASE("append", fdt_test_append),
+	FDT_TEST_CASE("new node", fdt_test_node),
+	FDT_TEST_CASE("new string", fdt_test_string),
+	FDT_TEST_CASE("boot", fdt_test_boot),
+};
+
+static int fdt_test_build(void *buf, int size)
+{
+	static const uint32_t soc_reg[] = { 0x01800000, 0x00001000 };
+	char name[16];
+	int i, err = 0;
+
+	err |= fdt_create(buf, size);
+	err |= fdt_finish_reservemap(buf);
+	err |= fdt_begin_node(buf, "");
+	err |= fdt_property_cell(buf, "#address-cells", 1);
+	err |= fdt_property_cell(buf, "#size-cells", 1);
+	err |= fdt_property_string(buf, "model", "Qualcomm Technologies, Inc. MSM 8916");
+	err |= fdt_property_string(buf, "compatible", "qcom,msm8916-mtp");
+
+	err |= fdt_begin_node(buf, "chosen");
+	err |= fdt_property_string(buf, "bootargs", bootargs);
+	err |= fdt_end_node(buf);
+
+	err |= fdt_begin_node(buf, "memory");
+	err |= fdt_property_string(buf, "device_type", "memory");
+	err |= fdt_property(buf, "reg", reg_one, sizeof(reg_one));
+	err |= fdt_end_node(buf);
+
+	err |= fdt_begin_node(buf, "reserved-memory");
+	err |= fdt_property_cell(buf, "#address-cells", 1);
+	err |= fdt_property_cell(buf, "#size-cells", 1);
+	err |= fdt_property(buf, "ranges", NULL, 0);
+	err |= fdt_begin_node(buf, "modem_region@86800000");
+	err |= fdt_property_string(buf, "compatible", "removed-dma-pool");
+	err |= fdt_property(buf, "reg", soc_reg, sizeof(soc_reg));
+	err |= fdt_property(buf, "no-map", NULL, 0);
+	err |= fdt_end_node(buf);
+	err |= fdt_end_node(buf);
+
+	err |= fdt_begin_node(buf, "soc");
+	for (i = 0; i < FDT_TEST_SOC_NODES; i++) {
+		snprintf(name, sizeof(name), "node@%x", i);
+		err |= fdt_begin_node(buf, name);
+		err |= fdt_property_string(buf, "compatible", "qcom,msm-test");
+		err |= fdt_property(buf, "reg", soc_reg, sizeof(soc_reg));
+		err |= fdt_property_string(buf, "status", "disabled");
+		err |= fdt_end_node(buf);
+	}
+	err |= fdt_end_node(buf);
+
+	err |= fdt_end_node(buf);
+	err |= fdt_finish(buf);
+
+	return err ? -1 : fdt_open_into(buf, buf, size);
+}
+
+/* the plain libfdt calls */
+static int fdt_test_apply(void *fdt, const struct fdt_test_case *tc)
+{
+	const struct fdt_test_op *op;
+	int i, offset, err;
+
+	for (i = 0; i < tc->count; i++) {
+		op = &tc->ops[i];
+		offset = fdt_path_offset(fdt, op->path);
+		if (offset < 0)
+			return offset;
+
+		switch (op->type) {
+		case FDT_TEST_SET:
+			err = fdt_setprop(fdt, offset, op->name, op->val, op->len);
+			break;
+		case FDT_TEST_APPEND:
+			err = fdt_appendprop(fdt, offset, op->name, op->val, op->len);
+			break;
+		case FDT_TEST_DELETE:
+			err = fdt_delprop(fdt, offset, op->name);
+			break;
+		default:
+			err = fdt_add_subnode(fdt, offset, op->name);
+			break;
+		}
+		if (err < 0)
+			return err;
+	}
+
+	return fdt_pack(fdt);
+}
+
+/* the same edits queued on a batch, new nodes found by their path */
+static int fdt_test_queue(const void *fdt, const struct fdt_test_case *tc,
+			  struct fdt_batch *batch)
+{
+	const struct fdt_test_op *op;
+	char path[FDT_BATCH_MAX_NODES][64];
+	int node[FDT_BATCH_MAX_NODES];
+	int nodes = 0;
+	int i, j, offset, err;
+
+	fdt_batch_init(batch);
+	for (i = 0; i < tc->count; i++) {
+		op = &tc->ops[i];
+		for (j = 0; j < nodes; j++)
+			if (!strcmp(path[j], op->path))
+				break;
+		offset = j < nodes ? node[j] : fdt_path_offset(fdt, op->path);
+		if (offset < 0)
+			return offset;
+
+		switch (op->type) {
+		case FDT_TEST_SET:
+			err = fdt_batch_setprop(batch, offset, op->name, op->val, op->len);
+			break;
+		case FDT_TEST_APPEND:
+			err = fdt_batch_appendprop(batch, offset, op->name, op->val,
+						   op->len);
+			break;
+		case FDT_TEST_DELETE:
+			err = fdt_batch_delprop(batch, offset, op->name);
+			break;
+		default:
+			if (nodes == FDT_BATCH_MAX_NODES)
+				return -FDT_ERR_NOSPACE;
+			err = fdt_batch_add_subnode(batch, offset, op->name);
+			snprintf(path[nodes], sizeof(path[nodes]), "%s/%s",
+				 op->path, op->name);
+			node[nodes++] = err;
+			break;
+		}
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+/* the properties of a node in a, looked up by name in the node in b */
+static int fdt_test_props_in(const void *a, int aoff, const void *b, int boff)
+{
+	const struct fdt_property *prop;
+	const void *val;
+	const char *name;
+	int offset, len, blen, count = 0;
+
+	for (offset = fdt_first_property_offset(a, aoff);
+	     offset >= 0;
+	     offset = fdt_next_property_offset(a, offset)) {
+		prop = fdt_get_property_by_offset(a, offset, &len);
+		if (!prop)
+			return -1;
+		name = fdt_string(a, fdt32_to_cpu(prop->nameoff));
+		val = fdt_getprop(b, boff, name, &blen);
+		if (!val || blen != len || memcmp(val, prop->data, len)) {
+			dprintf(INFO, "fdt_batch test: %s/%s differs\n",
+				fdt_get_name(a, aoff, NULL), name);
+			return -1;
+		}
+		count++;
+	}
+
+	return offset == -FDT_ERR_NOTFOUND ? count : -1;
+}
+
+/* both blobs have the same nodes, in the same order, with the same properties */
+static int fdt_test_compare(const void *a, const void *b)
+{
+	int aoff = 0, boff = 0, adepth = 0, bdepth = 0;
+	int nodes = 0, count;
+
+	if (fdt_check_header(a) || fdt_check_header(b))
+		return -1;
+
+	/* the walk ends past the root, with depth -1 */
+	while (adepth >= 0) {
+		if (aoff < 0 || boff < 0)
+			return -1;
+		if (adepth != bdepth ||
+		    strcmp(fdt_get_name(a, aoff, NULL), fdt_get_name(b, boff, NULL))) {
+			dprintf(INFO, "fdt_batch test: node %d, %s vs %s\n", nodes,
+				fdt_get_name(a, aoff, NULL), fdt_get_name(b, boff, NULL));
+			return -1;
+		}
+		count = fdt_test_props_in(a, aoff, b, boff);
+		if (count < 0 || count != fdt_test_props_in(b, boff, a, aoff))
+			return -1;
+
+		nodes++;
+		aoff = fdt_next_node(a, aoff, &adepth);
+		boff = fdt_next_node(b, boff, &bdepth);
+	}
+
+	return bdepth < 0 ? 0 : -1;
+}
+
+/* batched holds two blobs: the one committed to and a copy to check it against */
+static int fdt_test_one(const struct fdt_test_case *tc, char *plain, char *batched)
+{
+	struct fdt_batch batch;
+	int size = FDT_TEST_BUF_SIZE / 2;
+	int err, fail = 0;
+
+	if (fdt_test_build(plain, size) || fdt_test_build(batched, size))
+		return 1;
+
+	if (fdt_test_apply(plain, tc)) {
+		dprintf(INFO, "fdt_batch test: %s: libfdt failed\n", tc->name);
+		return 1;
+	}
+
+	err = fdt_test_queue(batched, tc, &batch);
+	if (err)
+		fail = 1;
+
+	/* a commit that does not fit leaves the blob as it was */
+	memcpy(batched + size, batched, size);
+	if (!err && fdt_batch_commit(batched, fdt_off_dt_strings(batched) +
+				     fdt_size_dt_strings(batched), &batch) !=
+	    -FDT_ERR_NOSPACE)
+		fail = 1;
+	if (memcmp(batched + size, batched, size))
+		fail = 1;
+
+	if (!err && fdt_batch_commit(batched, size, &batch))
+		fail = 1;
+	if (!fail && fdt_test_compare(plain, batched))
+		fail = 1;
+
+	/* and as packed as libfdt leaves it, but for the header */
+	if (fdt_size_dt_struct(batched) != fdt_size_dt_struct(plain) ||
+	    fdt_size_dt_strings(batched) != fdt_size_dt_strings(plain) ||
+	    fdt_totalsize(batched) != fdt_off_dt_strings(batched) +
+	    fdt_size_dt_strings(batched))
+		fail = 1;
+
+	dprintf(INFO, "fdt_batch test: %s: %d edits, %d nodes, %u bytes: %s\n",
+		tc->name, batch.count, batch.nodes, fdt_totalsize(batched),
+		fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
+int fdt_batch_tests(void)
+{
+	char *plain, *batched;
+	unsigned i;
+	int fail = 0;
+
+	plain = malloc(FDT_TEST_BUF_SIZE);
+	batched = malloc(FDT_TEST_BUF_SIZE);
+	if (!plain || !batched) {
+		dprintf(CRITICAL, "fdt_batch test: out of memory\n");
+		fail = 1;
+		goto out;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(fdt_test_cases); i++)
+		fail |= fdt_test_one(&fdt_test_cases[i], plain, batched);
+
+out:
+	free(plain);
+	free(batched);
+
+	return fail ? -1 : 0;
+}
+
+#endif
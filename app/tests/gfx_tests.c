@@ -0,0 +1,327 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <debug.h>
+#include <compiler.h>
+#include <string.h>
+#include <stdlib.h>
+#include <app/tests.h>
+
+#if WITH_LIB_GFX
+#include <lib/gfx.h>
+
+#define GUARD8		0xa5
+#define ROW_MAX		72
+#define ROW_PAD		8
+
+static uint32_t rand_state = 0x12345678;
+
+static uint32_t test_rand(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (rand_state >> 16) | (rand_state << 16);
+}
+
+static uint16_t ref_to_rgb565(uint32_t in)
+{
+	return ((in >> 3) & 0x1f) | (((in >> 10) & 0x3f) << 5) |
+		(((in >> 19) & 0x1f) << 11);
+}
+
+static uint32_t ref_from_rgb565(uint16_t in)
+{
+	return 0xff000000 | ((in & 0xf800) << 8) | ((in & 0x07e0) << 5) |
+		((in & 0x001f) << 3);
+}
+
+/* every byte outside [start, start + len) must still hold the guard */
+static bool guard_intact(const uint8_t *buf, size_t size, size_t start, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (i >= start && i < start + len)
+			continue;
+		if (buf[i] != GUARD8)
+			return false;
+	}
+
+	return true;
+}
+
+static int fill_tests(void)
+{
+	uint8_t buf[(ROW_MAX + ROW_PAD) * 4] __ALIGNED(4);
+	uint off, count, i;
+	int errors = 0;
+
+	for (off = 0; off < 4; off++) {
+		for (count = 0; count < ROW_MAX; count++) {
+			uint32_t color = test_rand();
+			uint16_t *p16 = (uint16_t *)(buf + (off & 2));
+			uint32_t *p32 = (uint32_t *)buf + (off & 1);
+			uint8_t *p24 = buf + off;
+
+			memset(buf, GUARD8, sizeof(buf));
+			gfx_row_fill16(p16, color, count);
+			for (i = 0; i < count; i++)
+				if (p16[i] != (uint16_t)color)
+					break;
+			if (i != count || !guard_intact(buf, sizeof(buf), off & 2, count * 2)) {
+				printf("fill16 off %u count %u mismatch\n", off & 2, count);
+				errors++;
+			}
+
+			memset(buf, GUARD8, sizeof(buf));
+			gfx_row_fill24(p24, color, count);
+			for (i = 0; i < count; i++)
+				if (p24[i * 3] != (uint8_t)color ||
+					p24[i * 3 + 1] != (uint8_t)(color >> 8) ||
+					p24[i * 3 + 2] != (uint8_t)(color >> 16))
+					break;
+			if (i != count || !guard_intact(buf, sizeof(buf), off, count * 3)) {
+				printf("fill24 off %u count %u mismatch\n", off, count);
+				errors++;
+			}
+
+			memset(buf, GUARD8, sizeof(buf));
+			gfx_row_fill32(p32, color, count);
+			for (i = 0; i < count; i++)
+				if (p32[i] != color)
+					break;
+			if (i != count || !guard_intact(buf, sizeof(buf), (off & 1) * 4, count * 4)) {
+				printf("fill32 off %u count %u mismatch\n", (off & 1) * 4, count);
+				errors++;
+			}
+		}
+	}
+
+	return errors;
+}
+
+static int convert_tests(void)
+{
+	uint32_t src[ROW_MAX];
+	uint8_t buf[(ROW_MAX + ROW_PAD) * 4] __ALIGNED(4);
+	uint off, count, i;
+	int errors = 0;
+
+	for (off = 0; off < 4; off++) {
+		for (count = 0; count < ROW_MAX; count++) {
+			uint16_t *p16 = (uint16_t *)(buf + (off & 2));
+			uint8_t *p24 = buf + off;
+
+			for (i = 0; i < count; i++)
+				src[i] = test_rand();
+
+			memset(buf, GUARD8, sizeof(buf));
+			gfx_row_argb8888_to_rgb565(p16, src, count);
+			for (i = 0; i < count; i++)
+				if (p16[i] != ref_to_rgb565(src[i]))
+					break;
+			if (i != count || !guard_intact(buf, sizeof(buf), off & 2, count * 2)) {
+				printf("argb8888 to rgb565 off %u count %u mismatch\n", off & 2, count);
+				errors++;
+			}
+
+			memset(buf, GUARD8, sizeof(buf));
+			gfx_row_argb8888_to_rgb888(p24, src, count);
+			for (i = 0; i < count; i++)
+				if (p24[i * 3] != (uint8_t)src[i] ||
+					p24[i * 3 + 1] != (uint8_t)(src[i] >> 8) ||
+					p24[i * 3 + 2] != (uint8_t)(src[i] >> 16))
+					break;
+			if (i != count || !guard_intact(buf, sizeof(buf), off, count * 3)) {
+				printf("argb8888 to rgb888 off %u count %u mismatch\n", off, count);
+				errors++;
+			}
+		}
+	}
+
+	return errors;
+}
+
+static int blend_tests(void)
+{
+	uint32_t src[256], dst[256], ref[256];
+	uint pass, i;
+	int errors = 0;
+
+	for (pass = 0; pass < 16; pass++) {
+		/* every alpha value once per pass, in a shuffled row */
+		for (i = 0; i < 256; i++) {
+			src[i] = (((i * 167 + pass) & 0xff) << 24) | (test_rand() & 0xffffff);
+			dst[i] = test_rand();
+			ref[i] = alpha32_add_ignore_destalpha(dst[i], src[i]);
+		}
+
+		gfx_row_blend32(dst, src, 256);
+
+		for (i = 0; i < 256; i++) {
+			if (dst[i] != ref[i]) {
+				printf("blend32 src 0x%08x: got 0x%08x want 0x%08x\n",
+					src[i], dst[i], ref[i]);
+				errors++;
+				break;
+			}
+		}
+	}
+
+	return errors;
+}
+
+/* read a pixel back as ARGB 8888, the way the blend widens the target */
+static uint32_t get_pixel(gfx_surface *s, uint x, uint y)
+{
+	uint8_t *p = (uint8_t *)s->ptr + (x + y * s->stride) * s->pixelsize;
+
+	switch (s->format) {
+		case GFX_FORMAT_RGB_565:
+			return ref_from_rgb565(*(uint16_t *)p);
+		case GFX_FORMAT_RGB_888:
+			return 0xff000000 | (p[2] << 16) | (p[1] << 8) | p[0];
+		default:
+			return *(uint32_t *)p;
+	}
+}
+
+static gfx_surface *random_surface(uint width, uint height, uint stride, gfx_format format)
+{
+	gfx_surface *s = gfx_create_surface(NULL, width, height, stride, format);
+	uint i;
+
+	for (i = 0; i < s->len; i++)
+		((uint8_t *)s->ptr)[i] = test_rand();
+
+	return s;
+}
+
+static gfx_surface *clone_surface(gfx_surface *s)
+{
+	gfx_surface *c = gfx_create_surface(NULL, s->width, s->height, s->stride, s->format);
+
+	memcpy(c->ptr, s->ptr, s->len);
+
+	return c;
+}
+
+static int surface_tests(gfx_format format)
+{
+	int errors = 0;
+	uint iter;
+
+	for (iter = 0; iter < 64; iter++) {
+		uint width = 1 + test_rand() % 37;
+		uint height = 1 + test_rand() % 23;
+		uint stride = width + test_rand() % 5;
+		gfx_surface *s = random_surface(width, height, stride, format);
+		gfx_surface *ref = clone_surface(s);
+		uint x = test_rand() % width, y = test_rand() % height;
+		uint x2 = test_rand() % width, y2 = test_rand() % height;
+		uint w = 1 + test_rand() % width, h = 1 + test_rand() % height;
+		uint32_t color = test_rand();
+		uint i, j;
+
+		/* fill against the per pixel path */
+		gfx_fillrect(s, x, y, w, h, color);
+		for (j = y; j < MIN(y + h, height); j++)
+			for (i = x; i < MIN(x + w, width); i++)
+				ref->putpixel(ref, i, j, color);
+		if (memcmp(s->ptr, ref->ptr, s->len)) {
+			printf("fillrect format %d %ux%u at %u,%u mismatch\n", format, w, h, x, y);
+			errors++;
+		}
+
+		/* overlapping copy against a copy through a scratch buffer */
+		memcpy(ref->ptr, s->ptr, s->len);
+		gfx_copyrect(s, x, y, w, h, x2, y2);
+		w = MIN(w, MIN(width - x, width - x2));
+		h = MIN(h, MIN(height - y, height - y2));
+		uint8_t *tmp = malloc(w * h * s->pixelsize);
+		for (j = 0; j < h; j++)
+			memcpy(tmp + j * w * s->pixelsize,
+				(uint8_t *)ref->ptr + (x + (y + j) * stride) * s->pixelsize,
+				w * s->pixelsize);
+		for (j = 0; j < h; j++)
+			memcpy((uint8_t *)ref->ptr + (x2 + (y2 + j) * stride) * s->pixelsize,
+				tmp + j * w * s->pixelsize, w * s->pixelsize);
+		free(tmp);
+		if (memcmp(s->ptr, ref->ptr, s->len)) {
+			printf("copyrect format %d %ux%u %u,%u -> %u,%u mismatch\n",
+				format, w, h, x, y, x2, y2);
+			errors++;
+		}
+
+		/* ARGB source blended on top, pixel by pixel in the reference */
+		uint src_width = 1 + test_rand() % 40;
+		gfx_surface *src = random_surface(src_width, 1 + test_rand() % 20,
+				src_width, GFX_FORMAT_ARGB_8888);
+		memcpy(ref->ptr, s->ptr, s->len);
+		gfx_surface_blend(s, src, x, y);
+		for (j = 0; j < src->height && y + j < height; j++) {
+			for (i = 0; i < src->width && x + i < width; i++) {
+				uint32_t in = ((uint32_t *)src->ptr)[i + j * src->stride];
+				uint32_t out = alpha32_add_ignore_destalpha(get_pixel(ref, x + i, y + j), in);
+
+				ref->putpixel(ref, x + i, y + j, out);
+			}
+		}
+		if (memcmp(s->ptr, ref->ptr, s->len)) {
+			printf("blend onto format %d at %u,%u mismatch\n", format, x, y);
+			errors++;
+		}
+
+		gfx_surface_destroy(src);
+		gfx_surface_destroy(ref);
+		gfx_surface_destroy(s);
+	}
+
+	return errors;
+}
+
+int gfx_tests(void)
+{
+	int errors = 0;
+
+	printf("testing gfx row kernels\n");
+	errors += fill_tests();
+	errors += convert_tests();
+	errors += blend_tests();
+
+	printf("testing gfx surface operations\n");
+	errors += surface_tests(GFX_FORMAT_RGB_565);
+	errors += surface_tests(GFX_FORMAT_RGB_888);
+	errors += surface_tests(GFX_FORMAT_RGB_x888);
+	errors += surface_tests(GFX_FORMAT_ARGB_8888);
+
+	printf("gfx tests: %d errors\n", errors);
+
+	return errors;
+}
+
+#endif
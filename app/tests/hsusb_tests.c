@@ -0,0 +1,224 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <app/tests.h>
+#include <arch/ops.h>
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include <platform.h>
+#include <hsusb.h>
+
+/*
+ * Model of the controller working through the TD chain of a request, so
+ * the chains the hsusb driver builds can be checked without the hardware.
+ *
+ * Each TD is checked the way the controller uses it: active, its bytes
+ * within the 5 pages it points to, the pages following each other, whole
+ * packets in all but the last TD, and the interrupt on every TD.  The
+ * bytes the host sends are copied through the page pointers, then the TD
+ * is retired holding the count of bytes it did not take.  As on the
+ * controller, a short packet (or a zero length one) retires the TD it
+ * lands in and the TDs after it are left active, untouched.
+ */
+#define TD_MODEL_PAGE       4096
+#define TD_MODEL_PAGES      5
+#define TD_MODEL_MAX_PKT    512
+#define TD_TEST_BUF_SIZE    (256 * 1024)
+
+struct td_model {
+	uint32_t tds;
+	uint32_t bad;
+};
+
+/* Copy len bytes from src to the TD's buffer, at offs into its pages */
+static void td_model_copy(struct ept_queue_item *item, uint32_t offs,
+			  const uint8_t *src, uint32_t len)
+{
+	uint32_t pages[TD_MODEL_PAGES] = {
+		item->page0 & ~(TD_MODEL_PAGE - 1), item->page1, item->page2,
+		item->page3, item->page4 };
+	uint32_t chunk;
+	uint8_t *dst;
+
+	while (len) {
+		chunk = MIN(len, TD_MODEL_PAGE - (offs % TD_MODEL_PAGE));
+		dst = (uint8_t *) VA((addr_t) (pages[offs / TD_MODEL_PAGE] +
+				(offs % TD_MODEL_PAGE)));
+		memcpy(dst, src, chunk);
+		src += chunk;
+		offs += chunk;
+		len -= chunk;
+	}
+}
+
+/* Run the chain at item for an OUT transfer of sent bytes from the host */
+static void td_model_run(struct td_model *m, struct ept_queue_item *item,
+			 const uint8_t *src, uint32_t sent)
+{
+	uint32_t bytes, take, start, i;
+	uint32_t *page;
+
+	while (1) {
+		m->tds++;
+		bytes = (item->info >> 16) & 0x7FFF;
+		start = item->page0 & (TD_MODEL_PAGE - 1);
+
+		if (!(item->info & INFO_ACTIVE))
+			m->bad++;
+		if (start + bytes > TD_MODEL_PAGES * TD_MODEL_PAGE) {
+			m->bad++;
+			bytes = TD_MODEL_PAGES * TD_MODEL_PAGE - start;
+		}
+		page = &item->page1;
+		for (i = 1; i < TD_MODEL_PAGES; i++, page++)
+			if (*page != (item->page0 & ~(TD_MODEL_PAGE - 1)) + i * TD_MODEL_PAGE)
+				m->bad++;
+		if (!(item->info & INFO_IOC))
+			m->bad++;
+		if (item->next != TERMINATE && (bytes % TD_MODEL_MAX_PKT))
+			m->bad++;
+
+		take = MIN(bytes, sent);
+		td_model_copy(item, start, src, take);
+		src += take;
+		sent -= take;
+
+		item->info = (item->info & ~(INFO_ACTIVE | INFO_BYTES(0x7FFF))) |
+			     INFO_BYTES(bytes - take);
+		arch_clean_cache_range((addr_t) item, sizeof(*item));
+
+		if (take < bytes || item->next == TERMINATE)
+			break;
+
+		item = (struct ept_queue_item *) VA((addr_t) item->next);
+	}
+}
+
+static void td_test_fill(uint8_t *buf, uint32_t len, uint32_t seed)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (uint8_t) ((i * 13) ^ (i >> 11) ^ seed);
+}
+
+/* Receive sent bytes of a len byte request, at offs into a page */
+static int td_test_one(uint32_t offs, uint32_t len, uint32_t sent)
+{
+	struct td_model m = { 0, 0 };
+	struct ept_queue_item *items = NULL;
+	uint8_t *src, *dst;
+	uint32_t count, retired, phys, i;
+	unsigned actual = 0;
+	int fail = 0;
+
+	src = malloc(TD_TEST_BUF_SIZE);
+	dst = memalign(TD_MODEL_PAGE, TD_TEST_BUF_SIZE);
+	if (!src || !dst) {
+		dprintf(CRITICAL, "hsusb test: out of memory\n");
+		fail = 1;
+		goto out;
+	}
+
+	phys = (uint32_t) PA((addr_t) (dst + offs));
+	count = hsusb_td_count(phys, len);
+	items = memalign(CACHE_LINE, ROUNDUP(count * sizeof(*items), CACHE_LINE));
+	if (!items) {
+		fail = 1;
+		goto out;
+	}
+
+	td_test_fill(src, sent, offs);
+	memset(dst, 0, TD_TEST_BUF_SIZE);
+
+	/* The host's last packet lands in the TD holding byte sent */
+	retired = (sent < len) ? hsusb_td_count(phys, sent + 1) : count;
+
+	hsusb_td_chain_fill(items, phys, len);
+	if (hsusb_td_chain_complete(items, phys, len, &actual) != 1)
+		fail = 1;
+
+	td_model_run(&m, items, src, sent);
+
+	if (hsusb_td_chain_complete(items, phys, len, &actual))
+		fail = 1;
+	if (actual != sent || m.tds != retired || m.bad)
+		fail = 1;
+	for (i = retired; i < count; i++)
+		if (!(items[i].info & INFO_ACTIVE))
+			fail = 1;
+	if (memcmp(dst + offs, src, sent))
+		fail = 1;
+
+	/* Nothing written around the transfer */
+	for (i = 0; i < offs; i++)
+		if (dst[i])
+			fail = 1;
+	for (i = offs + sent; i < TD_TEST_BUF_SIZE; i++)
+		if (dst[i])
+			fail = 1;
+
+	dprintf(INFO, "hsusb test: %u of %u bytes at +0x%x: %u of %u TDs, %u bad: %s\n",
+			sent, len, offs, m.tds, count, m.bad, fail ? "FAIL" : "PASS");
+
+out:
+	free(items);
+	free(src);
+	free(dst);
+
+	return fail;
+}
+
+int hsusb_tests(void)
+{
+	uint32_t max = TD_TEST_BUF_SIZE - TD_MODEL_PAGE;
+	int fail = 0;
+
+	/* A command, a zero length packet */
+	fail |= td_test_one(0, 64, 64);
+	fail |= td_test_one(0, 0, 0);
+
+	/* Aligned, every TD takes its 5 pages in full */
+	fail |= td_test_one(0, max, max);
+
+	/* Unaligned, the TDs take 4 pages worth */
+	fail |= td_test_one(0x123, max, max);
+	fail |= td_test_one(0xffc, 3 * TD_MODEL_PAGES * TD_MODEL_PAGE + 5,
+			    3 * TD_MODEL_PAGES * TD_MODEL_PAGE + 5);
+
+	/*
+	 * The host sends less than asked: a short packet in the last TD,
+	 * in a TD early in the chain, and a zero length packet after whole TDs
+	 */
+	fail |= td_test_one(0x200, max, max - 100);
+	fail |= td_test_one(0x200, max, 3 * (TD_MODEL_PAGES - 1) * TD_MODEL_PAGE + 700);
+	fail |= td_test_one(0, max, 2 * TD_MODEL_PAGES * TD_MODEL_PAGE);
+
+	return fail ? -1 : 0;
+}
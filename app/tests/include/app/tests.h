@@ -25,6 +25,12 @@
 
 int thread_tests(void);
 void printf_tests(void);
+int strbuild_tests(void);
+int gfx_tests(void);
+int cmdq_tests(void);
+int ubi_tests(void);
+int hsusb_tests(void);
+int fdt_batch_tests(void);
 
 #endif
 
@@ -21,7 +21,70 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <app/tests.h>
+#include <arch/ops.h>
 #include <debug.h>
+#include <printf.h>
+#include <string.h>
+
+#define PRINTF_BENCH_ITER 1000
+
+static void printf_check(const char *got, int ret, const char *expect)
+{
+	if (strcmp(got, expect) || ret != (int)strlen(expect))
+		printf("FAIL: got \"%s\" (%d), expected \"%s\"\n", got, ret, expect);
+}
+
+static void printf_bench(void)
+{
+	char buf[128];
+	uint count;
+	int i, ret;
+
+	printf("truncation:\n");
+	memset(buf, 'x', sizeof(buf));
+	ret = snprintf(buf, 0, "abc");
+	if (ret != 0 || buf[0] != 'x')
+		printf("FAIL: snprintf to a zero length buffer wrote to it\n");
+	ret = snprintf(buf, 1, "abc");
+	if (ret != 0 || buf[0] != 0 || buf[1] != 'x')
+		printf("FAIL: snprintf to a one byte buffer\n");
+	ret = snprintf(buf, 4, "abcdef");
+	printf_check(buf, ret, "abc");
+	ret = snprintf(buf, 6, "a%8d", 12);
+	printf_check(buf, ret, "a    ");
+	ret = snprintf(buf, 6, "%s:%d", "timer", 5);
+	printf_check(buf, ret, "timer");
+
+	ret = snprintf(buf, sizeof(buf), "%llu %lld", 18446744073709551615ULL, -9223372036854775807LL);
+	printf_check(buf, ret, "18446744073709551615 -9223372036854775807");
+	ret = snprintf(buf, sizeof(buf), "%u %d %05u", 4294967295U, -100, 42);
+	printf_check(buf, ret, "4294967295 -100 00042");
+
+	printf("speed:\n");
+	count = arch_cycle_count();
+	for (i = 0; i < PRINTF_BENCH_ITER; i++)
+		snprintf(buf, sizeof(buf), "androidboot.emmc=true androidboot.baseband=msm");
+	count = arch_cycle_count() - count;
+	printf("literal: %u cycles per call\n", count / PRINTF_BENCH_ITER);
+
+	count = arch_cycle_count();
+	for (i = 0; i < PRINTF_BENCH_ITER; i++)
+		snprintf(buf, sizeof(buf), "[%u] %s:%d", 123456, "partition_parser", i);
+	count = arch_cycle_count() - count;
+	printf("[%%u] %%s:%%d: %u cycles per call\n", count / PRINTF_BENCH_ITER);
+
+	count = arch_cycle_count();
+	for (i = 0; i < PRINTF_BENCH_ITER; i++)
+		snprintf(buf, sizeof(buf), "0x%08x", 0x8f600000 + i);
+	count = arch_cycle_count() - count;
+	printf("0x%%08x: %u cycles per call\n", count / PRINTF_BENCH_ITER);
+
+	count = arch_cycle_count();
+	for (i = 0; i < PRINTF_BENCH_ITER; i++)
+		snprintf(buf, sizeof(buf), "%llu", 1234567890123ULL * i);
+	count = arch_cycle_count() - count;
+	printf("%%llu: %u cycles per call\n", count / PRINTF_BENCH_ITER);
+}
 
 void printf_tests(void)
 {
@@ -85,6 +148,8 @@ void printf_tests(void)
 	printf(" returned %d\n", err);
 	err = printf("abcdef");
 	printf(" returned %d\n", err);
+
+	printf_bench();
 }
 
 
@@ -5,9 +5,29 @@ INCLUDES += -I$(LOCAL_DIR)/include
 OBJS += \
 	$(LOCAL_DIR)/tests.o \
 	$(LOCAL_DIR)/thread_tests.o \
-	$(LOCAL_DIR)/printf_tests.o
+	$(LOCAL_DIR)/printf_tests.o \
+	$(LOCAL_DIR)/strbuild_tests.o \
+	$(LOCAL_DIR)/gfx_tests.o \
+	$(LOCAL_DIR)/fdt_batch_tests.o
 
 ifeq ($(VERIFIED_BOOT),1)
 OBJS += \
 	$(LOCAL_DIR)/kauth_test.o
 endif
+
+ifeq ($(ENABLE_SDHCI_SUPPORT),1)
+OBJS += \
+	$(LOCAL_DIR)/cmdq_tests.o
+endif
+
+ifneq ($(filter mdm9x35 mdm9640 mdm9607,$(PLATFORM)),)
+DEFINES += UBI_TESTS=1
+OBJS += \
+	$(LOCAL_DIR)/ubi_tests.o
+endif
+
+ifneq ($(filter platform/msm_shared/hsusb.o,$(OBJS)),)
+DEFINES += HSUSB_TESTS=1
+OBJS += \
+	$(LOCAL_DIR)/hsusb_tests.o
+endif
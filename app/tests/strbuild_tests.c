@@ -0,0 +1,110 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <app/tests.h>
+#include <debug.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strbuild.h>
+
+static const char *strbuild_test_frags[] = {
+	"console=ttyHSL0,115200,n8",
+	" androidboot.emmc=true",
+	"",
+	" androidboot.serialno=",
+	"1234abcd",
+	NULL,
+	" androidboot.baseband=msm",
+	" qpnp-power-on.warm_boot=1",
+};
+
+#define STRBUILD_TEST_NFRAGS ARRAY_SIZE(strbuild_test_frags)
+
+/* build every subset of the fragments and check it against strlcat() */
+int strbuild_tests(void)
+{
+	struct strbuild sb;
+	char expect[256];
+	char got[256];
+	char *str;
+	unsigned mask, i;
+	size_t len, size;
+	int fail = 0;
+
+	for (mask = 0; mask < (1U << STRBUILD_TEST_NFRAGS); mask++) {
+		strbuild_init(&sb);
+		expect[0] = '\0';
+		for (i = 0; i < STRBUILD_TEST_NFRAGS; i++) {
+			if (!(mask & (1U << i)))
+				continue;
+			if (strbuild_add(&sb, strbuild_test_frags[i]))
+				fail++;
+			if (strbuild_test_frags[i])
+				strlcat(expect, strbuild_test_frags[i], sizeof(expect));
+		}
+		len = strlen(expect);
+
+		if (strbuild_len(&sb) != len)
+			fail++;
+
+		str = strbuild_alloc(&sb);
+		if (!str || strcmp(str, expect))
+			fail++;
+		free(str);
+
+		/* every truncation of the string, including none at all */
+		for (size = 0; size <= len + 1; size++) {
+			memset(got, 'x', sizeof(got));
+			if (strbuild_copy(&sb, got, size) != len)
+				fail++;
+			if (!size) {
+				if (got[0] != 'x')
+					fail++;
+				continue;
+			}
+			if (strncmp(got, expect, size - 1) || got[size - 1] != '\0' ||
+				got[size] != 'x')
+				fail++;
+		}
+	}
+
+	/* running out of fragments must be reported, not overflow */
+	strbuild_init(&sb);
+	for (i = 0; i < STRBUILD_MAX_FRAGS; i++)
+		if (strbuild_add_len(&sb, "a", 1))
+			fail++;
+	if (strbuild_add_len(&sb, "a", 1) != ERR_TOO_BIG ||
+		strbuild_len(&sb) != STRBUILD_MAX_FRAGS)
+		fail++;
+
+	printf("strbuild tests: %u combinations, %d failures\n",
+		1U << STRBUILD_TEST_NFRAGS, fail);
+
+	return fail ? -1 : 0;
+}
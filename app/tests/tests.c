@@ -30,7 +30,23 @@
 
 STATIC_COMMAND_START
 STATIC_COMMAND("printf_tests", NULL, (console_cmd)&printf_tests)
+STATIC_COMMAND("strbuild_tests", NULL, (console_cmd)&strbuild_tests)
 STATIC_COMMAND("thread_tests", NULL, (console_cmd)&thread_tests)
+#if WITH_LIB_GFX
+STATIC_COMMAND("gfx_tests", NULL, (console_cmd)&gfx_tests)
+#endif
+#if MMC_SDHCI_SUPPORT
+STATIC_COMMAND("cmdq_tests", NULL, (console_cmd)&cmdq_tests)
+#endif
+#if UBI_TESTS
+STATIC_COMMAND("ubi_tests", NULL, (console_cmd)&ubi_tests)
+#endif
+#if HSUSB_TESTS
+STATIC_COMMAND("hsusb_tests", NULL, (console_cmd)&hsusb_tests)
+#endif
+#if WITH_LIB_LIBFDT
+STATIC_COMMAND("fdt_batch_tests", NULL, (console_cmd)&fdt_batch_tests)
+#endif
 STATIC_COMMAND_END(tests);
 
 #endif
@@ -25,6 +25,8 @@
 #include <app/tests.h>
 #include <kernel/thread.h>
 #include <kernel/mutex.h>
+#include <kernel/amutex.h>
+#include <kernel/rwlock.h>
 #include <kernel/event.h>
 
 static int sleep_thread(void *arg)
@@ -136,6 +138,149 @@ int mutex_test(void)
 	return 0;
 }
 
+static amutex_t am;
+static volatile int amutex_thread_count = 0;
+
+static int amutex_thread(void *arg)
+{
+	int i;
+	const int iterations = 10000;
+
+	atomic_add(&amutex_thread_count, 1);
+
+	for (i = 0; i < iterations; i++) {
+		amutex_acquire(&am);
+
+		if (shared != 0)
+			panic("someone else has messed with the shared data\n");
+
+		shared = (int)current_thread;
+		if ((i & 3) == 0)
+			thread_yield();
+		shared = 0;
+
+		amutex_release(&am);
+		thread_yield();
+	}
+	atomic_add(&amutex_thread_count, -1);
+
+	return 0;
+}
+
+int amutex_test(void)
+{
+	int i;
+
+	amutex_init(&am);
+
+	for(i=0; i < 5; i++)
+		thread_resume(thread_create("amutex tester", &amutex_thread, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+
+	thread_sleep(1000);
+
+	while (amutex_thread_count > 0)
+		thread_yield();
+
+	printf("amutex: %u acquires, %u contended\n", am.acquires, am.contentions);
+
+	/* the uncontended path must not touch the wait queue */
+	uint count = arch_cycle_count();
+	for (i = 0; i < 10000; i++) {
+		amutex_acquire(&am);
+		amutex_release(&am);
+	}
+	count = arch_cycle_count() - count;
+	printf("amutex: %u cycles per uncontended acquire/release\n", count / 10000);
+
+	mutex_init(&m);
+	count = arch_cycle_count();
+	for (i = 0; i < 10000; i++) {
+		mutex_acquire(&m);
+		mutex_release(&m);
+	}
+	count = arch_cycle_count() - count;
+	printf("mutex: %u cycles per uncontended acquire/release\n", count / 10000);
+
+	amutex_destroy(&am);
+
+	printf("done with amutex tests\n");
+
+	return 0;
+}
+
+static rwlock_t rw;
+static volatile int rw_readers_inside;
+static volatile int rw_writer_inside;
+static volatile int rwlock_thread_count;
+
+static int rwlock_reader(void *arg)
+{
+	int i;
+
+	for (i = 0; i < 5000; i++) {
+		rwlock_acquire_read(&rw);
+
+		if (rw_writer_inside)
+			panic("reader %p got in while a writer holds the lock\n", current_thread);
+		atomic_add(&rw_readers_inside, 1);
+		thread_yield();
+		atomic_add(&rw_readers_inside, -1);
+
+		rwlock_release_read(&rw);
+		thread_yield();
+	}
+	atomic_add(&rwlock_thread_count, -1);
+
+	return 0;
+}
+
+static int rwlock_writer(void *arg)
+{
+	int i;
+
+	for (i = 0; i < 1000; i++) {
+		rwlock_acquire_write(&rw);
+
+		if (rw_writer_inside || rw_readers_inside)
+			panic("writer %p got in while the lock is held (%d readers)\n",
+					current_thread, rw_readers_inside);
+		rw_writer_inside = 1;
+		thread_yield();
+		rw_writer_inside = 0;
+
+		rwlock_release_write(&rw);
+		thread_sleep(1);
+	}
+	atomic_add(&rwlock_thread_count, -1);
+
+	return 0;
+}
+
+int rwlock_test(void)
+{
+	int i;
+
+	rwlock_init(&rw);
+	rwlock_thread_count = 6;
+
+	for (i = 0; i < 4; i++)
+		thread_resume(thread_create("rwlock reader", &rwlock_reader, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+	for (i = 0; i < 2; i++)
+		thread_resume(thread_create("rwlock writer", &rwlock_writer, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE));
+
+	while (rwlock_thread_count > 0)
+		thread_sleep(10);
+
+	printf("rwlock: %u reads (%u contended), %u writes (%u contended)\n",
+			rw.read_acquires, rw.read_contentions, rw.write_acquires, rw.write_contentions);
+
+	rwlock_destroy(&rw);
+
+	printf("done with rwlock tests\n");
+
+	return 0;
+}
+
 static event_t e;
 
 static int event_signaller(void *arg)
@@ -267,6 +412,70 @@ void context_switch_test(void)
 	thread_sleep(100);
 }
 
+static event_t ping_event;
+static event_t pong_event;
+static event_t ping_pong_done_event;
+
+static const int ping_pong_iter = 10000;
+
+static int ping_pong_responder(void *arg)
+{
+	int i;
+
+	for (i = 0; i < ping_pong_iter; i++) {
+		event_wait(&ping_event);
+		event_signal(&pong_event, true);
+	}
+
+	event_signal(&ping_pong_done_event, true);
+
+	return 0;
+}
+
+static void ping_pong_run(int priority)
+{
+	int i;
+
+	event_init(&ping_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&pong_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&ping_pong_done_event, false, 0);
+
+	thread_resume(thread_create("ping pong", &ping_pong_responder, NULL, priority, DEFAULT_STACK_SIZE));
+	thread_sleep(100);
+
+	uint count = arch_cycle_count();
+	for (i = 0; i < ping_pong_iter; i++) {
+		event_signal(&ping_event, true);
+		event_wait(&pong_event);
+	}
+	count = arch_cycle_count() - count;
+
+	event_wait(&ping_pong_done_event);
+
+	printf("ping pong (responder priority %d): took %u cycles for %d round trips, %u per round trip, %u per handoff\n",
+		priority, count, ping_pong_iter, count / ping_pong_iter, count / ping_pong_iter / 2);
+
+	event_destroy(&ping_event);
+	event_destroy(&pong_event);
+	event_destroy(&ping_pong_done_event);
+}
+
+/* measure the latency of handing the cpu back and forth between two threads
+ * through a pair of events, which is the pattern used by the usb and display
+ * threads.
+ */
+void ping_pong_test(void)
+{
+	int old_priority = current_thread->priority;
+
+	thread_set_priority(DEFAULT_PRIORITY);
+
+	ping_pong_run(DEFAULT_PRIORITY);
+	ping_pong_run(HIGH_PRIORITY);
+
+	thread_set_priority(old_priority);
+}
+
 static volatile int atomic;
 static volatile int atomic_count;
 
@@ -311,11 +520,16 @@ static void atomic_test(void)
 int thread_tests(void) 
 {
 	mutex_test();
+	amutex_test();
+	rwlock_test();
 	event_test();
 
 	thread_sleep(200);
 	context_switch_test();
 
+	thread_sleep(200);
+	ping_pong_test();
+
 	atomic_test();
 	
 	return 0;
@@ -0,0 +1,372 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <app/tests.h>
+#include <debug.h>
+#include <endian.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dev/flash-ubi.h>
+
+/*
+ * Simulated NAND the UBI code runs on through its flash ops.  A page can
+ * only be programmed once between erases, as on the real thing, and the
+ * erases, page programs & data page reads are counted.
+ */
+#define SIM_PAGE_SIZE       2048
+#define SIM_PAGES_PER_BLK   8
+#define SIM_BLK_SIZE        (SIM_PAGE_SIZE * SIM_PAGES_PER_BLK)
+#define SIM_NUM_BLKS        40
+#define SIM_BAD_BLK         24
+
+/* The UBI partition, the VID header in page 1, the data from page 2 on */
+#define UBI_TEST_START      4
+#define UBI_TEST_LEN        32
+#define UBI_TEST_VID_OFFS   SIM_PAGE_SIZE
+#define UBI_TEST_DATA_OFFS  (2 * SIM_PAGE_SIZE)
+#define UBI_TEST_LEB_SIZE   (SIM_BLK_SIZE - UBI_TEST_DATA_OFFS)
+#define UBI_TEST_VOL_PEBS   10
+
+struct nand_sim {
+	uint8_t *mem;
+	uint8_t programmed[SIM_NUM_BLKS * SIM_PAGES_PER_BLK];
+	uint32_t erases;
+	uint32_t programs;
+	uint32_t data_reads[SIM_NUM_BLKS];
+	uint32_t errors;
+};
+
+static struct nand_sim *sim;
+
+static unsigned sim_page_size(void)
+{
+	return SIM_PAGE_SIZE;
+}
+
+static unsigned sim_block_size(void)
+{
+	return SIM_BLK_SIZE;
+}
+
+static unsigned sim_spare_size(void)
+{
+	return 64;
+}
+
+static int sim_block_isbad(unsigned page)
+{
+	return page / SIM_PAGES_PER_BLK == SIM_BAD_BLK;
+}
+
+static int sim_read(uint32_t start_page, uint32_t num_pages,
+		unsigned char *buffer, unsigned char *spareaddr)
+{
+	uint32_t page;
+
+	for (page = start_page; page < start_page + num_pages; page++) {
+		if (page >= SIM_NUM_BLKS * SIM_PAGES_PER_BLK || sim_block_isbad(page))
+			return -1;
+		if (page % SIM_PAGES_PER_BLK >= UBI_TEST_DATA_OFFS / SIM_PAGE_SIZE)
+			sim->data_reads[page / SIM_PAGES_PER_BLK]++;
+		memcpy(buffer, sim->mem + page * SIM_PAGE_SIZE, SIM_PAGE_SIZE);
+		buffer += SIM_PAGE_SIZE;
+	}
+	return 0;
+}
+
+static int sim_read_heads(uint32_t start_page, uint32_t num_blocks,
+		uint32_t num_pages, unsigned char *buffer, int *results)
+{
+	uint32_t i;
+
+	for (i = 0; i < num_blocks; i++)
+		results[i] = sim_read(start_page + i * SIM_PAGES_PER_BLK, num_pages,
+				buffer + i * num_pages * SIM_PAGE_SIZE, NULL);
+	return 0;
+}
+
+static int sim_write(uint32_t start_page, uint32_t num_pages,
+		unsigned char *buffer, unsigned write_extra_bytes)
+{
+	uint32_t page;
+
+	for (page = start_page; page < start_page + num_pages; page++) {
+		if (page >= SIM_NUM_BLKS * SIM_PAGES_PER_BLK || sim_block_isbad(page))
+			return -1;
+		if (sim->programmed[page]) {
+			dprintf(CRITICAL, "ubi test: page %u programmed twice\n", page);
+			sim->errors++;
+			return -1;
+		}
+		sim->programmed[page] = 1;
+		sim->programs++;
+		memcpy(sim->mem + page * SIM_PAGE_SIZE, buffer, SIM_PAGE_SIZE);
+		buffer += SIM_PAGE_SIZE;
+	}
+	return 0;
+}
+
+static int sim_erase(uint32_t page)
+{
+	uint32_t blk = page / SIM_PAGES_PER_BLK;
+
+	if (blk >= SIM_NUM_BLKS || sim_block_isbad(page))
+		return -1;
+	sim->erases++;
+	memset(sim->mem + blk * SIM_BLK_SIZE, 0xFF, SIM_BLK_SIZE);
+	memset(sim->programmed + blk * SIM_PAGES_PER_BLK, 0, SIM_PAGES_PER_BLK);
+	return 0;
+}
+
+static const struct ubi_flash_ops sim_ops = {
+	.page_size = sim_page_size,
+	.block_size = sim_block_size,
+	.spare_size = sim_spare_size,
+	.block_isbad = sim_block_isbad,
+	.read = sim_read,
+	.read_heads = sim_read_heads,
+	.write = sim_write,
+	.erase = sim_erase,
+};
+
+static uint32_t ubi_test_crc(const void *buf, unsigned len)
+{
+	const uint8_t *p = buf;
+	uint32_t crc = UBI_CRC32_INIT;
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+	}
+	return crc;
+}
+
+/* Contents of the volume: LEB lnum of version ver */
+static void ubi_test_fill(uint8_t *buf, int lnum, int ver, unsigned len)
+{
+	unsigned i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (i * 7 + lnum * 13 + ver * 31) & 0xff;
+}
+
+static void ubi_test_peb(uint8_t *peb, uint32_t vol_id, uint32_t lnum,
+		const void *data, unsigned len, bool copy)
+{
+	struct ubi_ec_hdr *ech = (struct ubi_ec_hdr *)peb;
+	struct ubi_vid_hdr *vidh = (struct ubi_vid_hdr *)(peb + UBI_TEST_VID_OFFS);
+
+	memset(peb, 0xFF, SIM_BLK_SIZE);
+	memset(ech, 0, UBI_EC_HDR_SIZE);
+	ech->magic = BE32(UBI_EC_HDR_MAGIC);
+	ech->version = UBI_VERSION;
+	ech->vid_hdr_offset = BE32(UBI_TEST_VID_OFFS);
+	ech->data_offset = BE32(UBI_TEST_DATA_OFFS);
+
+	memset(vidh, 0, UBI_VID_HDR_SIZE);
+	vidh->magic = BE32(UBI_VID_HDR_MAGIC);
+	vidh->version = UBI_VERSION;
+	vidh->vol_type = UBI_VID_DYNAMIC;
+	vidh->vol_id = BE32(vol_id);
+	vidh->lnum = BE32(lnum);
+	if (copy) {
+		/* As UBI leaves a LEB it moved: with a CRC of its data */
+		vidh->copy_flag = 1;
+		vidh->data_size = BE32(len);
+		vidh->data_crc = BE32(ubi_test_crc(data, len));
+	}
+	vidh->hdr_crc = BE32(ubi_test_crc(vidh, UBI_VID_HDR_SIZE_CRC));
+
+	memcpy(peb + UBI_TEST_DATA_OFFS, data, len);
+}
+
+/*
+ * Check the partition holds LEBs 0 to nlebs - 1 of the volume, each once,
+ * as versions ver[], and no other LEB of it.
+ */
+static int ubi_test_check(const int *ver, int nlebs, unsigned last_len)
+{
+	uint8_t *expect = malloc(UBI_TEST_LEB_SIZE);
+	uint32_t seen = 0;
+	unsigned blk, len;
+	uint32_t lnum;
+	int fail = 0;
+
+	if (!expect)
+		return 1;
+
+	for (blk = UBI_TEST_START; blk < UBI_TEST_START + UBI_TEST_LEN; blk++) {
+		uint8_t *peb = sim->mem + blk * SIM_BLK_SIZE;
+		struct ubi_vid_hdr *vidh = (struct ubi_vid_hdr *)(peb + UBI_TEST_VID_OFFS);
+
+		if (blk == SIM_BAD_BLK || BE32(vidh->magic) != UBI_VID_HDR_MAGIC ||
+				BE32(vidh->vol_id))
+			continue;
+
+		lnum = BE32(vidh->lnum);
+		if (lnum >= (uint32_t)nlebs || (seen & (1 << lnum))) {
+			fail = 1;
+			continue;
+		}
+		seen |= 1 << lnum;
+
+		/* A partial last LEB is written a whole page at a time */
+		len = lnum == (uint32_t)nlebs - 1 ? last_len : UBI_TEST_LEB_SIZE;
+		if (len < UBI_TEST_LEB_SIZE)
+			len -= len % SIM_PAGE_SIZE;
+		memset(expect, 0xFF, UBI_TEST_LEB_SIZE);
+		ubi_test_fill(expect, lnum, ver[lnum], len);
+		if (memcmp(peb + UBI_TEST_DATA_OFFS, expect, UBI_TEST_LEB_SIZE))
+			fail = 1;
+	}
+	if (seen != (1U << nlebs) - 1)
+		fail = 1;
+
+	free(expect);
+	return fail;
+}
+
+/* Update the volume to nlebs LEBs of versions ver[] & check the result */
+static int ubi_test_update(struct ptentry *ptn, const int *ver, int nlebs,
+		unsigned last_len, uint32_t erases, bool writes, uint32_t keep_blk)
+{
+	unsigned size = (nlebs - 1) * UBI_TEST_LEB_SIZE + last_len;
+	uint8_t *data = malloc(size);
+	int lnum, fail = 0;
+
+	if (!data)
+		return 1;
+
+	for (lnum = 0; lnum < nlebs; lnum++)
+		ubi_test_fill(data + lnum * UBI_TEST_LEB_SIZE, lnum, ver[lnum],
+				lnum == nlebs - 1 ? last_len : UBI_TEST_LEB_SIZE);
+
+	sim->erases = 0;
+	sim->programs = 0;
+	memset(sim->data_reads, 0, sizeof(sim->data_reads));
+	if (update_ubi_vol(ptn, "rootfs", data, size))
+		fail = 1;
+
+	if (sim->erases != erases || !sim->programs != !writes)
+		fail = 1;
+	/* An unchanged LEB with a data CRC is not read back */
+	if (keep_blk && sim->data_reads[keep_blk])
+		fail = 1;
+	fail |= ubi_test_check(ver, nlebs, last_len);
+
+	dprintf(INFO, "ubi test: %d LEBs, %u erases, %u page programs: %s\n",
+			nlebs, sim->erases, sim->programs, fail ? "FAIL" : "PASS");
+
+	free(data);
+	return fail;
+}
+
+int ubi_tests(void)
+{
+	struct ptentry ptn = {
+		.name = "ubi",
+		.start = UBI_TEST_START,
+		.length = UBI_TEST_LEN,
+	};
+	struct ubi_vtbl_record *vtbl;
+	uint8_t *img = NULL, *leb = NULL;
+	int ver[4] = { 0, 0, 0, 0 };
+	unsigned last_len = UBI_TEST_LEB_SIZE / 2 + 100;
+	int lnum, fail = 0;
+
+	sim = calloc(1, sizeof(*sim));
+	if (sim)
+		sim->mem = malloc(SIM_NUM_BLKS * SIM_BLK_SIZE);
+	img = malloc(6 * SIM_BLK_SIZE);
+	leb = malloc(UBI_TEST_LEB_SIZE);
+	if (!sim || !sim->mem || !img || !leb) {
+		fail = 1;
+		goto out;
+	}
+	memset(sim->mem, 0xFF, SIM_NUM_BLKS * SIM_BLK_SIZE);
+
+	/* Two copies of the volume table, then a 4 LEB volume */
+	memset(leb, 0, UBI_TEST_LEB_SIZE);
+	vtbl = (struct ubi_vtbl_record *)leb;
+	vtbl->reserved_pebs = BE32(UBI_TEST_VOL_PEBS);
+	vtbl->vol_type = UBI_VID_DYNAMIC;
+	vtbl->name_len = BE16(6);
+	strcpy((char *)vtbl->name, "rootfs");
+	ubi_test_peb(img, UBI_LAYOUT_VOLUME_ID, 0, leb, UBI_TEST_LEB_SIZE, false);
+	ubi_test_peb(img + SIM_BLK_SIZE, UBI_LAYOUT_VOLUME_ID, 1, leb,
+			UBI_TEST_LEB_SIZE, false);
+	for (lnum = 0; lnum < 4; lnum++) {
+		unsigned len = lnum == 3 ? last_len - last_len % SIM_PAGE_SIZE :
+			UBI_TEST_LEB_SIZE;
+
+		ubi_test_fill(leb, lnum, 0, len);
+		ubi_test_peb(img + (lnum + 2) * SIM_BLK_SIZE, 0, lnum, leb, len,
+				lnum == 0);
+	}
+
+	flash_ubi_set_ops(&sim_ops);
+
+	if (flash_ubi_img(&ptn, img, 6 * SIM_BLK_SIZE) || sim->errors) {
+		fail = 1;
+		goto out_ops;
+	}
+	fail |= ubi_test_check(ver, 4, last_len);
+
+	/* The same volume again: nothing is erased or written */
+	fail |= ubi_test_update(&ptn, ver, 4, last_len, 0, false,
+			UBI_TEST_START + 2);
+
+	/* One LEB changes: only its PEB is erased */
+	ver[1] = 1;
+	fail |= ubi_test_update(&ptn, ver, 4, last_len, 1, true,
+			UBI_TEST_START + 2);
+
+	/* The volume shrinks to 2 LEBs & the first changes */
+	ver[0] = 2;
+	fail |= ubi_test_update(&ptn, ver, 2, UBI_TEST_LEB_SIZE, 3, true, 0);
+
+	/* Grows back to 4: the new LEBs go to free PEBs, nothing is erased */
+	fail |= ubi_test_update(&ptn, ver, 4, last_len, 0, true, 0);
+
+	if (sim->errors)
+		fail = 1;
+
+out_ops:
+	flash_ubi_set_ops(NULL);
+out:
+	if (sim)
+		free(sim->mem);
+	free(sim);
+	free(img);
+	free(leb);
+
+	dprintf(INFO, "ubi tests: %s\n", fail ? "FAIL" : "PASS");
+	return fail ? -1 : 0;
+}
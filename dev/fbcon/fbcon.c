@@ -59,6 +59,7 @@ static struct fbcon_config *config = NULL;
 #define FONT_HEIGHT		12
 
 #define SCALE_FACTOR		2
+#define LINE_HEIGHT		(FONT_HEIGHT * SCALE_FACTOR)
 
 static uint32_t			BGCOLOR;
 static uint32_t			FGCOLOR;
@@ -66,135 +67,274 @@ static uint32_t			FGCOLOR;
 static struct pos		cur_pos;
 static struct pos		max_pos;
 
-static void fbcon_drawglyph(char *pixels, uint32_t paint, unsigned stride,
-			    unsigned bpp, unsigned *glyph)
+/* framebuffer lines drawn since the last flush, none when start > end */
+static unsigned			dirty_start = ~0U;
+static unsigned			dirty_end;
+
+/*
+ * A glyph row is FONT_WIDTH bits, so a whole cell row (glyph plus the gap
+ * column, scaled up) can only look GLYPH_PATTERNS different ways.  They
+ * are rendered once for the current colours and framebuffer format and
+ * characters are then drawn by copying rows.
+ */
+#define GLYPH_PATTERNS		(1 << FONT_WIDTH)
+#define CELL_WIDTH		((FONT_WIDTH + 1) * SCALE_FACTOR)
+#define MAX_BYTES_PER_PIXEL	4
+
+static uint8_t			glyph_rows[GLYPH_PATTERNS][CELL_WIDTH * MAX_BYTES_PER_PIXEL];
+
+/* characters put on the current line that are not drawn yet */
+static char			pending[256];
+static unsigned			pending_len;
+
+static void fbcon_build_glyph_rows(void)
 {
-	unsigned x, y, i, j, k;
-	unsigned data, temp;
-	uint32_t fg_color = paint;
-	stride -= FONT_WIDTH * SCALE_FACTOR;
-
-	data = glyph[0];
-	for (y = 0; y < FONT_HEIGHT / 2; ++y) {
-		temp = data;
-		for (i = 0; i < SCALE_FACTOR; i++) {
-			data = temp;
-			for (x = 0; x < FONT_WIDTH; ++x) {
-				if (data & 1) {
-					for (j = 0; j < SCALE_FACTOR; j++) {
-						fg_color = paint;
-						for (k = 0; k < bpp; k++) {
-							*pixels = (unsigned char) fg_color;
-							fg_color = fg_color >> 8;
-							pixels++;
-						}
-					}
-				}
-				else
-				{
-					for (j = 0; j < SCALE_FACTOR; j++) {
-						pixels = pixels + bpp;
-					}
-				}
-				data >>= 1;
-			}
-			pixels += (stride * bpp);
+	unsigned bytes_per_bpp = config->bpp / 8;
+	unsigned pattern, x, k;
+	uint32_t color;
+	uint8_t *p;
+
+	ASSERT(bytes_per_bpp <= MAX_BYTES_PER_PIXEL);
+
+	for (pattern = 0; pattern < GLYPH_PATTERNS; pattern++) {
+		p = glyph_rows[pattern];
+		for (x = 0; x < CELL_WIDTH; x++) {
+			color = (pattern >> (x / SCALE_FACTOR)) & 1 ? FGCOLOR : BGCOLOR;
+			for (k = 0; k < bytes_per_bpp; k++)
+				*p++ = color >> (k * 8);
 		}
 	}
+}
 
-	data = glyph[1];
-	for (y = 0; y < FONT_HEIGHT / 2; ++y) {
-		temp = data;
-		for (i = 0; i < SCALE_FACTOR; i++) {
-			data = temp;
-			for (x = 0; x < FONT_WIDTH; ++x) {
-				if (data & 1) {
-					for (j = 0; j < SCALE_FACTOR; j++) {
-						fg_color = paint;
-						for (k = 0; k < bpp; k++) {
-							*pixels = (unsigned char) fg_color;
-							fg_color = fg_color >> 8;
-							pixels++;
-						}
-					}
-				}
-				else
-				{
-					for (j = 0; j < SCALE_FACTOR; j++) {
-						pixels = pixels + bpp;
-					}
-				}
-				data >>= 1;
-			}
-			pixels += (stride * bpp);
-		}
+/* font5x12 packs six rows of FONT_WIDTH bits into each word */
+static inline unsigned fbcon_glyph_row(const unsigned *glyph, unsigned row)
+{
+	return (glyph[row / (FONT_HEIGHT / 2)] >>
+		((row % (FONT_HEIGHT / 2)) * FONT_WIDTH)) & (GLYPH_PATTERNS - 1);
+}
+
+/* fill count RGB888 pixels with the same colour, a word at a time */
+static void fbcon_fill_rgb888(uint8_t *p, const uint8_t *px, unsigned count)
+{
+	uint32_t w0, w1, w2;
+	uint32_t *w;
+
+	/* at most three pixels get the destination word aligned */
+	while (count && ((addr_t)p & 3)) {
+		p[0] = px[0];
+		p[1] = px[1];
+		p[2] = px[2];
+		p += 3;
+		count--;
 	}
 
+	/* four pixels make up exactly three words */
+	w0 = px[0] | (px[1] << 8) | (px[2] << 16) | (px[0] << 24);
+	w1 = px[1] | (px[2] << 8) | (px[0] << 16) | (px[1] << 24);
+	w2 = px[2] | (px[0] << 8) | (px[1] << 16) | (px[2] << 24);
+
+	w = (uint32_t *)p;
+	while (count >= 4) {
+		w[0] = w0;
+		w[1] = w1;
+		w[2] = w2;
+		w += 3;
+		count -= 4;
+	}
+
+	p = (uint8_t *)w;
+	while (count--) {
+		p[0] = px[0];
+		p[1] = px[1];
+		p[2] = px[2];
+		p += 3;
+	}
 }
 
-static void fbcon_flush(void)
+static unsigned fbcon_pitch(void)
 {
-	unsigned total_x, total_y;
-	unsigned bytes_per_bpp;
+	unsigned stride = config->stride ? config->stride : config->width;
 
-	if (config->update_start)
-		config->update_start();
-	if (config->update_done)
-		while (!config->update_done());
+	return stride * (config->bpp / 8);
+}
 
-	total_x = config->width;
-	total_y = config->height;
-	bytes_per_bpp = ((config->bpp) / 8);
-	arch_clean_invalidate_cache_range((addr_t) config->base, (total_x * total_y * bytes_per_bpp));
+static void fbcon_mark_dirty(unsigned start, unsigned end)
+{
+	if (start < dirty_start)
+		dirty_start = start;
+	if (end > dirty_end)
+		dirty_end = end;
 }
 
-/* TODO: Take stride into account */
-static void fbcon_scroll_up(void)
+/*
+ * Write the dirty lines back to memory and forget about them, the panel
+ * is left alone.  Returns false if there was nothing to write.
+ */
+static bool fbcon_clean_dirty(unsigned *start, unsigned *end)
 {
-	unsigned short *dst = config->base;
-	unsigned short *src = dst + (config->width * FONT_HEIGHT);
-	unsigned count = config->width * (config->height - FONT_HEIGHT);
+	unsigned pitch;
+
+	if (dirty_start > dirty_end)
+		return false;
+
+	if (dirty_end >= config->height)
+		dirty_end = config->height - 1;
+
+	pitch = fbcon_pitch();
+	arch_clean_invalidate_cache_range((addr_t) config->base + dirty_start * pitch,
+			(dirty_end - dirty_start + 1) * pitch);
+
+	*start = dirty_start;
+	*end = dirty_end;
+	dirty_start = ~0U;
+	dirty_end = 0;
+
+	return true;
+}
+
+static void fbcon_flush_dirty(void)
+{
+	unsigned start, end;
+
+	if (!fbcon_clean_dirty(&start, &end))
+		return;
 
-	while(count--) {
-		*dst++ = *src++;
+	/* command mode panels only need to be sent the lines that changed */
+	if (!config->update_rows || config->update_rows(start, end)) {
+		if (config->update_start)
+			config->update_start();
+		if (config->update_done)
+			while (!config->update_done());
 	}
+}
+
+/* for callers that wrote to the framebuffer behind fbcon's back */
+static void fbcon_flush(void)
+{
+	fbcon_mark_dirty(0, config->height - 1);
+	fbcon_flush_dirty();
+}
 
-	count = config->width * FONT_HEIGHT;
-	while(count--) {
-		*dst++ = BGCOLOR;
+/* paint count lines from start with the background colour */
+static void fbcon_fill_lines(unsigned start, unsigned count)
+{
+	unsigned bytes_per_bpp = config->bpp / 8;
+	unsigned pitch = fbcon_pitch();
+	uint8_t *line = (uint8_t *) config->base + start * pitch;
+	uint8_t px[3];
+	unsigned i, x, k;
+
+	px[0] = BGCOLOR;
+	px[1] = BGCOLOR >> 8;
+	px[2] = BGCOLOR >> 16;
+
+	for (i = 0; i < count; i++, line += pitch) {
+		if (!BGCOLOR) {
+			memset(line, 0, config->width * bytes_per_bpp);
+		} else if (bytes_per_bpp == 3) {
+			fbcon_fill_rgb888(line, px, config->width);
+		} else if (bytes_per_bpp == 2) {
+			for (x = 0; x < config->width; x++)
+				((uint16_t *) line)[x] = BGCOLOR;
+		} else {
+			for (x = 0; x < config->width; x++)
+				for (k = 0; k < bytes_per_bpp; k++)
+					line[x * bytes_per_bpp + k] = BGCOLOR >> (k * 8);
+		}
 	}
 
-	fbcon_flush();
+	fbcon_mark_dirty(start, start + count - 1);
 }
 
-/* TODO: take stride into account */
-void fbcon_clear(void)
+/* draw the pending characters, which end just left of the cursor */
+static void fbcon_draw_pending(void)
 {
-	unsigned long i = 0, j = 0;
-	unsigned char *pixels = config->base;
-	unsigned count = config->width * config->height;
-	uint32_t bg_color;
-	for (i = 0; i < count; i++) {
-		bg_color = BGCOLOR;
-		for (j = 0; j < (config->bpp / 8); j++) {
-			*pixels = (unsigned char) bg_color;
-			bg_color = bg_color >> 8;
-			pixels++;
+	unsigned pitch = fbcon_pitch();
+	unsigned cell = CELL_WIDTH * (config->bpp / 8);
+	const uint8_t *src;
+	uint8_t *line, *dst;
+	unsigned row, i, s;
+
+	if (!pending_len)
+		return;
+
+	line = (uint8_t *) config->base + cur_pos.y * LINE_HEIGHT * pitch;
+	line += (cur_pos.x - pending_len) * cell;
+
+	/* go down the framebuffer once for the whole run of text */
+	for (row = 0; row < FONT_HEIGHT; row++, line += SCALE_FACTOR * pitch) {
+		for (i = 0; i < pending_len; i++) {
+			src = glyph_rows[fbcon_glyph_row(font5x12 +
+					(pending[i] - 32) * 2, row)];
+			dst = line + i * cell;
+			for (s = 0; s < SCALE_FACTOR; s++, dst += pitch)
+				memcpy(dst, src, cell);
+		}
+	}
+
+	fbcon_mark_dirty(cur_pos.y * LINE_HEIGHT, (cur_pos.y + 1) * LINE_HEIGHT - 1);
+	pending_len = 0;
+}
+
+static bool fbcon_can_pan(void)
+{
+	return config->pan && config->vbase &&
+		config->vheight >= config->height + LINE_HEIGHT;
+}
+
+static void fbcon_scroll_up(void)
+{
+	unsigned pitch = fbcon_pitch();
+	unsigned keep = config->height - LINE_HEIGHT;
+	uint8_t *next = (uint8_t *) config->base + LINE_HEIGHT * pitch;
+	unsigned start, end;
+
+	if (fbcon_can_pan()) {
+		/* the last line drawn is still relative to the old base */
+		fbcon_clean_dirty(&start, &end);
+
+		/* out of room below the screen, move it back to the top once */
+		if (next + config->height * pitch >
+				(uint8_t *) config->vbase + config->vheight * pitch) {
+			memmove(config->vbase, next, keep * pitch);
+			next = config->vbase;
+			fbcon_mark_dirty(0, keep - 1);
 		}
+
+		config->base = next;
+		fbcon_fill_lines(keep, LINE_HEIGHT);
+		fbcon_clean_dirty(&start, &end);
+
+		/* moving the scanout refreshes the whole panel anyway */
+		config->pan(next);
+		return;
 	}
+
+	memmove(config->base, next, keep * pitch);
+	fbcon_fill_lines(keep, LINE_HEIGHT);
+	fbcon_flush();
 }
 
+void fbcon_clear(void)
+{
+	/* whatever was still to be drawn would have been wiped anyway */
+	pending_len = 0;
+	fbcon_fill_lines(0, config->height);
+}
 
 static void fbcon_set_colors(unsigned bg, unsigned fg)
 {
 	BGCOLOR = bg;
 	FGCOLOR = fg;
+	fbcon_build_glyph_rows();
 }
 
+/*
+ * Text is collected a line at a time and drawn when the line ends, the
+ * cursor moves back or the line is full, then the panel is updated once.
+ */
 void fbcon_putc(char c)
 {
-	char *pixels;
-
 	/* ignore anything that happens before fbcon is initialized */
 	if (!config)
 		return;
@@ -206,6 +346,7 @@ void fbcon_putc(char c)
 		if(c == '\n')
 			goto newline;
 		else if (c == '\r') {
+			fbcon_draw_pending();
 			cur_pos.x = 0;
 			return;
 		}
@@ -213,24 +354,24 @@ void fbcon_putc(char c)
 			return;
 	}
 
-	pixels = config->base;
-	pixels += cur_pos.y * SCALE_FACTOR * ((config->bpp / 8) * FONT_HEIGHT * config->width);
-	pixels += cur_pos.x * SCALE_FACTOR * ((config->bpp / 8) * (FONT_WIDTH + 1));
-	fbcon_drawglyph(pixels, FGCOLOR, config->stride, (config->bpp / 8),
-			font5x12 + (c - 32) * 2);
+	pending[pending_len++] = c;
 
 	cur_pos.x++;
-	if (cur_pos.x < max_pos.x)
+	if (cur_pos.x < max_pos.x) {
+		if (pending_len == sizeof(pending))
+			fbcon_draw_pending();
 		return;
+	}
 
 newline:
+	fbcon_draw_pending();
 	cur_pos.y++;
 	cur_pos.x = 0;
 	if(cur_pos.y >= max_pos.y) {
 		cur_pos.y = max_pos.y - 1;
 		fbcon_scroll_up();
 	} else
-		fbcon_flush();
+		fbcon_flush_dirty();
 }
 
 void fbcon_setup(struct fbcon_config *_config)
@@ -259,10 +400,18 @@ void fbcon_setup(struct fbcon_config *_config)
 
 	fbcon_set_colors(bg, fg);
 
+	pending_len = 0;
 	cur_pos.x = 0;
 	cur_pos.y = 0;
-	max_pos.x = config->width / ((FONT_WIDTH + 1) * SCALE_FACTOR);
-	max_pos.y = (config->height - 1) / FONT_HEIGHT;
+	max_pos.x = config->width / CELL_WIDTH;
+	max_pos.y = config->height / LINE_HEIGHT;
+
+	if (!config->vbase)
+		config->vbase = config->base;
+	if (config->vheight < config->height)
+		config->vheight = config->height;
+	dirty_start = ~0U;
+	dirty_end = 0;
 #if !DISPLAY_SPLASH_SCREEN
 	fbcon_clear();
 #endif
@@ -273,66 +422,83 @@ struct fbcon_config* fbcon_display(void)
 	return config;
 }
 
-void fbcon_extract_to_screen(logo_img_header *header, void* address)
+int fbcon_extract_start(struct fbcon_rle_ctx *ctx, logo_img_header *header)
 {
-	const uint8_t *imagestart = (const uint8_t *)address;
-	uint pos = 0, offset;
-	uint count = 0;
-	uint x = 0, y = 0;
-	uint8_t *base, *p;
+	unsigned stride;
 
 	if (!config || header->width > config->width
 				|| header->height > config->height) {
 		dprintf(INFO, "the logo img is too large\n");
-		return;
+		return -1;
 	}
 
-	base = (uint8_t *) config->base;
+	if (config->bpp != 24) {
+		dprintf(INFO, "RLE24 logo needs a 24 bpp framebuffer\n");
+		return -1;
+	}
+
+	stride = config->stride ? config->stride : config->width;
+
+	ctx->width = header->width;
+	ctx->height = header->height;
+	ctx->pitch = stride * 3;
+	ctx->x = 0;
+	ctx->y = 0;
 
 	/* put the logo to be center */
-	offset = (config->height - header->height) / 2;
-	if (offset)
-		base += (offset * config->width) * 3;
-	offset = (config->width - header->width ) / 2;
-
-	x = offset;
-	while (count < (uint)header->height * (uint)header->width) {
-		uint8_t run = *(imagestart + pos);
-		bool repeat_run = (run & 0x80);
-		uint runlen = (run & 0x7f) + 1;
-		uint runpos;
+	ctx->base = (uint8_t *) config->base;
+	ctx->base += ((config->height - header->height) / 2) * ctx->pitch;
+	ctx->base += ((config->width - header->width) / 2) * 3;
 
-		/* consume the run byte */
-		pos++;
+	return 0;
+}
 
-		p = base + (y * config->width + x) * 3;
+uint32_t fbcon_extract_chunk(struct fbcon_rle_ctx *ctx, const uint8_t *data, uint32_t len)
+{
+	uint32_t pos = 0;
+	uint8_t *line = ctx->base + ctx->y * ctx->pitch;
 
-		/* start of a run */
-		for (runpos = 0; runpos < runlen; runpos++) {
-			*p++ = *(imagestart + pos);
-			*p++ = *(imagestart + pos + 1);
-			*p++ = *(imagestart + pos + 2);
-			count++;
+	while (ctx->y < ctx->height && pos < len) {
+		uint8_t run = data[pos];
+		bool repeat_run = (run & 0x80);
+		unsigned runlen = (run & 0x7f) + 1;
+		uint32_t runsize = 1 + (repeat_run ? 3 : runlen * 3);
+		unsigned npixels = runlen;
 
-			x++;
+		/* the rest of this run comes with the next chunk */
+		if (len - pos < runsize)
+			break;
 
-			/* if a run of raw pixels, consume an input pixel */
-			if (!repeat_run)
-				pos += 3;
-		}
+		/* the generator compresses line by line, but never write past the logo */
+		if (npixels > ctx->width - ctx->x)
+			npixels = ctx->width - ctx->x;
 
-		/* if this was a run of repeated pixels, consume the one input pixel we repeated */
 		if (repeat_run)
-			pos += 3;
+			fbcon_fill_rgb888(line + ctx->x * 3, data + pos + 1, npixels);
+		else
+			memcpy(line + ctx->x * 3, data + pos + 1, npixels * 3);
 
-		/* the generator will keep compressing data line by line */
-		/* don't cross the lines */
-		if (x == header->width + offset) {
-			y++;
-			x = offset;
+		pos += runsize;
+		ctx->x += npixels;
+
+		if (ctx->x >= ctx->width) {
+			ctx->x = 0;
+			ctx->y++;
+			line += ctx->pitch;
 		}
 	}
 
+	return pos;
+}
+
+void fbcon_extract_to_screen(logo_img_header *header, void* address)
+{
+	struct fbcon_rle_ctx ctx;
+
+	if (fbcon_extract_start(&ctx, header))
+		return;
+
+	fbcon_extract_chunk(&ctx, (const uint8_t *)address, header->blocks * 512);
 }
 
 void display_default_image_on_screen(void)
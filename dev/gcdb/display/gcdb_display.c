@@ -519,6 +519,10 @@ int gcdb_display_init(const char *panel_name, uint32_t rev, void *base)
 		panel.fb.stride =  panel.panel_info.xres;
 		panel.fb.bpp =  panel.panel_info.bpp;
 		panel.fb.format = panel.panel_info.mipi.dst_format;
+#if DISPLAY_FB_SCROLL_LINES
+		/* the target reserved this many spare lines below the screen */
+		panel.fb.vheight = panel.fb.height + DISPLAY_FB_SCROLL_LINES;
+#endif
 	} else if (pan_type == PANEL_TYPE_EDP) {
 		mdss_edp_panel_init(&(panel.panel_info));
 		/* prepare func is set up at edp_panel_init */
@@ -49,6 +49,7 @@ extern "C" {
 
 /* output */
 void _dputc(char c); // XXX for now, platform implements
+void _dflush(void); // push out output the platform held back, if it does
 int _dputs(const char *str);
 int _dprintf(const char *fmt, ...) __PRINTFLIKE(1, 2);
 int _dvprintf(const char *fmt, va_list ap);
@@ -67,6 +67,18 @@ struct fbcon_config {
 
 	void		(*update_start)(void);
 	int		(*update_done)(void);
+
+	/* optional, push only lines start..end to a command mode panel */
+	int		(*update_rows)(unsigned start, unsigned end);
+	/* optional, scan out from a new address inside the buffer */
+	int		(*pan)(void *base);
+	/*
+	 * lines of stride pixels backing the console, starting at vbase.
+	 * when larger than height and pan is set, fbcon scrolls by moving
+	 * the scanout base instead of copying the screen.
+	 */
+	void		*vbase;
+	unsigned	vheight;
 };
 
 void fbcon_setup(struct fbcon_config *cfg);
@@ -75,4 +87,19 @@ void fbcon_clear(void);
 struct fbcon_config* fbcon_display(void);
 void fbcon_extract_to_screen(logo_img_header *header, void* address);
 
+/* state for decoding an RLE24 logo that is delivered in several pieces */
+struct fbcon_rle_ctx {
+	uint8_t		*base;		/* top left pixel of the logo */
+	unsigned	pitch;		/* framebuffer line length in bytes */
+	unsigned	width;
+	unsigned	height;
+	unsigned	x;
+	unsigned	y;
+};
+
+int fbcon_extract_start(struct fbcon_rle_ctx *ctx, logo_img_header *header);
+/* decodes the whole runs in data, returns the number of bytes consumed */
+uint32_t fbcon_extract_chunk(struct fbcon_rle_ctx *ctx, const uint8_t *data, uint32_t len);
+#define fbcon_extract_done(ctx)	((ctx)->y >= (ctx)->height)
+
 #endif /* __DEV_FBCON_H */
@@ -132,8 +132,81 @@ struct __attribute__ ((packed)) ubi_vid_hdr {
 #define UBI_INTERNAL_VOL_START (0x7FFFFFFF - 4096)
 #define UBI_LAYOUT_VOLUME_ID     UBI_INTERNAL_VOL_START
 #define UBI_VID_DYNAMIC 1
+#define UBI_VID_STATIC  2
 #define UBI_LAYOUT_VOLUME_TYPE UBI_VID_DYNAMIC
 #define UBI_FM_SB_VOLUME_ID	(UBI_INTERNAL_VOL_START + 1)
+#define UBI_FM_DATA_VOLUME_ID	(UBI_INTERNAL_VOL_START + 2)
+
+/* Fastmap on-flash data structures */
+#define UBI_FM_SB_MAGIC		0x7B11D69F
+#define UBI_FM_HDR_MAGIC	0xD4B82EF7
+#define UBI_FM_VHDR_MAGIC	0xFA370ED1
+#define UBI_FM_POOL_MAGIC	0x67AF4D08
+#define UBI_FM_EBA_MAGIC	0xF0C040A8
+
+#define UBI_FM_FMT_VERSION	2
+/* The fastmap superblock is in one of the first UBI_FM_MAX_START PEBs */
+#define UBI_FM_MAX_START	64
+#define UBI_FM_MAX_BLOCKS	32
+#define UBI_FM_MAX_POOL_SIZE	256
+
+/* Fastmap superblock, at the start of the data of the fastmap anchor PEB */
+struct __attribute__ ((packed)) ubi_fm_sb {
+	uint32_t magic;
+	uint8_t  version;
+	uint8_t  padding1[3];
+	uint32_t data_crc;
+	uint32_t used_blocks;
+	uint32_t block_loc[UBI_FM_MAX_BLOCKS];
+	uint32_t block_ec[UBI_FM_MAX_BLOCKS];
+	uint64_t sqnum;
+	uint8_t  padding2[32];
+};
+
+/* Fastmap header, follows the superblock */
+struct __attribute__ ((packed)) ubi_fm_hdr {
+	uint32_t magic;
+	uint32_t free_peb_count;
+	uint32_t used_peb_count;
+	uint32_t scrub_peb_count;
+	uint32_t bad_peb_count;
+	uint32_t erase_peb_count;
+	uint32_t vol_count;
+	uint8_t  padding[4];
+};
+
+/* Pool of PEBs UBI may have written to since the fastmap was written */
+struct __attribute__ ((packed)) ubi_fm_scan_pool {
+	uint32_t magic;
+	uint16_t size;
+	uint16_t max_size;
+	uint32_t pebs[UBI_FM_MAX_POOL_SIZE];
+	uint32_t padding[4];
+};
+
+/* Entry of the free, used, scrub and erase PEB lists */
+struct __attribute__ ((packed)) ubi_fm_ec {
+	uint32_t pnum;
+	uint32_t ec;
+};
+
+struct __attribute__ ((packed)) ubi_fm_volhdr {
+	uint32_t magic;
+	uint32_t vol_id;
+	uint8_t  vol_type;
+	uint8_t  padding1[3];
+	uint32_t data_pad;
+	uint32_t used_ebs;
+	uint32_t last_eb_bytes;
+	uint8_t  padding2[8];
+};
+
+/* LEB to PEB table of a volume, follows its ubi_fm_volhdr */
+struct __attribute__ ((packed)) ubi_fm_eba {
+	uint32_t magic;
+	uint32_t reserved_pebs;
+	uint32_t pnum[0];
+};
 
 /* A record in the UBI volume table. */
 struct __attribute__ ((packed)) ubi_vtbl_record {
@@ -167,11 +240,19 @@ enum {
  * @status: status of this PEB: UBI_BAD_PEB/USED/FREE/EMPTY
  * @volume: if status = UBI_USED_PEB this is the volume
  * 		ID this PEB belongs to -1 for any other status
+ * @lnum: if status = UBI_USED_PEB this is the LEB number it holds
+ * @data_size: size of the data at the start of the LEB the VID header
+ * 		has a CRC of, 0 if it has none (dynamic volume LEB that
+ * 		isn't a copy) or it wasn't read
+ * @data_crc: the CRC of the data, if @data_size is set
  */
 struct peb_info {
 	uint64_t ec;
 	int status;
 	int volume;
+	int lnum;
+	uint32_t data_size;
+	uint32_t data_crc;
 };
 
 /**
@@ -209,6 +290,28 @@ struct ubi_scan_info {
 	uint32_t  read_image_seq;
 };
 
+/**
+ * struct ubi_flash_ops - NAND accessors of the UBI code
+ *
+ * They are the qpic_nand driver ones unless flash_ubi_set_ops() sets
+ * others, e.g. to run on a simulated NAND. Pages are numbered from the
+ * start of the device, the calls return 0 on success.
+ */
+struct ubi_flash_ops {
+	unsigned (*page_size)(void);
+	unsigned (*block_size)(void);
+	unsigned (*spare_size)(void);
+	int (*block_isbad)(unsigned page);
+	int (*read)(uint32_t start_page, uint32_t num_pages,
+			unsigned char *buffer, unsigned char *spareaddr);
+	int (*read_heads)(uint32_t start_page, uint32_t num_blocks,
+			uint32_t num_pages, unsigned char *buffer, int *results);
+	int (*write)(uint32_t start_page, uint32_t num_pages,
+			unsigned char *buffer, unsigned write_extra_bytes);
+	int (*erase)(uint32_t page);
+};
+
+void flash_ubi_set_ops(const struct ubi_flash_ops *ops);
 int flash_ubi_img(struct ptentry *ptn, void *data, unsigned size);
 int update_ubi_vol(struct ptentry *ptn, const char* vol_name,
 				void *data, unsigned size);
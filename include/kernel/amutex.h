@@ -0,0 +1,63 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __KERNEL_AMUTEX_H
+#define __KERNEL_AMUTEX_H
+
+#include <kernel/thread.h>
+
+#define AMUTEX_MAGIC 'amtx'
+
+/* how many times to poll a running owner before blocking */
+#define AMUTEX_SPIN_COUNT 1000
+
+typedef struct amutex {
+	int magic;
+	volatile int count;	/* holder plus waiters */
+	int handoffs;		/* releases that found no waiter blocked yet */
+	thread_t *holder;
+	wait_queue_t wait;
+
+	/* statistics, only updated by the holder */
+	uint32_t acquires;
+	uint32_t contentions;
+} amutex_t;
+
+/* Rules for adaptive mutexes:
+ * - Same as mutex_t: thread context only, non-recursive.
+ * - An uncontended acquire or release is a single atomic operation and does
+ *   not enter a critical section. Contended acquires spin while the owner is
+ *   running on another cpu (SMP only) and otherwise block.
+*/
+
+void amutex_init(amutex_t *);
+void amutex_destroy(amutex_t *);
+status_t amutex_acquire(amutex_t *);
+status_t amutex_release(amutex_t *);
+
+#endif
@@ -32,6 +32,25 @@ typedef void (*dpc_callback)(void *arg);
 
 #define DPC_FLAG_NORESCHED 0x1
 
+/* priority class of the callback, normal if neither is set */
+#define DPC_FLAG_HIGH      0x2	/* latency critical completions */
+#define DPC_FLAG_LOW       0x4	/* long running background work */
+
+/* number of preallocated dpc descriptors, dpc_queue() never allocates */
+#ifndef DPC_POOL_SIZE
+#define DPC_POOL_SIZE 32
+#endif
+
+/* number of worker threads servicing the queues */
+#ifndef DPC_WORKERS
+#define DPC_WORKERS 1
+#endif
+
+/*
+ * queue a callback to be run from a dpc worker thread.
+ * safe to call from interrupt context with DPC_FLAG_NORESCHED.
+ * returns ERR_NO_MEMORY if all the descriptors are in use.
+ */
 status_t dpc_queue(dpc_callback, void *arg, uint flags);
 
 #endif
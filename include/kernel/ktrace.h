@@ -0,0 +1,82 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __KERNEL_KTRACE_H
+#define __KERNEL_KTRACE_H
+
+#include <sys/types.h>
+
+/* per-thread cpu accounting and the scheduler trace ring are cheap enough to
+ * be left on in production builds. define KERNEL_TRACE=0 to compile them out.
+ */
+#ifndef KERNEL_TRACE
+#define KERNEL_TRACE 1
+#endif
+
+enum ktrace_event {
+	KTRACE_NONE = 0,
+	KTRACE_SWITCH,		/* arg0 = old thread, arg1 = new thread */
+	KTRACE_WAKE,		/* arg0 = woken thread, arg1 = wait queue (0 for sleep) */
+	KTRACE_BLOCK,		/* arg0 = blocking thread, arg1 = wait queue (0 for sleep) */
+	KTRACE_IRQ_ENTER,	/* arg0 = interrupt number */
+	KTRACE_IRQ_EXIT,	/* arg0 = interrupt number, arg1 = handler return */
+	KTRACE_DPC,		/* arg0 = callback, arg1 = callback argument */
+	KTRACE_MAX,
+};
+
+struct ktrace_entry {
+	uint32_t timestamp;	/* cycle counter */
+	uint32_t event;
+	uint32_t arg0;
+	uint32_t arg1;
+};
+
+/* must be a power of two */
+#define KTRACE_ENTRIES 512
+
+typedef void (*ktrace_callback)(const struct ktrace_entry *entry, void *arg);
+
+#if KERNEL_TRACE
+/* may be called from any context, including interrupt handlers */
+void ktrace_log(uint event, uint32_t arg0, uint32_t arg1);
+#else
+static inline void ktrace_log(uint event, uint32_t arg0, uint32_t arg1) { }
+#endif
+
+/*
+ * walk the ring from the oldest to the newest entry. logging is paused for the
+ * duration of the walk so the callback sees a consistent snapshot.
+ */
+void ktrace_for_every(ktrace_callback cb, void *arg);
+
+/* format an entry as a single line, prev is the timestamp of the previous entry */
+int ktrace_format(const struct ktrace_entry *entry, uint32_t prev, char *buf, size_t len);
+
+void ktrace_dump(void);
+
+#endif
@@ -0,0 +1,66 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __KERNEL_RWLOCK_H
+#define __KERNEL_RWLOCK_H
+
+#include <kernel/thread.h>
+
+#define RWLOCK_MAGIC 'rwlk'
+
+typedef struct rwlock {
+	int magic;
+	int readers;		/* number of readers holding the lock */
+	int writers_waiting;
+	thread_t *writer;	/* writer holding the lock, if any */
+	wait_queue_t read_wait;
+	wait_queue_t write_wait;
+
+	/* statistics */
+	uint32_t read_acquires;
+	uint32_t read_contentions;
+	uint32_t write_acquires;
+	uint32_t write_contentions;
+} rwlock_t;
+
+/* Rules for reader-writer locks:
+ * - Only safe to use from thread context.
+ * - Any number of readers or a single writer may hold the lock.
+ * - Waiting writers take precedence over new readers so that a steady
+ *   stream of readers cannot starve them.
+ * - Non-recursive, a reader must not try to upgrade to a writer.
+*/
+
+void rwlock_init(rwlock_t *);
+void rwlock_destroy(rwlock_t *);
+status_t rwlock_acquire_read(rwlock_t *);
+status_t rwlock_release_read(rwlock_t *);
+status_t rwlock_acquire_write(rwlock_t *);
+status_t rwlock_release_write(rwlock_t *);
+
+#endif
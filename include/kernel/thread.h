@@ -28,6 +28,7 @@
 #include <compiler.h>
 #include <arch/ops.h>
 #include <arch/thread.h>
+#include <kernel/ktrace.h>
 
 enum thread_state {
 	THREAD_SUSPENDED = 0,
@@ -79,6 +80,15 @@ typedef struct thread {
 	/* thread local storage */
 	uint32_t tls[MAX_TLS_ENTRY];
 
+#if KERNEL_TRACE
+	/* cpu accounting, in cycle counter ticks */
+	uint64_t runtime;	/* time spent running */
+	uint64_t ready_time;	/* time spent in the run queue waiting for the cpu */
+	uint32_t last_switch;	/* timestamp of the last switch to this thread */
+	uint32_t last_ready;	/* timestamp of the last insertion in the run queue */
+	uint32_t switches;	/* number of times this thread was switched to */
+#endif
+
 	char name[32];
 } thread_t;
 
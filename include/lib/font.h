@@ -7,6 +7,7 @@
 #define FONT_Y	12
 
 void font_draw_char(gfx_surface *surface, unsigned char c, int x, int y, uint32_t color);
+void font_draw_char_bg(gfx_surface *surface, unsigned char c, int x, int y, uint32_t color, uint32_t bgcolor);
 
 #endif
 
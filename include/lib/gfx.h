@@ -10,6 +10,7 @@ typedef enum {
 	GFX_FORMAT_RGB_565,
 	GFX_FORMAT_ARGB_8888,
 	GFX_FORMAT_RGB_x888,
+	GFX_FORMAT_RGB_888,	// packed, blue in the lowest byte
 
 	GFX_FORMAT_MAX
 } gfx_format;
@@ -36,6 +37,10 @@ typedef struct gfx_surface {
 	size_t len;
 	uint alpha;
 
+	// rows drawn since the last flush, none when dirty_start > dirty_end
+	uint dirty_start;
+	uint dirty_end;
+
 	// function pointers
 	void (*copyrect)(struct gfx_surface *, uint x, uint y, uint width, uint height, uint x2, uint y2);
 	void (*fillrect)(struct gfx_surface *, uint x, uint y, uint width, uint height, uint color);
@@ -52,6 +57,15 @@ void gfx_fillrect(gfx_surface *surface, uint x, uint y, uint width, uint height,
 // draw a pixel at x, y in the surface
 void gfx_putpixel(gfx_surface *surface, uint x, uint y, uint color);
 
+// note that rows start to end (inclusive) were drawn and need flushing
+static inline void gfx_mark_dirty(gfx_surface *surface, uint start, uint end)
+{
+	if (start < surface->dirty_start)
+		surface->dirty_start = start;
+	if (end > surface->dirty_end)
+		surface->dirty_end = end;
+}
+
 // clear the entire surface with a color
 static inline void gfx_clear(gfx_surface *surface, uint color)
 {
@@ -64,8 +78,21 @@ static inline void gfx_clear(gfx_surface *surface, uint color)
 // blend between two surfaces
 void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, uint destx, uint desty);
 
+// blend a single ARGB 8888 pixel over another, ignoring the destination alpha
+uint32_t alpha32_add_ignore_destalpha(uint32_t dest, uint32_t src);
+
+// row kernels, each works on count pixels
+void gfx_row_fill16(uint16_t *dst, uint16_t color, uint count);
+void gfx_row_fill24(uint8_t *dst, uint32_t color, uint count);
+void gfx_row_fill32(uint32_t *dst, uint32_t color, uint count);
+void gfx_row_blend32(uint32_t *dst, const uint32_t *src, uint count);
+void gfx_row_argb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint count);
+void gfx_row_argb8888_to_rgb888(uint8_t *dst, const uint32_t *src, uint count);
+
 void gfx_flush(struct gfx_surface *surface);
 
+void gfx_flush_dirty(struct gfx_surface *surface);
+
 void gfx_flush_rows(struct gfx_surface *surface, uint start, uint end);
 
 // surface setup
@@ -27,6 +27,8 @@
 
 #include <dload_util.h>
 
+struct fdt_batch;
+
 #define PA(x) platform_get_virt_to_phys_mapping(x)
 #define VA(x) platform_get_phys_to_virt_mapping(x)
 
@@ -50,6 +52,8 @@ void display_init(void);
 void display_shutdown(void);
 void display_image_on_screen(void);
 void display_fbcon_message(char *str);
+int debug_log_update_dt(const void *fdt, struct fdt_batch *batch);
+void debug_log_flush(void);
 
 unsigned board_machtype(void);
 unsigned board_platform_id(void);
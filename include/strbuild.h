@@ -0,0 +1,75 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __STRBUILD_H
+#define __STRBUILD_H
+
+#include <sys/types.h>
+
+/*
+ * String builder: collect the pieces of a string first, then size it
+ * with a single length pass and copy each piece in one go.  Pieces are
+ * not copied when they are added, they must stay valid until the string
+ * is built.
+ */
+#define STRBUILD_MAX_FRAGS	32
+
+struct strbuild_frag {
+	const char *str;
+	size_t len;
+};
+
+struct strbuild {
+	unsigned count;
+	size_t len;
+	struct strbuild_frag frag[STRBUILD_MAX_FRAGS];
+};
+
+void strbuild_init(struct strbuild *sb);
+
+/* NULL and empty strings are skipped; returns 0 or ERR_TOO_BIG */
+int strbuild_add(struct strbuild *sb, const char *str);
+int strbuild_add_len(struct strbuild *sb, const char *str, size_t len);
+
+/* length of the built string, not counting the terminator */
+static inline size_t strbuild_len(const struct strbuild *sb)
+{
+	return sb->len;
+}
+
+/*
+ * Copy the string to dst, truncated to size - 1 characters and always
+ * terminated if size is not 0.  Returns the untruncated length, as
+ * strlcpy() does.
+ */
+size_t strbuild_copy(const struct strbuild *sb, char *dst, size_t size);
+
+/* malloc() a buffer rounded up to a word multiple and copy the string to it */
+char *strbuild_alloc(const struct strbuild *sb);
+
+#endif
@@ -0,0 +1,169 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief  Adaptive mutex functions
+ *
+ * An uncontended acquire/release costs one atomic operation and never
+ * enters a critical section. Only contended acquires fall back to the
+ * wait queue.
+ *
+ * @defgroup amutex Adaptive mutex
+ * @{
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <kernel/amutex.h>
+#include <kernel/thread.h>
+
+#if DEBUGLEVEL > 1
+#define AMUTEX_CHECK 1
+#endif
+
+/**
+ * @brief  Initialize an amutex_t
+ */
+void amutex_init(amutex_t *m)
+{
+	m->magic = AMUTEX_MAGIC;
+	m->count = 0;
+	m->handoffs = 0;
+	m->holder = 0;
+	m->acquires = 0;
+	m->contentions = 0;
+	wait_queue_init(&m->wait);
+}
+
+/**
+ * @brief  Destroy an amutex_t
+ *
+ * Any thread still waiting for the mutex is woken with ERR_OBJECT_DESTROYED.
+ */
+void amutex_destroy(amutex_t *m)
+{
+	enter_critical_section();
+
+#if AMUTEX_CHECK
+	ASSERT(m->magic == AMUTEX_MAGIC);
+#endif
+
+	m->magic = 0;
+	m->count = 0;
+	m->handoffs = 0;
+	wait_queue_destroy(&m->wait, true);
+	exit_critical_section();
+}
+
+/**
+ * @brief  Acquire an adaptive mutex; wait if needed.
+ *
+ * @return  NO_ERROR on success, ERR_OBJECT_DESTROYED if the mutex was
+ * destroyed while waiting for it.
+ */
+status_t amutex_acquire(amutex_t *m)
+{
+	status_t ret = NO_ERROR;
+	bool contended = false;
+
+	if (current_thread == m->holder)
+		panic("amutex_acquire: thread %p (%s) tried to acquire mutex %p it already owns.\n",
+				current_thread, current_thread->name, m);
+
+#if AMUTEX_CHECK
+	ASSERT(m->magic == AMUTEX_MAGIC);
+#endif
+
+#if WITH_SMP
+	/* an owner running on another cpu is likely to let go shortly, so poll for
+	 * a while before committing to the wait queue.
+	 */
+	int spins = AMUTEX_SPIN_COUNT;
+	while (m->count != 0 && spins-- > 0) {
+		thread_t *holder = m->holder;
+
+		if (!holder || holder->state != THREAD_RUNNING)
+			break;
+	}
+#endif
+
+	if (unlikely(atomic_add(&m->count, 1) != 0)) {
+		contended = true;
+
+		enter_critical_section();
+		/*
+		 * the holder may have released the mutex after we bumped the count but
+		 * before we made it onto the wait queue, in which case it left a
+		 * handoff for us instead of waking anyone.
+		 */
+		if (m->handoffs > 0)
+			m->handoffs--;
+		else
+			ret = wait_queue_block(&m->wait, INFINITE_TIME);
+		exit_critical_section();
+
+		if (ret < 0)
+			return ret;
+	}
+
+	m->holder = current_thread;
+	m->acquires++;
+	if (contended)
+		m->contentions++;
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief  Release an adaptive mutex
+ */
+status_t amutex_release(amutex_t *m)
+{
+	if (current_thread != m->holder)
+		panic("amutex_release: thread %p (%s) tried to release mutex %p it doesn't own. owned by %p (%s)\n",
+				current_thread, current_thread->name, m, m->holder, m->holder ? m->holder->name : "none");
+
+#if AMUTEX_CHECK
+	ASSERT(m->magic == AMUTEX_MAGIC);
+#endif
+
+	m->holder = 0;
+
+	if (unlikely(atomic_add(&m->count, -1) > 1)) {
+		/* someone is waiting, pass the mutex on */
+		enter_critical_section();
+		if (wait_queue_wake_one(&m->wait, true, NO_ERROR) == 0)
+			m->handoffs++;
+		exit_critical_section();
+	}
+
+	return NO_ERROR;
+}
+
+/** @} */
@@ -34,6 +34,7 @@
 #include <debug.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <kernel/ktrace.h>
 #include <platform.h>
 
 #if WITH_LIB_CONSOLE
@@ -42,6 +43,7 @@
 static int cmd_threads(int argc, const cmd_args *argv);
 static int cmd_threadstats(int argc, const cmd_args *argv);
 static int cmd_threadload(int argc, const cmd_args *argv);
+static int cmd_ktrace(int argc, const cmd_args *argv);
 
 STATIC_COMMAND_START
 #if DEBUGLEVEL > 1
@@ -51,6 +53,7 @@ STATIC_COMMAND("threads", "list kernel threads", &cmd_threads)
 STATIC_COMMAND("threadstats", "thread level statistics", &cmd_threadstats)
 STATIC_COMMAND("threadload", "toggle thread load display", &cmd_threadload)
 #endif
+STATIC_COMMAND("ktrace", "dump the kernel scheduler trace", &cmd_ktrace)
 STATIC_COMMAND_END(kernel);
 
 #if DEBUGLEVEL > 1
@@ -63,6 +66,13 @@ static int cmd_threads(int argc, const cmd_args *argv)
 }
 #endif
 
+static int cmd_ktrace(int argc, const cmd_args *argv)
+{
+	ktrace_dump();
+
+	return 0;
+}
+
 #if THREAD_STATS
 static int cmd_threadstats(int argc, const cmd_args *argv)
 {
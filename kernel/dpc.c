@@ -22,42 +22,83 @@
  */
 #include <debug.h>
 #include <list.h>
-#include <malloc.h>
 #include <err.h>
 #include <kernel/dpc.h>
 #include <kernel/thread.h>
 #include <kernel/event.h>
+#include <kernel/ktrace.h>
+
+/* priority classes, serviced in this order */
+enum {
+	DPC_CLASS_HIGH = 0,
+	DPC_CLASS_NORMAL,
+	DPC_CLASS_LOW,
+	DPC_NUM_CLASSES,
+};
+
+/* maximum number of callbacks pulled off a queue per lock acquisition */
+#define DPC_BATCH 8
 
 struct dpc {
-	struct list_node node;	
+	struct list_node node;
 
 	dpc_callback cb;
 	void *arg;
 };
 
-static struct list_node dpc_list = LIST_INITIAL_VALUE(dpc_list);
+static struct dpc dpc_pool[DPC_POOL_SIZE];
+static struct list_node dpc_free_list = LIST_INITIAL_VALUE(dpc_free_list);
+static struct list_node dpc_list[DPC_NUM_CLASSES];
+static int dpc_pending;
 static event_t dpc_event;
 
 static int dpc_thread_routine(void *arg);
 
 void dpc_init(void)
 {
+	int i;
+
+	for (i = 0; i < DPC_NUM_CLASSES; i++)
+		list_initialize(&dpc_list[i]);
+
+	for (i = 0; i < DPC_POOL_SIZE; i++)
+		list_add_tail(&dpc_free_list, &dpc_pool[i].node);
+
 	event_init(&dpc_event, false, 0);
 
-	thread_resume(thread_create("dpc", &dpc_thread_routine, NULL, DPC_PRIORITY, DEFAULT_STACK_SIZE));
+	for (i = 0; i < DPC_WORKERS; i++)
+		thread_resume(thread_create("dpc", &dpc_thread_routine, NULL, DPC_PRIORITY, DEFAULT_STACK_SIZE));
 }
 
 status_t dpc_queue(dpc_callback cb, void *arg, uint flags)
 {
 	struct dpc *dpc;
+	int class = DPC_CLASS_NORMAL;
+
+	if (flags & DPC_FLAG_HIGH)
+		class = DPC_CLASS_HIGH;
+	else if (flags & DPC_FLAG_LOW)
+		class = DPC_CLASS_LOW;
 
-	dpc = malloc(sizeof(struct dpc));
+	enter_critical_section();
+
+	dpc = list_remove_head_type(&dpc_free_list, struct dpc, node);
+	if (!dpc) {
+		exit_critical_section();
+		dprintf(CRITICAL, "dpc_queue: out of dpc descriptors, dropping %p\n", cb);
+		return ERR_NO_MEMORY;
+	}
 
 	dpc->cb = cb;
 	dpc->arg = arg;
-	enter_critical_section();
-	list_add_tail(&dpc_list, &dpc->node);
-	event_signal(&dpc_event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+	list_add_tail(&dpc_list[class], &dpc->node);
+
+	/* the event stays signalled for as long as anything is pending, so only
+	 * the first callback queued needs to wake the workers up.
+	 */
+	if (dpc_pending++ == 0)
+		event_signal(&dpc_event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+
 	exit_critical_section();
 
 	return NO_ERROR;
@@ -65,24 +106,49 @@ status_t dpc_queue(dpc_callback cb, void *arg, uint flags)
 
 static int dpc_thread_routine(void *arg)
 {
+	struct list_node batch = LIST_INITIAL_VALUE(batch);
+	struct dpc *dpc;
+	int class;
+	int count;
+
 	for (;;) {
 		event_wait(&dpc_event);
 
+		/* pull a batch off the highest priority queue that has work */
 		enter_critical_section();
-		struct dpc *dpc = list_remove_head_type(&dpc_list, struct dpc, node);
-		if (!dpc)
+		for (class = 0; class < DPC_NUM_CLASSES - 1; class++) {
+			if (!list_is_empty(&dpc_list[class]))
+				break;
+		}
+
+		for (count = 0; count < DPC_BATCH; count++) {
+			dpc = list_remove_head_type(&dpc_list[class], struct dpc, node);
+			if (!dpc)
+				break;
+			list_add_tail(&batch, &dpc->node);
+		}
+
+		dpc_pending -= count;
+		if (dpc_pending == 0)
 			event_unsignal(&dpc_event);
 		exit_critical_section();
 
-		if (dpc) {
+		if (count == 0)
+			continue;
+
+		list_for_every_entry(&batch, dpc, struct dpc, node) {
 //			dprintf("dpc calling %p, arg %p\n", dpc->cb, dpc->arg);
+			ktrace_log(KTRACE_DPC, (uint32_t)dpc->cb, (uint32_t)dpc->arg);
 			dpc->cb(dpc->arg);
-
-			free(dpc);
 		}
+
+		/* hand the whole batch back to the pool */
+		enter_critical_section();
+		while ((dpc = list_remove_head_type(&batch, struct dpc, node)))
+			list_add_head(&dpc_free_list, &dpc->node);
+		exit_critical_section();
 	}
 
 	return 0;
 }
 
-
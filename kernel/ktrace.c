@@ -0,0 +1,134 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <debug.h>
+#include <printf.h>
+#include <arch/ops.h>
+#include <kernel/thread.h>
+#include <kernel/ktrace.h>
+
+#if KERNEL_TRACE
+
+static struct ktrace_entry ktrace_ring[KTRACE_ENTRIES];
+
+/* total number of entries ever logged, the ring index is the low bits */
+static volatile int ktrace_head;
+static volatile int ktrace_paused;
+
+static const char *ktrace_event_names[KTRACE_MAX] = {
+	[KTRACE_NONE]      = "none",
+	[KTRACE_SWITCH]    = "switch",
+	[KTRACE_WAKE]      = "wake",
+	[KTRACE_BLOCK]     = "block",
+	[KTRACE_IRQ_ENTER] = "irq",
+	[KTRACE_IRQ_EXIT]  = "irq done",
+	[KTRACE_DPC]       = "dpc",
+};
+
+void ktrace_log(uint event, uint32_t arg0, uint32_t arg1)
+{
+	struct ktrace_entry *entry;
+	int slot;
+
+	if (ktrace_paused)
+		return;
+
+	/* claim a slot without taking a lock, interrupts may nest in here */
+	slot = atomic_add(&ktrace_head, 1);
+	entry = &ktrace_ring[slot & (KTRACE_ENTRIES - 1)];
+
+	entry->timestamp = arch_cycle_count();
+	entry->event = event;
+	entry->arg0 = arg0;
+	entry->arg1 = arg1;
+}
+
+void ktrace_for_every(ktrace_callback cb, void *arg)
+{
+	int head;
+	int i;
+
+	atomic_add(&ktrace_paused, 1);
+
+	head = ktrace_head;
+	i = (head > KTRACE_ENTRIES) ? head - KTRACE_ENTRIES : 0;
+
+	for (; i < head; i++)
+		cb(&ktrace_ring[i & (KTRACE_ENTRIES - 1)], arg);
+
+	atomic_add(&ktrace_paused, -1);
+}
+
+int ktrace_format(const struct ktrace_entry *entry, uint32_t prev, char *buf, size_t len)
+{
+	const char *name = "unknown";
+
+	if (entry->event < KTRACE_MAX)
+		name = ktrace_event_names[entry->event];
+
+	return snprintf(buf, len, "%10u +%8u %-8s 0x%08x 0x%08x",
+			entry->timestamp, entry->timestamp - prev, name,
+			entry->arg0, entry->arg1);
+}
+
+static void ktrace_dump_entry(const struct ktrace_entry *entry, void *arg)
+{
+	uint32_t *prev = (uint32_t *)arg;
+	char line[64];
+
+	ktrace_format(entry, *prev, line, sizeof(line));
+	*prev = entry->timestamp;
+
+	printf("%s\n", line);
+}
+
+void ktrace_dump(void)
+{
+	uint32_t prev = 0;
+
+	printf("kernel trace, %d entries logged:\n", ktrace_head);
+	ktrace_for_every(ktrace_dump_entry, &prev);
+}
+
+#else
+
+void ktrace_for_every(ktrace_callback cb, void *arg)
+{
+}
+
+int ktrace_format(const struct ktrace_entry *entry, uint32_t prev, char *buf, size_t len)
+{
+	return 0;
+}
+
+void ktrace_dump(void)
+{
+	printf("kernel trace not compiled in\n");
+}
+
+#endif
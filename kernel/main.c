@@ -121,6 +121,8 @@ int main(void);
 
 static int bootstrap2(void *arg)
 {
+	int span;
+
 	dprintf(SPEW, "top of bootstrap2()\n");
 
 	arch_init();
@@ -135,11 +137,15 @@ static int bootstrap2(void *arg)
 
 	// initialize the rest of the platform
 	dprintf(SPEW, "initializing platform\n");
+	span = bs_profile_begin("platform-init");
 	platform_init();
+	bs_profile_end(span);
 
 	// initialize the target
 	dprintf(SPEW, "initializing target\n");
+	span = bs_profile_begin("target-init");
 	target_init();
+	bs_profile_end(span);
 
 	dprintf(SPEW, "calling apps_init()\n");
 	apps_init();
@@ -6,11 +6,14 @@ MODULES += \
 	lib/heap
 
 OBJS += \
+	$(LOCAL_DIR)/amutex.o \
 	$(LOCAL_DIR)/debug.o \
 	$(LOCAL_DIR)/dpc.o \
 	$(LOCAL_DIR)/event.o \
+	$(LOCAL_DIR)/ktrace.o \
 	$(LOCAL_DIR)/main.o \
 	$(LOCAL_DIR)/mutex.o \
+	$(LOCAL_DIR)/rwlock.o \
 	$(LOCAL_DIR)/thread.o \
 	$(LOCAL_DIR)/timer.o
 
@@ -0,0 +1,208 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation. nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * @brief  Reader-writer lock functions
+ *
+ * @defgroup rwlock Reader-writer lock
+ * @{
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <kernel/rwlock.h>
+#include <kernel/thread.h>
+
+#if DEBUGLEVEL > 1
+#define RWLOCK_CHECK 1
+#endif
+
+/**
+ * @brief  Initialize a rwlock_t
+ */
+void rwlock_init(rwlock_t *rw)
+{
+	rw->magic = RWLOCK_MAGIC;
+	rw->readers = 0;
+	rw->writers_waiting = 0;
+	rw->writer = 0;
+	rw->read_acquires = 0;
+	rw->read_contentions = 0;
+	rw->write_acquires = 0;
+	rw->write_contentions = 0;
+	wait_queue_init(&rw->read_wait);
+	wait_queue_init(&rw->write_wait);
+}
+
+/**
+ * @brief  Destroy a rwlock_t
+ *
+ * Any thread still waiting for the lock is woken with ERR_OBJECT_DESTROYED.
+ */
+void rwlock_destroy(rwlock_t *rw)
+{
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	rw->magic = 0;
+	wait_queue_destroy(&rw->read_wait, false);
+	wait_queue_destroy(&rw->write_wait, true);
+	exit_critical_section();
+}
+
+/**
+ * @brief  Acquire the lock for reading; wait if a writer holds or waits for it.
+ *
+ * @return  NO_ERROR on success, other values on error
+ */
+status_t rwlock_acquire_read(rwlock_t *rw)
+{
+	status_t ret = NO_ERROR;
+
+	if (current_thread == rw->writer)
+		panic("rwlock_acquire_read: thread %p (%s) tried to read lock %p it holds for writing.\n",
+				current_thread, current_thread->name, rw);
+
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	rw->read_acquires++;
+	if (unlikely(rw->writer || rw->writers_waiting)) {
+		rw->read_contentions++;
+		/* the releasing writer accounts for us in rw->readers before waking us */
+		ret = wait_queue_block(&rw->read_wait, INFINITE_TIME);
+	} else {
+		rw->readers++;
+	}
+
+	exit_critical_section();
+
+	return ret;
+}
+
+/**
+ * @brief  Release a read hold on the lock
+ */
+status_t rwlock_release_read(rwlock_t *rw)
+{
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+	ASSERT(rw->readers > 0);
+	ASSERT(rw->writer == 0);
+#endif
+
+	rw->readers--;
+	if (rw->readers == 0 && rw->writers_waiting) {
+		/* the last reader out hands the lock to a waiting writer */
+		rw->writers_waiting--;
+		rw->writer = list_peek_head_type(&rw->write_wait.list, thread_t, queue_node);
+		wait_queue_wake_one(&rw->write_wait, true, NO_ERROR);
+	}
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+/**
+ * @brief  Acquire the lock for writing; wait if it is held.
+ *
+ * @return  NO_ERROR on success, other values on error
+ */
+status_t rwlock_acquire_write(rwlock_t *rw)
+{
+	status_t ret = NO_ERROR;
+
+	if (current_thread == rw->writer)
+		panic("rwlock_acquire_write: thread %p (%s) tried to acquire lock %p it already owns.\n",
+				current_thread, current_thread->name, rw);
+
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	rw->write_acquires++;
+	if (unlikely(rw->writer || rw->readers)) {
+		rw->write_contentions++;
+		rw->writers_waiting++;
+		/* the releasing side makes us the writer before waking us */
+		ret = wait_queue_block(&rw->write_wait, INFINITE_TIME);
+	} else {
+		rw->writer = current_thread;
+	}
+
+	exit_critical_section();
+
+	return ret;
+}
+
+/**
+ * @brief  Release a write hold on the lock
+ *
+ * Another waiting writer gets the lock first, otherwise all waiting
+ * readers are let in at once.
+ */
+status_t rwlock_release_write(rwlock_t *rw)
+{
+	if (current_thread != rw->writer)
+		panic("rwlock_release_write: thread %p (%s) tried to release lock %p it doesn't own. owned by %p (%s)\n",
+				current_thread, current_thread->name, rw, rw->writer, rw->writer ? rw->writer->name : "none");
+
+	enter_critical_section();
+
+#if RWLOCK_CHECK
+	ASSERT(rw->magic == RWLOCK_MAGIC);
+#endif
+
+	rw->writer = 0;
+	if (rw->writers_waiting) {
+		rw->writers_waiting--;
+		rw->writer = list_peek_head_type(&rw->write_wait.list, thread_t, queue_node);
+		wait_queue_wake_one(&rw->write_wait, true, NO_ERROR);
+	} else if (rw->read_wait.count > 0) {
+		rw->readers += rw->read_wait.count;
+		wait_queue_wake_all(&rw->read_wait, true, NO_ERROR);
+	}
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+/** @} */
@@ -69,8 +69,12 @@ static thread_t bootstrap_thread;
 /* the idle thread */
 thread_t *idle_thread;
 
+/* threads that exited when no dpc was free to clean them up */
+static struct list_node dead_threads = LIST_INITIAL_VALUE(dead_threads);
+
 /* local routines */
 static void thread_resched(void);
+static void thread_reap_dead(void);
 static void idle_thread_routine(void) __NO_RETURN;
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
@@ -90,6 +94,9 @@ static void insert_in_run_queue_head(thread_t *t)
 
 	list_add_head(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
+#if KERNEL_TRACE
+	t->last_ready = arch_cycle_count();
+#endif
 }
 
 static void insert_in_run_queue_tail(thread_t *t)
@@ -103,6 +110,9 @@ static void insert_in_run_queue_tail(thread_t *t)
 
 	list_add_tail(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
+#if KERNEL_TRACE
+	t->last_ready = arch_cycle_count();
+#endif
 }
 
 static void init_thread_struct(thread_t *t, const char *name)
@@ -143,6 +153,8 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 {
 	thread_t *t;
 
+	thread_reap_dead();
+
 	t = malloc(sizeof(thread_t));
 	if (!t)
 		return NULL;
@@ -211,11 +223,9 @@ status_t thread_resume(thread_t *t)
 	return NO_ERROR;
 }
 
-static void thread_cleanup_dpc(void *thread)
+static void thread_free(thread_t *t)
 {
-	thread_t *t = (thread_t *)thread;
-
-//	dprintf(SPEW, "thread_cleanup_dpc: thread %p (%s)\n", t, t->name);
+//	dprintf(SPEW, "thread_free: thread %p (%s)\n", t, t->name);
 
 #if THREAD_CHECKS
 	ASSERT(t->state == THREAD_DEATH);
@@ -235,6 +245,29 @@ static void thread_cleanup_dpc(void *thread)
 	free(t);
 }
 
+static void thread_cleanup_dpc(void *thread)
+{
+	thread_free((thread_t *)thread);
+	thread_reap_dead();
+}
+
+/* clean up the threads left on the dead list by thread_exit() */
+static void thread_reap_dead(void)
+{
+	thread_t *t;
+
+	for (;;) {
+		enter_critical_section();
+		t = list_remove_head_type(&dead_threads, thread_t, queue_node);
+		exit_critical_section();
+
+		if (!t)
+			break;
+
+		thread_free(t);
+	}
+}
+
 /**
  * @brief  Terminate the current thread
  *
@@ -257,8 +290,11 @@ void thread_exit(int retcode)
 	current_thread->state = THREAD_DEATH;
 	current_thread->retcode = retcode;
 
-	/* schedule a dpc to clean ourselves up */
-	dpc_queue(thread_cleanup_dpc, (void *)current_thread, DPC_FLAG_NORESCHED);
+	/* schedule a dpc to clean ourselves up. If none is free, the next
+	 * thread cleanup or thread_create() does it.
+	 */
+	if (dpc_queue(thread_cleanup_dpc, (void *)current_thread, DPC_FLAG_NORESCHED | DPC_FLAG_LOW) != NO_ERROR)
+		list_add_tail(&dead_threads, &current_thread->queue_node);
 
 	/* reschedule */
 	thread_resched();
@@ -269,8 +305,11 @@ void thread_exit(int retcode)
 
 static void idle_thread_routine(void)
 {
-	for(;;)
+	for(;;) {
+		/* console output held back while there was work to do */
+		_dflush();
 		arch_idle();
+	}
 }
 
 /**
@@ -321,16 +360,6 @@ void thread_resched(void)
 	if (list_is_empty(&run_queue[next_queue]))
 		run_queue_bitmap &= ~(1<<next_queue);
 
-#if 0
-	// XXX make this more efficient
-	newthread = NULL;
-	for (i=HIGHEST_PRIORITY; i >= LOWEST_PRIORITY; i--) {
-		newthread = list_remove_head_type(&run_queue[i], thread_t, queue_node);
-		if (newthread)
-			break;
-	}
-#endif
-
 //	dprintf("newthread: ");
 //	dump_thread(newthread);
 
@@ -361,6 +390,16 @@ void thread_resched(void)
 	ASSERT(newthread->saved_critical_section_count > 0);
 #endif
 
+#if KERNEL_TRACE
+	uint32_t now = arch_cycle_count();
+
+	oldthread->runtime += now - oldthread->last_switch;
+	newthread->ready_time += now - newthread->last_ready;
+	newthread->last_switch = now;
+	newthread->switches++;
+	ktrace_log(KTRACE_SWITCH, (uint32_t)oldthread, (uint32_t)newthread);
+#endif
+
 #if PLATFORM_HAS_DYNAMIC_TIMER
 	/* if we're switching from idle to a real thread, set up a periodic
 	 * timer to run our preemption tick.
@@ -499,6 +538,7 @@ static enum handler_return thread_sleep_handler(timer_t *timer, time_t now, void
 
 	t->state = THREAD_READY;
 	insert_in_run_queue_head(t);
+	ktrace_log(KTRACE_WAKE, (uint32_t)t, 0);
 
 	return INT_RESCHEDULE;
 }
@@ -527,6 +567,7 @@ void thread_sleep(time_t delay)
 	enter_critical_section();
 	timer_set_oneshot(&timer, delay, thread_sleep_handler, (void *)current_thread);
 	current_thread->state = THREAD_SLEEPING;
+	ktrace_log(KTRACE_BLOCK, (uint32_t)current_thread, 0);
 	thread_resched();
 	exit_critical_section();
 }
@@ -618,6 +659,12 @@ void dump_thread(thread_t *t)
 	dprintf(INFO, "\tstack %p, stack_size %zd\n", t->stack, t->stack_size);
 	dprintf(INFO, "\tentry %p, arg %p\n", t->entry, t->arg);
 	dprintf(INFO, "\twait queue %p, wait queue ret %d\n", t->blocking_wait_queue, t->wait_queue_block_ret);
+#if KERNEL_TRACE
+	uint64_t runtime = t->runtime;
+	if (t == current_thread)
+		runtime += arch_cycle_count() - t->last_switch;
+	dprintf(INFO, "\truntime %llu cycles, ready wait %llu cycles, switches %u\n", runtime, t->ready_time, t->switches);
+#endif
 	dprintf(INFO, "\ttls:");
 	int i;
 	for (i=0; i < MAX_TLS_ENTRY; i++) {
@@ -715,6 +762,7 @@ status_t wait_queue_block(wait_queue_t *wait, time_t timeout)
 		timer_set_oneshot(&timer, timeout, wait_queue_timeout_handler, (void *)current_thread);
 	}
 
+	ktrace_log(KTRACE_BLOCK, (uint32_t)current_thread, (uint32_t)wait);
 	thread_block();
 
 	/* we don't really know if the timer fired or not, so it's better safe to try to cancel it */
@@ -758,6 +806,7 @@ int wait_queue_wake_one(wait_queue_t *wait, bool reschedule, status_t wait_queue
 		t->state = THREAD_READY;
 		t->wait_queue_block_ret = wait_queue_error;
 		t->blocking_wait_queue = NULL;
+		ktrace_log(KTRACE_WAKE, (uint32_t)t, (uint32_t)wait);
 
 		/* if we're instructed to reschedule, stick the current thread on the head
 		 * of the run queue first, so that the newly awakened thread gets a chance to run
@@ -782,19 +831,20 @@ int wait_queue_wake_one(wait_queue_t *wait, bool reschedule, status_t wait_queue
  *
  * This function removes all threads (if any) from the wait queue and
  * makes them executable.  The new threads will be placed at the head of the
- * run queue.
+ * run queue, in the order in which they blocked.
  *
  * @param wait  The wait queue to wake
  * @param reschedule  If true, the newly-woken threads will run immediately.
  * @param wait_queue_error  The return value which the new thread will receive
  * from wait_queue_block().
  *
- * @return  The number of threads woken (zero or one)
+ * @return  The number of threads woken
  */
 int wait_queue_wake_all(wait_queue_t *wait, bool reschedule, status_t wait_queue_error)
 {
 	thread_t *t;
 	int ret = 0;
+	uint32_t woken_bitmap = 0;
 
 #if THREAD_CHECKS
 	ASSERT(wait->magic == WAIT_QUEUE_MAGIC);
@@ -810,9 +860,12 @@ int wait_queue_wake_all(wait_queue_t *wait, bool reschedule, status_t wait_queue
 		insert_in_run_queue_head(current_thread);
 	}
 
-	/* pop all the threads off the wait queue into the run queue */
-	while ((t = list_remove_head_type(&wait->list, thread_t, queue_node))) {
-		wait->count--;
+	/* pop all the threads off the wait queue into the run queue. walk the wait
+	 * queue from the tail so that the waiters end up at the head of their run
+	 * queues in the order they blocked, and publish them to the run queue
+	 * bitmap in one go.
+	 */
+	while ((t = list_remove_tail_type(&wait->list, thread_t, queue_node))) {
 #if THREAD_CHECKS
 		ASSERT(t->state == THREAD_BLOCKED);
 #endif
@@ -820,13 +873,20 @@ int wait_queue_wake_all(wait_queue_t *wait, bool reschedule, status_t wait_queue
 		t->wait_queue_block_ret = wait_queue_error;
 		t->blocking_wait_queue = NULL;
 
-		insert_in_run_queue_head(t);
+		list_add_head(&run_queue[t->priority], &t->queue_node);
+		woken_bitmap |= (1<<t->priority);
 		ret++;
+#if KERNEL_TRACE
+		t->last_ready = arch_cycle_count();
+		ktrace_log(KTRACE_WAKE, (uint32_t)t, (uint32_t)wait);
+#endif
 	}
 
 #if THREAD_CHECKS
-	ASSERT(wait->count == 0);
+	ASSERT(wait->count == ret);
 #endif
+	wait->count = 0;
+	run_queue_bitmap |= woken_bitmap;
 
 	if (reschedule && ret > 0)
 		thread_resched();
@@ -879,6 +939,7 @@ status_t thread_unblock_from_wait_queue(thread_t *t, bool reschedule, status_t w
 	ASSERT(list_in_list(&t->queue_node));
 #endif	
 
+	ktrace_log(KTRACE_WAKE, (uint32_t)t, (uint32_t)t->blocking_wait_queue);
 	list_delete(&t->queue_node);
 	t->blocking_wait_queue->count--;
 	t->blocking_wait_queue = NULL;
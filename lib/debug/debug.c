@@ -83,6 +83,10 @@ void _panic(void *caller, const char *fmt, ...)
 	halt();
 }
 
+__WEAK void _dflush(void)
+{
+}
+
 int _dputs(const char *str)
 {
 	while(*str != 0) {
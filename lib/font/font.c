@@ -32,31 +32,195 @@
  */
 
 #include <debug.h>
+#include <stdlib.h>
+#include <string.h>
 #include <lib/gfx.h>
 #include <lib/font.h>
 
 #include "font.h"
 
+/*
+ * Every glyph row is FONT_X bits, so there are only FONT_PATTERNS ways a
+ * row can look.  They are rendered once for a colour pair and surface
+ * format, after which a character is drawn by copying FONT_Y rows.
+ */
+#define FONT_PATTERNS	(1 << FONT_X)
+
+static struct {
+	bool valid;
+	gfx_format format;
+	uint32_t color;
+	uint32_t bgcolor;
+	uint8_t rows[FONT_PATTERNS * FONT_X * 4];
+} glyph_cache;
+
+// rows are packed FONT_X pixels apart, however big a pixel is
+#define GLYPH_ROW(pattern, pixelsize) \
+	(glyph_cache.rows + (pattern) * FONT_X * (pixelsize))
+
+// the row with every pixel set, on its own for font_draw_char()
+static struct {
+	bool valid;
+	gfx_format format;
+	uint32_t color;
+	uint8_t row[FONT_X * 4];
+} solid_cache;
+
+// render count rows of FONT_X pixels to buf, row n from pattern n
+static bool font_render_rows(uint8_t *buf, uint count, uint pattern, gfx_format format,
+		uint32_t color, uint32_t bgcolor)
+{
+	gfx_surface *cache;
+	uint row, x;
+
+	// let the surface code do the colour conversion for this format
+	cache = gfx_create_surface(buf, FONT_X, count, FONT_X, format);
+	if (!cache)
+		return false;
+
+	for (row = 0; row < count; row++, pattern++)
+		for (x = 0; x < FONT_X; x++)
+			cache->putpixel(cache, x, row, (pattern >> x) & 1 ? color : bgcolor);
+	gfx_surface_destroy(cache);
+
+	return true;
+}
+
+static bool font_cache_glyph_rows(gfx_format format, uint32_t color, uint32_t bgcolor)
+{
+	if (glyph_cache.valid && glyph_cache.format == format &&
+			glyph_cache.color == color && glyph_cache.bgcolor == bgcolor)
+		return true;
+
+	glyph_cache.valid = font_render_rows(glyph_cache.rows, FONT_PATTERNS, 0,
+			format, color, bgcolor);
+	glyph_cache.format = format;
+	glyph_cache.color = color;
+	glyph_cache.bgcolor = bgcolor;
+
+	return glyph_cache.valid;
+}
+
+static bool font_cache_solid_row(gfx_format format, uint32_t color)
+{
+	if (solid_cache.valid && solid_cache.format == format &&
+			solid_cache.color == color)
+		return true;
+
+	solid_cache.valid = font_render_rows(solid_cache.row, 1, FONT_PATTERNS - 1,
+			format, color, 0);
+	solid_cache.format = format;
+	solid_cache.color = color;
+
+	return solid_cache.valid;
+}
+
+// pixel at a time, for when the rows can't be cached
+static void font_draw_char_slow(gfx_surface *surface, unsigned char c, int x, int y,
+		uint width, uint height, uint32_t color, uint32_t bgcolor, bool bg)
+{
+	uint i, j;
+	uint line;
+
+	for (i = 0; i < height; i++) {
+		line = FONT[c * FONT_Y + i];
+		for (j = 0; j < width; j++) {
+			if (line & (1 << j))
+				surface->putpixel(surface, x + j, y + i, color);
+			else if (bg)
+				surface->putpixel(surface, x + j, y + i, bgcolor);
+		}
+	}
+
+	gfx_mark_dirty(surface, y, y + height - 1);
+}
+
+/*
+ * Work out where character cell x,y lands in the surface, returning false
+ * if none of it does.  Cells are clipped against the right and bottom edges.
+ */
+static bool font_cell(gfx_surface *surface, int x, int y, uint *width, uint *height)
+{
+	if (x < 0 || y < 0 || (uint)x >= surface->width || (uint)y >= surface->height)
+		return false;
+
+	*width = MIN(FONT_X, surface->width - x);
+	*height = MIN(FONT_Y, surface->height - y);
+
+	return true;
+}
+
 /**
  * @brief Draw one character from the built-in font
  *
+ * Only the pixels of the glyph itself are written, whatever is behind it
+ * shows through.
+ *
  * @ingroup graphics
  */
 void font_draw_char(gfx_surface *surface, unsigned char c, int x, int y, uint32_t color)
 {
-	uint i,j;
+	uint i, j, start, width, height;
+	uint pixelsize = surface->pixelsize;
+	uint pitch = surface->stride * pixelsize;
+	const uint8_t *solid;
+	uint8_t *dest;
 	uint line;
 
-	// draw this char into a buffer
-	for (i = 0; i < FONT_Y; i++) {
+	if (!font_cell(surface, x, y, &width, &height))
+		return;
+
+	if (!font_cache_solid_row(surface->format, color)) {
+		font_draw_char_slow(surface, c, x, y, width, height, color, 0, false);
+		return;
+	}
+	solid = solid_cache.row;
+
+	dest = (uint8_t *)surface->ptr + y * pitch + x * pixelsize;
+	for (i = 0; i < height; i++, dest += pitch) {
 		line = FONT[c * FONT_Y + i];
-		for (j = 0; j < FONT_X; j++) {
-			if (line & 0x1)
-				gfx_putpixel(surface, x + j, y + i, color);
-			line = line >> 1;
+
+		// copy each run of set pixels in one go
+		for (j = 0; j < width; j++) {
+			if (!(line & (1 << j)))
+				continue;
+			for (start = j; j < width && (line & (1 << j)); j++)
+				;
+			memcpy(dest + start * pixelsize, solid + start * pixelsize,
+					(j - start) * pixelsize);
 		}
 	}
-	gfx_flush_rows(surface, y, y + FONT_Y);
+
+	gfx_mark_dirty(surface, y, y + height - 1);
 }
 
+/**
+ * @brief Draw one character from the built-in font over a background colour
+ *
+ * The whole character cell is written, which is cheaper than drawing just
+ * the glyph when the background is a solid colour anyway.
+ *
+ * @ingroup graphics
+ */
+void font_draw_char_bg(gfx_surface *surface, unsigned char c, int x, int y, uint32_t color, uint32_t bgcolor)
+{
+	uint i, width, height;
+	uint pitch = surface->stride * surface->pixelsize;
+	uint8_t *dest;
+
+	if (!font_cell(surface, x, y, &width, &height))
+		return;
+
+	if (!font_cache_glyph_rows(surface->format, color, bgcolor)) {
+		font_draw_char_slow(surface, c, x, y, width, height, color, bgcolor, true);
+		return;
+	}
+
+	dest = (uint8_t *)surface->ptr + y * pitch + x * surface->pixelsize;
+	for (i = 0; i < height; i++, dest += pitch)
+		memcpy(dest, GLYPH_ROW(FONT[c * FONT_Y + i], surface->pixelsize),
+				width * surface->pixelsize);
+
+	gfx_mark_dirty(surface, y, y + height - 1);
+}
 
@@ -35,6 +35,7 @@
 #include <debug.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <arch/ops.h>
 #include <sys/types.h>
 #include <lib/gfx.h>
@@ -83,6 +84,7 @@ void gfx_copyrect(gfx_surface *surface, uint x, uint y, uint width, uint height,
 		height = surface->height - y2;
 
 	surface->copyrect(surface, x, y, width, height, x2, y2);
+	gfx_mark_dirty(surface, y2, y2 + height - 1);
 }
 
 /**
@@ -108,6 +110,7 @@ void gfx_fillrect(gfx_surface *surface, uint x, uint y, uint width, uint height,
 		height = surface->height - y;
 
 	surface->fillrect(surface, x, y, width, height, color);
+	gfx_mark_dirty(surface, y, y + height - 1);
 }
 
 /**
@@ -121,6 +124,220 @@ void gfx_putpixel(gfx_surface *surface, uint x, uint y, uint color)
 		return;
 
 	surface->putpixel(surface, x, y, color);
+	gfx_mark_dirty(surface, y, y);
+}
+
+/*
+ * Row kernels.  These work a 32 bit word at a time rather than a pixel at
+ * a time; NEON is not used since the thread switch code does not preserve
+ * the VFP/NEON register file.  Pixels are in memory in little endian
+ * order, an RGB_888 pixel is stored as blue, green, red.
+ */
+
+/**
+ * @brief  Fill count 16 bit pixels with color.
+ */
+void gfx_row_fill16(uint16_t *dst, uint16_t color, uint count)
+{
+	uint32_t color2 = color | ((uint32_t)color << 16);
+	uint32_t *dst32;
+
+	if (count && ((addr_t)dst & 2)) {
+		*dst++ = color;
+		count--;
+	}
+
+	dst32 = (uint32_t *)dst;
+	while (count >= 8) {
+		dst32[0] = color2;
+		dst32[1] = color2;
+		dst32[2] = color2;
+		dst32[3] = color2;
+		dst32 += 4;
+		count -= 8;
+	}
+	while (count >= 2) {
+		*dst32++ = color2;
+		count -= 2;
+	}
+
+	if (count)
+		*(uint16_t *)dst32 = color;
+}
+
+/**
+ * @brief  Fill count packed 24 bit pixels with the low 24 bits of color.
+ */
+void gfx_row_fill24(uint8_t *dst, uint32_t color, uint count)
+{
+	uint32_t w0, w1, w2;
+	uint32_t *dst32;
+
+	color &= 0xffffff;
+
+	/* at most three pixels get the destination word aligned */
+	while (count && ((addr_t)dst & 3)) {
+		dst[0] = color;
+		dst[1] = color >> 8;
+		dst[2] = color >> 16;
+		dst += 3;
+		count--;
+	}
+
+	/* four pixels make up exactly three words */
+	w0 = color | (color << 24);
+	w1 = (color >> 8) | (color << 16);
+	w2 = (color >> 16) | (color << 8);
+
+	dst32 = (uint32_t *)dst;
+	while (count >= 4) {
+		dst32[0] = w0;
+		dst32[1] = w1;
+		dst32[2] = w2;
+		dst32 += 3;
+		count -= 4;
+	}
+
+	dst = (uint8_t *)dst32;
+	while (count--) {
+		dst[0] = color;
+		dst[1] = color >> 8;
+		dst[2] = color >> 16;
+		dst += 3;
+	}
+}
+
+/**
+ * @brief  Fill count 32 bit pixels with color.
+ */
+void gfx_row_fill32(uint32_t *dst, uint32_t color, uint count)
+{
+	while (count >= 8) {
+		dst[0] = color;
+		dst[1] = color;
+		dst[2] = color;
+		dst[3] = color;
+		dst[4] = color;
+		dst[5] = color;
+		dst[6] = color;
+		dst[7] = color;
+		dst += 8;
+		count -= 8;
+	}
+
+	while (count--)
+		*dst++ = color;
+}
+
+/**
+ * @brief  Blend count ARGB 8888 pixels from src over dst.
+ *
+ * Gives exactly the result of alpha32_add_ignore_destalpha() for every
+ * pixel.  Red and blue are scaled together in one multiply: each product
+ * fits in 16 bits, so the two lanes never carry into each other.
+ */
+void gfx_row_blend32(uint32_t *dst, const uint32_t *src, uint count)
+{
+	while (count--) {
+		uint32_t s = *src++;
+		uint32_t a = s >> 24;
+
+		if (a == 255) {
+			*dst = s;
+		} else if (a != 0) {
+			uint32_t d = *dst;
+			uint32_t ainv;
+			uint32_t rb, g;
+
+			a++;
+			ainv = 255 - a;
+
+			rb = (((s & 0xff00ff) * a) >> 8) & 0xff00ff;
+			rb += (((d & 0xff00ff) * ainv) >> 8) & 0xff00ff;
+			g = ((((s >> 8) & 0xff) * a) >> 8) + ((((d >> 8) & 0xff) * ainv) >> 8);
+
+			*dst = (a << 24) | rb | (g << 8);
+		}
+		dst++;
+	}
+}
+
+/**
+ * @brief  Convert count ARGB 8888 pixels to RGB 565, dropping alpha.
+ */
+void gfx_row_argb8888_to_rgb565(uint16_t *dst, const uint32_t *src, uint count)
+{
+	uint32_t *dst32;
+
+	if (count && ((addr_t)dst & 2)) {
+		*dst++ = ARGB8888_to_RGB565(*src++);
+		count--;
+	}
+
+	dst32 = (uint32_t *)dst;
+	while (count >= 2) {
+		*dst32++ = ARGB8888_to_RGB565(src[0]) |
+			((uint32_t)ARGB8888_to_RGB565(src[1]) << 16);
+		src += 2;
+		count -= 2;
+	}
+
+	if (count)
+		*(uint16_t *)dst32 = ARGB8888_to_RGB565(*src);
+}
+
+/**
+ * @brief  Convert count ARGB 8888 pixels to packed RGB 888, dropping alpha.
+ */
+void gfx_row_argb8888_to_rgb888(uint8_t *dst, const uint32_t *src, uint count)
+{
+	uint32_t *dst32;
+
+	while (count && ((addr_t)dst & 3)) {
+		dst[0] = *src;
+		dst[1] = *src >> 8;
+		dst[2] = *src >> 16;
+		dst += 3;
+		src++;
+		count--;
+	}
+
+	dst32 = (uint32_t *)dst;
+	while (count >= 4) {
+		dst32[0] = (src[0] & 0xffffff) | (src[1] << 24);
+		dst32[1] = ((src[1] >> 8) & 0xffff) | (src[2] << 16);
+		dst32[2] = ((src[2] >> 16) & 0xff) | (src[3] << 8);
+		dst32 += 3;
+		src += 4;
+		count -= 4;
+	}
+
+	dst = (uint8_t *)dst32;
+	while (count--) {
+		dst[0] = *src;
+		dst[1] = *src >> 8;
+		dst[2] = *src >> 16;
+		dst += 3;
+		src++;
+	}
+}
+
+static void rgb565_to_argb8888(uint32_t *dst, const uint16_t *src, uint count)
+{
+	while (count--) {
+		uint32_t in = *src++;
+
+		*dst++ = 0xff000000 | ((in & 0xf800) << 8) | ((in & 0x07e0) << 5) |
+			((in & 0x001f) << 3);
+	}
+}
+
+static void rgb888_to_argb8888(uint32_t *dst, const uint8_t *src, uint count)
+{
+	while (count--) {
+		*dst++ = 0xff000000 | (src[2] << 16) | (src[1] << 8) | src[0];
+		src += 3;
+	}
 }
 
 static void putpixel16(gfx_surface *surface, uint x, uint y, uint color)
@@ -131,6 +348,15 @@ static void putpixel16(gfx_surface *surface, uint x, uint y, uint color)
 	*dest = ARGB8888_to_RGB565(color);
 }
 
+static void putpixel24(gfx_surface *surface, uint x, uint y, uint color)
+{
+	uint8_t *dest = &((uint8_t *)surface->ptr)[(x + y * surface->stride) * 3];
+
+	dest[0] = color;
+	dest[1] = color >> 8;
+	dest[2] = color >> 16;
+}
+
 static void putpixel32(gfx_surface *surface, uint x, uint y, uint color)
 {
 	uint32_t *dest = &((uint32_t *)surface->ptr)[x + y * surface->stride];
@@ -138,38 +364,28 @@ static void putpixel32(gfx_surface *surface, uint x, uint y, uint color)
 	*dest = color;
 }
 
-static void copyrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
+static void copyrect(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
 {
-	// copy
-	const uint16_t *src = &((const uint16_t *)surface->ptr)[x + y * surface->stride];
-	uint16_t *dest = &((uint16_t *)surface->ptr)[x2 + y2 * surface->stride];
-	uint stride_diff = surface->stride - width;
-
-	if (dest < src) {
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += stride_diff;
-			src += stride_diff;
+	uint pitch = surface->stride * surface->pixelsize;
+	size_t len = width * surface->pixelsize;
+	const uint8_t *src = (const uint8_t *)surface->ptr + (x + y * surface->stride) * surface->pixelsize;
+	uint8_t *dest = (uint8_t *)surface->ptr + (x2 + y2 * surface->stride) * surface->pixelsize;
+	uint i;
+
+	// rows may overlap, so walk them away from the destination
+	if (dest <= src) {
+		for (i = 0; i < height; i++) {
+			memmove(dest, src, len);
+			dest += pitch;
+			src += pitch;
 		}
 	} else {
-		// copy backwards
-		src += height * surface->stride + width;
-		dest += height * surface->stride + width;
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest--;
-				src--;
-			}
-			dest -= stride_diff;
-			src -= stride_diff;
+		dest += (height - 1) * pitch;
+		src += (height - 1) * pitch;
+		for (i = 0; i < height; i++) {
+			memmove(dest, src, len);
+			dest -= pitch;
+			src -= pitch;
 		}
 	}
 }
@@ -177,68 +393,34 @@ static void copyrect16(gfx_surface *surface, uint x, uint y, uint width, uint he
 static void fillrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
 {
 	uint16_t *dest = &((uint16_t *)surface->ptr)[x + y * surface->stride];
-	uint stride_diff = surface->stride - width;
-
 	uint16_t color16 = ARGB8888_to_RGB565(color);
-	
-	uint i, j;
-	for (i=0; i < height; i++) {
-		for (j=0; j < width; j++) {
-			*dest = color16;
-			dest++;
-		}
-		dest += stride_diff;
+	uint i;
+
+	for (i = 0; i < height; i++) {
+		gfx_row_fill16(dest, color16, width);
+		dest += surface->stride;
 	}
 }
 
-static void copyrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
+static void fillrect24(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
 {
-	// copy
-	const uint32_t *src = &((const uint32_t *)surface->ptr)[x + y * surface->stride];
-	uint32_t *dest = &((uint32_t *)surface->ptr)[x2 + y2 * surface->stride];
-	uint stride_diff = surface->stride - width;
+	uint8_t *dest = &((uint8_t *)surface->ptr)[(x + y * surface->stride) * 3];
+	uint i;
 
-	if (dest < src) {
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += stride_diff;
-			src += stride_diff;
-		}
-	} else {
-		// copy backwards
-		src += height * surface->stride + width;
-		dest += height * surface->stride + width;
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest--;
-				src--;
-			}
-			dest -= stride_diff;
-			src -= stride_diff;
-		}
+	for (i = 0; i < height; i++) {
+		gfx_row_fill24(dest, color, width);
+		dest += surface->stride * 3;
 	}
 }
 
 static void fillrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
 {
 	uint32_t *dest = &((uint32_t *)surface->ptr)[x + y * surface->stride];
-	uint stride_diff = surface->stride - width;
-	
-	uint i, j;
-	for (i=0; i < height; i++) {
-		for (j=0; j < width; j++) {
-			*dest = color;
-			dest++;
-		}
-		dest += stride_diff;
+	uint i;
+
+	for (i = 0; i < height; i++) {
+		gfx_row_fill32(dest, color, width);
+		dest += surface->stride;
 	}
 }
 
@@ -279,15 +461,60 @@ uint32_t alpha32_add_ignore_destalpha(uint32_t dest, uint32_t src)
 	return (srca << 24) | (cres[0] << 16) | (cres[1] << 8) | (cres[2]);
 }
 
+// pixels staged on the stack when blending onto a 16 or 24 bit target
+#define BLEND_CHUNK 64
+
+/*
+ * Blend or copy count 32 bit source pixels onto a row of a target of any
+ * format.  ARGB sources are blended, x888 sources are copied.
+ */
+static void blend_row32(gfx_surface *target, void *dest, const uint32_t *src, bool alpha, uint count)
+{
+	uint32_t tmp[BLEND_CHUNK];
+	uint n;
+
+	if (target->pixelsize == 4) {
+		if (alpha)
+			gfx_row_blend32(dest, src, count);
+		else
+			memcpy(dest, src, count * 4);
+		return;
+	}
+
+	while (count) {
+		n = MIN(count, BLEND_CHUNK);
+
+		if (alpha) {
+			// widen what is there, blend on top, then narrow it again
+			if (target->pixelsize == 2)
+				rgb565_to_argb8888(tmp, dest, n);
+			else
+				rgb888_to_argb8888(tmp, dest, n);
+			gfx_row_blend32(tmp, src, n);
+		} else {
+			memcpy(tmp, src, n * 4);
+		}
+
+		if (target->pixelsize == 2)
+			gfx_row_argb8888_to_rgb565(dest, tmp, n);
+		else
+			gfx_row_argb8888_to_rgb888(dest, tmp, n);
+
+		dest = (uint8_t *)dest + n * target->pixelsize;
+		src += n;
+		count -= n;
+	}
+}
+
 /**
  * @brief  Copy pixels from source to dest.
  *
- * Currently does not support alpha channel.
+ * ARGB 8888 sources are alpha blended (ignoring the destination alpha),
+ * x888 sources are copied.  Either can be drawn onto any target format;
+ * otherwise the formats must match.
  */
 void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, uint destx, uint desty)
 {
-	DEBUG_ASSERT(target->format == source->format);
-
 	LTRACEF("target %p, source %p, destx %u, desty %u\n", target, source, destx, desty);
 
 	if (destx >= target->width)
@@ -303,79 +530,59 @@ void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, u
 	if (desty + height > target->height)
 		height = target->height - desty;
 
-	// XXX total hack to deal with various blends
-	if (source->format == GFX_FORMAT_RGB_565 && target->format == GFX_FORMAT_RGB_565) {
-		// 16 bit to 16 bit
-		const uint16_t *src = (const uint16_t *)source->ptr;
-		uint16_t *dest = &((uint16_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
-
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
-		}
-	} else if (source->format == GFX_FORMAT_ARGB_8888 && target->format == GFX_FORMAT_ARGB_8888) {
-		// both are 32 bit modes, both alpha
-		const uint32_t *src = (const uint32_t *)source->ptr;
-		uint32_t *dest = &((uint32_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
-
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				// XXX ignores destination alpha
-				*dest = alpha32_add_ignore_destalpha(*dest, *src);
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
+	const uint8_t *src = (const uint8_t *)source->ptr;
+	uint8_t *dest = (uint8_t *)target->ptr + (destx + desty * target->stride) * target->pixelsize;
+	uint src_pitch = source->stride * source->pixelsize;
+	uint dest_pitch = target->stride * target->pixelsize;
+	uint i;
+
+	LTRACEF("w %u h %u dpitch %u spitch %u\n", width, height, dest_pitch, src_pitch);
+
+	if (source->format == GFX_FORMAT_ARGB_8888 || source->format == GFX_FORMAT_RGB_x888) {
+		// 32 bit sources can go onto any target format
+		bool alpha = (source->format == GFX_FORMAT_ARGB_8888);
+
+		for (i = 0; i < height; i++) {
+			blend_row32(target, dest, (const uint32_t *)src, alpha, width);
+			dest += dest_pitch;
+			src += src_pitch;
 		}
-	} else if (source->format == GFX_FORMAT_RGB_x888 && target->format == GFX_FORMAT_RGB_x888) {
-		// both are 32 bit modes, no alpha
-		const uint32_t *src = (const uint32_t *)source->ptr;
-		uint32_t *dest = &((uint32_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
-
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
+	} else if (source->format == target->format) {
+		// no alpha, straight copy of the rows
+		for (i = 0; i < height; i++) {
+			memcpy(dest, src, width * target->pixelsize);
+			dest += dest_pitch;
+			src += src_pitch;
 		}
 	} else {
 		panic("gfx_surface_blend: unimplemented colorspace combination (source %d target %d)\n", source->format, target->format);
 	}
+
+	gfx_mark_dirty(target, desty, desty + height - 1);
 }
 
 /**
  * @brief  Ensure all graphics rendering is sent to display
+ *
+ * Only the rows drawn through the gfx calls since the last flush are
+ * written back.  If nothing was tracked the whole surface is flushed,
+ * for callers that draw straight into surface->ptr.
  */
 void gfx_flush(gfx_surface *surface)
 {
-	arch_clean_cache_range((addr_t)surface->ptr, surface->len);
+	if (surface->dirty_start > surface->dirty_end)
+		gfx_flush_rows(surface, 0, surface->height - 1);
+	else
+		gfx_flush_dirty(surface);
+}
 
-	if (surface->flush)
-		surface->flush(0, surface->height-1);
+/**
+ * @brief  Flush the rows drawn since the last flush, if there are any.
+ */
+void gfx_flush_dirty(gfx_surface *surface)
+{
+	if (surface->dirty_start <= surface->dirty_end)
+		gfx_flush_rows(surface, surface->dirty_start, surface->dirty_end);
 }
 
 /**
@@ -399,9 +606,13 @@ void gfx_flush_rows(struct gfx_surface *surface, uint start, uint end)
 	if (surface->flush)
 		surface->flush(start, end);
 
+	// forget the dirty rows once they have all been written back
+	if (start <= surface->dirty_start && end >= surface->dirty_end) {
+		surface->dirty_start = UINT_MAX;
+		surface->dirty_end = 0;
+	}
 }
 
-
 /**
  * @brief  Create a new graphics surface object
  */
@@ -413,6 +624,8 @@ gfx_surface *gfx_create_surface(void *ptr, uint width, uint height, uint stride,
 	DEBUG_ASSERT(format < GFX_FORMAT_MAX);
 
 	gfx_surface *surface = malloc(sizeof(gfx_surface));
+	if (!surface)
+		return NULL;
 
 	surface->free_on_destroy = false;
 	surface->format = format;
@@ -420,19 +633,29 @@ gfx_surface *gfx_create_surface(void *ptr, uint width, uint height, uint stride,
 	surface->height = height;
 	surface->stride = stride;
 	surface->alpha = MAX_ALPHA;
+	surface->dirty_start = UINT_MAX;
+	surface->dirty_end = 0;
+	surface->flush = NULL;
 
 	// set up some function pointers
 	switch (format) {
 		case GFX_FORMAT_RGB_565:
-			surface->copyrect = &copyrect16;
+			surface->copyrect = &copyrect;
 			surface->fillrect = &fillrect16;
 			surface->putpixel = &putpixel16;
 			surface->pixelsize = 2;
 			surface->len = surface->height * surface->stride * surface->pixelsize;
 			break;
+		case GFX_FORMAT_RGB_888:
+			surface->copyrect = &copyrect;
+			surface->fillrect = &fillrect24;
+			surface->putpixel = &putpixel24;
+			surface->pixelsize = 3;
+			surface->len = surface->height * surface->stride * surface->pixelsize;
+			break;
 		case GFX_FORMAT_RGB_x888:
 		case GFX_FORMAT_ARGB_8888:
-			surface->copyrect = &copyrect32;
+			surface->copyrect = &copyrect;
 			surface->fillrect = &fillrect32;
 			surface->putpixel = &putpixel32;
 			surface->pixelsize = 4;
@@ -505,8 +728,7 @@ void gfx_draw_pattern(void)
 		}
 	}
 
-	if (surface->flush)
-		surface->flush(0, surface->height-1);
+	gfx_flush(surface);
 
 	gfx_surface_destroy(surface);
 }
@@ -528,8 +750,7 @@ void gfx_draw_pattern_white(void)
 		}
 	}
 
-	if (surface->flush)
-		surface->flush(0, surface->height-1);
+	gfx_flush(surface);
 
 	gfx_surface_destroy(surface);
 }
@@ -609,8 +830,7 @@ usage:
 		}
 	}
 
-	 if (surface->flush)
-	 		surface->flush(0, surface->height-1);
+	 gfx_flush(surface);
 
 	 gfx_surface_destroy(surface);
 
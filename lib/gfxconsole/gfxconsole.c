@@ -65,11 +65,13 @@ static void gfxconsole_putc(char c)
 			if(c == '\n' || c == '\r') {
 				gfxconsole.x = 0;
 				gfxconsole.y++;
+				// push out the rows drawn since the last line ended
+				gfx_flush_dirty(gfxconsole.surface);
 			} else if (c == 0x1b) {
 				p_num = 0;
 				state = ESCAPE;
 			} else {
-				font_draw_char(gfxconsole.surface, c, gfxconsole.x * FONT_X, gfxconsole.y * FONT_Y, gfxconsole.front_color);
+				font_draw_char_bg(gfxconsole.surface, c, gfxconsole.x * FONT_X, gfxconsole.y * FONT_Y, gfxconsole.front_color, gfxconsole.back_color);
 				gfxconsole.x++;
 			}
 			break;
@@ -86,7 +88,7 @@ static void gfxconsole_putc(char c)
 			} else if (c == '[') {
 				// eat this character
 			} else {
-				font_draw_char(gfxconsole.surface, c, gfxconsole.x * FONT_X, gfxconsole.y * FONT_Y, gfxconsole.front_color);
+				font_draw_char_bg(gfxconsole.surface, c, gfxconsole.x * FONT_X, gfxconsole.y * FONT_Y, gfxconsole.front_color, gfxconsole.back_color);
 				gfxconsole.x++;
 				state = NORMAL;
 			}
@@ -91,10 +91,25 @@ int snprintf(char *str, size_t len, const char *fmt, ...)
 #define LEFTFORMATFLAG 0x00000200
 #define LEADZEROFLAG 0x00000400
 
+/* "00".."99", so decimal conversion needs one divide per two digits */
+static const char digit_pairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
 static char *longlong_to_string(char *buf, unsigned long long n, int len, uint flag)
 {
 	int pos = len;
 	int negative = 0;
+	unsigned long v;
+	unsigned int digit;
 
 	if((flag & SIGNEDFLAG) && (long long)n < 0) {
 		negative = 1;
@@ -102,17 +117,31 @@ static char *longlong_to_string(char *buf, unsigned long long n, int len, uint f
 	}
 
 	buf[--pos] = 0;
-	
-	/* only do the math if the number is >= 10 */
-	while(n >= 10) {
-		int digit = n % 10;
 
-		n /= 10;
+	/* 64 bit division is a libgcc call, only use it while we have to */
+	while(n > ULONG_MAX) {
+		digit = n % 100;
+		n /= 100;
 
-		buf[--pos] = digit + '0';
+		pos -= 2;
+		memcpy(&buf[pos], &digit_pairs[digit * 2], 2);
 	}
-	buf[--pos] = n + '0';
-	
+
+	v = n;
+	while(v >= 100) {
+		digit = v % 100;
+		v /= 100;
+
+		pos -= 2;
+		memcpy(&buf[pos], &digit_pairs[digit * 2], 2);
+	}
+	if(v >= 10) {
+		pos -= 2;
+		memcpy(&buf[pos], &digit_pairs[v * 2], 2);
+	} else {
+		buf[--pos] = v + '0';
+	}
+
 	if(negative)
 		buf[--pos] = '-';
 	else if((flag & SHOWSIGNFLAG))
@@ -159,18 +188,40 @@ int vsnprintf(char *str, size_t len, const char *fmt, va_list ap)
 	int flags;
 	unsigned int format_num;
 	size_t chars_written = 0;
+	size_t room, run;
 	char num_buffer[32];
 
-#define OUTPUT_CHAR(c) do { (*str++ = c); chars_written++; if (chars_written + 1 == len) goto done; } while(0)
-#define OUTPUT_CHAR_NOLENCHECK(c) do { (*str++ = c); chars_written++; } while(0)
+	/* leave room for the terminator, if there is room for anything */
+	if (len <= 1) {
+		if (len)
+			*str = '\0';
+		return 0;
+	}
+	room = len - 1;
 
-	for(;;) {	
-		/* handle regular chars that aren't format related */
-		while((c = *fmt++) != 0) {
-			if(c == '%')
-				break; /* we saw a '%', break and start parsing format */
-			OUTPUT_CHAR(c);
-		}
+#define OUTPUT_CHAR(c) do { (*str++ = c); chars_written++; if (chars_written == room) goto done; } while(0)
+#define OUTPUT_CHAR_NOLENCHECK(c) do { (*str++ = c); chars_written++; } while(0)
+	/* copy or pad whole runs of output, clipped to the room that's left */
+#define OUTPUT_RUN(p, n) do { \
+		size_t _n = (n), _left = room - chars_written; \
+		if (_n >= _left) { memcpy(str, (p), _left); str += _left; chars_written = room; goto done; } \
+		memcpy(str, (p), _n); str += _n; chars_written += _n; \
+	} while(0)
+#define OUTPUT_FILL(c, n) do { \
+		size_t _n = (n), _left = room - chars_written; \
+		if (_n >= _left) { memset(str, (c), _left); str += _left; chars_written = room; goto done; } \
+		memset(str, (c), _n); str += _n; chars_written += _n; \
+	} while(0)
+
+	for(;;) {
+		/* copy the regular chars up to the next '%' in one go */
+		s = fmt;
+		while(*fmt != 0 && *fmt != '%')
+			fmt++;
+		run = fmt - s;
+		if (run)
+			OUTPUT_RUN(s, run);
+		c = *fmt++;
 
 		/* make sure we haven't just hit the end of the string */
 		if(c == 0)
@@ -302,27 +353,24 @@ hex:
 
 		/* shared output code */
 _output_string:
+		run = strlen(s);
 		if (flags & LEFTFORMATFLAG) {
 			/* left justify the text */
-			uint count = 0;
-			while(*s != 0) {
-				OUTPUT_CHAR(*s++);
-				count++;
-			}
+			if (run)
+				OUTPUT_RUN(s, run);
 
 			/* pad to the right (if necessary) */
-			for (; format_num > count; format_num--)
-				OUTPUT_CHAR(' ');
+			if (format_num > run)
+				OUTPUT_FILL(' ', format_num - run);
 		} else {
 			/* right justify the text (digits) */
-			size_t string_len = strlen(s);
 			char outchar = (flags & LEADZEROFLAG) ? '0' : ' ';
-			for (; format_num > string_len; format_num--)
-				OUTPUT_CHAR(outchar);
+			if (format_num > run)
+				OUTPUT_FILL(outchar, format_num - run);
 
 			/* output the string */
-			while(*s != 0)
-				OUTPUT_CHAR(*s++);
+			if (run)
+				OUTPUT_RUN(s, run);
 		}
 		continue;
 	}
@@ -334,6 +382,8 @@ done:
 
 #undef OUTPUT_CHAR
 #undef OUTPUT_CHAR_NOLENCHECK
+#undef OUTPUT_RUN
+#undef OUTPUT_FILL
 
 	return chars_written;
 }
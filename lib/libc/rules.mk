@@ -8,6 +8,7 @@ OBJS += \
 	$(LOCAL_DIR)/printf.o \
 	$(LOCAL_DIR)/malloc.o \
 	$(LOCAL_DIR)/rand.o \
+	$(LOCAL_DIR)/strbuild.o \
 	$(LOCAL_DIR)/eabi.o
 
 
@@ -0,0 +1,97 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strbuild.h>
+
+void strbuild_init(struct strbuild *sb)
+{
+	sb->count = 0;
+	sb->len = 0;
+}
+
+int strbuild_add_len(struct strbuild *sb, const char *str, size_t len)
+{
+	if (!str || !len)
+		return 0;
+
+	if (sb->count == STRBUILD_MAX_FRAGS)
+		return ERR_TOO_BIG;
+
+	sb->frag[sb->count].str = str;
+	sb->frag[sb->count].len = len;
+	sb->count++;
+	sb->len += len;
+
+	return 0;
+}
+
+int strbuild_add(struct strbuild *sb, const char *str)
+{
+	if (!str)
+		return 0;
+
+	return strbuild_add_len(sb, str, strlen(str));
+}
+
+size_t strbuild_copy(const struct strbuild *sb, char *dst, size_t size)
+{
+	size_t left;
+	size_t n;
+	unsigned i;
+
+	if (!size)
+		return sb->len;
+
+	left = size - 1;
+	for (i = 0; i < sb->count && left; i++) {
+		n = MIN(sb->frag[i].len, left);
+		memcpy(dst, sb->frag[i].str, n);
+		dst += n;
+		left -= n;
+	}
+	*dst = '\0';
+
+	return sb->len;
+}
+
+char *strbuild_alloc(const struct strbuild *sb)
+{
+	size_t size = ROUNDUP(sb->len + 1, 4);
+	char *str;
+
+	str = malloc(size);
+	if (!str)
+		return NULL;
+
+	strbuild_copy(sb, str, size);
+
+	return str;
+}
@@ -1,10 +1,12 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
-ASM_STRING_OPS := bcopy bzero memcpy memmove memset
+ASM_STRING_OPS := bcopy bzero memcmp memcpy memmove memset strlen
 
 OBJS += \
+	$(LOCAL_DIR)/memcmp.o \
 	$(LOCAL_DIR)/memcpy.o \
-	$(LOCAL_DIR)/memset.o
+	$(LOCAL_DIR)/memset.o \
+	$(LOCAL_DIR)/strlen.o
 
 # filter out the C implementation
 C_STRING_OPS := $(filter-out $(ASM_STRING_OPS),$(C_STRING_OPS))
@@ -0,0 +1,604 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "libfdt_env.h"
+
+#include <fdt.h>
+#include <libfdt.h>
+#include <fdt_batch.h>
+
+#include "libfdt_internal.h"
+
+/*
+ * A commit first works out, without touching the blob, every place the
+ * structure block changes: a splice for each edited property, one for
+ * each node that gains properties and one for each node added.  The blob
+ * between the splices is then moved to where it ends up, each byte at
+ * most once, and the new bytes are written into the gaps that leaves.
+ */
+enum batch_splice_kind {
+	BATCH_SPLICE_PROP,	/* the whole property is replaced or removed */
+	BATCH_SPLICE_TAIL,	/* appends go after the value that is kept */
+	BATCH_SPLICE_NODE,	/* new properties go after the node's last one */
+	BATCH_SPLICE_SUBNODE,	/* a new node goes before its parent's end */
+};
+
+struct batch_splice {
+	enum batch_splice_kind kind;
+	int offset;		/* in the structure block, before the commit */
+	int oldlen;		/* bytes taken out there */
+	int newlen;		/* bytes put in their place */
+	int first;		/* first edit of the property, or of the node */
+	int node;		/* SUBNODE: which of the batch's new nodes */
+	int propoffset;		/* TAIL: the property whose length changes */
+	int proplen;		/* TAIL: and its new length */
+	int nameoff;		/* PROP: name of the property */
+	int shift;		/* how far the blob before it moves */
+};
+
+struct batch_ctx {
+	const struct fdt_batch *batch;
+	int count;
+	struct batch_splice splice[FDT_BATCH_MAX_EDITS + FDT_BATCH_MAX_NODES];
+	int nameoff[FDT_BATCH_MAX_EDITS];
+	int newstrsize;
+	char done[FDT_BATCH_MAX_EDITS];
+};
+
+static int batch_add(struct fdt_batch *batch, int nodeoffset, const char *name,
+		     const void *val, int len, enum fdt_batch_op op)
+{
+	struct fdt_batch_edit *edit;
+
+	if (batch->count >= FDT_BATCH_MAX_EDITS)
+		return -FDT_ERR_NOSPACE;
+	if (nodeoffset < 0 || len < 0)
+		return -FDT_ERR_BADOFFSET;
+	if (nodeoffset >= FDT_BATCH_NEW_NODE &&
+	    nodeoffset - FDT_BATCH_NEW_NODE >= batch->nodes)
+		return -FDT_ERR_BADOFFSET;
+
+	edit = &batch->edit[batch->count++];
+	edit->nodeoffset = nodeoffset;
+	edit->name = name;
+	edit->val = val;
+	edit->len = len;
+	edit->op = op;
+
+	return 0;
+}
+
+void fdt_batch_init(struct fdt_batch *batch)
+{
+	batch->count = 0;
+	batch->nodes = 0;
+}
+
+int fdt_batch_setprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name, const void *val, int len)
+{
+	return batch_add(batch, nodeoffset, name, val, len, FDT_BATCH_SET);
+}
+
+int fdt_batch_appendprop(struct fdt_batch *batch, int nodeoffset,
+			 const char *name, const void *val, int len)
+{
+	return batch_add(batch, nodeoffset, name, val, len, FDT_BATCH_APPEND);
+}
+
+int fdt_batch_delprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name)
+{
+	return batch_add(batch, nodeoffset, name, NULL, 0, FDT_BATCH_DELETE);
+}
+
+int fdt_batch_add_subnode(struct fdt_batch *batch, int parentoffset,
+			  const char *name)
+{
+	struct fdt_batch_node *node;
+
+	if (batch->nodes >= FDT_BATCH_MAX_NODES)
+		return -FDT_ERR_NOSPACE;
+	/* the parent has to be in the blob already */
+	if (parentoffset < 0 || parentoffset >= FDT_BATCH_NEW_NODE)
+		return -FDT_ERR_BADOFFSET;
+
+	node = &batch->node[batch->nodes];
+	node->parentoffset = parentoffset;
+	node->name = name;
+
+	return FDT_BATCH_NEW_NODE + batch->nodes++;
+}
+
+static int batch_same_prop(const struct fdt_batch_edit *a,
+			   const struct fdt_batch_edit *b)
+{
+	return a->nodeoffset == b->nodeoffset && !strcmp(a->name, b->name);
+}
+
+/*
+ * Work out what the edits to a property leave of it.  *base is the last
+ * edit that set or deleted it, -1 if the old value (oldlen bytes, -1 if
+ * there was none) still stands, and appends after that add to it.
+ * Returns the final length, -1 if the property is gone.
+ */
+static int batch_resolve(const struct fdt_batch *batch, int first,
+			 int oldlen, int *base)
+{
+	const struct fdt_batch_edit *edit;
+	int len = oldlen;
+	int i;
+
+	*base = -1;
+	for (i = first; i < batch->count; i++) {
+		edit = &batch->edit[i];
+		if (!batch_same_prop(edit, &batch->edit[first]))
+			continue;
+
+		switch (edit->op) {
+		case FDT_BATCH_SET:
+			*base = i;
+			len = edit->len;
+			break;
+		case FDT_BATCH_DELETE:
+			*base = i;
+			len = -1;
+			break;
+		case FDT_BATCH_APPEND:
+			len = (len < 0 ? 0 : len) + edit->len;
+			break;
+		}
+	}
+
+	return len;
+}
+
+static void batch_mark_done(struct batch_ctx *ctx, int first)
+{
+	const struct fdt_batch *batch = ctx->batch;
+	int i;
+
+	for (i = first; i < batch->count; i++)
+		if (batch_same_prop(&batch->edit[i], &batch->edit[first]))
+			ctx->done[i] = 1;
+}
+
+/* the edited values, from the edit after start on, written out at p */
+static char *batch_put_values(const struct fdt_batch *batch, int first,
+			      int start, char *p)
+{
+	const struct fdt_batch_edit *edit;
+	int i;
+
+	for (i = start; i < batch->count; i++) {
+		edit = &batch->edit[i];
+		if (!batch_same_prop(edit, &batch->edit[first]))
+			continue;
+		if (edit->op == FDT_BATCH_DELETE ||
+		    (i != start && edit->op == FDT_BATCH_SET))
+			continue;
+		memcpy(p, edit->val, edit->len);
+		p += edit->len;
+	}
+
+	return p;
+}
+
+/*
+ * A whole property built from the edits starting at first, which replace
+ * any old value.  Returns the bytes written, with no dst just counted.
+ */
+static int batch_put_prop(const struct fdt_batch *batch, int first,
+			  int nameoff, char *dst)
+{
+	struct fdt_property *prop;
+	int base, len, total;
+	char *p;
+
+	len = batch_resolve(batch, first, -1, &base);
+	if (len < 0)
+		return 0;
+
+	total = sizeof(*prop) + FDT_TAGALIGN(len);
+	if (!dst)
+		return total;
+
+	prop = (struct fdt_property *)dst;
+	prop->tag = cpu_to_fdt32(FDT_PROP);
+	prop->len = cpu_to_fdt32(len);
+	prop->nameoff = cpu_to_fdt32(nameoff);
+
+	p = batch_put_values(batch, first, base < 0 ? first : base, prop->data);
+	memset(p, 0, dst + total - p);
+
+	return total;
+}
+
+/* properties a node did not have yet, in the order they were queued */
+static int batch_put_new_props(struct batch_ctx *ctx, int nodeoffset,
+			       char *dst)
+{
+	const struct fdt_batch *batch = ctx->batch;
+	int first, total = 0;
+	int i, j;
+
+	for (first = 0; first < batch->count; first++)
+		if (batch->edit[first].nodeoffset == nodeoffset)
+			break;
+
+	for (i = first; i < batch->count; i++) {
+		if (batch->edit[i].nodeoffset != nodeoffset)
+			continue;
+		for (j = first; j < i; j++)
+			if (batch_same_prop(&batch->edit[j], &batch->edit[i]))
+				break;
+		if (j < i || ctx->done[i])
+			continue;
+
+		total += batch_put_prop(batch, i, ctx->nameoff[i],
+					dst ? dst + total : NULL);
+	}
+
+	return total;
+}
+
+static struct batch_splice *batch_add_splice(struct batch_ctx *ctx,
+					     enum batch_splice_kind kind,
+					     int offset, int oldlen, int newlen,
+					     int first)
+{
+	struct batch_splice *splice;
+	int i;
+
+	/* every splice uses up at least one edit or new node */
+	if (ctx->count >= FDT_BATCH_MAX_EDITS + FDT_BATCH_MAX_NODES)
+		return NULL;
+
+	/* keep them sorted; equal offsets stay in the order they came */
+	for (i = ctx->count; i > 0 && ctx->splice[i - 1].offset > offset; i--)
+		ctx->splice[i] = ctx->splice[i - 1];
+
+	splice = &ctx->splice[i];
+	splice->kind = kind;
+	splice->offset = offset;
+	splice->oldlen = oldlen;
+	splice->newlen = newlen;
+	splice->first = first;
+	splice->node = -1;
+	splice->propoffset = -1;
+	splice->proplen = 0;
+	splice->nameoff = 0;
+	splice->shift = 0;
+	ctx->count++;
+
+	return splice;
+}
+
+/* find the splices one edited node needs */
+static int batch_plan_node(struct batch_ctx *ctx, const void *fdt, int first)
+{
+	const struct fdt_batch *batch = ctx->batch;
+	int nodeoffset = batch->edit[first].nodeoffset;
+	const struct fdt_property *prop;
+	struct batch_splice *splice;
+	int offset, end, oldlen, len, base, i;
+	const char *name;
+
+	end = _fdt_check_node_offset(fdt, nodeoffset);
+	if (end < 0)
+		return end;
+
+	for (offset = fdt_first_property_offset(fdt, nodeoffset);
+	     offset >= 0;
+	     offset = fdt_next_property_offset(fdt, offset)) {
+		prop = fdt_get_property_by_offset(fdt, offset, &oldlen);
+		if (!prop)
+			return oldlen;
+		end = offset + sizeof(*prop) + FDT_TAGALIGN(oldlen);
+
+		name = fdt_string(fdt, fdt32_to_cpu(prop->nameoff));
+		for (i = first; i < batch->count; i++)
+			if (!ctx->done[i] && batch->edit[i].nodeoffset == nodeoffset &&
+			    !strcmp(batch->edit[i].name, name))
+				break;
+		if (i == batch->count)
+			continue;
+
+		batch_mark_done(ctx, i);
+		len = batch_resolve(batch, i, oldlen, &base);
+		if (base < 0) {
+			splice = batch_add_splice(ctx, BATCH_SPLICE_TAIL,
+						  offset + sizeof(*prop) + oldlen,
+						  FDT_TAGALIGN(oldlen) - oldlen,
+						  FDT_TAGALIGN(len) - oldlen, i);
+			if (!splice)
+				return -FDT_ERR_INTERNAL;
+			splice->propoffset = offset;
+			splice->proplen = len;
+		} else {
+			splice = batch_add_splice(ctx, BATCH_SPLICE_PROP, offset,
+						  end - offset,
+						  batch_put_prop(batch, i, 0, NULL), i);
+			if (!splice)
+				return -FDT_ERR_INTERNAL;
+			splice->nameoff = fdt32_to_cpu(prop->nameoff);
+		}
+	}
+	if (offset != -FDT_ERR_NOTFOUND)
+		return offset;
+
+	len = batch_put_new_props(ctx, nodeoffset, NULL);
+	if (len && !batch_add_splice(ctx, BATCH_SPLICE_NODE, end, 0, len, first))
+		return -FDT_ERR_INTERNAL;
+
+	return 0;
+}
+
+/* a whole new node, its properties included */
+static int batch_put_subnode(struct batch_ctx *ctx, int n, char *dst)
+{
+	const char *name = ctx->batch->node[n].name;
+	struct fdt_node_header *nh;
+	int namelen = FDT_TAGALIGN(strlen(name) + 1);
+	int total;
+
+	total = sizeof(*nh) + namelen;
+	if (dst) {
+		nh = (struct fdt_node_header *)dst;
+		nh->tag = cpu_to_fdt32(FDT_BEGIN_NODE);
+		memset(nh->name, 0, namelen);
+		memcpy(nh->name, name, strlen(name));
+	}
+
+	total += batch_put_new_props(ctx, FDT_BATCH_NEW_NODE + n,
+				     dst ? dst + total : NULL);
+
+	if (dst)
+		*(uint32_t *)(dst + total) = cpu_to_fdt32(FDT_END_NODE);
+
+	return total + FDT_TAGSIZE;
+}
+
+/* find where a new node goes, after the subnodes its parent has */
+static int batch_plan_subnode(struct batch_ctx *ctx, const void *fdt, int n)
+{
+	const struct fdt_batch_node *node = &ctx->batch->node[n];
+	struct batch_splice *splice;
+	int offset, nextoffset;
+	int depth = 0;
+	uint32_t tag;
+
+	int i;
+
+	offset = fdt_subnode_offset(fdt, node->parentoffset, node->name);
+	if (offset >= 0)
+		return -FDT_ERR_EXISTS;
+	if (offset != -FDT_ERR_NOTFOUND)
+		return offset;
+	for (i = 0; i < n; i++)
+		if (ctx->batch->node[i].parentoffset == node->parentoffset &&
+		    !strcmp(ctx->batch->node[i].name, node->name))
+			return -FDT_ERR_EXISTS;
+
+	offset = node->parentoffset;
+	do {
+		tag = fdt_next_tag(fdt, offset, &nextoffset);
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			depth++;
+			break;
+		case FDT_END_NODE:
+			depth--;
+			break;
+		case FDT_END:
+			return -FDT_ERR_BADSTRUCTURE;
+		}
+		if (depth)
+			offset = nextoffset;
+	} while (depth);
+
+	splice = batch_add_splice(ctx, BATCH_SPLICE_SUBNODE, offset, 0,
+				  batch_put_subnode(ctx, n, NULL), -1);
+	if (!splice)
+		return -FDT_ERR_INTERNAL;
+	splice->node = n;
+
+	return 0;
+}
+
+/* names the strings block does not have yet are added on its end */
+static void batch_assign_names(struct batch_ctx *ctx, const void *fdt)
+{
+	const struct fdt_batch *batch = ctx->batch;
+	const char *strtab = (const char *)fdt + fdt_off_dt_strings(fdt);
+	int strsize = fdt_size_dt_strings(fdt);
+	const char *p;
+	int i, j;
+
+	ctx->newstrsize = 0;
+	for (i = 0; i < batch->count; i++) {
+		p = _fdt_find_string(strtab, strsize, batch->edit[i].name);
+		if (p) {
+			ctx->nameoff[i] = p - strtab;
+			continue;
+		}
+
+		for (j = 0; j < i; j++)
+			if (!strcmp(batch->edit[j].name, batch->edit[i].name))
+				break;
+		if (j < i) {
+			ctx->nameoff[i] = ctx->nameoff[j];
+			continue;
+		}
+
+		ctx->nameoff[i] = strsize + ctx->newstrsize;
+		ctx->newstrsize += strlen(batch->edit[i].name) + 1;
+	}
+}
+
+static int batch_blocks_in_order(const void *fdt)
+{
+	int rsv_end = fdt_off_mem_rsvmap(fdt) +
+		(fdt_num_mem_rsv(fdt) + 1) * sizeof(struct fdt_reserve_entry);
+
+	return fdt_version(fdt) >= 17 &&
+		fdt_off_mem_rsvmap(fdt) >= sizeof(struct fdt_header) &&
+		fdt_off_dt_struct(fdt) >= rsv_end &&
+		fdt_off_dt_strings(fdt) >= fdt_off_dt_struct(fdt) + fdt_size_dt_struct(fdt);
+}
+
+/*
+ * Move the piece of the blob before splice n (up to end for the last) to
+ * where it ends up.  Pieces moving down go first, front to back, and the
+ * ones moving up after them, back to front: neither ever lands on a piece
+ * that has not moved yet.
+ */
+static void batch_move_piece(const struct batch_ctx *ctx, char *base, int end,
+			     int total, int n, int up)
+{
+	const struct batch_splice *splice = ctx->splice;
+	int start, shift;
+
+	start = n ? splice[n - 1].offset + splice[n - 1].oldlen : 0;
+	if (n < ctx->count) {
+		end = splice[n].offset;
+		shift = splice[n].shift;
+	} else {
+		shift = total;
+	}
+
+	if (up ? shift > 0 : shift < 0)
+		memmove(base + start + shift, base + start, end - start);
+}
+
+static void batch_put_splice(struct batch_ctx *ctx,
+			     const struct batch_splice *splice, char *base)
+{
+	const struct fdt_batch *batch = ctx->batch;
+	char *dst = base + splice->offset + splice->shift;
+	struct fdt_property *prop;
+	char *p;
+
+	switch (splice->kind) {
+	case BATCH_SPLICE_PROP:
+		batch_put_prop(batch, splice->first, splice->nameoff, dst);
+		break;
+	case BATCH_SPLICE_TAIL:
+		p = batch_put_values(batch, splice->first, splice->first, dst);
+		memset(p, 0, dst + splice->newlen - p);
+		/* nothing else changes between the property and its tail */
+		prop = (struct fdt_property *)(base + splice->propoffset +
+					       splice->shift);
+		prop->len = cpu_to_fdt32(splice->proplen);
+		break;
+	case BATCH_SPLICE_NODE:
+		batch_put_new_props(ctx, batch->edit[splice->first].nodeoffset,
+				    dst);
+		break;
+	case BATCH_SPLICE_SUBNODE:
+		batch_put_subnode(ctx, splice->node, dst);
+		break;
+	}
+}
+
+int fdt_batch_commit(void *fdt, int bufsize, const struct fdt_batch *batch)
+{
+	struct batch_ctx ctx;
+	char *structp, *strings;
+	int strings_off, strings_size, end, total;
+	int err, i, j;
+
+	FDT_CHECK_HEADER(fdt);
+
+	if (!batch_blocks_in_order(fdt)) {
+		err = fdt_open_into(fdt, fdt, bufsize);
+		if (err)
+			return err;
+	}
+
+	ctx.batch = batch;
+	ctx.count = 0;
+	memset(ctx.done, 0, sizeof(ctx.done));
+	batch_assign_names(&ctx, fdt);
+
+	for (i = 0; i < batch->count; i++) {
+		if (batch->edit[i].nodeoffset >= FDT_BATCH_NEW_NODE)
+			continue;
+		for (j = 0; j < i; j++)
+			if (batch->edit[j].nodeoffset == batch->edit[i].nodeoffset)
+				break;
+		if (j < i)
+			continue;
+
+		err = batch_plan_node(&ctx, fdt, i);
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < batch->nodes; i++) {
+		err = batch_plan_subnode(&ctx, fdt, i);
+		if (err)
+			return err;
+	}
+
+	total = 0;
+	for (i = 0; i < ctx.count; i++) {
+		ctx.splice[i].shift = total;
+		total += ctx.splice[i].newlen - ctx.splice[i].oldlen;
+	}
+
+	strings_off = fdt_off_dt_strings(fdt);
+	strings_size = fdt_size_dt_strings(fdt);
+	if (strings_off + total + strings_size + ctx.newstrsize > bufsize)
+		return -FDT_ERR_NOSPACE;
+
+	/* everything from the structure block to the end of the strings */
+	structp = (char *)fdt + fdt_off_dt_struct(fdt);
+	end = strings_off + strings_size - fdt_off_dt_struct(fdt);
+
+	for (i = 0; i <= ctx.count; i++)
+		batch_move_piece(&ctx, structp, end, total, i, 0);
+	for (i = ctx.count; i >= 0; i--)
+		batch_move_piece(&ctx, structp, end, total, i, 1);
+
+	for (i = 0; i < ctx.count; i++)
+		batch_put_splice(&ctx, &ctx.splice[i], structp);
+
+	strings = (char *)fdt + strings_off + total;
+	for (i = 0; i < batch->count; i++)
+		if (ctx.nameoff[i] >= strings_size)
+			memcpy(strings + ctx.nameoff[i], batch->edit[i].name,
+			       strlen(batch->edit[i].name) + 1);
+
+	fdt_set_size_dt_struct(fdt, fdt_size_dt_struct(fdt) + total);
+	fdt_set_off_dt_strings(fdt, strings_off + total);
+	fdt_set_size_dt_strings(fdt, strings_size + ctx.newstrsize);
+	fdt_set_totalsize(fdt, strings_off + total + strings_size + ctx.newstrsize);
+
+	return 0;
+}
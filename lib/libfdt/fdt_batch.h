@@ -0,0 +1,105 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _FDT_BATCH_H
+#define _FDT_BATCH_H
+
+#include <stdint.h>
+
+/*
+ * Batched property edits.
+ *
+ * Every fdt_setprop()/fdt_appendprop() that changes the size of a
+ * property moves the whole rest of the blob.  Edits queued on a batch
+ * are instead applied together by fdt_batch_commit(), which moves each
+ * byte of the blob at most once however many edits there are.
+ *
+ * Node offsets are those of the blob the batch is committed to, as it is
+ * before the commit, or ones fdt_batch_add_subnode() handed out for the
+ * nodes it queued.  Names and values are not copied: they must stay
+ * valid, and must not point into the blob, until the commit.  Edits to
+ * the same property apply in the order they were queued, just like the
+ * libfdt calls they stand for.
+ */
+#define FDT_BATCH_MAX_EDITS	16
+#define FDT_BATCH_MAX_NODES	4
+
+/* offsets from here on are the nodes a batch adds, in the order queued */
+#define FDT_BATCH_NEW_NODE	0x40000000
+
+enum fdt_batch_op {
+	FDT_BATCH_SET,
+	FDT_BATCH_APPEND,
+	FDT_BATCH_DELETE,
+};
+
+struct fdt_batch_edit {
+	int nodeoffset;
+	const char *name;
+	const void *val;
+	int len;
+	enum fdt_batch_op op;
+};
+
+struct fdt_batch_node {
+	int parentoffset;
+	const char *name;
+};
+
+struct fdt_batch {
+	int count;
+	struct fdt_batch_edit edit[FDT_BATCH_MAX_EDITS];
+	int nodes;
+	struct fdt_batch_node node[FDT_BATCH_MAX_NODES];
+};
+
+void fdt_batch_init(struct fdt_batch *batch);
+int fdt_batch_setprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name, const void *val, int len);
+int fdt_batch_appendprop(struct fdt_batch *batch, int nodeoffset,
+			 const char *name, const void *val, int len);
+int fdt_batch_delprop(struct fdt_batch *batch, int nodeoffset,
+		      const char *name);
+
+/*
+ * Queue a new node, which goes after the subnodes parentoffset already
+ * has, as fdt_add_subnode() puts it.  Returns the offset to queue the new
+ * node's properties with, or a -FDT_ERR_* code.
+ */
+int fdt_batch_add_subnode(struct fdt_batch *batch, int parentoffset,
+			  const char *name);
+
+/*
+ * Apply the queued edits to the blob at fdt, which may grow up to
+ * bufsize bytes, and trim its totalsize to the end of the strings.  The
+ * blob is not touched unless all the edits fit.  Returns 0 or a
+ * -FDT_ERR_* code.
+ */
+int fdt_batch_commit(void *fdt, int bufsize, const struct fdt_batch *batch);
+
+#endif /* _FDT_BATCH_H */
@@ -30,6 +30,8 @@
 
 #include <debug.h>
 #include <compiler.h>
+#include <string.h>
+#include <stdlib.h>
 #include <lib/tga.h>
 
 #define LOCAL_TRACE 0
@@ -66,39 +68,76 @@ static void print_tga_info(const struct tga_header *header)
 
 }
 
-static void decode_2byte(gfx_surface *surface, uint x, uint y, const void *input)
-{
-	const uint8_t *in = (const uint8_t *)input;
+// pixels decoded on the stack before being written to the surface
+#define DECODE_CHUNK 64
 
-//	printf("in 0x%hhx 0x%hhx\n", in[0], in[1]);
+static uint32_t decode_pixel(const uint8_t *in, uint step)
+{
 	uint r,g,b;
 
-	b = (in[0] & 0x1f) << 3;
-	g = (((in[0] >> 5) & 0x7) | ((in[1] & 0x3) << 3)) << 3;
-	r = ((in[1] >> 2) & 0x1f) << 3;
-
-	gfx_putpixel(surface, x, y, 0xff000000 | r << 16 | g << 8 | b);
+	switch (step) {
+		case 2:
+			b = (in[0] & 0x1f) << 3;
+			g = (((in[0] >> 5) & 0x7) | ((in[1] & 0x3) << 3)) << 3;
+			r = ((in[1] >> 2) & 0x1f) << 3;
+			return 0xff000000 | r << 16 | g << 8 | b;
+		case 3:
+			return 0xff000000 | in[2] << 16 | in[1] << 8 | in[0];
+		default:
+			if (in[3] == 0)
+				return 0;
+			return in[3] << 24 | in[2] << 16 | in[1] << 8 | in[0];
+	}
 }
 
-static void decode_3byte(gfx_surface *surface, uint x, uint y, const void *input)
+static void decode_row(uint32_t *out, const uint8_t *in, uint count, uint step)
 {
-	const uint8_t *in = (const uint8_t *)input;
-
-//	printf("in 0x%hhx 0x%hhx\n", in[0], in[1]);
+	while (count--) {
+		*out++ = decode_pixel(in, step);
+		in += step;
+	}
+}
 
-	gfx_putpixel(surface, x, y, 0xff000000 | in[2] << 16 | in[1] << 8 | in[0]);
+// write count ARGB 8888 pixels into row y of the surface, starting at x
+static void put_row(gfx_surface *surface, uint x, uint y, const uint32_t *argb, uint count)
+{
+	uint8_t *dest = (uint8_t *)surface->ptr + (x + y * surface->stride) * surface->pixelsize;
+
+	switch (surface->format) {
+		case GFX_FORMAT_RGB_565:
+			gfx_row_argb8888_to_rgb565((uint16_t *)dest, argb, count);
+			break;
+		case GFX_FORMAT_RGB_888:
+			gfx_row_argb8888_to_rgb888(dest, argb, count);
+			break;
+		default:
+			memcpy(dest, argb, count * 4);
+			break;
+	}
 }
 
-static void decode_4byte(gfx_surface *surface, uint x, uint y, const void *input)
+// decode count raw input pixels into row y of the surface, starting at x
+static void decode_to_row(gfx_surface *surface, uint x, uint y, const uint8_t *in, uint count, uint step)
 {
-	const uint8_t *in = (const uint8_t *)input;
+	uint32_t tmp[DECODE_CHUNK];
+	uint n;
+
+	if (y >= surface->height)
+		return;
 
-//	printf("in 0x%hhx 0x%hhx 0x%hhx 0x%hhx\n", in[0], in[1], in[2], in[3]);
+	if (surface->pixelsize == 4) {
+		decode_row((uint32_t *)surface->ptr + x + y * surface->stride, in, count, step);
+		return;
+	}
 
-	if (in[3] == 0)
-		gfx_putpixel(surface, x, y, 0);
-	else
-		gfx_putpixel(surface, x, y, in[3] << 24 | in[2] << 16 | in[1] << 8 | in[0]);
+	while (count) {
+		n = MIN(count, DECODE_CHUNK);
+		decode_row(tmp, in, n, step);
+		put_row(surface, x, y, tmp, n);
+		in += n * step;
+		x += n;
+		count -= n;
+	}
 }
 
 /**
@@ -143,24 +182,12 @@ gfx_surface *tga_decode(const void *ptr, size_t len, gfx_format format)
 	DEBUG_ASSERT(surface);
 
 	/* copy the bits out */
-	void (*decodefunc)(gfx_surface *, uint x, uint y, const void *) = NULL;
-
-	uint step = 1;
-	if (header->bitsperpixel == 16) {
-		step = 2;
-		decodefunc = decode_2byte;
-	} else if (header->bitsperpixel == 24) {
-		step = 3;
-		decodefunc = decode_3byte;
-	} else if (header->bitsperpixel == 32) {
-		step = 4;
-		decodefunc = decode_4byte;
-	}
+	uint step = header->bitsperpixel / 8;
 
 	if (header->datatypecode == 2) {
-		/* no RLE */
+		/* no RLE, decode a whole row at a time */
 		uint pos = 0;
-		uint x, y;
+		uint y;
 		uint surfacey;
 
 		for (y = 0; y < header->height; y++) {
@@ -170,10 +197,8 @@ gfx_surface *tga_decode(const void *ptr, size_t len, gfx_format format)
 			else
 				surfacey = y;
 
-			for (x = 0; x < header->width; x++) {
-				decodefunc(surface, x, surfacey, (const uint8_t *)imagestart + pos);
-				pos += step;
-			}
+			decode_to_row(surface, 0, surfacey, (const uint8_t *)imagestart + pos, header->width, step);
+			pos += header->width * step;
 		}
 	} else if (header->datatypecode == 10) {
 		/* RLE compression */
@@ -188,23 +213,34 @@ gfx_surface *tga_decode(const void *ptr, size_t len, gfx_format format)
 			y = 0;
 
 		while (count < (uint)header->height * (uint)header->width) {
-			uint runpos;
-
 			uint8_t run = *((const uint8_t *)imagestart + pos);
 			bool repeat_run = (run & 0x80);
 			uint runlen = (run & 0x7f) + 1;
+			uint32_t color = 0;
 
 //			printf("pos 0x%x count %u run 0x%hhx runtype %d runlen %u\n", pos, count, run, run & 0x80, runlen);
 
 			/* consume the run byte */
 			pos++;
 
-			/* start of a run */
-			for (runpos = 0; runpos < runlen; runpos++) {
-				decodefunc(surface, x, y, (const uint8_t *)imagestart + pos);
-				count++;
+			if (repeat_run)
+				color = decode_pixel((const uint8_t *)imagestart + pos, step);
+
+			/* a run may carry on into the next row */
+			while (runlen > 0) {
+				uint n = MIN(runlen, surface->width - x);
+
+				if (repeat_run) {
+					gfx_fillrect(surface, x, y, n, 1, color);
+				} else {
+					decode_to_row(surface, x, y, (const uint8_t *)imagestart + pos, n, step);
+					/* a run of raw pixels consumes an input pixel each */
+					pos += n * step;
+				}
 
-				x++;
+				count += n;
+				runlen -= n;
+				x += n;
 				if (x == surface->width) {
 					if ((header->imagedescriptor & (1 << 5)) == 0)
 						y--;
@@ -212,10 +248,6 @@ gfx_surface *tga_decode(const void *ptr, size_t len, gfx_format format)
 						y++;
 					x = 0;
 				}
-
-				/* if a run of raw pixels, consume an input pixel */
-				if (!repeat_run)
-					pos += step;
 			}
 			/* if this was a run of repeated pixels, consume the one input pixel we repeated */
 			if (repeat_run)
@@ -271,6 +271,11 @@
 #endif
 #define MDP_INTR_EN                             REG_MDP(0x1010)
 
+#ifdef MDP_INTR_STATUS
+#undef MDP_INTR_STATUS
+#endif
+#define MDP_INTR_STATUS                         REG_MDP(0x1014)
+
 #ifdef MDP_INTR_CLEAR
 #undef MDP_INTR_CLEAR
 #endif
@@ -56,6 +56,7 @@
 
 #define MSM_SDC1_BASE               (PERIPH_SS_BASE + 0x00064000)
 #define MSM_SDC1_SDHCI_BASE         (PERIPH_SS_BASE + 0x00064900)
+#define MSM_SDC1_CMDQ_BASE          (PERIPH_SS_BASE + 0x00064E00)
 #define MSM_SDC2_BASE               (PERIPH_SS_BASE + 0x000A4000)
 #define MSM_SDC2_SDHCI_BASE         (PERIPH_SS_BASE + 0x000A4900)
 
@@ -249,6 +250,11 @@
 #endif
 #define MDP_INTR_EN                             REG_MDP(0x1010)
 
+#ifdef MDP_INTR_STATUS
+#undef MDP_INTR_STATUS
+#endif
+#define MDP_INTR_STATUS                         REG_MDP(0x1014)
+
 #ifdef MDP_INTR_CLEAR
 #undef MDP_INTR_CLEAR
 #endif
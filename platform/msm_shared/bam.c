@@ -261,6 +261,58 @@ void bam_read_offset_update(struct bam_instance *bam, unsigned int pipe_num)
 	dprintf(SPEW, "Offset value is %d \n", offset);
 }
 
+/* Function to get the FIFO offset where the next descriptor will be added.
+ * bam : BAM that uses the FIFO.
+ * pipe_num : BAM pipe that uses the FIFO.
+ * return : offset in bytes from the FIFO head.
+ */
+uint32_t bam_fifo_offset(struct bam_instance *bam, uint8_t pipe_num)
+{
+	return (bam->pipe[pipe_num].fifo.current - bam->pipe[pipe_num].fifo.head) * BAM_DESC_SIZE;
+}
+
+/* A blocking function that waits till the BAM has processed the descriptors
+ * queued between the FIFO offsets start and end, as got from bam_fifo_offset()
+ * before and after queuing them.
+ * Unlike bam_wait_for_interrupt(), this works with more descriptors queued
+ * behind the ones waited for, so a client can queue the next transfer before
+ * waiting for the current one. The descriptors queued before start must have
+ * been waited for already.
+ * bam : BAM instance for the descriptors to be queued.
+ * pipe_num : pipe number for the descriptors to be queued.
+ */
+int bam_wait_for_offset(struct bam_instance *bam,
+                        uint8_t pipe_num,
+                        uint32_t start,
+                        uint32_t end)
+{
+	uint32_t mask = bam->pipe[pipe_num].fifo.size * BAM_DESC_SIZE - 1;
+	uint32_t offset;
+	uint32_t val;
+
+	do
+	{
+		/* Check for error */
+		val = readl(BAM_P_IRQ_STTSn(bam->pipe[pipe_num].pipe_num, bam->base));
+		if (val & P_ERR_EN_MASK)
+		{
+			dprintf(CRITICAL, "Unexpected interrupt : val %u\n", val);
+			return BAM_RESULT_FAILURE;
+		}
+
+		/* Offset of the first descriptor not processed yet */
+		offset = readl(BAM_P_SW_OFSTSn(bam->pipe[pipe_num].pipe_num, bam->base)) & 0xFFFF;
+	} while (((offset - start) & mask) < ((end - start) & mask));
+
+	/* The offset accounts for the processed descriptors, clear their
+	 * interrupts so that they don't satisfy a later bam_wait_for_interrupt()
+	 */
+	val = P_OUT_OF_DESC_EN_MASK | P_PRCSD_DESC_EN_MASK | P_TRNSFR_END_EN_MASK;
+	writel(val, BAM_P_IRQ_CLRn(bam->pipe[pipe_num].pipe_num, bam->base));
+
+	return BAM_RESULT_SUCCESS;
+}
+
 /* Function to get the next desc address.
  * Keeps track of circular properties of the FIFO
  * and returns the appropriate address.
@@ -29,15 +29,213 @@
 #include <boot_stats.h>
 #include <debug.h>
 #include <reg.h>
+#include <string.h>
+#include <printf.h>
+#include <libfdt.h>
+#include <fdt_batch.h>
+#include <kernel/thread.h>
 #include <platform/iomap.h>
 #include <platform.h>
 
+/* The sleep clock runs at 32768 Hz */
+#define BS_SCLK_TO_US(count)    ((uint32_t)(((uint64_t)(count) * 15625) >> 9))
+#define BS_PROFILE_OPEN         0xFFFFFFFF
+
+struct bs_profile_entry {
+	const char *name;
+	uint32_t seq;
+	uint32_t start;
+	uint32_t end;   /* same as start for a marker, BS_PROFILE_OPEN for a running span */
+};
+
+static struct bs_profile_entry bs_profile[BS_PROFILE_MAX_ENTRIES];
+static uint32_t bs_profile_count;
+
+static struct bs_profile_entry *bs_profile_add(const char *name)
+{
+	struct bs_profile_entry *entry;
+
+	entry = &bs_profile[bs_profile_count % BS_PROFILE_MAX_ENTRIES];
+	entry->name = name;
+	entry->seq = bs_profile_count++;
+	entry->start = platform_get_sclk_count();
+
+	return entry;
+}
+
+int bs_profile_begin(const char *name)
+{
+	struct bs_profile_entry *entry;
+
+	enter_critical_section();
+	entry = bs_profile_add(name);
+	entry->end = BS_PROFILE_OPEN;
+	exit_critical_section();
+
+	return entry->seq;
+}
+
+void bs_profile_end(int span)
+{
+	struct bs_profile_entry *entry;
+
+	if (span < 0)
+		return;
+
+	entry = &bs_profile[span % BS_PROFILE_MAX_ENTRIES];
+
+	enter_critical_section();
+	/* The span may have dropped out of the ring already */
+	if (entry->seq == (uint32_t)span && entry->end == BS_PROFILE_OPEN)
+		entry->end = platform_get_sclk_count();
+	exit_critical_section();
+}
+
+void bs_profile_mark(const char *name)
+{
+	struct bs_profile_entry *entry;
+
+	enter_critical_section();
+	entry = bs_profile_add(name);
+	entry->end = entry->start;
+	exit_critical_section();
+}
+
+static uint32_t bs_profile_first(void)
+{
+	if (bs_profile_count > BS_PROFILE_MAX_ENTRIES)
+		return bs_profile_count - BS_PROFILE_MAX_ENTRIES;
+
+	return 0;
+}
+
+unsigned bs_profile_dump(void (*print)(const char *line))
+{
+	struct bs_profile_entry *entry;
+	char name[BS_PROFILE_NAME_LEN + 1];
+	char line[64];
+	uint32_t seq;
+
+	/* The name column is BS_PROFILE_NAME_LEN wide */
+	print("name                      start(us)  time(us)");
+
+	for (seq = bs_profile_first(); seq < bs_profile_count; seq++) {
+		entry = &bs_profile[seq % BS_PROFILE_MAX_ENTRIES];
+		strlcpy(name, entry->name, sizeof(name));
+
+		if (entry->end == BS_PROFILE_OPEN)
+			snprintf(line, sizeof(line), "%-24s %10u      open",
+				 name, BS_SCLK_TO_US(entry->start));
+		else if (entry->end == entry->start)
+			snprintf(line, sizeof(line), "%-24s %10u         -",
+				 name, BS_SCLK_TO_US(entry->start));
+		else
+			snprintf(line, sizeof(line), "%-24s %10u %9u",
+				 name, BS_SCLK_TO_US(entry->start),
+				 BS_SCLK_TO_US(entry->end - entry->start));
+		print(line);
+	}
+
+	return bs_profile_count - bs_profile_first();
+}
+
+static void bs_profile_print_line(const char *line)
+{
+	dprintf(INFO, "%s\n", line);
+}
+
+void bs_profile_print(void)
+{
+	dprintf(INFO, "boot profile:\n");
+	bs_profile_dump(bs_profile_print_line);
+}
+
+/* The kernel gets the profile as a list of names and a matching list of
+ * <start duration> pairs in us; markers have no duration and spans still
+ * running have 0xffffffff.  The lists are static, the batch points at them
+ * until it is committed.
+ */
+int bs_profile_update_dt(const void *fdt, struct fdt_batch *batch)
+{
+	static char names[BS_PROFILE_MAX_ENTRIES * (BS_PROFILE_NAME_LEN + 1)];
+	static uint32_t timings[BS_PROFILE_MAX_ENTRIES * 2];
+	struct bs_profile_entry *entry;
+	uint32_t names_len = 0;
+	uint32_t n = 0;
+	uint32_t seq;
+	uint32_t len;
+	int offset;
+	int ret;
+
+	enter_critical_section();
+	for (seq = bs_profile_first(); seq < bs_profile_count; seq++, n++) {
+		entry = &bs_profile[seq % BS_PROFILE_MAX_ENTRIES];
+
+		len = strnlen(entry->name, BS_PROFILE_NAME_LEN);
+		memcpy(names + names_len, entry->name, len);
+		names[names_len + len] = '\0';
+		names_len += len + 1;
+
+		timings[2 * n] = cpu_to_fdt32(BS_SCLK_TO_US(entry->start));
+		if (entry->end == BS_PROFILE_OPEN)
+			timings[2 * n + 1] = cpu_to_fdt32(BS_PROFILE_OPEN);
+		else
+			timings[2 * n + 1] = cpu_to_fdt32(BS_SCLK_TO_US(entry->end - entry->start));
+	}
+	exit_critical_section();
+
+	offset = fdt_path_offset(fdt, "/chosen/lk-boot-profile");
+	if (offset == -FDT_ERR_NOTFOUND) {
+		offset = fdt_path_offset(fdt, "/chosen");
+		if (offset >= 0)
+			offset = fdt_batch_add_subnode(batch, offset, "lk-boot-profile");
+	}
+	if (offset < 0)
+		return offset;
+
+	ret = fdt_batch_setprop(batch, offset, "names", names, names_len);
+	if (!ret)
+		ret = fdt_batch_setprop(batch, offset, "timings", timings,
+					n * 2 * sizeof(uint32_t));
+
+	return ret;
+}
+
 static uint32_t kernel_load_start;
+static int kernel_load_span = -1;
+
+/* The BS_* timestamps, as they show up in the boot profile */
+static void bs_profile_record(enum bs_entry bs_id)
+{
+	switch (bs_id) {
+	case BS_BL_START:
+		bs_profile_mark("bl-start");
+		break;
+	case BS_KERNEL_ENTRY:
+		bs_profile_mark("kernel-entry");
+		break;
+	case BS_SPLASH_SCREEN_DISPLAY:
+		bs_profile_mark("splash-screen");
+		break;
+	case BS_KERNEL_LOAD_START:
+		kernel_load_span = bs_profile_begin("kernel-load");
+		break;
+	case BS_KERNEL_LOAD_DONE:
+		bs_profile_end(kernel_load_span);
+		kernel_load_span = -1;
+		break;
+	default:
+		break;
+	}
+}
+
 void bs_set_timestamp(enum bs_entry bs_id)
 {
 	addr_t bs_imem = get_bs_info_addr();
 	uint32_t clk_count = 0;
 
+	bs_profile_record(bs_id);
+
 	if(bs_imem) {
 		if (bs_id >= BS_MAX) {
 			dprintf(CRITICAL, "bad bs id: %u, max: %u\n", bs_id, BS_MAX);
@@ -33,6 +33,10 @@
 #include <stdlib.h>
 #include <debug.h>
 #include <printf.h>
+#include <compiler.h>
+#include <libfdt.h>
+#include <fdt_batch.h>
+#include <arch/ops.h>
 #include <arch/arm/dcc.h>
 #include <dev/fbcon.h>
 #include <dev/uart.h>
@@ -62,9 +66,17 @@ static void write_dcc(char c)
 
 #if WITH_DEBUG_LOG_BUF
 
+/* With WITH_DEBUG_LOG_DEFERRED the UART is fed from the log buffer by the
+ * idle thread instead of as the characters are written, so it has to hold
+ * everything printed while the CPU is busy.
+ */
 #ifndef LK_LOG_BUF_SIZE
+#if WITH_DEBUG_LOG_DEFERRED
+#define LK_LOG_BUF_SIZE    (16384)
+#else
 #define LK_LOG_BUF_SIZE    (4096) /* align on 4k */
 #endif
+#endif
 
 #define LK_LOG_COOKIE    0x474f4c52 /* "RLOG" in ASCII */
 
@@ -78,7 +90,8 @@ struct lk_log {
 	char data[LK_LOG_BUF_SIZE];
 };
 
-static struct lk_log log = {
+/* Page aligned, so that it can be handed to the kernel as reserved memory */
+static struct lk_log log __ALIGNED(4096) = {
 	.header = {
 		.cookie = LK_LOG_COOKIE,
 		.max_size = sizeof(log.data),
@@ -90,13 +103,113 @@ static struct lk_log log = {
 
 static void log_putc(char c)
 {
-	log.data[log.header.idx++] = c;
-	log.header.size_written++;
-	if (unlikely(log.header.idx >= log.header.max_size))
-		log.header.idx = 0;
+	unsigned pos;
+
+	/* Claim the slot before filling it: an interrupt handler printing
+	 * in between gets the next one instead of the same.
+	 */
+	pos = atomic_add((volatile int *)&log.header.size_written, 1);
+	log.data[pos % LK_LOG_BUF_SIZE] = c;
+	log.header.idx = (pos + 1) % LK_LOG_BUF_SIZE;
 }
 #endif /* WITH_DEBUG_LOG_BUF */
 
+#if WITH_DEBUG_LOG_BUF && WITH_DEBUG_LOG_DEFERRED && WITH_DEBUG_UART
+static unsigned log_drained;
+static volatile int log_draining;
+
+/* Send the log buffer to the UART up to what has been written so far.
+ * Output that was overwritten before it got out is lost.
+ */
+static void log_drain(void)
+{
+	unsigned written;
+
+	while ((written = log.header.size_written) != log_drained) {
+		if (written - log_drained > LK_LOG_BUF_SIZE)
+			log_drained = written - LK_LOG_BUF_SIZE;
+
+		uart_putc(0, log.data[log_drained % LK_LOG_BUF_SIZE]);
+		log_drained++;
+	}
+}
+
+/* Called by the idle thread, and before anything that may not come back */
+void _dflush(void)
+{
+	/* Whoever got here first is already at it */
+	if (atomic_swap(&log_draining, 1))
+		return;
+
+	log_drain();
+	log_draining = 0;
+}
+#endif
+
+/* Get out everything there is before LK is left for good: with interrupts
+ * off, or from a path that does not come back.
+ */
+void debug_log_flush(void)
+{
+#if WITH_DEBUG_LOG_BUF && WITH_DEBUG_LOG_DEFERRED && WITH_DEBUG_UART
+	/* Interrupts are off for good now, take over from an interrupted drain */
+	log_draining = 0;
+#endif
+	_dflush();
+}
+
+/* Hand the log buffer to the kernel as a reserved-memory region, so that
+ * it survives into the kernel's view of the last boot.  The node is queued
+ * on batch, which points at the static name and reg until it is committed.
+ */
+int debug_log_update_dt(const void *fdt, struct fdt_batch *batch)
+{
+#if WITH_DEBUG_LOG_BUF
+	static char name[32];
+	static uint32_t reg[4];
+	uint32_t cells = 0;
+	const uint32_t *valp;
+	addr_t base = PA((addr_t)&log);
+	uint32_t size = ROUNDUP(sizeof(log), 4096);
+	int offset;
+	int len;
+	int ret;
+
+	offset = fdt_path_offset(fdt, "/reserved-memory");
+	if (offset == -FDT_ERR_NOTFOUND)
+		return 0;
+	if (offset < 0)
+		return offset;
+
+	/* reg is <address size>, each one or two cells as the parent says */
+	valp = fdt_getprop(fdt, offset, "#address-cells", &len);
+	if (valp && len == sizeof(uint32_t) && fdt32_to_cpu(*valp) == 2)
+		reg[cells++] = 0;
+	reg[cells++] = cpu_to_fdt32(base);
+	valp = fdt_getprop(fdt, offset, "#size-cells", &len);
+	if (valp && len == sizeof(uint32_t) && fdt32_to_cpu(*valp) == 2)
+		reg[cells++] = 0;
+	reg[cells++] = cpu_to_fdt32(size);
+
+	snprintf(name, sizeof(name), "lk_log@%x", (unsigned)base);
+	offset = fdt_batch_add_subnode(batch, offset, name);
+	if (offset < 0)
+		return offset;
+
+	ret = fdt_batch_setprop(batch, offset, "compatible", "lk,log-buffer",
+				sizeof("lk,log-buffer"));
+	if (!ret)
+		ret = fdt_batch_setprop(batch, offset, "reg", reg,
+					cells * sizeof(uint32_t));
+	if (!ret)
+		ret = fdt_batch_setprop(batch, offset, "no-map", NULL, 0);
+
+	return ret;
+#else
+	return 0;
+#endif
+}
+
 void display_fbcon_message(char *str)
 {
 #if ENABLE_FBCON_LOGGING
@@ -117,7 +230,7 @@ void _dputc(char c)
 	}
 	write_dcc(c) ;
 #endif
-#if WITH_DEBUG_UART
+#if WITH_DEBUG_UART && !(WITH_DEBUG_LOG_BUF && WITH_DEBUG_LOG_DEFERRED)
 	uart_putc(0, c);
 #endif
 #if WITH_DEBUG_FBCON && WITH_DEV_FBCON
@@ -154,6 +267,7 @@ void platform_halt(void)
 	if (set_download_mode(NORMAL_DLOAD) == 0)
 	{
 		dprintf(CRITICAL, "HALT: reboot into dload mode...\n");
+		debug_log_flush();
 		reboot_device(DLOAD);
 		dprintf(CRITICAL, "HALT: reboot_device failed\n");
 	}
@@ -162,5 +276,6 @@ void platform_halt(void)
 		dprintf(CRITICAL, "HALT: set_download_mode not supported\n");
 	}
 	dprintf(CRITICAL, "HALT: spinning forever...\n");
+	debug_log_flush();
 	for (;;) ;
 }
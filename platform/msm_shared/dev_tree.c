@@ -27,6 +27,7 @@
 */
 
 #include <libfdt.h>
+#include <fdt_batch.h>
 #include <dev_tree.h>
 #include <lib/ptable.h>
 #include <malloc.h>
@@ -39,6 +40,7 @@
 #include <kernel/thread.h>
 #include <target.h>
 #include <partial_goods.h>
+#include <boot_stats.h>
 
 struct dt_entry_v1
 {
@@ -50,9 +52,6 @@ struct dt_entry_v1
 };
 
 static struct dt_mem_node_info mem_node;
-static int platform_dt_absolute_match(struct dt_entry *cur_dt_entry, struct dt_entry_node *dt_list);
-static struct dt_entry *platform_dt_match_best(struct dt_entry_node *dt_list);
-static int update_dtb_entry_node(struct dt_entry_node *dt_list, uint32_t dtb_info);
 extern int target_is_emmc_boot(void);
 extern uint32_t target_dev_tree_mem(void *fdt, uint32_t memory_node_offset);
 /* TODO: This function needs to be moved to target layer to check violations
@@ -64,62 +63,203 @@ extern int check_aboot_addr_range_overlap(uint32_t start, uint32_t size);
    otherwise return 0xFFFFFFFF */
 #define INVALID_SOC_REV_ID 0XFFFFFFFF
 
-/* Add function to allocate dt entry list, used for recording
-*  the entry which conform to platform_dt_absolute_match()
-*/
-static struct dt_entry_node *dt_entry_list_init(void)
+/*
+ * DTB selection looks at every (msm-id, board-id, pmic-id) combination in
+ * the image once, as it goes past, and only keeps the best one so far.
+ *
+ * An entry is usable when its msm-id, hardware platform, subtype and DDR
+ * size equal the board's and none of its soc, board or pmic versions are
+ * newer than the board's.  Usable entries are ranked on the fields below,
+ * most significant first.  The compat fields score 2 when they equal the
+ * board's value, 1 for the 0x0 default and 0 otherwise, the rest prefer
+ * the newest version.  Of equally ranked entries the first one wins.
+ */
+enum dt_score_field
+{
+	DT_SCORE_FOUNDRY = 0,
+	DT_SCORE_PMIC_MODEL,
+	DT_SCORE_PANEL_TYPE,
+	DT_SCORE_BOOT_DEVICE,
+	DT_SCORE_SOC,
+	DT_SCORE_MAJOR_MINOR,
+	DT_SCORE_PMIC0,
+	DT_SCORE_PMIC1,
+	DT_SCORE_PMIC2,
+	DT_SCORE_PMIC3,
+	DT_SCORE_FIELDS,
+};
+
+/* fields up to here must have matched the board or the default */
+#define DT_SCORE_COMPAT_FIELDS	(DT_SCORE_BOOT_DEVICE + 1)
+
+struct dt_match
+{
+	/* the board, read once up front */
+	uint32_t msm_id;
+	uint32_t hw_platform;
+	uint32_t hw_subtype;
+	uint32_t hlos_subtype;
+	uint32_t soc_rev;
+	uint32_t target_id;
+	uint32_t foundry;
+	uint32_t pmic[4];
+	uint32_t pmic_model;
+
+	bool found;
+	struct dt_entry best;
+	uint32_t score[DT_SCORE_FIELDS];
+};
+
+/* the four pmic model bytes of an entry or the board, as one word */
+static uint32_t dt_pmic_model(const uint32_t *pmic_rev)
+{
+	return (pmic_rev[0] & 0xff) | ((pmic_rev[1] & 0xff) << 8) |
+		((pmic_rev[2] & 0xff) << 16) | ((pmic_rev[3] & 0xff) << 24);
+}
+
+static void dt_match_init(struct dt_match *match)
+{
+	uint32_t i;
+
+	memset(match, 0, sizeof(*match));
+
+	match->msm_id = board_platform_id() & 0x0000ffff;
+	match->hw_platform = board_hardware_id();
+	match->hw_subtype = board_hardware_subtype();
+	match->hlos_subtype = target_get_hlos_subtype();
+	match->soc_rev = board_soc_version();
+	match->target_id = board_target_id();
+	match->foundry = board_foundry_id() << 16;
+	for (i = 0; i < 4; i++)
+		match->pmic[i] = board_pmic_target(i);
+	match->pmic_model = dt_pmic_model(match->pmic);
+}
+
+static bool dt_entry_usable(const struct dt_match *match, const struct dt_entry *cur)
 {
-	struct dt_entry_node *dt_node_member = NULL;
+	uint32_t i;
 
-	dt_node_member = (struct dt_entry_node *)
-		malloc(sizeof(struct dt_entry_node));
+	/* Platform-id
+	* bit no |31	 24|23	16|15	0|
+	*        |reserved|foundry-id|msm-id|
+	*/
+	if ((cur->platform_id & 0x0000ffff) != match->msm_id ||
+		(cur->variant_id & 0x000000ff) != match->hw_platform ||
+		(cur->board_hw_subtype & 0xff) != match->hw_subtype ||
+		/* bits 10:8 of the subtype carry the DDR size */
+		(cur->board_hw_subtype & 0x700) != (match->hlos_subtype & 0x700))
+		return false;
 
-	ASSERT(dt_node_member);
+	if (cur->soc_rev > match->soc_rev ||
+		(cur->variant_id & 0x00ffff00) > (match->target_id & 0x00ffff00))
+		return false;
 
-	list_clear_node(&dt_node_member->node);
-	dt_node_member->dt_entry_m = (struct dt_entry *)
-			malloc(sizeof(struct dt_entry));
-	ASSERT(dt_node_member->dt_entry_m);
+	for (i = 0; i < 4; i++)
+		if ((cur->pmic_rev[i] & 0x00ffff00) > (match->pmic[i] & 0x00ffff00))
+			return false;
 
-	memset(dt_node_member->dt_entry_m ,0 ,sizeof(struct dt_entry));
-	return dt_node_member;
+	return true;
 }
 
-static void insert_dt_entry_in_queue(struct dt_entry_node *dt_list, struct dt_entry_node *dt_node_member)
+static uint32_t dt_compat_rank(uint32_t value, uint32_t board_value)
 {
-	list_add_tail(&dt_list->node, &dt_node_member->node);
+	if (value == board_value)
+		return 2;
+
+	return value ? 0 : 1;
 }
 
-static void dt_entry_list_delete(struct dt_entry_node *dt_node_member)
+static void dt_entry_score(const struct dt_match *match, const struct dt_entry *cur,
+			   uint32_t *score)
 {
-	if (list_in_list(&dt_node_member->node)) {
-			list_delete(&dt_node_member->node);
-			free(dt_node_member->dt_entry_m);
-			free(dt_node_member);
+	uint32_t i;
+
+	score[DT_SCORE_FOUNDRY] = dt_compat_rank(cur->platform_id & 0x00ff0000, match->foundry);
+	score[DT_SCORE_PMIC_MODEL] = dt_compat_rank(dt_pmic_model(cur->pmic_rev), match->pmic_model);
+	score[DT_SCORE_PANEL_TYPE] = dt_compat_rank(cur->board_hw_subtype & 0x1800,
+						    match->hlos_subtype & 0x1800);
+	score[DT_SCORE_BOOT_DEVICE] = dt_compat_rank(cur->board_hw_subtype & 0xf0000,
+						     match->hlos_subtype & 0xf0000);
+	score[DT_SCORE_SOC] = cur->soc_rev;
+	score[DT_SCORE_MAJOR_MINOR] = cur->variant_id & 0x00ffff00;
+	for (i = 0; i < 4; i++)
+		score[DT_SCORE_PMIC0 + i] = cur->pmic_rev[i] & 0x00ffff00;
+}
+
+static void dt_match_consider(struct dt_match *match, const struct dt_entry *cur)
+{
+	uint32_t score[DT_SCORE_FIELDS];
+	uint32_t i;
+
+	if (!dt_entry_usable(match, cur))
+		return;
+
+	dprintf(SPEW, "Add DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
+		cur->platform_id, cur->variant_id,
+		cur->board_hw_subtype, cur->soc_rev,
+		cur->pmic_rev[0], cur->pmic_rev[1],
+		cur->pmic_rev[2], cur->pmic_rev[3],
+		cur->offset, cur->size);
+
+	dt_entry_score(match, cur, score);
+
+	if (match->found) {
+		for (i = 0; i < DT_SCORE_FIELDS && score[i] == match->score[i]; i++)
+			;
+		if (i == DT_SCORE_FIELDS || score[i] < match->score[i])
+			return;
 	}
+
+	match->best = *cur;
+	memcpy(match->score, score, sizeof(score));
+	match->found = true;
 }
 
-static int dev_tree_compatible(void *dtb, uint32_t dtb_size, struct dt_entry_node *dtb_list)
+static struct dt_entry *dt_match_best(struct dt_match *match)
+{
+	uint32_t i;
+
+	if (!match->found)
+		return NULL;
+
+	/*
+	 * The best entry only lacks a compat field when no usable entry that
+	 * ranks the same on the fields before it had the board's value or
+	 * the default either, so nothing in the image fits.
+	 */
+	for (i = 0; i < DT_SCORE_COMPAT_FIELDS; i++) {
+		if (!match->score[i]) {
+			dprintf(CRITICAL, "ERROR: Couldn't find the suitable DTB!\n");
+			return NULL;
+		}
+	}
+
+	return &match->best;
+}
+
+/*
+ * Offer every msm-id, board-id and pmic-id combination listed in the root
+ * of an appended DTB to the match, reading them straight from the blob.
+ */
+static int dev_tree_compatible(void *dtb, uint32_t dtb_size, struct dt_match *match)
 {
 	int root_offset;
-	const void *prop = NULL;
+	const char *model = NULL;
 	const char *plat_prop = NULL;
 	const char *board_prop = NULL;
 	const char *pmic_prop = NULL;
-	char *model = NULL;
-	struct dt_entry *cur_dt_entry;
-	struct dt_entry *dt_entry_array = NULL;
-	struct board_id *board_data = NULL;
-	struct plat_id *platform_data = NULL;
-	struct pmic_id *pmic_data = NULL;
+	const struct dt_entry_v1 *entry_v1;
+	const struct plat_id *plat;
+	const struct board_id *board;
+	const struct pmic_id *pmic;
+	struct dt_entry cur_dt_entry;
 	int len;
 	int len_board_id;
 	int len_plat_id;
 	int min_plat_id_len = 0;
 	int len_pmic_id;
 	uint32_t dtb_ver;
-	uint32_t num_entries = 0;
-	uint32_t i, j, k, n;
+	uint32_t i, j, n;
 	uint32_t msm_data_count;
 	uint32_t board_data_count;
 	uint32_t pmic_data_count;
@@ -128,13 +268,10 @@ static int dev_tree_compatible(void *dtb, uint32_t dtb_size, struct dt_entry_nod
 	if (root_offset < 0)
 		return false;
 
-	prop = fdt_getprop(dtb, root_offset, "model", &len);
-	if (prop && len > 0) {
-		model = (char *) malloc(sizeof(char) * len);
-		ASSERT(model);
-		strlcpy(model, prop, len);
-	} else {
+	model = (const char *)fdt_getprop(dtb, root_offset, "model", &len);
+	if (!model || len <= 0) {
 		dprintf(INFO, "model does not exist in device tree\n");
+		model = "unknown";
 	}
 	/* Find the pmic-id prop from DTB , if pmic-id is present then
 	* the DTB is version 3, otherwise find the board-id prop from DTB ,
@@ -175,6 +312,10 @@ static int dev_tree_compatible(void *dtb, uint32_t dtb_size, struct dt_entry_nod
 		return false;
 	}
 
+	memset(&cur_dt_entry, 0, sizeof(cur_dt_entry));
+	cur_dt_entry.offset = (uint32_t)dtb;
+	cur_dt_entry.size = dtb_size;
+
 	/*
 	 * If DTB version is '1' look for <x y z> pair in the DTB
 	 * x: platform_id
@@ -182,85 +323,43 @@ static int dev_tree_compatible(void *dtb, uint32_t dtb_size, struct dt_entry_nod
 	 * z: SOC rev
 	 */
 	if (dtb_ver == DEV_TREE_VERSION_V1) {
-		cur_dt_entry = (struct dt_entry *)
-				malloc(sizeof(struct dt_entry));
-
-		if (!cur_dt_entry) {
-			dprintf(CRITICAL, "Out of memory\n");
-			return false;
-		}
-		memset(cur_dt_entry, 0, sizeof(struct dt_entry));
-
-		while (len_plat_id) {
-			cur_dt_entry->platform_id = fdt32_to_cpu(((const struct dt_entry_v1 *)plat_prop)->platform_id);
-			cur_dt_entry->variant_id = fdt32_to_cpu(((const struct dt_entry_v1 *)plat_prop)->variant_id);
-			cur_dt_entry->soc_rev = fdt32_to_cpu(((const struct dt_entry_v1 *)plat_prop)->soc_rev);
-			cur_dt_entry->board_hw_subtype =
-				fdt32_to_cpu(((const struct dt_entry_v1 *)plat_prop)->variant_id) >> 0x18;
-			cur_dt_entry->pmic_rev[0] = board_pmic_target(0);
-			cur_dt_entry->pmic_rev[1] = board_pmic_target(1);
-			cur_dt_entry->pmic_rev[2] = board_pmic_target(2);
-			cur_dt_entry->pmic_rev[3] = board_pmic_target(3);
-			cur_dt_entry->offset = (uint32_t)dtb;
-			cur_dt_entry->size = dtb_size;
+		for (i = 0; i < len_plat_id / DT_ENTRY_V1_SIZE; i++) {
+			entry_v1 = (const struct dt_entry_v1 *)(plat_prop + i * DT_ENTRY_V1_SIZE);
+			cur_dt_entry.platform_id = fdt32_to_cpu(entry_v1->platform_id);
+			cur_dt_entry.variant_id = fdt32_to_cpu(entry_v1->variant_id);
+			cur_dt_entry.soc_rev = fdt32_to_cpu(entry_v1->soc_rev);
+			cur_dt_entry.board_hw_subtype = cur_dt_entry.variant_id >> 0x18;
+			memcpy(cur_dt_entry.pmic_rev, match->pmic, sizeof(cur_dt_entry.pmic_rev));
 
 			dprintf(SPEW, "Found an appended flattened device tree (%s - %u %u 0x%x)\n",
-				*model ? model : "unknown",
-				cur_dt_entry->platform_id, cur_dt_entry->variant_id, cur_dt_entry->soc_rev);
-
-			if (platform_dt_absolute_match(cur_dt_entry, dtb_list)) {
-				dprintf(SPEW, "Device tree exact match the board: <%u %u 0x%x> != <%u %u 0x%x>\n",
-					cur_dt_entry->platform_id,
-					cur_dt_entry->variant_id,
-					cur_dt_entry->soc_rev,
-					board_platform_id(),
-					board_hardware_id(),
-					board_soc_version());
-
-			} else {
-				dprintf(SPEW, "Device tree's msm_id doesn't match the board: <%u %u 0x%x> != <%u %u 0x%x>\n",
-					cur_dt_entry->platform_id,
-					cur_dt_entry->variant_id,
-					cur_dt_entry->soc_rev,
-					board_platform_id(),
-					board_hardware_id(),
-					board_soc_version());
-				plat_prop += DT_ENTRY_V1_SIZE;
-				len_plat_id -= DT_ENTRY_V1_SIZE;
-				continue;
-			}
-		}
-		free(cur_dt_entry);
+				model, cur_dt_entry.platform_id, cur_dt_entry.variant_id,
+				cur_dt_entry.soc_rev);
 
+			dt_match_consider(match, &cur_dt_entry);
+		}
+		return true;
 	}
+
 	/*
-	 * If DTB Version is '3' then we have split DTB with board & msm data & pmic
-	 * populated saperately in board-id & msm-id & pmic-id prop respectively.
-	 * Extract the data & prepare a look up table
+	 * Version 2 and 3 DTBs list the msm, board and pmic data separately
+	 * in msm-id, board-id and pmic-id, every combination of them is a
+	 * candidate.  If we have '<X>; <Y>' as platform data & '<A>; <B>' as
+	 * board data the entries are <X, A>; <X, B>; <Y, A>; <Y, B>.
 	 */
-	else if (dtb_ver == DEV_TREE_VERSION_V2 || dtb_ver == DEV_TREE_VERSION_V3) {
-		board_data_count = (len_board_id / BOARD_ID_SIZE);
-		msm_data_count = (len_plat_id / PLAT_ID_SIZE);
-		/* If dtb version is v2.0, the pmic_data_count will be <= 0 */
-		pmic_data_count = (len_pmic_id / PMIC_ID_SIZE);
-
-		/* If we are using dtb v3.0, then we have split board, msm & pmic data in the DTB
-		*  If we are using dtb v2.0, then we have split board & msmdata in the DTB
-		*/
-		board_data = (struct board_id *) malloc(sizeof(struct board_id) * (len_board_id / BOARD_ID_SIZE));
-		ASSERT(board_data);
-		platform_data = (struct plat_id *) malloc(sizeof(struct plat_id) * (len_plat_id / PLAT_ID_SIZE));
-		ASSERT(platform_data);
-		if (dtb_ver == DEV_TREE_VERSION_V3) {
-			pmic_data = (struct pmic_id *) malloc(sizeof(struct pmic_id) * (len_pmic_id / PMIC_ID_SIZE));
-			ASSERT(pmic_data);
-		}
-		i = 0;
-
-		/* Extract board data from DTB */
-		for(i = 0 ; i < board_data_count; i++) {
-			board_data[i].variant_id = fdt32_to_cpu(((struct board_id *)board_prop)->variant_id);
-			board_data[i].platform_subtype = fdt32_to_cpu(((struct board_id *)board_prop)->platform_subtype);
+	msm_data_count = len_plat_id / PLAT_ID_SIZE;
+	board_data_count = len_board_id / BOARD_ID_SIZE;
+	/* a v2 DTB carries no pmic data, it fits the board's pmics */
+	pmic_data_count = (dtb_ver == DEV_TREE_VERSION_V3) ? len_pmic_id / PMIC_ID_SIZE : 1;
+
+	for (i = 0; i < msm_data_count; i++) {
+		plat = (const struct plat_id *)plat_prop + i;
+		cur_dt_entry.platform_id = fdt32_to_cpu(plat->platform_id);
+		cur_dt_entry.soc_rev = fdt32_to_cpu(plat->soc_rev);
+
+		for (j = 0; j < board_data_count; j++) {
+			board = (const struct board_id *)board_prop + j;
+			cur_dt_entry.variant_id = fdt32_to_cpu(board->variant_id);
+			cur_dt_entry.board_hw_subtype = fdt32_to_cpu(board->platform_subtype);
 			/* For V2/V3 version of DTBs we have platform version field as part
 			 * of variant ID, in such case the subtype will be mentioned as 0x0
 			 * As the qcom, board-id = <0xSSPMPmPH, 0x0>
@@ -271,135 +370,29 @@ static int dev_tree_compatible(void *dtb, uint32_t dtb_size, struct dt_entry_nod
 			 * In such case to make it compatible with LK algorithm move the subtype
 			 * from variant_id to subtype field
 			 */
-			if (board_data[i].platform_subtype == 0)
-				board_data[i].platform_subtype =
-					fdt32_to_cpu(((struct board_id *)board_prop)->variant_id) >> 0x18;
-
-			len_board_id -= sizeof(struct board_id);
-			board_prop += sizeof(struct board_id);
-		}
-
-		/* Extract platform data from DTB */
-		for(i = 0 ; i < msm_data_count; i++) {
-			platform_data[i].platform_id = fdt32_to_cpu(((struct plat_id *)plat_prop)->platform_id);
-			platform_data[i].soc_rev = fdt32_to_cpu(((struct plat_id *)plat_prop)->soc_rev);
-			len_plat_id -= sizeof(struct plat_id);
-			plat_prop += sizeof(struct plat_id);
-		}
-
-		if (dtb_ver == DEV_TREE_VERSION_V3 && pmic_prop) {
-			/* Extract pmic data from DTB */
-			for(i = 0 ; i < pmic_data_count; i++) {
-				pmic_data[i].pmic_version[0]= fdt32_to_cpu(((struct pmic_id *)pmic_prop)->pmic_version[0]);
-				pmic_data[i].pmic_version[1]= fdt32_to_cpu(((struct pmic_id *)pmic_prop)->pmic_version[1]);
-				pmic_data[i].pmic_version[2]= fdt32_to_cpu(((struct pmic_id *)pmic_prop)->pmic_version[2]);
-				pmic_data[i].pmic_version[3]= fdt32_to_cpu(((struct pmic_id *)pmic_prop)->pmic_version[3]);
-				len_pmic_id -= sizeof(struct pmic_id);
-				pmic_prop += sizeof(struct pmic_id);
-			}
-
-			/* We need to merge board & platform data into dt entry structure */
-			num_entries = msm_data_count * board_data_count * pmic_data_count;
-		} else {
-			/* We need to merge board & platform data into dt entry structure */
-			num_entries = msm_data_count * board_data_count;
-		}
-
-		if ((((uint64_t)msm_data_count * (uint64_t)board_data_count * (uint64_t)pmic_data_count) !=
-			msm_data_count * board_data_count * pmic_data_count) ||
-			(((uint64_t)msm_data_count * (uint64_t)board_data_count) != msm_data_count * board_data_count)) {
-
-			free(board_data);
-			free(platform_data);
-			if (pmic_data)
-				free(pmic_data);
-			if (model)
-				free(model);
-			return false;
-		}
-
-		dt_entry_array = (struct dt_entry*) malloc(sizeof(struct dt_entry) * num_entries);
-		ASSERT(dt_entry_array);
-
-		/* If we have '<X>; <Y>; <Z>' as platform data & '<A>; <B>; <C>' as board data.
-		 * Then dt entry should look like
-		 * <X ,A >;<X, B>;<X, C>;
-		 * <Y ,A >;<Y, B>;<Y, C>;
-		 * <Z ,A >;<Z, B>;<Z, C>;
-		 */
-		i = 0;
-		k = 0;
-		n = 0;
-		for (i = 0; i < msm_data_count; i++) {
-			for (j = 0; j < board_data_count; j++) {
-				if (dtb_ver == DEV_TREE_VERSION_V3 && pmic_prop) {
-					for (n = 0; n < pmic_data_count; n++) {
-						dt_entry_array[k].platform_id = platform_data[i].platform_id;
-						dt_entry_array[k].soc_rev = platform_data[i].soc_rev;
-						dt_entry_array[k].variant_id = board_data[j].variant_id;
-						dt_entry_array[k].board_hw_subtype = board_data[j].platform_subtype;
-						dt_entry_array[k].pmic_rev[0]= pmic_data[n].pmic_version[0];
-						dt_entry_array[k].pmic_rev[1]= pmic_data[n].pmic_version[1];
-						dt_entry_array[k].pmic_rev[2]= pmic_data[n].pmic_version[2];
-						dt_entry_array[k].pmic_rev[3]= pmic_data[n].pmic_version[3];
-						dt_entry_array[k].offset = (uint32_t)dtb;
-						dt_entry_array[k].size = dtb_size;
-						k++;
-					}
-
+			if (cur_dt_entry.board_hw_subtype == 0)
+				cur_dt_entry.board_hw_subtype = cur_dt_entry.variant_id >> 0x18;
+
+			for (n = 0; n < pmic_data_count; n++) {
+				if (dtb_ver == DEV_TREE_VERSION_V3) {
+					pmic = (const struct pmic_id *)pmic_prop + n;
+					cur_dt_entry.pmic_rev[0] = fdt32_to_cpu(pmic->pmic_version[0]);
+					cur_dt_entry.pmic_rev[1] = fdt32_to_cpu(pmic->pmic_version[1]);
+					cur_dt_entry.pmic_rev[2] = fdt32_to_cpu(pmic->pmic_version[2]);
+					cur_dt_entry.pmic_rev[3] = fdt32_to_cpu(pmic->pmic_version[3]);
 				} else {
-					dt_entry_array[k].platform_id = platform_data[i].platform_id;
-					dt_entry_array[k].soc_rev = platform_data[i].soc_rev;
-					dt_entry_array[k].variant_id = board_data[j].variant_id;
-					dt_entry_array[k].board_hw_subtype = board_data[j].platform_subtype;
-					dt_entry_array[k].pmic_rev[0]= board_pmic_target(0);
-					dt_entry_array[k].pmic_rev[1]= board_pmic_target(1);
-					dt_entry_array[k].pmic_rev[2]= board_pmic_target(2);
-					dt_entry_array[k].pmic_rev[3]= board_pmic_target(3);
-					dt_entry_array[k].offset = (uint32_t)dtb;
-					dt_entry_array[k].size = dtb_size;
-					k++;
+					memcpy(cur_dt_entry.pmic_rev, match->pmic, sizeof(cur_dt_entry.pmic_rev));
 				}
-			}
-		}
 
-		for (i=0 ;i < num_entries; i++) {
-			dprintf(SPEW, "Found an appended flattened device tree (%s - %u %u %u 0x%x)\n",
-				*model ? model : "unknown",
-				dt_entry_array[i].platform_id, dt_entry_array[i].variant_id, dt_entry_array[i].board_hw_subtype, dt_entry_array[i].soc_rev);
-
-			if (platform_dt_absolute_match(&(dt_entry_array[i]), dtb_list)) {
-				dprintf(SPEW, "Device tree exact match the board: <%u %u %u 0x%x> == <%u %u %u 0x%x>\n",
-					dt_entry_array[i].platform_id,
-					dt_entry_array[i].variant_id,
-					dt_entry_array[i].soc_rev,
-					dt_entry_array[i].board_hw_subtype,
-					board_platform_id(),
-					board_hardware_id(),
-					board_hardware_subtype(),
-					board_soc_version());
-
-			} else {
-				dprintf(SPEW, "Device tree's msm_id doesn't match the board: <%u %u %u 0x%x> != <%u %u %u 0x%x>\n",
-					dt_entry_array[i].platform_id,
-					dt_entry_array[i].variant_id,
-					dt_entry_array[i].soc_rev,
-					dt_entry_array[i].board_hw_subtype,
-					board_platform_id(),
-					board_hardware_id(),
-					board_hardware_subtype(),
-					board_soc_version());
+				dprintf(SPEW, "Found an appended flattened device tree (%s - %u %u %u 0x%x)\n",
+					model, cur_dt_entry.platform_id, cur_dt_entry.variant_id,
+					cur_dt_entry.board_hw_subtype, cur_dt_entry.soc_rev);
+
+				dt_match_consider(match, &cur_dt_entry);
 			}
 		}
-
-		free(board_data);
-		free(platform_data);
-		if (pmic_data)
-			free(pmic_data);
-		free(dt_entry_array);
 	}
-	if (model)
-		free(model);
+
 	return true;
 }
 
@@ -422,20 +415,9 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 	void *bestmatch_tag = NULL;
 	struct dt_entry *best_match_dt_entry = NULL;
 	uint32_t bestmatch_tag_size;
-	struct dt_entry_node *dt_entry_queue = NULL;
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-	struct dt_entry_node *dt_node_tmp2 = NULL;
-
+	struct dt_match match;
 
-	/* Initialize the dtb entry node*/
-	dt_entry_queue = (struct dt_entry_node *)
-				malloc(sizeof(struct dt_entry_node));
-
-	if (!dt_entry_queue) {
-		dprintf(CRITICAL, "Out of memory\n");
-		return NULL;
-	}
-	list_initialize(&dt_entry_queue->node);
+	dt_match_init(&match);
 
 	if (dtb_offset)
 		app_dtb_offset = dtb_offset;
@@ -464,13 +446,14 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 			return NULL;
 		}
 
-		dev_tree_compatible(dtb, dtb_size, dt_entry_queue);
+		dev_tree_compatible(dtb, dtb_size, &match);
 
 		/* goto the next device tree if any */
 		dtb += dtb_size;
 	}
 
-	best_match_dt_entry = platform_dt_match_best(dt_entry_queue);
+	/* only the DTB that won is touched again */
+	best_match_dt_entry = dt_match_best(&match);
 	if (best_match_dt_entry){
 		bestmatch_tag = (void *)best_match_dt_entry->offset;
 		bestmatch_tag_size = best_match_dt_entry->size;
@@ -486,13 +469,6 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 			board_pmic_target(0), board_pmic_target(1),
 			board_pmic_target(2), board_pmic_target(3));
 	}
-	/* free queue's memory */
-	list_for_every_entry(&dt_entry_queue->node, dt_node_tmp1, dt_node, node) {
-		dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-		dt_entry_list_delete(dt_node_tmp1);
-		dt_node_tmp1 = dt_node_tmp2;
-	}
-
 	if(bestmatch_tag) {
 		memcpy(tags, bestmatch_tag, bestmatch_tag_size);
 		/* clear out the old DTB magic so kernel doesn't find it */
@@ -547,359 +523,6 @@ int dev_tree_validate(struct dt_table *table, unsigned int page_size, uint32_t *
 	return 0;
 }
 
-static int platform_dt_absolute_match(struct dt_entry *cur_dt_entry, struct dt_entry_node *dt_list)
-{
-	uint32_t cur_dt_hlos_ddr;
-	uint32_t cur_dt_hw_platform;
-	uint32_t cur_dt_hw_subtype;
-	uint32_t cur_dt_msm_id;
-	dt_node *dt_node_tmp = NULL;
-
-	/* Platform-id
-	* bit no |31	 24|23	16|15	0|
-	*        |reserved|foundry-id|msm-id|
-	*/
-	cur_dt_msm_id = (cur_dt_entry->platform_id & 0x0000ffff);
-	cur_dt_hw_platform = (cur_dt_entry->variant_id & 0x000000ff);
-	cur_dt_hw_subtype = (cur_dt_entry->board_hw_subtype & 0xff);
-
-	/* Determine the bits 10:8 to check the DT with the DDR Size */
-	cur_dt_hlos_ddr = (cur_dt_entry->board_hw_subtype & 0x700);
-
-	/* 1. must match the msm_id, platform_hw_id, platform_subtype and DDR size
-	*  soc, board major/minor, pmic major/minor must less than board info
-	*  2. find the matched DTB then return 1
-	*  3. otherwise return 0
-	*/
-	if((cur_dt_msm_id == (board_platform_id() & 0x0000ffff)) &&
-		(cur_dt_hw_platform == board_hardware_id()) &&
-		(cur_dt_hw_subtype == board_hardware_subtype()) &&
-		(cur_dt_hlos_ddr == (target_get_hlos_subtype() & 0x700)) &&
-		(cur_dt_entry->soc_rev <= board_soc_version()) &&
-		((cur_dt_entry->variant_id & 0x00ffff00) <= (board_target_id() & 0x00ffff00)) &&
-		((cur_dt_entry->pmic_rev[0] & 0x00ffff00) <= (board_pmic_target(0) & 0x00ffff00)) &&
-		((cur_dt_entry->pmic_rev[1] & 0x00ffff00) <= (board_pmic_target(1) & 0x00ffff00)) &&
-		((cur_dt_entry->pmic_rev[2] & 0x00ffff00) <= (board_pmic_target(2) & 0x00ffff00)) &&
-		((cur_dt_entry->pmic_rev[3] & 0x00ffff00) <= (board_pmic_target(3) & 0x00ffff00))) {
-
-		dt_node_tmp = dt_entry_list_init();
-		memcpy((char*)dt_node_tmp->dt_entry_m,(char*)cur_dt_entry, sizeof(struct dt_entry));
-
-		dprintf(SPEW, "Add DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
-			dt_node_tmp->dt_entry_m->platform_id, dt_node_tmp->dt_entry_m->variant_id,
-			dt_node_tmp->dt_entry_m->board_hw_subtype, dt_node_tmp->dt_entry_m->soc_rev,
-			dt_node_tmp->dt_entry_m->pmic_rev[0], dt_node_tmp->dt_entry_m->pmic_rev[1],
-			dt_node_tmp->dt_entry_m->pmic_rev[2], dt_node_tmp->dt_entry_m->pmic_rev[3],
-			dt_node_tmp->dt_entry_m->offset, dt_node_tmp->dt_entry_m->size);
-
-		insert_dt_entry_in_queue(dt_list, dt_node_tmp);
-		return 1;
-	}
-	return 0;
-}
-
-static int platform_dt_absolute_compat_match(struct dt_entry_node *dt_list, uint32_t dtb_info) {
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-	struct dt_entry_node *dt_node_tmp2 = NULL;
-	uint32_t current_info = 0;
-	uint32_t board_info = 0;
-	uint32_t best_info = 0;
-	uint32_t current_pmic_model[4] = {0, 0, 0, 0};
-	uint32_t board_pmic_model[4] = {0, 0, 0, 0};
-	uint32_t best_pmic_model[4] = {0, 0, 0, 0};
-	uint32_t delete_current_dt = 0;
-	uint32_t i;
-
-	/* start to select the exact entry
-	* default to exact match 0, if find current DTB entry info is the same as board info,
-	* then exact match board info.
-	*/
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1){
-			dprintf(SPEW, "Current node is the end\n");
-			break;
-		}
-		switch(dtb_info) {
-		case DTB_FOUNDRY:
-			current_info = ((dt_node_tmp1->dt_entry_m->platform_id) & 0x00ff0000);
-			board_info = board_foundry_id() << 16;
-			break;
-		case DTB_PMIC_MODEL:
-			for (i = 0; i < 4; i++) {
-				current_pmic_model[i] = (dt_node_tmp1->dt_entry_m->pmic_rev[i] & 0xff);
-				board_pmic_model[i] = (board_pmic_target(i) & 0xff);
-			}
-			break;
-		case DTB_PANEL_TYPE:
-			current_info = ((dt_node_tmp1->dt_entry_m->board_hw_subtype) & 0x1800);
-			board_info = (target_get_hlos_subtype() & 0x1800);
-			break;
-		case DTB_BOOT_DEVICE:
-			current_info = ((dt_node_tmp1->dt_entry_m->board_hw_subtype) & 0xf0000);
-			board_info = (target_get_hlos_subtype() & 0xf0000);
-			break;
-		default:
-			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
-					dtb_info);
-			return 0;
-		}
-
-		if (dtb_info == DTB_PMIC_MODEL) {
-			if ((current_pmic_model[0] == board_pmic_model[0]) &&
-				(current_pmic_model[1] == board_pmic_model[1]) &&
-				(current_pmic_model[2] == board_pmic_model[2]) &&
-				(current_pmic_model[3] == board_pmic_model[3])) {
-
-				for (i = 0; i < 4; i++) {
-					best_pmic_model[i] = current_pmic_model[i];
-				}
-				break;
-			}
-		} else {
-			if (current_info == board_info) {
-				best_info = current_info;
-				break;
-			}
-		}
-	}
-
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1){
-			dprintf(SPEW, "Current node is the end\n");
-			break;
-		}
-		switch(dtb_info) {
-		case DTB_FOUNDRY:
-			current_info = ((dt_node_tmp1->dt_entry_m->platform_id) & 0x00ff0000);
-			break;
-		case DTB_PMIC_MODEL:
-			for (i = 0; i < 4; i++) {
-				current_pmic_model[i] = (dt_node_tmp1->dt_entry_m->pmic_rev[i] & 0xff);
-			}
-			break;
-		case DTB_PANEL_TYPE:
-			current_info = ((dt_node_tmp1->dt_entry_m->board_hw_subtype) & 0x1800);
-			break;
-		case DTB_BOOT_DEVICE:
-			current_info = ((dt_node_tmp1->dt_entry_m->board_hw_subtype) & 0xf0000);
-			break;
-		default:
-			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
-					dtb_info);
-			return 0;
-		}
-
-		if (dtb_info == DTB_PMIC_MODEL) {
-			if ((current_pmic_model[0] != best_pmic_model[0]) ||
-				(current_pmic_model[1] != best_pmic_model[1]) ||
-				(current_pmic_model[2] != best_pmic_model[2]) ||
-				(current_pmic_model[3] != best_pmic_model[3])) {
-
-				delete_current_dt = 1;
-			}
-		} else {
-			if (current_info != best_info) {
-				delete_current_dt = 1;
-			}
-		}
-
-		if (delete_current_dt) {
-			dprintf(SPEW, "Delete don't fit DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
-				dt_node_tmp1->dt_entry_m->platform_id, dt_node_tmp1->dt_entry_m->variant_id,
-				dt_node_tmp1->dt_entry_m->board_hw_subtype, dt_node_tmp1->dt_entry_m->soc_rev,
-				dt_node_tmp1->dt_entry_m->pmic_rev[0], dt_node_tmp1->dt_entry_m->pmic_rev[1],
-				dt_node_tmp1->dt_entry_m->pmic_rev[2], dt_node_tmp1->dt_entry_m->pmic_rev[3],
-				dt_node_tmp1->dt_entry_m->offset, dt_node_tmp1->dt_entry_m->size);
-
-			dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-			dt_entry_list_delete(dt_node_tmp1);
-			dt_node_tmp1 = dt_node_tmp2;
-			delete_current_dt = 0;
-		}
-	}
-
-	return 1;
-}
-
-static int update_dtb_entry_node(struct dt_entry_node *dt_list, uint32_t dtb_info) {
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-	struct dt_entry_node *dt_node_tmp2 = NULL;
-	uint32_t current_info = 0;
-	uint32_t board_info = 0;
-	uint32_t best_info = 0;
-
-	/* start to select the best entry*/
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1){
-			dprintf(SPEW, "Current node is the end\n");
-			break;
-		}
-		switch(dtb_info) {
-		case DTB_SOC:
-			current_info = dt_node_tmp1->dt_entry_m->soc_rev;
-			board_info = board_soc_version();
-			break;
-		case DTB_MAJOR_MINOR:
-			current_info = ((dt_node_tmp1->dt_entry_m->variant_id) & 0x00ffff00);
-			board_info = (board_target_id() & 0x00ffff00);
-			break;
-		case DTB_PMIC0:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[0]) & 0x00ffff00);
-			board_info = (board_pmic_target(0) & 0x00ffff00);
-			break;
-		case DTB_PMIC1:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[1]) & 0x00ffff00);
-			board_info = (board_pmic_target(1) & 0x00ffff00);
-			break;
-		case DTB_PMIC2:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[2]) & 0x00ffff00);
-			board_info = (board_pmic_target(2) & 0x00ffff00);
-			break;
-		case DTB_PMIC3:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[3]) & 0x00ffff00);
-			board_info = (board_pmic_target(3) & 0x00ffff00);
-			break;
-		default:
-			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
-					dtb_info);
-			return 0;
-		}
-
-		if (current_info == board_info) {
-			best_info = current_info;
-			break;
-		}
-		if ((current_info < board_info) && (current_info > best_info)) {
-			best_info = current_info;
-		}
-		if (current_info < best_info) {
-			dprintf(SPEW, "Delete don't fit DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
-				dt_node_tmp1->dt_entry_m->platform_id, dt_node_tmp1->dt_entry_m->variant_id,
-				dt_node_tmp1->dt_entry_m->board_hw_subtype, dt_node_tmp1->dt_entry_m->soc_rev,
-				dt_node_tmp1->dt_entry_m->pmic_rev[0], dt_node_tmp1->dt_entry_m->pmic_rev[1],
-				dt_node_tmp1->dt_entry_m->pmic_rev[2], dt_node_tmp1->dt_entry_m->pmic_rev[3],
-				dt_node_tmp1->dt_entry_m->offset, dt_node_tmp1->dt_entry_m->size);
-
-			dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-			dt_entry_list_delete(dt_node_tmp1);
-			dt_node_tmp1 = dt_node_tmp2;
-		}
-	}
-
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1){
-			dprintf(SPEW, "Current node is the end\n");
-			break;
-		}
-		switch(dtb_info) {
-		case DTB_SOC:
-			current_info = dt_node_tmp1->dt_entry_m->soc_rev;
-			break;
-		case DTB_MAJOR_MINOR:
-			current_info = ((dt_node_tmp1->dt_entry_m->variant_id) & 0x00ffff00);
-			break;
-		case DTB_PMIC0:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[0]) & 0x00ffff00);
-			break;
-		case DTB_PMIC1:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[1]) & 0x00ffff00);
-			break;
-		case DTB_PMIC2:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[2]) & 0x00ffff00);
-			break;
-		case DTB_PMIC3:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[3]) & 0x00ffff00);
-			break;
-		default:
-			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
-					dtb_info);
-			return 0;
-		}
-
-		if (current_info != best_info) {
-			dprintf(SPEW, "Delete don't fit DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
-				dt_node_tmp1->dt_entry_m->platform_id, dt_node_tmp1->dt_entry_m->variant_id,
-				dt_node_tmp1->dt_entry_m->board_hw_subtype, dt_node_tmp1->dt_entry_m->soc_rev,
-				dt_node_tmp1->dt_entry_m->pmic_rev[0], dt_node_tmp1->dt_entry_m->pmic_rev[1],
-				dt_node_tmp1->dt_entry_m->pmic_rev[2], dt_node_tmp1->dt_entry_m->pmic_rev[3],
-				dt_node_tmp1->dt_entry_m->offset, dt_node_tmp1->dt_entry_m->size);
-
-			dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-			dt_entry_list_delete(dt_node_tmp1);
-			dt_node_tmp1 = dt_node_tmp2;
-		}
-	}
-	return 1;
-}
-
-static struct dt_entry *platform_dt_match_best(struct dt_entry_node *dt_list)
-{
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-
-	/* check Foundry id
-	* the foundry id must exact match board founddry id, this is compatibility check,
-	* if couldn't find the exact match from DTB, will exact match 0x0.
-	*/
-	if (!platform_dt_absolute_compat_match(dt_list, DTB_FOUNDRY))
-		return NULL;
-
-	/* check PMIC model
-	* the PMIC model must exact match board PMIC model, this is compatibility check,
-	* if couldn't find the exact match from DTB, will exact match 0x0.
-	*/
-	if (!platform_dt_absolute_compat_match(dt_list, DTB_PMIC_MODEL))
-		return NULL;
-
-	/* check panel type
-	* the panel  type must exact match board panel type, this is compatibility check,
-	* if couldn't find the exact match from DTB, will exact match 0x0.
-	*/
-	if (!platform_dt_absolute_compat_match(dt_list, DTB_PANEL_TYPE))
-		return NULL;
-
-	/* check boot device subtype
-	* the boot device subtype must exact match board boot device subtype, this is compatibility check,
-	* if couldn't find the exact match from DTB, will exact match 0x0.
-	*/
-	if (!platform_dt_absolute_compat_match(dt_list, DTB_BOOT_DEVICE))
-		return NULL;
-
-	/* check soc version
-	* the suitable soc version must less than or equal to board soc version
-	*/
-	if (!update_dtb_entry_node(dt_list, DTB_SOC))
-		return NULL;
-
-	/*check major and minor version
-	* the suitable major&minor version must less than or equal to board major&minor version
-	*/
-	if (!update_dtb_entry_node(dt_list, DTB_MAJOR_MINOR))
-		return NULL;
-
-	/*check pmic info
-	* the suitable pmic major&minor info must less than or equal to board pmic major&minor version
-	*/
-	if (!update_dtb_entry_node(dt_list, DTB_PMIC0))
-		return NULL;
-	if (!update_dtb_entry_node(dt_list, DTB_PMIC1))
-		return NULL;
-	if (!update_dtb_entry_node(dt_list, DTB_PMIC2))
-		return NULL;
-	if (!update_dtb_entry_node(dt_list, DTB_PMIC3))
-		return NULL;
-
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1) {
-			dprintf(CRITICAL, "ERROR: Couldn't find the suitable DTB!\n");
-			return NULL;
-		}
-		if (dt_node_tmp1->dt_entry_m)
-			return dt_node_tmp1->dt_entry_m;
-	}
-
-	return NULL;
-}
-
 /* Function to obtain the index information for the correct device tree
  *  based on the platform data.
  *  If a matching device tree is found, the information is returned in the
@@ -915,10 +538,9 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 	struct dt_entry *best_match_dt_entry = NULL;
 	struct dt_entry_v1 *dt_entry_v1 = NULL;
 	struct dt_entry_v2 *dt_entry_v2 = NULL;
-	struct dt_entry_node *dt_entry_queue = NULL;
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-	struct dt_entry_node *dt_node_tmp2 = NULL;
+	struct dt_match match;
 	uint32_t found = 0;
+	int span;
 
 	if (!dt_entry_info) {
 		dprintf(CRITICAL, "ERROR: Bad parameter passed to %s \n",
@@ -929,16 +551,10 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 	table_ptr = (unsigned char *)table + DEV_TREE_HEADER_SIZE;
 	cur_dt_entry = &dt_entry_buf_1;
 	best_match_dt_entry = NULL;
-	dt_entry_queue = (struct dt_entry_node *)
-				malloc(sizeof(struct dt_entry_node));
-
-	if (!dt_entry_queue) {
-		dprintf(CRITICAL, "Out of memory\n");
-		return -1;
-	}
+	dt_match_init(&match);
 
-	list_initialize(&dt_entry_queue->node);
 	dprintf(INFO, "DTB Total entry: %d, DTB version: %d\n", table->num_entries, table->version);
+	span = bs_profile_begin("dtb-select");
 	for(i = 0; found == 0 && i < table->num_entries; i++)
 	{
 		memset(cur_dt_entry, 0, sizeof(struct dt_entry));
@@ -949,10 +565,7 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 			cur_dt_entry->variant_id = dt_entry_v1->variant_id;
 			cur_dt_entry->soc_rev = dt_entry_v1->soc_rev;
 			cur_dt_entry->board_hw_subtype = (dt_entry_v1->variant_id >> 0x18);
-			cur_dt_entry->pmic_rev[0] = board_pmic_target(0);
-			cur_dt_entry->pmic_rev[1] = board_pmic_target(1);
-			cur_dt_entry->pmic_rev[2] = board_pmic_target(2);
-			cur_dt_entry->pmic_rev[3] = board_pmic_target(3);
+			memcpy(cur_dt_entry->pmic_rev, match.pmic, sizeof(cur_dt_entry->pmic_rev));
 			cur_dt_entry->offset = dt_entry_v1->offset;
 			cur_dt_entry->size = dt_entry_v1->size;
 			table_ptr += sizeof(struct dt_entry_v1);
@@ -976,10 +589,7 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 				cur_dt_entry->board_hw_subtype = (cur_dt_entry->variant_id >> 0x18);
 			else
 				cur_dt_entry->board_hw_subtype = dt_entry_v2->board_hw_subtype;
-			cur_dt_entry->pmic_rev[0] = board_pmic_target(0);
-			cur_dt_entry->pmic_rev[1] = board_pmic_target(1);
-			cur_dt_entry->pmic_rev[2] = board_pmic_target(2);
-			cur_dt_entry->pmic_rev[3] = board_pmic_target(3);
+			memcpy(cur_dt_entry->pmic_rev, match.pmic, sizeof(cur_dt_entry->pmic_rev));
 			cur_dt_entry->offset = dt_entry_v2->offset;
 			cur_dt_entry->size = dt_entry_v2->size;
 			table_ptr += sizeof(struct dt_entry_v2);
@@ -1005,21 +615,22 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 		default:
 			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in DT table \n",
 					table->version);
-			free(dt_entry_queue);
+			bs_profile_end(span);
 			return -1;
 		}
 
 		/* DTBs must match the platform_id, platform_hw_id, platform_subtype and DDR size.
-		* The satisfactory DTBs are stored in dt_entry_queue
+		* Only the best of the satisfactory DTBs is remembered
 		*/
-		platform_dt_absolute_match(cur_dt_entry, dt_entry_queue);
+		dt_match_consider(&match, cur_dt_entry);
 
 	}
-	best_match_dt_entry = platform_dt_match_best(dt_entry_queue);
+	best_match_dt_entry = dt_match_best(&match);
 	if (best_match_dt_entry) {
 		*dt_entry_info = *best_match_dt_entry;
 		found = 1;
 	}
+	bs_profile_end(span);
 
 	if (found != 0) {
 		dprintf(INFO, "Using DTB entry 0x%08x/%08x/0x%08x/%u for device 0x%08x/%08x/0x%08x/%u\n",
@@ -1046,16 +657,26 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 			board_platform_id(), board_soc_version(),
 			board_target_id(), board_hardware_subtype());
 
-	list_for_every_entry(&dt_entry_queue->node, dt_node_tmp1, dt_node, node) {
-		/* free node memory */
-		dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-		dt_entry_list_delete(dt_node_tmp1);
-		dt_node_tmp1 = dt_node_tmp2;
-	}
-	free(dt_entry_queue);
 	return -1;
 }
 
+/* Queue one address or size of cell_size words for the memory node reg. */
+static int dev_tree_mem_reg_add(uint64_t val, uint32_t cell_size)
+{
+	if (mem_node.reg_cells + cell_size > DTB_MEM_REG_MAX_CELLS)
+	{
+		dprintf(CRITICAL, "ERROR: Too many RAM partitions for the memory node\n");
+		return -FDT_ERR_NOSPACE;
+	}
+
+	if (cell_size == 2)
+		mem_node.reg[mem_node.reg_cells++] = cpu_to_fdt32(val >> 32);
+
+	mem_node.reg[mem_node.reg_cells++] = cpu_to_fdt32((uint32_t)val);
+
+	return 0;
+}
+
 /* Function to add the first RAM partition info to the device tree.
  * Note: The function replaces the reg property in the "/memory" node
  * with the addr and size provided.
@@ -1064,19 +685,17 @@ int dev_tree_add_first_mem_info(uint32_t *fdt, uint32_t offset, uint32_t addr, u
 {
 	int ret;
 
-	ret = fdt_setprop_u32(fdt, offset, "reg", addr);
-
-	if (ret)
-	{
-		dprintf(CRITICAL, "Failed to add the memory information addr: %d\n",
-				ret);
-	}
+	mem_node.offset = offset;
+	mem_node.reg_cells = 0;
+	mem_node.mem_info_cnt = 1;
 
-	ret = fdt_appendprop_u32(fdt, offset, "reg", size);
+	ret = dev_tree_mem_reg_add(addr, 1);
+	if (!ret)
+		ret = dev_tree_mem_reg_add(size, 1);
 
 	if (ret)
 	{
-		dprintf(CRITICAL, "Failed to add the memory information size: %d\n",
+		dprintf(CRITICAL, "Failed to add the memory information: %d\n",
 				ret);
 	}
 
@@ -1177,73 +796,20 @@ int dev_tree_add_mem_info(void *fdt, uint32_t offset, uint64_t addr, uint64_t si
 	if (!(mem_node.mem_info_cnt))
 	{
 		/* Replace any other reg prop in the memory node. */
-
-		/* cell_size is the number of 32 bit words used to represent an address/length in the device tree.
-		 * memory node in DT can be either 32-bit(cell-size = 1) or 64-bit(cell-size = 2).So when updating
-		 * the memory node in the device tree, we write one word or two words based on cell_size = 1 or 2.
-		 */
-
-		if(mem_node.addr_cell_size == 2)
-		{
-			ret = fdt_setprop_u32(fdt, mem_node.offset, "reg", addr >> 32);
-			if(ret)
-			{
-				dprintf(CRITICAL, "ERROR: Could not set prop reg for memory node\n");
-				return ret;
-			}
-
-			ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", (uint32_t)addr);
-			if(ret)
-			{
-				dprintf(CRITICAL, "ERROR: Could not append prop reg for memory node\n");
-				return ret;
-			}
-		}
-		else
-		{
-			ret = fdt_setprop_u32(fdt, mem_node.offset, "reg", (uint32_t)addr);
-			if(ret)
-			{
-				dprintf(CRITICAL, "ERROR: Could not set prop reg for memory node\n");
-				return ret;
-			}
-		}
-
+		mem_node.reg_cells = 0;
 		mem_node.mem_info_cnt = 1;
 	}
-	else
-	{
-		/* Append the mem info to the reg prop for subsequent nodes.  */
-		if(mem_node.addr_cell_size == 2)
-		{
-			ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", addr >> 32);
-			if(ret)
-			{
-				dprintf(CRITICAL, "ERROR: Could not append prop reg for memory node\n");
-				return ret;
-			}
-		}
-
-		ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", (uint32_t)addr);
-		if(ret)
-		{
-			dprintf(CRITICAL, "ERROR: Could not append prop reg for memory node\n");
-			return ret;
-		}
-	}
-
-	if(mem_node.size_cell_size == 2)
-	{
-		ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", size>>32);
-		if(ret)
-		{
-			dprintf(CRITICAL, "ERROR: Could not append prop reg for memory node\n");
-			return ret;
-		}
-	}
 
-	ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", (uint32_t)size);
+	/* cell_size is the number of 32 bit words used to represent an address/length in the device tree.
+	 * memory node in DT can be either 32-bit(cell-size = 1) or 64-bit(cell-size = 2).So when updating
+	 * the memory node in the device tree, we write one word or two words based on cell_size = 1 or 2.
+	 * The reg property is only written to the device tree once all the partitions are in.
+	 */
+	ret = dev_tree_mem_reg_add(addr, mem_node.addr_cell_size);
+	if (ret)
+		return ret;
 
+	ret = dev_tree_mem_reg_add(size, mem_node.size_cell_size);
 	if (ret)
 	{
 		dprintf(CRITICAL, "Failed to add the memory information size: %d\n",
@@ -1254,12 +820,22 @@ int dev_tree_add_mem_info(void *fdt, uint32_t offset, uint64_t addr, uint64_t si
 	return ret;
 }
 
-/* Top level function that updates the device tree. */
+/* Top level function that updates the device tree.
+ * All the changes are queued up and written to the device tree in one go,
+ * so that it is only moved around once however many there are.
+ */
 int update_device_tree(void *fdt, const char *cmdline,
 					   void *ramdisk, uint32_t ramdisk_size)
 {
 	int ret = 0;
 	uint32_t offset;
+	struct fdt_batch batch;
+	uint32_t initrd_start;
+	uint32_t initrd_end;
+	uint32_t bufsize;
+	int edits, nodes;
+	int log_edits, log_nodes;
+	int span;
 
 	/* Check the device tree header */
 	ret = fdt_check_header(fdt);
@@ -1269,13 +845,9 @@ int update_device_tree(void *fdt, const char *cmdline,
 		return ret;
 	}
 
-	/* Add padding to make space for new nodes and properties. */
-	ret = fdt_open_into(fdt, fdt, fdt_totalsize(fdt) + DTB_PAD_SIZE);
-	if (ret!= 0)
-	{
-		dprintf(CRITICAL, "Failed to move/resize dtb buffer: %d\n", ret);
-		return ret;
-	}
+	span = bs_profile_begin("dt-update");
+	bufsize = fdt_totalsize(fdt) + DTB_PAD_SIZE;
+	fdt_batch_init(&batch);
 
 	/* Get offset of the memory node */
 	ret = fdt_path_offset(fdt, "/memory");
@@ -1287,6 +859,9 @@ int update_device_tree(void *fdt, const char *cmdline,
 
 	offset = ret;
 
+	mem_node.mem_info_cnt = 0;
+	mem_node.reg_cells = 0;
+
 	ret = target_dev_tree_mem(fdt, offset);
 	if(ret)
 	{
@@ -1294,6 +869,17 @@ int update_device_tree(void *fdt, const char *cmdline,
 		return ret;
 	}
 
+	if (mem_node.reg_cells)
+	{
+		ret = fdt_batch_setprop(&batch, mem_node.offset, "reg", mem_node.reg,
+					mem_node.reg_cells * sizeof(uint32_t));
+		if (ret)
+		{
+			dprintf(CRITICAL, "ERROR: Could not set prop reg for memory node\n");
+			return ret;
+		}
+	}
+
 	/* Get offset of the chosen node */
 	ret = fdt_path_offset(fdt, "/chosen");
 	if (ret < 0)
@@ -1306,7 +892,7 @@ int update_device_tree(void *fdt, const char *cmdline,
 	if (cmdline)
 	{
 		/* Adding the cmdline to the chosen node */
-		ret = fdt_appendprop_string(fdt, offset, (const char*)"bootargs", (const void*)cmdline);
+		ret = fdt_batch_appendprop(&batch, offset, "bootargs", cmdline, strlen(cmdline) + 1);
 		if (ret)
 		{
 			dprintf(CRITICAL, "ERROR: Cannot update chosen node [bootargs]\n");
@@ -1315,9 +901,12 @@ int update_device_tree(void *fdt, const char *cmdline,
 	}
 
 	if (ramdisk_size) {
+		initrd_start = cpu_to_fdt32((uint32_t)ramdisk);
+		initrd_end = cpu_to_fdt32((uint32_t)ramdisk + ramdisk_size);
+
 		/* Adding the initrd-start to the chosen node */
-		ret = fdt_setprop_u32(fdt, offset, "linux,initrd-start",
-				      (uint32_t)ramdisk);
+		ret = fdt_batch_setprop(&batch, offset, "linux,initrd-start",
+					&initrd_start, sizeof(initrd_start));
 		if (ret)
 		{
 			dprintf(CRITICAL, "ERROR: Cannot update chosen node [linux,initrd-start]\n");
@@ -1325,8 +914,8 @@ int update_device_tree(void *fdt, const char *cmdline,
 		}
 
 		/* Adding the initrd-end to the chosen node */
-		ret = fdt_setprop_u32(fdt, offset, "linux,initrd-end",
-				      ((uint32_t)ramdisk + ramdisk_size));
+		ret = fdt_batch_setprop(&batch, offset, "linux,initrd-end",
+					&initrd_end, sizeof(initrd_end));
 		if (ret)
 		{
 			dprintf(CRITICAL, "ERROR: Cannot update chosen node [linux,initrd-end]\n");
@@ -1334,7 +923,47 @@ int update_device_tree(void *fdt, const char *cmdline,
 		}
 	}
 
-	fdt_pack(fdt);
+	/* The profile is taken now, so the commit is not in it */
+	bs_profile_end(span);
+
+	/* The profile and the log are nice to have, booting goes on without
+	 * them: they are queued last, and taken off the batch again if they
+	 * cannot be added.
+	 */
+	edits = batch.count;
+	nodes = batch.nodes;
+
+	if (bs_profile_update_dt(fdt, &batch))
+	{
+		dprintf(CRITICAL, "ERROR: Cannot add the boot profile to the device tree\n");
+		batch.count = edits;
+		batch.nodes = nodes;
+	}
+
+	log_edits = batch.count;
+	log_nodes = batch.nodes;
+
+	if (debug_log_update_dt(fdt, &batch))
+	{
+		dprintf(CRITICAL, "ERROR: Cannot add the log buffer to the device tree\n");
+		batch.count = log_edits;
+		batch.nodes = log_nodes;
+	}
+
+	/* The device tree may grow into the padding after it. */
+	ret = fdt_batch_commit(fdt, bufsize, &batch);
+	if (ret == -FDT_ERR_NOSPACE && (batch.count != edits || batch.nodes != nodes))
+	{
+		dprintf(CRITICAL, "ERROR: No room for the boot profile and log in the device tree\n");
+		batch.count = edits;
+		batch.nodes = nodes;
+		ret = fdt_batch_commit(fdt, bufsize, &batch);
+	}
+	if (ret)
+	{
+		dprintf(CRITICAL, "ERROR: Cannot update device tree: %d\n", ret);
+		return ret;
+	}
 
 #if ENABLE_PARTIAL_GOODS_SUPPORT
 	update_partial_goods_dtb_nodes(fdt);
@@ -1342,4 +971,3 @@ int update_device_tree(void *fdt, const char *cmdline,
 
 	return ret;
 }
-
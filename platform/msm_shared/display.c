@@ -34,6 +34,7 @@
 #include <boot_stats.h>
 #include <platform.h>
 #include <malloc.h>
+#include <stdlib.h>
 #include <qpic.h>
 #include <target.h>
 #ifdef DISPLAY_TYPE_MDSS
@@ -49,9 +50,10 @@ static int msm_fb_alloc(struct fbcon_config *fb)
 	if (fb == NULL)
 		return ERROR;
 
+	/* room for vheight lines lets fbcon scroll by panning */
 	if (fb->base == NULL)
 		fb->base = memalign(4096, fb->width
-							* fb->height
+							* MAX(fb->height, fb->vheight)
 							* (fb->bpp / 8));
 
 	if (fb->base == NULL)
@@ -60,6 +62,20 @@ static int msm_fb_alloc(struct fbcon_config *fb)
 	return NO_ERROR;
 }
 
+#ifdef DISPLAY_TYPE_MDSS
+static int msm_display_update_rows(unsigned start, unsigned end)
+{
+	return mdp_dsi_cmd_update_rows(&(panel->panel_info), &(panel->fb),
+					start, end);
+}
+
+static void msm_display_pan(void *base)
+{
+	if (mdp_set_scanout(&(panel->panel_info), &(panel->fb), base))
+		dprintf(CRITICAL, "Failed to move the scanout to %p\n", base);
+}
+#endif
+
 int msm_display_config()
 {
 	int ret = NO_ERROR;
@@ -269,6 +285,7 @@ msm_display_on_out:
 int msm_display_init(struct msm_fb_panel_data *pdata)
 {
 	int ret = NO_ERROR;
+	int span = bs_profile_begin("display-init");
 
 	panel = pdata;
 	if (!panel) {
@@ -329,6 +346,16 @@ int msm_display_init(struct msm_fb_panel_data *pdata)
 	if (ret)
 		goto msm_display_init_out;
 
+#ifdef DISPLAY_TYPE_MDSS
+	if (panel->mdp_rev == MDP_REV_50) {
+		if (panel->panel_info.type == MIPI_CMD_PANEL)
+			panel->fb.update_rows = msm_display_update_rows;
+		if (panel->panel_info.type == MIPI_CMD_PANEL ||
+			panel->panel_info.type == MIPI_VIDEO_PANEL)
+			panel->fb.pan = msm_display_pan;
+	}
+#endif
+
 	fbcon_setup(&(panel->fb));
 	display_image_on_screen();
 
@@ -358,6 +385,7 @@ int msm_display_init(struct msm_fb_panel_data *pdata)
 		goto msm_display_init_out;
 
 msm_display_init_out:
+	bs_profile_end(span);
 	return ret;
 }
 
@@ -394,6 +422,10 @@ int msm_display_off()
 		break;
 	case MIPI_CMD_PANEL:
 		dprintf(INFO, "Turn off MIPI_CMD_PANEL.\n");
+		/* leave the full frame set up for whoever takes over */
+		ret = mdp_dsi_cmd_reset_rows(pinfo, &(panel->fb));
+		if (ret)
+			goto msm_display_off_out;
 		ret = mdp_dsi_cmd_off();
 		if (ret)
 			goto msm_display_off_out;
@@ -89,6 +89,57 @@ const uint32_t crc32_table[256] = {
 	0x2d02ef8dL
 };
 
+static int qpic_block_isbad(unsigned page)
+{
+	return qpic_nand_block_isbad(page);
+}
+
+static int qpic_read(uint32_t start_page, uint32_t num_pages,
+		unsigned char *buffer, unsigned char *spareaddr)
+{
+	return qpic_nand_read(start_page, num_pages, buffer, spareaddr);
+}
+
+static int qpic_read_heads(uint32_t start_page, uint32_t num_blocks,
+		uint32_t num_pages, unsigned char *buffer, int *results)
+{
+	return qpic_nand_read_heads(start_page, num_blocks, num_pages,
+			buffer, results);
+}
+
+static int qpic_write(uint32_t start_page, uint32_t num_pages,
+		unsigned char *buffer, unsigned write_extra_bytes)
+{
+	return qpic_nand_write(start_page, num_pages, buffer, write_extra_bytes);
+}
+
+static int qpic_erase(uint32_t page)
+{
+	return qpic_nand_blk_erase(page);
+}
+
+static const struct ubi_flash_ops qpic_ops = {
+	.page_size = flash_page_size,
+	.block_size = flash_block_size,
+	.spare_size = flash_spare_size,
+	.block_isbad = qpic_block_isbad,
+	.read = qpic_read,
+	.read_heads = qpic_read_heads,
+	.write = qpic_write,
+	.erase = qpic_erase,
+};
+
+static const struct ubi_flash_ops *ubi_nand = &qpic_ops;
+
+/**
+ * flash_ubi_set_ops() - Set the NAND accessors of the UBI code
+ * @ops: the accessors to use, NULL for the qpic_nand driver
+ */
+void flash_ubi_set_ops(const struct ubi_flash_ops *ops)
+{
+	ubi_nand = ops ? ops : &qpic_ops;
+}
+
 static uint32_t mtd_crc32(uint32_t crc, const void *buf, size_t size)
 {
 	const uint8_t *p = buf;
@@ -142,94 +193,89 @@ static int calc_data_len(int page_size, const void *buf, int len)
 }
 
 /**
- * read_ec_hdr - read and check an erase counter header.
- * @peb: number of the physical erase block to read the header for
- * @ec_hdr: a &struct ubi_ec_hdr object where to store the read erase counter
- * 			header
- *
- * This function reads erase counter header from physical eraseblock @peb and
- * stores it in @ec_hdr. This function also checks the validity of the read
- * header.
+ * check_ec_hdr - check an erase counter header.
+ * @peb: number of the physical erase block the header was read from
+ * @ec_hdr: the read erase counter header
  *
  * Return codes:
- * -1 - in case of error
+ * -1 - if the header isn't valid
  *  0 - if PEB was found valid
  *  1 - if PEB is empty
  */
-static int read_ec_hdr(uint32_t peb, struct ubi_ec_hdr *ec_hdr)
+static int check_ec_hdr(uint32_t peb, struct ubi_ec_hdr *ec_hdr)
 {
-	unsigned char *spare, *tmp_buf;
-	int ret = -1;
 	uint32_t crc;
-	int page_size = flash_page_size();
-	int num_pages_per_blk = flash_block_size()/page_size;
-
-	spare = (unsigned char *)malloc(flash_spare_size());
-	if (!spare)
-	{
-		dprintf(CRITICAL, "read_ec_hdr: Mem allocation failed\n");
-		return ret;
-	}
-
-	tmp_buf = (unsigned char *)malloc(page_size);
-	if (!tmp_buf)
-	{
-		dprintf(CRITICAL, "read_ec_hdr: Mem allocation failed\n");
-		goto out_tmp_buf;
-	}
-
-	if (qpic_nand_block_isbad(peb * num_pages_per_blk)) {
-		dprintf(CRITICAL, "read_ec_hdr: Bad block @ %d\n", peb);
-		goto out;
-	}
 
-	if (qpic_nand_read(peb * num_pages_per_blk, 1, tmp_buf, spare)) {
-		dprintf(CRITICAL, "read_ec_hdr: Read %d failed \n", peb);
-		goto out;
-	}
-	memcpy(ec_hdr, tmp_buf, UBI_EC_HDR_SIZE);
-
-	if (check_pattern((void *)ec_hdr, 0xFF, UBI_EC_HDR_SIZE)) {
-		ret = 1;
-		goto out;
-	}
+	if (check_pattern((void *)ec_hdr, 0xFF, UBI_EC_HDR_SIZE))
+		return 1;
 
 	/* Make sure we read a valid UBI EC_HEADER */
 	if (BE32(ec_hdr->magic) != (uint32_t)UBI_EC_HDR_MAGIC) {
 		dprintf(CRITICAL,
-			"read_ec_hdr: Wrong magic at peb-%d Expected: %d, received %d\n",
+			"check_ec_hdr: Wrong magic at peb-%d Expected: %d, received %d\n",
 			peb, UBI_EC_HDR_MAGIC, BE32(ec_hdr->magic));
-		goto out;
+		return -1;
 	}
 
 	if (ec_hdr->version != UBI_VERSION) {
 		dprintf(CRITICAL,
-			"read_ec_hdr: Wrong version at peb-%d Expected: %d, received %d\n",
+			"check_ec_hdr: Wrong version at peb-%d Expected: %d, received %d\n",
 			peb, UBI_VERSION, ec_hdr->version);
-		goto out;
+		return -1;
 	}
 
 	if (BE64(ec_hdr->ec) > UBI_MAX_ERASECOUNTER) {
 		dprintf(CRITICAL,
-			"read_ec_hdr: Wrong ec at peb-%d: %lld \n",
+			"check_ec_hdr: Wrong ec at peb-%d: %lld \n",
 			peb, BE64(ec_hdr->ec));
-		goto out;
+		return -1;
 	}
 
 	crc = mtd_crc32(UBI_CRC32_INIT, ec_hdr, UBI_EC_HDR_SIZE_CRC);
 	if (BE32(ec_hdr->hdr_crc) != crc) {
 		dprintf(CRITICAL,
-			"read_ec_hdr: Wrong crc at peb-%d: calculated %d, recived %d\n",
+			"check_ec_hdr: Wrong crc at peb-%d: calculated %d, recived %d\n",
 			peb,crc,  BE32(ec_hdr->hdr_crc));
-		goto out;
+		return -1;
 	}
 
-	ret = 0;
-out:
-	free(tmp_buf);
-out_tmp_buf:
-	free(spare);
-	return ret;
+	return 0;
+}
+
+/**
+ * check_vid_hdr - check a Volume identifier header.
+ * @peb: number of the physical erase block the header was read from
+ * @vid_hdr: the read volume identifier header
+ *
+ * Return codes:
+ * -1 - if the header isn't valid
+ *  0 - on success
+ *  1 - if the PEB is free (no VID hdr)
+ */
+static int check_vid_hdr(uint32_t peb, struct ubi_vid_hdr *vid_hdr)
+{
+	uint32_t crc, magic;
+
+	if (check_pattern((void *)vid_hdr, 0xFF, UBI_VID_HDR_SIZE))
+		return 1;
+
+	magic = BE32(vid_hdr->magic);
+	if (magic != UBI_VID_HDR_MAGIC) {
+		dprintf(CRITICAL,
+				"check_vid_hdr: Wrong magic at peb-%d Expected: %d, received %d\n",
+				peb, UBI_VID_HDR_MAGIC, BE32(vid_hdr->magic));
+		return -1;
+	}
+
+	crc = mtd_crc32(UBI_CRC32_INIT, vid_hdr, UBI_EC_HDR_SIZE_CRC);
+	if (BE32(vid_hdr->hdr_crc) != crc) {
+		dprintf(CRITICAL,
+			"check_vid_hdr: Wrong crc at peb-%d: calculated %d, received %d\n",
+			peb,crc,  BE32(vid_hdr->hdr_crc));
+		return -1;
+	}
+
+	return 0;
 }
 
 /**
@@ -253,11 +299,10 @@ static int read_vid_hdr(uint32_t peb, struct ubi_vid_hdr *vid_hdr,
 {
 	unsigned char *spare, *tmp_buf;
 	int ret = -1;
-	uint32_t crc, magic;
-	int page_size = flash_page_size();
-	int num_pages_per_blk = flash_block_size()/page_size;
+	int page_size = ubi_nand->page_size();
+	int num_pages_per_blk = ubi_nand->block_size()/page_size;
 
-	spare = (unsigned char *)malloc(flash_spare_size());
+	spare = (unsigned char *)malloc(ubi_nand->spare_size());
 	if (!spare)
 	{
 		dprintf(CRITICAL, "read_vid_hdr: Mem allocation failed\n");
@@ -271,40 +316,19 @@ static int read_vid_hdr(uint32_t peb, struct ubi_vid_hdr *vid_hdr,
 		goto out_tmp_buf;
 	}
 
-	if (qpic_nand_block_isbad(peb * num_pages_per_blk)) {
+	if (ubi_nand->block_isbad(peb * num_pages_per_blk)) {
 		dprintf(CRITICAL, "read_vid_hdr: Bad block @ %d\n", peb);
 		goto out;
 	}
 
-	if (qpic_nand_read(peb * num_pages_per_blk + vid_hdr_offset/page_size,
+	if (ubi_nand->read(peb * num_pages_per_blk + vid_hdr_offset/page_size,
 			1, tmp_buf, spare)) {
 		dprintf(CRITICAL, "read_vid_hdr: Read %d failed \n", peb);
 		goto out;
 	}
 	memcpy(vid_hdr, tmp_buf, UBI_VID_HDR_SIZE);
 
-	if (check_pattern((void *)vid_hdr, 0xFF, UBI_VID_HDR_SIZE)) {
-		ret = 1;
-		goto out;
-	}
-
-	magic = BE32(vid_hdr->magic);
-	if (magic != UBI_VID_HDR_MAGIC) {
-		dprintf(CRITICAL,
-				"read_vid_hdr: Wrong magic at peb-%d Expected: %d, received %d\n",
-				peb, UBI_VID_HDR_MAGIC, BE32(vid_hdr->magic));
-		goto out;
-	}
-
-	crc = mtd_crc32(UBI_CRC32_INIT, vid_hdr, UBI_EC_HDR_SIZE_CRC);
-	if (BE32(vid_hdr->hdr_crc) != crc) {
-		dprintf(CRITICAL,
-			"read_vid_hdr: Wrong crc at peb-%d: calculated %d, received %d\n",
-			peb,crc,  BE32(vid_hdr->hdr_crc));
-		goto out;
-	}
-
-	ret = 0;
+	ret = check_vid_hdr(peb, vid_hdr);
 out:
 	free(tmp_buf);
 out_tmp_buf:
@@ -329,11 +353,11 @@ static int read_leb_data(uint32_t peb, void *leb_data,
 {
 	unsigned char *spare, *tmp_buf;
 	int ret = -1;
-	int page_size = flash_page_size();
-	int block_size = flash_block_size();
+	int page_size = ubi_nand->page_size();
+	int block_size = ubi_nand->block_size();
 	int num_pages_per_blk = block_size/page_size;
 
-	spare = (unsigned char *)malloc(flash_spare_size());
+	spare = (unsigned char *)malloc(ubi_nand->spare_size());
 	if (!spare)
 	{
 		dprintf(CRITICAL, "read_leb_data: Mem allocation failed\n");
@@ -347,12 +371,12 @@ static int read_leb_data(uint32_t peb, void *leb_data,
 		goto out_tmp_buf;
 	}
 
-	if (qpic_nand_block_isbad(peb * num_pages_per_blk)) {
+	if (ubi_nand->block_isbad(peb * num_pages_per_blk)) {
 		dprintf(CRITICAL, "read_leb_data: Bad block @ %d\n", peb);
 		goto out;
 	}
 
-	if (qpic_nand_read(peb * num_pages_per_blk + data_offset/page_size,
+	if (ubi_nand->read(peb * num_pages_per_blk + data_offset/page_size,
 			leb_size/page_size, tmp_buf, spare)) {
 		dprintf(CRITICAL, "read_leb_data: Read %d failed \n", peb);
 		goto out;
@@ -378,8 +402,8 @@ out_tmp_buf:
  */
 static int write_ec_header(uint32_t peb, struct ubi_ec_hdr *new_ech)
 {
-	unsigned page_size = flash_page_size();
-	int num_pages_per_blk = flash_block_size()/page_size;
+	unsigned page_size = ubi_nand->page_size();
+	int num_pages_per_blk = ubi_nand->block_size()/page_size;
 	unsigned char *buf;
 	int ret = 0;
 
@@ -392,7 +416,7 @@ static int write_ec_header(uint32_t peb, struct ubi_ec_hdr *new_ech)
 	memset(buf, 0, page_size);
 	ASSERT(page_size > sizeof(*new_ech));
 	memcpy(buf, new_ech, UBI_EC_HDR_SIZE);
-	ret = qpic_nand_write(peb * num_pages_per_blk, 1, buf, 0);
+	ret = ubi_nand->write(peb * num_pages_per_blk, 1, buf, 0);
 	if (ret) {
 		dprintf(CRITICAL,
 			"write_ec_header: qpic_nand_write failed with %d\n", ret);
@@ -418,8 +442,8 @@ out:
 static int write_vid_header(uint32_t peb,
 		struct ubi_vid_hdr *new_vidh, int offset)
 {
-	unsigned page_size = flash_page_size();
-	int num_pages_per_blk = flash_block_size()/page_size;
+	unsigned page_size = ubi_nand->page_size();
+	int num_pages_per_blk = ubi_nand->block_size()/page_size;
 	unsigned char *buf;
 	int ret = 0;
 
@@ -432,7 +456,7 @@ static int write_vid_header(uint32_t peb,
 	memset(buf, 0, page_size);
 	ASSERT(page_size > sizeof(*new_vidh));
 	memcpy(buf, new_vidh, UBI_VID_HDR_SIZE);
-	ret = qpic_nand_write(peb * num_pages_per_blk + offset/page_size,
+	ret = ubi_nand->write(peb * num_pages_per_blk + offset/page_size,
 			1, buf, 0);
 	if (ret) {
 		dprintf(CRITICAL,
@@ -446,6 +470,23 @@ out:
 	return ret;
 }
 
+/**
+ * leb_data_pages - number of pages write_leb_data() programs
+ * @data: a data buffer to write
+ * @size: data size
+ * @leb_size: LEB size
+ *
+ * The pages of the LEB after these are left erased.
+ */
+static int leb_data_pages(const void *data, int size, int leb_size)
+{
+	int page_size = ubi_nand->page_size();
+
+	if (size < leb_size)
+		return size / page_size;
+	return calc_data_len(page_size, data, leb_size);
+}
+
 /**
  * write_leb_data - write data section of the PEB (LEB).
  * @peb: number of the physical erase block to write the data for
@@ -464,8 +505,8 @@ static int write_leb_data(uint32_t peb, void *data,
 	unsigned char *tmp_buf;
 	int ret = -1;
 	int num_pages;
-	int page_size = flash_page_size();
-	int block_size = flash_block_size();
+	int page_size = ubi_nand->page_size();
+	int block_size = ubi_nand->block_size();
 	int num_pages_per_blk = block_size/page_size;
 
 	tmp_buf = (unsigned char *)malloc(block_size - data_offset);
@@ -475,13 +516,9 @@ static int write_leb_data(uint32_t peb, void *data,
 		return -1;
 	}
 
-	if (size < block_size - data_offset)
-		num_pages = size / page_size;
-	else
-		num_pages = calc_data_len(page_size, data,
-				block_size - data_offset);
+	num_pages = leb_data_pages(data, size, block_size - data_offset);
 	memcpy(tmp_buf, data, num_pages * page_size);
-	ret = qpic_nand_write(peb * num_pages_per_blk + data_offset/page_size,
+	ret = ubi_nand->write(peb * num_pages_per_blk + data_offset/page_size,
 			num_pages, tmp_buf, 0);
 	if (ret) {
 		dprintf(CRITICAL,
@@ -496,22 +533,431 @@ out:
 	return ret;
 }
 
+/*
+ * Headers of up to UBI_SCAN_BATCH PEBs are read in one go while scanning.
+ * Until the VID header offset is known UBI_SCAN_HDR_PAGES pages of each PEB
+ * are read, the VID header is usually in the second one.
+ */
+#define UBI_SCAN_BATCH		32
+#define UBI_SCAN_HDR_PAGES	2
+
+/**
+ * scan_peb() - Collect the headers info of one PEB
+ * @si: pointer to struct ubi_scan_info to fill in
+ * @ptn_start: PEB number the partition begins at
+ * @i: index of the PEB in si->pebs_data. Relative to ptn_start
+ * @hdrs: the first @num_pages pages of the PEB, NULL if they couldn't
+ * 		be read
+ * @num_pages: number of pages at @hdrs
+ *
+ * The VID header is taken from @hdrs if it's in there, and read from the
+ * PEB otherwise.
+ */
+static void scan_peb(struct ubi_scan_info *si, int ptn_start, unsigned i,
+		const unsigned char *hdrs, unsigned num_pages)
+{
+	struct ubi_ec_hdr ec_hdr;
+	struct ubi_vid_hdr vid_hdr;
+	unsigned page_size = ubi_nand->page_size();
+	uint32_t peb = ptn_start + i;
+	unsigned vid_page;
+	int ret = -1;
+
+	if (hdrs) {
+		memcpy(&ec_hdr, hdrs, UBI_EC_HDR_SIZE);
+		ret = check_ec_hdr(peb, &ec_hdr);
+	}
+	switch (ret) {
+	case 1:
+		si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+		si->pebs_data[i].status = UBI_EMPTY_PEB;
+		break;
+	case 0:
+		if (!si->vid_hdr_offs) {
+			si->vid_hdr_offs = BE32(ec_hdr.vid_hdr_offset);
+			si->data_offs = BE32(ec_hdr.data_offset);
+			if (!si->vid_hdr_offs || !si->data_offs ||
+				si->vid_hdr_offs % page_size ||
+				si->data_offs % page_size) {
+				si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+				si->vid_hdr_offs = 0;
+				return;
+			}
+			if (BE32(ec_hdr.vid_hdr_offset) != si->vid_hdr_offs) {
+				si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+				return;
+			}
+			if (BE32(ec_hdr.data_offset) != si->data_offs) {
+				si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+				return;
+			}
+		}
+		si->read_image_seq = BE32(ec_hdr.image_seq);
+		si->pebs_data[i].ec = BE64(ec_hdr.ec);
+		/* Now check the VID header to find if the peb is free */
+		vid_page = BE32(ec_hdr.vid_hdr_offset) / page_size;
+		if (vid_page < num_pages) {
+			memcpy(&vid_hdr, hdrs + vid_page * page_size, UBI_VID_HDR_SIZE);
+			ret = check_vid_hdr(peb, &vid_hdr);
+		} else {
+			ret = read_vid_hdr(peb, &vid_hdr,
+					BE32(ec_hdr.vid_hdr_offset));
+		}
+		switch (ret) {
+		case 1:
+			si->pebs_data[i].status = UBI_FREE_PEB;
+			break;
+		case 0:
+			si->pebs_data[i].status = UBI_USED_PEB;
+			si->pebs_data[i].volume = BE32(vid_hdr.vol_id);
+			si->pebs_data[i].lnum = BE32(vid_hdr.lnum);
+			if (vid_hdr.copy_flag || vid_hdr.vol_type == UBI_VID_STATIC) {
+				si->pebs_data[i].data_size = BE32(vid_hdr.data_size);
+				si->pebs_data[i].data_crc = BE32(vid_hdr.data_crc);
+			}
+			if (BE32(vid_hdr.vol_id) == UBI_LAYOUT_VOLUME_ID) {
+				if (si->vtbl_peb1 == -1)
+					si->vtbl_peb1 = i;
+				else if (si->vtbl_peb2 == -1)
+					si->vtbl_peb2 = i;
+				else
+					dprintf(CRITICAL,
+						"scan_partition: Found > 2 copies of vtbl");
+			}
+			if (BE32(vid_hdr.vol_id) == UBI_FM_SB_VOLUME_ID)
+				si->fastmap_sb = i;
+			break;
+		case -1:
+		default:
+			si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+			si->pebs_data[i].status = UBI_BAD_PEB;
+			break;
+		}
+		break;
+	case -1:
+	default:
+		si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+		si->pebs_data[i].status = UBI_BAD_PEB;
+		break;
+	}
+}
+
+/**
+ * scan_pebs() - Collect the headers info of a range of PEBs
+ * @si: pointer to struct ubi_scan_info to fill in
+ * @ptn: partition being scanned
+ * @first: first PEB to scan. Relative to ptn->start
+ * @count: number of PEBs to scan
+ *
+ * The pages holding the headers of UBI_SCAN_BATCH PEBs at a time are read
+ * in one pipelined NAND operation.
+ *
+ * Return codes:
+ * -1 - in case of error
+ *  0 - on success
+ */
+static int scan_pebs(struct ubi_scan_info *si, struct ptentry *ptn,
+		unsigned first, unsigned count)
+{
+	int results[UBI_SCAN_BATCH];
+	unsigned char *buf;
+	unsigned page_size = ubi_nand->page_size();
+	unsigned num_pages_per_blk = ubi_nand->block_size() / page_size;
+	unsigned num, num_pages, i;
+
+	while (count) {
+		num = MIN(count, UBI_SCAN_BATCH);
+		if (si->vid_hdr_offs)
+			num_pages = si->vid_hdr_offs / page_size + 1;
+		else
+			num_pages = UBI_SCAN_HDR_PAGES;
+		num_pages = MIN(num_pages, num_pages_per_blk);
+
+		buf = malloc(num * num_pages * page_size);
+		if (!buf) {
+			dprintf(CRITICAL, "scan_pebs: Mem allocation failed\n");
+			return -1;
+		}
+
+		if (ubi_nand->read_heads((ptn->start + first) * num_pages_per_blk,
+				num, num_pages, buf, results)) {
+			dprintf(CRITICAL, "scan_pebs: Read %d failed\n",
+					ptn->start + first);
+			free(buf);
+			return -1;
+		}
+
+		for (i = 0; i < num; i++)
+			scan_peb(si, ptn->start, first + i,
+				results[i] ? NULL : buf + i * num_pages * page_size,
+				num_pages);
+
+		free(buf);
+		first += num;
+		count -= num;
+	}
+	return 0;
+}
+
+#if UBI_FASTMAP_SCAN
+/**
+ * scan_fastmap() - Collect the PEBs info of a partition from its fastmap
+ * @si: pointer to struct ubi_scan_info, holding the headers info of the
+ * 		PEBs before @first, si->fastmap_sb among them
+ * @ptn: partition being scanned
+ * @first: first PEB to fill in. Relative to ptn->start
+ *
+ * This function reads the fastmap the superblock at si->fastmap_sb points
+ * to and fills in the info of the PEBs from @first on with it. Only the
+ * headers of the PEBs the fastmap can't tell about are read: the pools and
+ * the erase list, which UBI may have written to since, and the used PEBs
+ * no volume maps. Every PEB that isn't bad has to be in the fastmap.
+ *
+ * Return codes:
+ * -1 - if the fastmap isn't usable, si is left as it was
+ *  0 - on success
+ */
+static int scan_fastmap(struct ubi_scan_info *si, struct ptentry *ptn,
+		unsigned first)
+{
+	struct ubi_fm_sb *fmsb;
+	struct ubi_fm_hdr *fmh;
+	struct ubi_fm_scan_pool *fmpl;
+	struct ubi_fm_ec *fmec;
+	struct ubi_fm_volhdr *fmvh;
+	struct ubi_fm_eba *fmeba;
+	struct ubi_vid_hdr vid_hdr;
+	struct peb_info *pi;
+	unsigned block_size = ubi_nand->block_size();
+	unsigned num_pages_per_blk = block_size / ubi_nand->page_size();
+	unsigned leb_size = block_size - si->data_offs;
+	uint32_t used_blocks, counts[4], crc, pnum, vol_id, n;
+	int vtbl_peb1 = si->vtbl_peb1;
+	int vtbl_peb2 = si->vtbl_peb2;
+	void *fm, *pos, *end;
+	unsigned i, j, k;
+	int ret = -1;
+
+	fm = malloc(leb_size);
+	if (!fm) {
+		dprintf(CRITICAL, "scan_fastmap: Mem allocation failed\n");
+		return -1;
+	}
+
+	if (read_leb_data(ptn->start + si->fastmap_sb, fm, leb_size,
+			si->data_offs))
+		goto out;
+
+	fmsb = fm;
+	used_blocks = BE32(fmsb->used_blocks);
+	if (BE32(fmsb->magic) != UBI_FM_SB_MAGIC ||
+			fmsb->version != UBI_FM_FMT_VERSION ||
+			!used_blocks || used_blocks > UBI_FM_MAX_BLOCKS ||
+			BE32(fmsb->block_loc[0]) != (uint32_t)si->fastmap_sb) {
+		dprintf(CRITICAL, "scan_fastmap: Bad fastmap superblock at peb-%d\n",
+				ptn->start + si->fastmap_sb);
+		goto out;
+	}
+
+	/* Read the rest of the fastmap after the anchor */
+	if (used_blocks > 1) {
+		pos = realloc(fm, used_blocks * leb_size);
+		if (!pos) {
+			dprintf(CRITICAL, "scan_fastmap: Mem allocation failed\n");
+			goto out;
+		}
+		fm = pos;
+		fmsb = fm;
+	}
+	for (j = 1; j < used_blocks; j++) {
+		pnum = BE32(fmsb->block_loc[j]);
+		if (pnum >= ptn->length ||
+				read_vid_hdr(ptn->start + pnum, &vid_hdr, si->vid_hdr_offs) ||
+				BE32(vid_hdr.vol_id) != UBI_FM_DATA_VOLUME_ID ||
+				BE32(vid_hdr.lnum) != j ||
+				read_leb_data(ptn->start + pnum, fm + j * leb_size,
+					leb_size, si->data_offs)) {
+			dprintf(CRITICAL, "scan_fastmap: Bad fastmap block %d\n", j);
+			goto out;
+		}
+	}
+
+	crc = BE32(fmsb->data_crc);
+	fmsb->data_crc = 0;
+	if (mtd_crc32(UBI_CRC32_INIT, fm, used_blocks * leb_size) != crc) {
+		dprintf(CRITICAL, "scan_fastmap: Wrong fastmap data crc\n");
+		goto out;
+	}
+
+	pos = fm + sizeof(*fmsb);
+	end = fm + used_blocks * leb_size;
+	fmh = pos;
+	pos += sizeof(*fmh);
+	if (BE32(fmh->magic) != UBI_FM_HDR_MAGIC)
+		goto bad_fm;
+
+	/* The two pools: the fastmap can't tell what UBI did with them */
+	for (k = 0; k < 2; k++) {
+		fmpl = pos;
+		pos += sizeof(*fmpl);
+		if (BE32(fmpl->magic) != UBI_FM_POOL_MAGIC ||
+				BE16(fmpl->size) > BE16(fmpl->max_size) ||
+				BE16(fmpl->max_size) > UBI_FM_MAX_POOL_SIZE)
+			goto bad_fm;
+		for (j = 0; j < BE16(fmpl->size); j++) {
+			pnum = BE32(fmpl->pebs[j]);
+			if (pnum >= ptn->length)
+				goto bad_fm;
+			if (pnum < first)
+				continue;
+			pi = &si->pebs_data[pnum];
+			if (pi->status != UBI_UNKNOWN)
+				goto bad_fm;
+			pi->status = UBI_USED_PEB;
+			pi->volume = -1;
+		}
+	}
+
+	/*
+	 * Then the free, used, scrub & erase lists. The erase list PEBs are
+	 * taken as used PEBs of no volume, to be scanned.
+	 */
+	counts[0] = BE32(fmh->free_peb_count);
+	counts[1] = BE32(fmh->used_peb_count);
+	counts[2] = BE32(fmh->scrub_peb_count);
+	counts[3] = BE32(fmh->erase_peb_count);
+	for (k = 0; k < 4; k++) {
+		if (counts[k] > ptn->length ||
+				pos + counts[k] * sizeof(*fmec) > end)
+			goto bad_fm;
+		for (j = 0; j < counts[k]; j++) {
+			fmec = pos;
+			pos += sizeof(*fmec);
+			pnum = BE32(fmec->pnum);
+			if (pnum >= ptn->length)
+				goto bad_fm;
+			if (pnum < first)
+				continue;
+			pi = &si->pebs_data[pnum];
+			if (pi->status != UBI_UNKNOWN)
+				goto bad_fm;
+			pi->ec = BE32(fmec->ec);
+			pi->status = k ? UBI_USED_PEB : UBI_FREE_PEB;
+			pi->volume = -1;
+		}
+	}
+
+	/* Volumes & their LEB to PEB tables */
+	for (i = 0; i < BE32(fmh->vol_count); i++) {
+		fmvh = pos;
+		pos += sizeof(*fmvh);
+		fmeba = pos;
+		pos += sizeof(*fmeba);
+		if (pos > end || BE32(fmvh->magic) != UBI_FM_VHDR_MAGIC ||
+				BE32(fmeba->magic) != UBI_FM_EBA_MAGIC)
+			goto bad_fm;
+		vol_id = BE32(fmvh->vol_id);
+		n = BE32(fmeba->reserved_pebs);
+		if (n > ptn->length || pos + n * sizeof(uint32_t) > end)
+			goto bad_fm;
+		pos += n * sizeof(uint32_t);
+		for (j = 0; j < n; j++) {
+			pnum = BE32(fmeba->pnum[j]);
+			if (pnum == (uint32_t)-1)
+				continue;
+			if (pnum >= ptn->length)
+				goto bad_fm;
+			if (pnum < first)
+				continue;
+			pi = &si->pebs_data[pnum];
+			if (pi->status != UBI_USED_PEB || pi->volume != -1)
+				goto bad_fm;
+			pi->volume = vol_id;
+			pi->lnum = j;
+			if (vol_id == UBI_LAYOUT_VOLUME_ID) {
+				if (si->vtbl_peb1 == -1)
+					si->vtbl_peb1 = pnum;
+				else if (si->vtbl_peb2 == -1)
+					si->vtbl_peb2 = pnum;
+			}
+		}
+	}
+
+	/* The fastmap's own PEBs */
+	for (j = 1; j < used_blocks; j++) {
+		pnum = BE32(fmsb->block_loc[j]);
+		if (pnum < first)
+			continue;
+		pi = &si->pebs_data[pnum];
+		if (pi->status != UBI_UNKNOWN)
+			goto bad_fm;
+		pi->ec = BE32(fmsb->block_ec[j]);
+		pi->status = UBI_USED_PEB;
+		pi->volume = UBI_FM_DATA_VOLUME_ID;
+		pi->lnum = j;
+	}
+
+	/* Whatever isn't in the fastmap has to be bad */
+	for (i = first; i < ptn->length; i++) {
+		pi = &si->pebs_data[i];
+		if (pi->status != UBI_UNKNOWN)
+			continue;
+		if (!ubi_nand->block_isbad((ptn->start + i) * num_pages_per_blk)) {
+			dprintf(CRITICAL, "scan_fastmap: peb-%d not in the fastmap\n",
+					ptn->start + i);
+			goto bad_fm;
+		}
+		pi->ec = UBI_MAX_ERASECOUNTER;
+		pi->status = UBI_BAD_PEB;
+	}
+
+	/* Read the headers of the PEBs the fastmap doesn't map */
+	for (i = first; i < ptn->length; i = j) {
+		for (j = i; j < ptn->length; j++) {
+			pi = &si->pebs_data[j];
+			if (pi->status != UBI_USED_PEB || pi->volume != -1)
+				break;
+			memset((void *)pi, 0, sizeof(*pi));
+		}
+		if (j == i) {
+			j++;
+			continue;
+		}
+		if (scan_pebs(si, ptn, i, j - i))
+			goto bad_fm;
+	}
+
+	ret = 0;
+	goto out;
+
+bad_fm:
+	dprintf(CRITICAL, "scan_fastmap: Fastmap not usable, scanning\n");
+	memset((void *)&si->pebs_data[first], 0,
+			(ptn->length - first) * sizeof(struct peb_info));
+	si->vtbl_peb1 = vtbl_peb1;
+	si->vtbl_peb2 = vtbl_peb2;
+out:
+	free(fm);
+	return ret;
+}
+#endif
+
 /**
  * scan_partition() - Collect the ec_headers info of a given partition
  * @ptn: partition to read the headers of
  *
+ * With UBI_FASTMAP_SCAN, a good fastmap is used instead of reading the
+ * headers of all the PEBs after the first UBI_FM_MAX_START.
+ *
  * Returns allocated and filled struct ubi_scan_info (si).
  * Note: si should be released by caller.
  */
 static struct ubi_scan_info *scan_partition(struct ptentry *ptn)
 {
 	struct ubi_scan_info *si;
-	struct ubi_ec_hdr *ec_hdr;
-	struct ubi_vid_hdr vid_hdr;
-	unsigned i;
+	unsigned i = 0;
 	unsigned long long sum = 0;
-	int page_size = flash_page_size();
-	int ret;
+	uint32_t fallbacks = qpic_nand_erased_page_fallbacks();
 
 	si = malloc(sizeof(*si));
 	if (!si) {
@@ -529,98 +975,40 @@ static struct ubi_scan_info *scan_partition(struct ptentry *ptn)
 	}
 	memset((void *)si->pebs_data, 0, ptn->length * sizeof(struct peb_info));
 
-	ec_hdr = malloc(UBI_EC_HDR_SIZE);
-	if (!ec_hdr) {
-		dprintf(CRITICAL,"scan_partition: (%s) Memory allocation failed\n",
-				ptn->name);
-		goto out_failed;
-	}
-
 	si->vid_hdr_offs = 0;
 	si->image_seq = rand() & UBI_IMAGE_SEQ_BASE;
 	si->vtbl_peb1 = -1;
 	si->vtbl_peb2 = -1;
 	si->fastmap_sb = -1;
-	for (i = 0; i < ptn->length; i++){
-		ret = read_ec_hdr(ptn->start + i, ec_hdr);
-		switch (ret) {
-		case 1:
+
+#if UBI_FASTMAP_SCAN
+	/* The fastmap superblock can only be in the first PEBs */
+	i = MIN(ptn->length, UBI_FM_MAX_START);
+	if (scan_pebs(si, ptn, 0, i))
+		goto out_failed;
+	if (si->fastmap_sb > -1 && !scan_fastmap(si, ptn, i))
+		i = ptn->length;
+#endif
+	if (scan_pebs(si, ptn, i, ptn->length - i))
+		goto out_failed;
+
+	for (i = 0; i < ptn->length; i++) {
+		switch (si->pebs_data[i].status) {
+		case UBI_EMPTY_PEB:
 			si->empty_cnt++;
-			si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-			si->pebs_data[i].status = UBI_EMPTY_PEB;
 			break;
-		case 0:
-			if (!si->vid_hdr_offs) {
-				si->vid_hdr_offs = BE32(ec_hdr->vid_hdr_offset);
-				si->data_offs = BE32(ec_hdr->data_offset);
-				if (!si->vid_hdr_offs || !si->data_offs ||
-					si->vid_hdr_offs % page_size ||
-					si->data_offs % page_size) {
-					si->bad_cnt++;
-					si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-					si->vid_hdr_offs = 0;
-					continue;
-				}
-				if (BE32(ec_hdr->vid_hdr_offset) != si->vid_hdr_offs) {
-					si->bad_cnt++;
-					si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-					continue;
-				}
-				if (BE32(ec_hdr->data_offset) != si->data_offs) {
-					si->bad_cnt++;
-					si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-					continue;
-				}
-			}
-			si->read_image_seq = BE32(ec_hdr->image_seq);
-			si->pebs_data[i].ec = BE64(ec_hdr->ec);
-			/* Now read the VID header to find if the peb is free */
-			ret = read_vid_hdr(ptn->start + i, &vid_hdr,
-					BE32(ec_hdr->vid_hdr_offset));
-			switch (ret) {
-			case 1:
-				si->pebs_data[i].status = UBI_FREE_PEB;
-				si->free_cnt++;
-				break;
-			case 0:
-				si->pebs_data[i].status = UBI_USED_PEB;
-				si->pebs_data[i].volume = BE32(vid_hdr.vol_id);
-				if (BE32(vid_hdr.vol_id) == UBI_LAYOUT_VOLUME_ID) {
-					if (si->vtbl_peb1 == -1)
-						si->vtbl_peb1 = i;
-					else if (si->vtbl_peb2 == -1)
-						si->vtbl_peb2 = i;
-					else
-						dprintf(CRITICAL,
-							"scan_partition: Found > 2 copies of vtbl");
-				}
-				if (BE32(vid_hdr.vol_id) == UBI_FM_SB_VOLUME_ID)
-					si->fastmap_sb = i;
-				si->used_cnt++;
-				break;
-			case -1:
-			default:
-				si->bad_cnt++;
-				si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-				si->pebs_data[i].status = UBI_BAD_PEB;
-				break;
-			}
+		case UBI_FREE_PEB:
+			si->free_cnt++;
+			break;
+		case UBI_USED_PEB:
+			si->used_cnt++;
 			break;
-		case -1:
 		default:
 			si->bad_cnt++;
-			si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-			si->pebs_data[i].status = UBI_BAD_PEB;
 			break;
 		}
 	}
 
-	/* Sanity check */
-	if (si->bad_cnt + si->empty_cnt + si->free_cnt + si->used_cnt != (int)ptn->length) {
-		dprintf(CRITICAL,"scan_partition: peb count doesn't sum up \n");
-		goto out_failed;
-	}
-
 	/*
 	 * If less then 95% of the PEBs were "bad" (didn't have valid
 	 * ec header), then set mean_ec = UBI_DEF_ERACE_COUNTER.
@@ -637,7 +1025,10 @@ static struct ubi_scan_info *scan_partition(struct ptentry *ptn)
 	} else {
 		si->mean_ec = UBI_DEF_ERACE_COUNTER;
 	}
-	free(ec_hdr);
+
+	/* Erased pages the controller didn't flag cost a raw read each */
+	dprintf(INFO, "scan_partition: (%s) %u erased pages checked in software\n",
+			ptn->name, qpic_nand_erased_page_fallbacks() - fallbacks);
 	return si;
 
 out_failed:
@@ -733,11 +1124,11 @@ static int ubi_erase_peb(int peb_num, struct ubi_scan_info *si,
 		int ptn_start)
 {
 	struct ubi_ec_hdr new_ech;
-	int page_size = flash_page_size();
-	int num_pages_per_blk = flash_block_size() / page_size;
+	int page_size = ubi_nand->page_size();
+	int num_pages_per_blk = ubi_nand->block_size() / page_size;
 	int ret;
 
-	if (qpic_nand_blk_erase(peb_num * num_pages_per_blk)) {
+	if (ubi_nand->erase(peb_num * num_pages_per_blk)) {
 		dprintf(INFO, "ubi_erase_peb: erase of %d failed\n", peb_num);
 		return -1;
 	}
@@ -810,8 +1201,8 @@ int flash_ubi_img(struct ptentry *ptn, void *data, unsigned size)
 	struct ubi_ec_hdr *old_ech;
 	uint32_t curr_peb = ptn->start;
 	void *img_peb;
-	unsigned page_size = flash_page_size();
-	unsigned block_size = flash_block_size();
+	unsigned page_size = ubi_nand->page_size();
+	unsigned block_size = ubi_nand->block_size();
 	int num_pages_per_blk = block_size / page_size;
 	int num_pages;
 	int ret;
@@ -838,7 +1229,7 @@ int flash_ubi_img(struct ptentry *ptn, void *data, unsigned size)
 	/* Update the "to be" flashed image and flash it */
 	img_peb = data;
 	while (size && curr_peb < ptn->start + ptn->length) {
-		if (qpic_nand_blk_erase(curr_peb * num_pages_per_blk)) {
+		if (ubi_nand->erase(curr_peb * num_pages_per_blk)) {
 			dprintf(CRITICAL, "flash_ubi_img: erase of %d failed\n",
 				curr_peb);
 			bad_blocks_cnt++;
@@ -854,7 +1245,7 @@ int flash_ubi_img(struct ptentry *ptn, void *data, unsigned size)
 		else
 			num_pages = calc_data_len(page_size, img_peb, block_size);
 		/* Write one block from image */
-		ret = qpic_nand_write(curr_peb * num_pages_per_blk,
+		ret = ubi_nand->write(curr_peb * num_pages_per_blk,
 				num_pages, img_peb, 0);
 		if (ret) {
 			dprintf(CRITICAL, "flash_ubi_img: writing to peb-%d failed\n",
@@ -872,7 +1263,7 @@ int flash_ubi_img(struct ptentry *ptn, void *data, unsigned size)
 			fmsb_peb = curr_peb;
 			is_fmsb_peb_valid = 1;
 		}
-		img_peb += flash_block_size();
+		img_peb += ubi_nand->block_size();
 		curr_peb++;
 	}
 
@@ -926,7 +1317,7 @@ static int find_volume(struct ubi_scan_info *si, int ptn_start,
 		const char *vol_name, struct ubi_vtbl_record *vol_info)
 {
 	int i, vtbl_records, vtbl_peb, ret = -1;
-	int block_size = flash_block_size();
+	int block_size = ubi_nand->block_size();
 	void *leb_data;
 	struct ubi_vtbl_record *curr_vol;
 
@@ -1020,6 +1411,58 @@ out:
 	return ret;
 }
 
+/**
+ * leb_unchanged() - check if a PEB already holds the given LEB data
+ * @si: pointer to struct ubi_scan_info
+ * @ptn_start: PEB number the partition begins at
+ * @idx: index of the PEB in si->pebs_data
+ * @data: the LEB data to write
+ * @size: size of the data
+ *
+ * The PEB holds the data if writing it there would leave the same content
+ * on the flash. If the VID header of the PEB has a CRC of the data it's
+ * checked against, otherwise the LEB is read and compared.
+ *
+ * Returns 1 if the PEB holds the data, 0 if not or if it can't be read.
+ */
+static int leb_unchanged(struct ubi_scan_info *si, int ptn_start, int idx,
+		const void *data, unsigned size)
+{
+	struct peb_info *pi = &si->pebs_data[idx];
+	unsigned leb_size = ubi_nand->block_size() - si->data_offs;
+	unsigned len, n;
+	void *leb_data;
+	uint32_t crc;
+	int ret = 0;
+
+	len = leb_data_pages(data, size, leb_size) * ubi_nand->page_size();
+
+	if (pi->data_size && pi->data_size <= leb_size) {
+		/* The LEB is data_size bytes of data, erased after them */
+		if (len > pi->data_size &&
+				!check_pattern(data + pi->data_size, 0xFF,
+					len - pi->data_size))
+			return 0;
+		n = MIN(len, pi->data_size);
+		crc = mtd_crc32(UBI_CRC32_INIT, data, n);
+		for (; n < pi->data_size; n++)
+			crc = crc32_table[(crc ^ 0xFF) & 0xff] ^ (crc >> 8);
+		return crc == pi->data_crc;
+	}
+
+	leb_data = malloc(leb_size);
+	if (!leb_data) {
+		dprintf(CRITICAL, "leb_unchanged: Mem allocation failed\n");
+		return 0;
+	}
+	if (!read_leb_data(ptn_start + idx, leb_data, leb_size, si->data_offs) &&
+			!memcmp(leb_data, data, len) &&
+			check_pattern(leb_data + len, 0xFF, leb_size - len))
+		ret = 1;
+	free(leb_data);
+	return ret;
+}
+
 /**
  * update_ubi_vol() - Write the provided (UBI) image to given volume
  * @ptn: partition holding the required volume
@@ -1034,11 +1477,13 @@ int update_ubi_vol(struct ptentry *ptn, const char* vol_name,
 				void *data, unsigned size)
 {
 	struct ubi_scan_info *si;
+	struct peb_info *pi;
 	int vol_id, vol_pebs, curr_peb = 0, ret = -1;
-	unsigned block_size = flash_block_size();
-	void *img_peb;
+	unsigned block_size = ubi_nand->block_size();
+	unsigned leb_size, len;
 	struct ubi_vtbl_record curr_vol;
-	int img_pebs, lnum = 0;
+	int img_pebs, lnum = 0, kept = 0, changed = 0;
+	int *leb_peb = NULL;
 
 	si = scan_partition(ptn);
 	if (!si) {
@@ -1053,14 +1498,10 @@ int update_ubi_vol(struct ptentry *ptn, const char* vol_name,
 		dprintf(CRITICAL, "update_ubi_vol: dint find volume\n");
 		goto out;
 	}
-	if (si->fastmap_sb > -1 &&
-			ubi_erase_peb(ptn->start + si->fastmap_sb, si, ptn->start)) {
-		dprintf(CRITICAL, "update_ubi_vol: fastmap invalidation failed\n");
-		goto out;
-	}
 
-	img_pebs = size / (block_size - si->data_offs);
-	if (size % (block_size - si->data_offs))
+	leb_size = block_size - si->data_offs;
+	img_pebs = size / leb_size;
+	if (size % leb_size)
 		img_pebs++;
 
 	vol_pebs = BE32(curr_vol.reserved_pebs);
@@ -1071,54 +1512,90 @@ int update_ubi_vol(struct ptentry *ptn, const char* vol_name,
 		goto out;
 	}
 
-	/* First erase all volume used PEBs */
-	curr_peb = 0;
-	while (curr_peb < (int)ptn->length) {
-		if (si->pebs_data[curr_peb].status != UBI_USED_PEB ||
-				si->pebs_data[curr_peb].volume != vol_id) {
-			curr_peb++;
+	leb_peb = malloc(MAX(img_pebs, 1) * sizeof(int));
+	if (!leb_peb) {
+		dprintf(CRITICAL, "update_ubi_vol: Mem allocation failed\n");
+		goto out;
+	}
+	for (lnum = 0; lnum < img_pebs; lnum++)
+		leb_peb[lnum] = -1;
+
+	/*
+	 * Keep the volume PEBs that already hold their LEB as it is in the
+	 * image, leb_peb[] is the PEB kept for each LEB. They are neither
+	 * erased nor written, their EC header stays as it is.
+	 */
+	for (curr_peb = 0; curr_peb < (int)ptn->length; curr_peb++) {
+		pi = &si->pebs_data[curr_peb];
+		if (pi->status != UBI_USED_PEB || pi->volume != vol_id)
 			continue;
+		lnum = pi->lnum;
+		if (lnum >= 0 && lnum < img_pebs && leb_peb[lnum] == -1 &&
+				leb_unchanged(si, ptn->start, curr_peb,
+					data + lnum * leb_size,
+					MIN(size - lnum * leb_size, leb_size))) {
+			leb_peb[lnum] = curr_peb;
+			kept++;
+		} else {
+			changed = 1;
 		}
+	}
+
+	if (!changed && kept == img_pebs) {
+		dprintf(INFO, "update_ubi_vol: %s is unchanged\n", vol_name);
+		ret = 0;
+		goto out;
+	}
+
+	if (si->fastmap_sb > -1 &&
+			ubi_erase_peb(ptn->start + si->fastmap_sb, si, ptn->start)) {
+		dprintf(CRITICAL, "update_ubi_vol: fastmap invalidation failed\n");
+		goto out;
+	}
+
+	/* Then erase the rest of the volume used PEBs */
+	for (curr_peb = 0; curr_peb < (int)ptn->length; curr_peb++) {
+		pi = &si->pebs_data[curr_peb];
+		if (pi->status != UBI_USED_PEB || pi->volume != vol_id)
+			continue;
+		if (pi->lnum >= 0 && pi->lnum < img_pebs &&
+				leb_peb[pi->lnum] == curr_peb)
+			continue;
 		if (ubi_erase_peb(ptn->start + curr_peb, si, ptn->start))
 			goto out;
-		curr_peb++;
 	}
 
-	/* Flash the image */
-	img_peb = data;
-	lnum = 0;
-	for (curr_peb = 0;
-			curr_peb < (int)ptn->length && size && vol_pebs;
-			curr_peb++) {
-		if (si->pebs_data[curr_peb].status != UBI_FREE_PEB &&
-			si->pebs_data[curr_peb].status != UBI_EMPTY_PEB)
+	/* Flash the LEBs of the image that changed */
+	curr_peb = 0;
+	for (lnum = 0; lnum < img_pebs; lnum++) {
+		if (leb_peb[lnum] != -1)
 			continue;
 
+		while (curr_peb < (int)ptn->length &&
+				si->pebs_data[curr_peb].status != UBI_FREE_PEB &&
+				si->pebs_data[curr_peb].status != UBI_EMPTY_PEB)
+			curr_peb++;
+		if (curr_peb == (int)ptn->length) {
+			dprintf(CRITICAL,
+				"update_ubi_vol: Not enough available PEBs for writing the volume\n");
+			goto out;
+		}
+
+		len = MIN(size - lnum * leb_size, leb_size);
 		if (write_one_peb(curr_peb, ptn->start, si,
-				lnum++, vol_id, img_peb,
-				(size < block_size - si->data_offs ? size :
-						block_size - si->data_offs))) {
+				lnum, vol_id, data + lnum * leb_size, len)) {
 			dprintf(CRITICAL, "update_ubi_vol: write_one_peb failed\n");
 			goto out;
 		}
-		if (size < block_size - si->data_offs)
-			size = 0;
-		else
-			size -= (block_size - si->data_offs);
-		vol_pebs--;
-		img_peb += block_size - si->data_offs;
+		curr_peb++;
 	}
 
-	if (size) {
-		dprintf(CRITICAL,
-			"update_ubi_vol: Not enough available PEBs for writing the volume\n");
-		goto out;
-	}
+	dprintf(INFO, "update_ubi_vol: %d of %d LEBs of %s unchanged\n",
+			kept, img_pebs, vol_name);
 	ret = 0;
 out:
+	free(leb_peb);
 	free(si->pebs_data);
 	free(si);
 	return ret;
 }
-
-
@@ -44,9 +44,12 @@
 #include <target.h>
 #include "hsusb.h"
 
-#define MAX_TD_XFER_SIZE  (16 * 1024)
-
-BUF_DMA_ALIGN(transfer_desc_item, ROUNDUP(sizeof(struct ept_queue_item), CACHE_LINE));
+/*
+ * A TD points to 5 pages of the buffer. It takes all 5 when the buffer
+ * is page aligned, 4 otherwise, so every TD but the last is a multiple
+ * of the max packet size.
+ */
+#define MAX_TD_XFER_SIZE  (5 * 4096)
 
 /* common code - factor out into a shared file */
 
@@ -131,7 +134,8 @@ __WEAK void hsusb_clock_init(void)
 
 struct usb_request {
 	struct udc_request req;
-	struct ept_queue_item *item;
+	struct ept_queue_item *item;	/* TDs of the request, chained in order */
+	unsigned num_items;
 };
 
 struct udc_endpoint {
@@ -262,71 +266,163 @@ struct udc_request *udc_request_alloc(void)
 	req->req.length = 0;
 	req->item = memalign(CACHE_LINE, ROUNDUP(sizeof(struct ept_queue_item),
 								CACHE_LINE));
+	ASSERT(req->item);
+	req->num_items = 1;
 	return &req->req;
 }
 
-void udc_request_free(struct udc_request *req)
+void udc_request_free(struct udc_request *_req)
 {
+	struct usb_request *req = (struct usb_request *)_req;
+
+	free(req->item);
 	free(req);
 }
 
+/* Bytes of the len bytes at phys the next TD can take */
+static unsigned hsusb_td_xfer(unsigned phys, unsigned len)
+{
+	unsigned max = (phys & 0xfff) ? MAX_TD_XFER_SIZE - 4096 : MAX_TD_XFER_SIZE;
+
+	return (len > max) ? max : len;
+}
+
+/* Number of TDs needed to transfer len bytes at phys, at least one */
+unsigned hsusb_td_count(unsigned phys, unsigned len)
+{
+	unsigned count = 0;
+	unsigned xfer;
+
+	do {
+		xfer = hsusb_td_xfer(phys, len);
+		phys += xfer;
+		len -= xfer;
+		count++;
+	} while (len > 0);
+
+	return count;
+}
+
 /*
- * Assumes that TDs allocated already are not freed.
- * But it can handle case where TDs are freed as well.
+ * Fill the hsusb_td_count() TDs at item to transfer len bytes at phys.
+ * The TDs are chained in order & the last one terminates the chain.
+ * Every TD raises the interrupt: a short packet retires the TD it lands
+ * in but leaves the rest of the chain active, so the last TD may never
+ * complete.
  */
-int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
+void hsusb_td_chain_fill(struct ept_queue_item *item, unsigned phys,
+			 unsigned len)
 {
-	unsigned xfer = 0;
-	struct ept_queue_item *item, *curr_item;
-	struct usb_request *req = (struct usb_request *)_req;
-	unsigned phys = (unsigned)req->req.buf;
-	unsigned len = req->req.length;
+	unsigned xfer;
+	unsigned page;
 
-	xfer = (len > MAX_TD_XFER_SIZE) ? MAX_TD_XFER_SIZE : len;
-	/*
-	 * First TD allocated during request allocation
-	 */
-	curr_item = req->item;
-	curr_item->info = INFO_BYTES(xfer) | INFO_ACTIVE;
-	curr_item->page0 = phys;
-	curr_item->page1 = (phys & 0xfffff000) + 0x1000;
-	curr_item->page2 = (phys & 0xfffff000) + 0x2000;
-	curr_item->page3 = (phys & 0xfffff000) + 0x3000;
-	curr_item->page4 = (phys & 0xfffff000) + 0x4000;
-	phys += xfer;
-	len -= xfer;
-
-	/*
-	 * If transfer length is more then
-	 * accomodate by 1 TD
-	 * we add more transfer descriptors
-	 */
-	while (len > 0) {
-		xfer = (len > MAX_TD_XFER_SIZE) ? MAX_TD_XFER_SIZE : len;
-		if (curr_item->next == TERMINATE) {
-				curr_item->next = PA((addr_t)transfer_desc_item);
-				item = (struct ept_queue_item *)transfer_desc_item;
-				item->next = TERMINATE;
-		} else
-			/* Since next TD in chain already exists */
-			item = (struct ept_queue_item *)VA(curr_item->next);
-
-		/* Update TD with transfer information */
-		item->info = INFO_BYTES(xfer) | INFO_ACTIVE;
-		item->page0 = phys;
-		item->page1 = (phys & 0xfffff000) + 0x1000;
-		item->page2 = (phys & 0xfffff000) + 0x2000;
-		item->page3 = (phys & 0xfffff000) + 0x3000;
-		item->page4 = (phys & 0xfffff000) + 0x4000;
+	while (1) {
+		xfer = hsusb_td_xfer(phys, len);
+		page = phys & 0xfffff000;
 
-		curr_item = item;
+		item->info = INFO_BYTES(xfer) | INFO_IOC | INFO_ACTIVE;
+		item->page0 = phys;
+		item->page1 = page + 0x1000;
+		item->page2 = page + 0x2000;
+		item->page3 = page + 0x3000;
+		item->page4 = page + 0x4000;
+		phys += xfer;
 		len -= xfer;
+
+		if (len == 0)
+			break;
+
+		item->next = PA((addr_t)(item + 1));
+		item++;
+	}
+
+	/* Terminate the chain at the last TD */
+	item->next = TERMINATE;
+}
+
+/*
+ * Check the TDs at item, filled by hsusb_td_chain_fill() for len bytes
+ * at phys, as retired by the controller. Counts the bytes transferred in
+ * actual. Returns 0 once the last TD or a short one was retired, 1 while
+ * the controller is still working through the chain, or -1 if it failed
+ * a TD.
+ */
+int hsusb_td_chain_complete(struct ept_queue_item *item, unsigned phys,
+			    unsigned len, unsigned *actual)
+{
+	unsigned xfer;
+	unsigned left;
+
+	*actual = 0;
+
+	while (1) {
+		xfer = hsusb_td_xfer(phys, len);
+
+		/*
+		 * Must clean/invalidate cached item
+		 * data before checking the status
+		 * every time.
+		 */
+		arch_invalidate_cache_range((addr_t)(item),
+					    sizeof(struct ept_queue_item));
+
+		if (readl(&item->info) & INFO_ACTIVE)
+			return 1;
+
+		if ((item->info) & 0xff) {
+			/* error */
+			dprintf(INFO, "TD FAIL nfo=%x pg0=%x\n",
+				item->info, item->page0);
+			return -1;
+		}
+
+		/* The TD holds the bytes it did not transfer */
+		left = (item->info >> 16) & 0x7FFF;
+		*actual += xfer - left;
 		phys += xfer;
+		len -= xfer;
+
+		/* A short packet ends the transfer, the TDs after it stay active */
+		if (left || item->next == TERMINATE)
+			break;
+
+		/*Move to next item in chain*/
+		item = (struct ept_queue_item *)VA(item->next);
+	}
+
+	return 0;
+}
+
+/*
+ * Queue a request of up to several MB in one go, as a chain of TDs the
+ * controller works through on its own. The TDs of the request are only
+ * reallocated when it needs more than it had so far.
+ */
+int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
+{
+	struct ept_queue_item *item;
+	struct usb_request *req = (struct usb_request *)_req;
+	unsigned phys = (unsigned)req->req.buf;
+	unsigned len = req->req.length;
+	unsigned count;
+
+	count = hsusb_td_count(phys, len);
+	if (count > req->num_items) {
+		item = memalign(CACHE_LINE,
+				ROUNDUP(count * sizeof(struct ept_queue_item),
+					CACHE_LINE));
+		if (!item) {
+			dprintf(CRITICAL, "udc_request_queue: no memory for %u TDs\n",
+				count);
+			return -1;
+		}
+		free(req->item);
+		req->item = item;
+		req->num_items = count;
 	}
 
-	/* Terminate and set interrupt for last TD */
-	curr_item->next = TERMINATE;
-	curr_item->info |= INFO_IOC;
+	hsusb_td_chain_fill(req->item, phys, len);
+
 	enter_critical_section();
 	ept->head->next = PA((addr_t)req->item);
 	ept->head->info = 0;
@@ -340,17 +436,9 @@ int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 	arch_clean_invalidate_cache_range((addr_t) VA((addr_t)req->req.buf),
 					  req->req.length);
 
-	item = req->item;
 	/* Write all TD's to memory from cache */
-	while (item != NULL) {
-		curr_item = item;
-		if (curr_item->next == TERMINATE)
-			item = NULL;
-		else
-			item =  (struct ept_queue_item *)curr_item->next;
-		arch_clean_invalidate_cache_range((addr_t) curr_item,
-					  sizeof(struct ept_queue_item));
-	}
+	arch_clean_invalidate_cache_range((addr_t) req->item,
+					  count * sizeof(struct ept_queue_item));
 
 	DBG("ept%d %s queue req=%p\n", ept->num, ept->in ? "in" : "out", req);
 	writel(ept->bit, USB_ENDPTPRIME);
@@ -360,8 +448,7 @@ int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 
 static void handle_ept_complete(struct udc_endpoint *ept)
 {
-	struct ept_queue_item *item;
-	unsigned actual, total_len;
+	unsigned actual;
 	int status;
 	struct usb_request *req=NULL;
 
@@ -379,59 +466,23 @@ static void handle_ept_complete(struct udc_endpoint *ept)
 	}
 
 	if (req) {
-		item = (struct ept_queue_item *)VA((addr_t)req->item);
-		/* total transfer length for transacation */
-		total_len = req->req.length;
-		ept->req = 0;
-		actual = 0;
-		while(1) {
-
-			do {
-				/*
-				 * Must clean/invalidate cached item
-				 * data before checking the status
-				 * every time.
-				 */
-				arch_invalidate_cache_range((addr_t)(item),
-							sizeof(
-							struct ept_queue_item));
-
-			} while(readl(&item->info) & INFO_ACTIVE);
-
-			if ((item->info) & 0xff) {
-				/* error */
-				status = -1;
-				dprintf(INFO, "EP%d/%s FAIL nfo=%x pg0=%x\n",
-					ept->num, ept->in ? "in" : "out",
-					item->info,
-					item->page0);
-				goto out;
-			}
+		status = hsusb_td_chain_complete(
+				(struct ept_queue_item *)VA((addr_t)req->item),
+				(unsigned)req->req.buf, req->req.length, &actual);
+		/* Every TD interrupts, wait for the one ending the chain */
+		if (status > 0)
+			return;
 
-			/* Check if we are processing last TD */
-			if (item->next == TERMINATE) {
-				/*
-				 * Record the data transferred for the last TD
-				 */
-				actual += (total_len - (item->info >> 16))
-								& 0x7FFF;
-				total_len = 0;
-				break;
-			} else {
-				/*
-				 * Since we are not in last TD
-				 * the total assumed transfer ascribed to this
-				 * TD woulb the max possible TD transfer size
-				 * (16K)
-				 */
-				actual += (MAX_TD_XFER_SIZE - (item->info >> 16)) & 0x7FFF;
-				total_len -= (MAX_TD_XFER_SIZE - (item->info >> 16)) & 0x7FFF;
-				/*Move to next item in chain*/
-				item = (struct ept_queue_item *)VA(item->next);
-			}
+		ept->req = 0;
+		if (status) {
+			dprintf(INFO, "EP%d/%s FAIL\n",
+				ept->num, ept->in ? "in" : "out");
+		} else if (actual != req->req.length) {
+			/* Drop the TDs a short packet left active */
+			writel(ept->bit, USB_ENDPTFLUSH);
+			while (readl(USB_ENDPTFLUSH) & ept->bit);
 		}
-		status = 0;
-out:
+
 		if (req->req.complete)
 			req->req.complete(&req->req, actual, status);
 	}
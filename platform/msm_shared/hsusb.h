@@ -181,4 +181,11 @@ struct ept_queue_item {
 #define ULPI_MISC_A_VBUSVLDEXTSEL    (1 << 1)
 #define ULPI_MISC_A_VBUSVLDEXT       (1 << 0)
 
+/* Chains of TDs for one request, hsusb_td_count() TDs long */
+unsigned hsusb_td_count(unsigned phys, unsigned len);
+void hsusb_td_chain_fill(struct ept_queue_item *item, unsigned phys,
+			 unsigned len);
+int hsusb_td_chain_complete(struct ept_queue_item *item, unsigned phys,
+			    unsigned len, unsigned *actual);
+
 #endif
@@ -269,6 +269,11 @@ int bam_wait_for_interrupt(struct bam_instance *bam,
                            uint8_t pipe_num,
                            enum p_int_type interrupt);
 void bam_read_offset_update(struct bam_instance *bam, unsigned int pipe_num);
+uint32_t bam_fifo_offset(struct bam_instance *bam, uint8_t pipe_num);
+int bam_wait_for_offset(struct bam_instance *bam,
+                        uint8_t pipe_num,
+                        uint32_t start,
+                        uint32_t end);
 void bam_pipe_reset(struct bam_instance *bam,
 					uint8_t pipe_num);
 
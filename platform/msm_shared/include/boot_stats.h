@@ -30,6 +30,10 @@
 #ifndef __BOOT_STATS_H
 #define __BOOT_STATS_H
 
+#include <stdint.h>
+
+struct fdt_batch;
+
 /* The order of the entries in this enum does not correspond to bootup order.
  * It is mandated by the expected order of the entries in imem when the values
  * are read in the kernel.
@@ -45,4 +49,25 @@ enum bs_entry {
 };
 void bs_set_timestamp(enum bs_entry bs_id);
 
+/* Boot profile: named spans and markers over the whole boot, timed by the
+ * sleep clock.  The last BS_PROFILE_MAX_ENTRIES are kept, oldest dropped
+ * first.  Names are not copied and must stay valid, string literals are best.
+ * The BS_* timestamps above are recorded here as well.
+ */
+#define BS_PROFILE_MAX_ENTRIES  64
+#define BS_PROFILE_NAME_LEN     24
+
+/* Start a span, returns the handle to end it with */
+int bs_profile_begin(const char *name);
+void bs_profile_end(int span);
+/* Record a single point in time */
+void bs_profile_mark(const char *name);
+
+/* Format the profile a line at a time for print(), returns the entry count */
+unsigned bs_profile_dump(void (*print)(const char *line));
+/* Print the profile on the console */
+void bs_profile_print(void);
+/* Queue the profile on batch for the device tree as /chosen/lk-boot-profile */
+int bs_profile_update_dt(const void *fdt, struct fdt_batch *batch);
+
 #endif
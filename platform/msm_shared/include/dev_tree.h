@@ -105,26 +105,18 @@ struct pmic_id
 	uint32_t pmic_version[4];
 };
 
+/* Room for 32 RAM partitions with 64 bit address and size. */
+#define DTB_MEM_REG_MAX_CELLS   128
+
 struct dt_mem_node_info
 {
 	uint32_t offset;
 	uint32_t mem_info_cnt;
 	uint32_t addr_cell_size;
 	uint32_t size_cell_size;
-};
-
-enum dt_entry_info
-{
-	DTB_FOUNDRY = 0,
-	DTB_SOC,
-	DTB_MAJOR_MINOR,
-	DTB_PMIC0,
-	DTB_PMIC1,
-	DTB_PMIC2,
-	DTB_PMIC3,
-	DTB_PMIC_MODEL,
-	DTB_PANEL_TYPE,
-	DTB_BOOT_DEVICE,
+	/* reg property of the memory node, written out by update_device_tree() */
+	uint32_t reg_cells;
+	uint32_t reg[DTB_MEM_REG_MAX_CELLS];
 };
 
 enum dt_err_codes
@@ -133,11 +125,6 @@ enum dt_err_codes
 	DT_OP_FAILURE = -1,
 };
 
-typedef struct dt_entry_node {
-	struct list_node node;
-	struct dt_entry * dt_entry_m;
-}dt_node;
-
 int dev_tree_validate(struct dt_table *table, unsigned int page_size, uint32_t *dt_hdr_size);
 int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_info);
 int update_device_tree(void *fdt, const char *, void *, unsigned);
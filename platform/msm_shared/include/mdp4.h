@@ -119,6 +119,12 @@ int mdp_get_revision();
 int mdp_edp_config(struct msm_panel_info *pinfo, struct fbcon_config *fb);
 int mdp_edp_on(struct msm_panel_info *pinfo);
 int mdp_edp_off(void);
+int mdp_dsi_cmd_update_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb, uint32_t start, uint32_t end);
+int mdp_dsi_cmd_reset_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb);
+int mdp_set_scanout(struct msm_panel_info *pinfo, struct fbcon_config *fb,
+		void *base);
 
 int mdss_hdmi_init(void);
 int mdss_hdmi_on(struct msm_panel_info *pinfo);
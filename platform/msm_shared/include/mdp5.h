@@ -99,9 +99,12 @@
 
 #define MDP_HW_REV                              REG_MDP(0x0100)
 #define MDP_INTR_EN                             REG_MDP(0x0110)
+#define MDP_INTR_STATUS                         REG_MDP(0x0114)
 #define MDP_INTR_CLEAR                          REG_MDP(0x0118)
 #define MDP_HIST_INTR_EN                        REG_MDP(0x011C)
 
+#define MDP_INTR_PP_0_DONE                      BIT(8)
+
 #define MDP_DISP_INTF_SEL                       REG_MDP(0x0104)
 #define MDP_VIDEO_INTF_UNDERFLOW_CTL            REG_MDP(0x03E0)
 #define MDP_UPPER_NEW_ROI_PRIOR_RO_START        REG_MDP(0x02EC)
@@ -229,6 +232,12 @@ int mipi_dsi_cmd_config(struct fbcon_config mipi_fb_cfg,
 			unsigned short num_of_lanes);
 int mdp_dsi_video_on(struct msm_panel_info *pinfo);
 int mdp_dma_on(struct msm_panel_info *pinfo);
+int mdp_dsi_cmd_update_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb, uint32_t start, uint32_t end);
+int mdp_dsi_cmd_reset_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb);
+int mdp_set_scanout(struct msm_panel_info *pinfo, struct fbcon_config *fb,
+		void *base);
 int mdp_edp_config(struct msm_panel_info *pinfo, struct fbcon_config *fb);
 int mdp_edp_on(struct msm_panel_info *pinfo);
 int mdp_edp_off(void);
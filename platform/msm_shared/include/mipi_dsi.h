@@ -277,6 +277,8 @@ int mdss_dsi_cmds_tx(struct mipi_panel_info *mipi,
 	struct mipi_dsi_cmd *cmds, int count, char dual_dsi);
 int mdss_dsi_cmds_rx(struct mipi_panel_info *mipi, uint32_t **rp, int rp_len,
 	int rdbk_len);
+int mdss_dsi_cmd_set_rows(struct msm_panel_info *pinfo, uint32_t start,
+	uint32_t end);
 int32_t mdss_dsi_auto_pll_config(uint32_t pll_base, uint32_t ctl_base,
 	struct mdss_dsi_pll_config *pd);
 void mdss_dsi_auto_pll_20nm_config(struct msm_panel_info *pinfo);
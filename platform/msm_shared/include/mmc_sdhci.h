@@ -30,6 +30,7 @@
 #define __MMC_SDHCI_H__
 
 #include <sdhci.h>
+#include <sdhci_cmdq.h>
 
 /* Emmc Card bus commands */
 #define CMD0_GO_IDLE_STATE                        0
@@ -104,6 +105,9 @@
 #define MMC_HC_ERASE_GRP_SIZE                     224
 #define MMC_PARTITION_CONFIG                      179
 #define MMC_EXT_CSD_EN_RPMB_REL_WR                166 //emmc 5.1 and above
+#define MMC_EXT_CSD_CMDQ_MODE_EN                  15
+#define MMC_EXT_CSD_CMDQ_DEPTH                    307
+#define MMC_EXT_CSD_CMDQ_SUPPORT                  308
 
 /* Values for ext csd fields */
 #define MMC_HS_TIMING                             0x1
@@ -119,6 +123,16 @@
 #define MMC_SEC_COUNT2_SHIFT                      8
 #define MMC_HC_ERASE_MULT                         (512 * 1024)
 #define RST_N_FUNC_ENABLE                         BIT(0)
+#define MMC_CMDQ_SUPPORTED                        BIT(0)
+#define MMC_CMDQ_DEPTH_MASK                       0x1F
+#define MMC_CMDQ_MODE_ENABLE                      0x1
+#define MMC_CMDQ_MODE_DISABLE                     0x0
+
+/*
+ * Transfers of at least this many blocks go through the command queue,
+ * smaller ones are not worth the two CMD6s it takes to enter & leave it
+ */
+#define MMC_CMDQ_MIN_BLKS                         (2 * CMDQ_MAX_TASK_BLKS)
 
 /* RPMB Related */
 #define RPMB_PART_MIN_SIZE                        (128 * 2014)
@@ -311,6 +325,7 @@ struct mmc_card {
 	uint32_t raw_scr[2];     /* SCR for SD card */
 	uint32_t rpmb_size;      /* Size of rpmb partition */
 	uint32_t rel_wr_count;   /* Reliable write count */
+	uint32_t cmdq_depth;     /* Command queue depth in use, 0 if no cmdq */
 	struct mmc_cid cid;      /* CID structure */
 	struct mmc_csd csd;      /* CSD structure */
 	struct mmc_sd_scr scr;   /* SCR structure */
@@ -321,6 +336,7 @@ struct mmc_card {
 struct mmc_config_data {
 	uint8_t slot;          /* Sdcc slot used */
 	uint32_t pwr_irq;       /* Power Irq from card to host */
+	uint32_t sdhc_irq;      /* Host controller irq, 0 to poll for completion */
 	uint32_t sdhc_base;    /* Base address for the sdhc */
 	uint32_t pwrctl_base;  /* Base address for power control registers */
 	uint16_t bus_width;    /* Bus width used */
@@ -328,6 +344,7 @@ struct mmc_config_data {
 	uint8_t hs200_support; /* SDHC HS200 mode supported or not */
 	uint8_t hs400_support; /* SDHC HS400 mode supported or not */
 	uint8_t use_io_switch; /* IO pad switch flag for shared sdc controller */
+	uint32_t cmdq_base;    /* Base address for the command queue engine, 0 if none */
 };
 
 /* mmc device structure */
@@ -335,6 +352,7 @@ struct mmc_device {
 	struct sdhci_host host;          /* Handle to host controller */
 	struct mmc_card card;            /* Handle to mmc card */
 	struct mmc_config_data config;   /* Handle for the mmc config data */
+	struct cmdq_host cmdq;           /* Command queue engine, if cmdq_depth */
 };
 
 /*
@@ -346,6 +364,8 @@ struct mmc_device *mmc_init(struct mmc_config_data *);
 uint32_t mmc_sdhci_read(struct mmc_device *dev, void *dest, uint64_t blk_addr, uint32_t num_blocks);
 /* API: Write requried number of blocks from source to card */
 uint32_t mmc_sdhci_write(struct mmc_device *dev, void *src, uint64_t blk_addr, uint32_t num_blocks);
+/* API: Largest transfer in bytes mmc_sdhci_read/write take in one call */
+uint32_t mmc_sdhci_max_trans_size(struct mmc_device *dev);
 /* API: Erase len bytes (after converting to number of erase groups), from specified address */
 uint32_t mmc_sdhci_erase(struct mmc_device *dev, uint32_t blk_addr, uint64_t len);
 /* API: Write protect or release len bytes (after converting to number of write protect groups) from specified start address*/
@@ -0,0 +1,95 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __NAND_BBT_H__
+#define __NAND_BBT_H__
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * In RAM bad block table, shared by the nand drivers.
+ *
+ * Two bits per block, so that a lookup is a shift & mask. A block's bad
+ * block marker is read from the flash the first time the block is used
+ * & the result kept for the rest of the boot; marking a block bad
+ * updates the table too. No table is kept on the flash: the markers in
+ * the blocks stay the only record, as the kernel expects.
+ */
+enum nand_bbt_state
+{
+	NAND_BBT_UNKNOWN = 0,  /* Marker not read yet */
+	NAND_BBT_GOOD = 1,
+	NAND_BBT_BAD = 2,
+};
+
+#define NAND_BBT_BLKS_PER_WORD           16
+
+struct nand_bbt
+{
+	uint32_t *map;
+	uint32_t num_blocks;
+};
+
+/* Returns 0 on success, 1 if the table could not be allocated */
+static inline int nand_bbt_init(struct nand_bbt *bbt, uint32_t num_blocks)
+{
+	uint32_t words = (num_blocks + NAND_BBT_BLKS_PER_WORD - 1) / NAND_BBT_BLKS_PER_WORD;
+
+	bbt->num_blocks = num_blocks;
+	bbt->map = (uint32_t *) malloc(words * sizeof(uint32_t));
+	if (!bbt->map)
+		return 1;
+
+	memset(bbt->map, 0, words * sizeof(uint32_t));
+
+	return 0;
+}
+
+static inline enum nand_bbt_state nand_bbt_get(struct nand_bbt *bbt, uint32_t blk)
+{
+	if (blk >= bbt->num_blocks)
+		return NAND_BBT_BAD;
+
+	return (bbt->map[blk / NAND_BBT_BLKS_PER_WORD] >>
+		((blk % NAND_BBT_BLKS_PER_WORD) * 2)) & 0x3;
+}
+
+static inline void nand_bbt_set(struct nand_bbt *bbt, uint32_t blk, enum nand_bbt_state state)
+{
+	uint32_t shift = (blk % NAND_BBT_BLKS_PER_WORD) * 2;
+
+	if (blk >= bbt->num_blocks)
+		return;
+
+	bbt->map[blk / NAND_BBT_BLKS_PER_WORD] &= ~(0x3U << shift);
+	bbt->map[blk / NAND_BBT_BLKS_PER_WORD] |= ((uint32_t) state << shift);
+}
+
+#endif
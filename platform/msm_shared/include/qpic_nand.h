@@ -230,13 +230,6 @@ typedef enum {
 	NANDC_RESULT_BAD_BLOCK = 6,
 } nand_result_t;
 
-enum nand_bad_block_value
-{
-	NAND_BAD_BLK_VALUE_NOT_READ,
-	NAND_BAD_BLK_VALUE_IS_BAD,
-	NAND_BAD_BLK_VALUE_IS_GOOD,
-};
-
 enum nand_cfg_value
 {
 	NAND_CFG_RAW,
@@ -356,9 +349,13 @@ qpic_nand_uninit();
 uint32_t nand_device_base();
 nand_result_t qpic_nand_read(uint32_t start_page, uint32_t num_pages,
 		unsigned char* buffer, unsigned char* spareaddr);
+nand_result_t qpic_nand_read_heads(uint32_t start_page, uint32_t num_blocks,
+		uint32_t num_pages, unsigned char* buffer, int *results);
 nand_result_t qpic_nand_write(uint32_t start_page, uint32_t num_pages,
 		unsigned char* buffer, unsigned  write_extra_bytes);
 nand_result_t qpic_nand_block_isbad(unsigned page);
 nand_result_t qpic_nand_blk_erase(uint32_t page);
+/* Api to return the number of erased page checks done in software */
+uint32_t qpic_nand_erased_page_fallbacks();
 
 #endif
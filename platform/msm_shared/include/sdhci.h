@@ -51,6 +51,7 @@ struct host_caps {
 	uint32_t max_blk_len;    /* Max block len supported */
 	uint8_t bus_width_8bit;  /* 8 Bit mode supported */
 	uint8_t adma_support;    /* Adma support */
+	uint8_t adma_64bit;      /* 64 bit adma, data may live above 4 GB */
 	uint8_t voltage;         /* Supported voltage */
 	uint8_t sdr_support;     /* Single Data rate */
 	uint8_t ddr_support;     /* Dual Data rate */
@@ -73,8 +74,12 @@ struct sdhci_host {
 	uint16_t minor;          /* host controller major ver */
 	bool use_cdclp533;       /* Use cdclp533 calibration circuit */
 	event_t* sdhc_event;     /* Event for power control irqs */
+	uint32_t irq;            /* Host controller irq, 0 to poll for completion */
+	event_t irq_event;       /* Signalled by the host controller irq */
 	struct host_caps caps;   /* Host capabilities */
 	struct sdhci_msm_data *msm_host; /* MSM specific host info */
+	void *adma_desc;         /* Adma descriptor table, reused for every transfer */
+	uint32_t adma_desc_cnt;  /* Number of descriptors in the table */
 };
 
 /*
@@ -114,6 +119,16 @@ struct desc_entry {
 	uint32_t addr;       /* Address of the data */
 };
 
+/*
+ * Descriptor table for 64 bit adma, 96 bit entries
+ */
+struct desc_entry_64 {
+	uint16_t tran_att;   /* Attribute for transfer data */
+	uint16_t len;        /* Length of data */
+	uint32_t addr;       /* Lower 32 bits of the data address */
+	uint32_t addr_hi;    /* Upper 32 bits of the data address */
+} __PACKED;
+
 /*
  * Command types for sdhci
  */
@@ -176,6 +191,7 @@ enum {
 #define SDHCI_CAPS_REG2                           (0x044)
 #define SDHCI_ADM_ERR_REG                         (0x054)
 #define SDHCI_ADM_ADDR_REG                        (0x058)
+#define SDHCI_ADM_ADDR_HI_REG                     (0x05C)
 
 /*
  * Helper macros for register writes
@@ -249,12 +265,14 @@ enum {
 #define SDHCI_BLK_LEN_MASK                        0x00030000
 #define SDHCI_BLK_LEN_BIT                         16
 #define SDHCI_BLK_ADMA_MASK                       0x00080000
+#define SDHCI_64BIT_SYS_BUS_MASK                  0x10000000
 #define SDHCI_INT_STS_TRANS_COMPLETE              BIT(1)
 #define SDHCI_STATE_CMD_DAT_MASK                  0x0003
 #define SDHCI_INT_STS_CMD_COMPLETE                BIT(0)
 #define SDHCI_ERR_INT_STAT_MASK                   0x8000
 #define SDHCI_ADMA_DESC_LINE_SZ                   65536
 #define SDHCI_ADMA_MAX_TRANS_SZ                   (65535 * 512)
+#define SDHCI_ADMA_MAX_DESC                       ((SDHCI_ADMA_MAX_TRANS_SZ + SDHCI_ADMA_DESC_LINE_SZ - 1) / SDHCI_ADMA_DESC_LINE_SZ)
 #define SDHCI_ADMA_TRANS_VALID                    BIT(0)
 #define SDHCI_ADMA_TRANS_END                      BIT(1)
 #define SDHCI_ADMA_TRANS_DATA                     BIT(5)
@@ -268,6 +286,7 @@ enum {
 #define SDHCI_AUTO_CMD23_EN                       BIT(3)
 #define SDHCI_AUTO_CMD12_EN                       BIT(2)
 #define SDHCI_ADMA_32BIT                          BIT(4)
+#define SDHCI_ADMA_64BIT                          (BIT(4) | BIT(3))
 
 /*
  * Command related macros
@@ -0,0 +1,150 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SDHCI_CMDQ_H__
+#define __SDHCI_CMDQ_H__
+
+#include <sys/types.h>
+#include <bits.h>
+
+/*
+ * Command queue engine (CQHCI, eMMC 5.1) registers, relative to the
+ * base of the engine's register block
+ */
+#define CMDQ_VER_REG                              (0x000)
+#define CMDQ_CAP_REG                              (0x004)
+#define CMDQ_CFG_REG                              (0x008)
+#define CMDQ_CTL_REG                              (0x00C)
+#define CMDQ_IS_REG                               (0x010)
+#define CMDQ_ISTE_REG                             (0x014)
+#define CMDQ_ISGE_REG                             (0x018)
+#define CMDQ_IC_REG                               (0x01C)
+#define CMDQ_TDLBA_REG                            (0x020)
+#define CMDQ_TDLBAU_REG                           (0x024)
+#define CMDQ_TDBR_REG                             (0x028)
+#define CMDQ_TCN_REG                              (0x02C)
+#define CMDQ_DQS_REG                              (0x030)
+#define CMDQ_DPT_REG                              (0x034)
+#define CMDQ_TCLR_REG                             (0x038)
+#define CMDQ_SSC1_REG                             (0x040)
+#define CMDQ_SSC2_REG                             (0x044)
+#define CMDQ_CRDCT_REG                            (0x048)
+#define CMDQ_RMEM_REG                             (0x050)
+#define CMDQ_TERRI_REG                            (0x054)
+#define CMDQ_CRI_REG                              (0x058)
+#define CMDQ_CRA_REG                              (0x05C)
+#define CMDQ_REG_SPACE                            (0x060)
+
+/* Config register */
+#define CMDQ_ENABLE                               BIT(0)
+#define CMDQ_TASK_DESC_SZ_128                     BIT(8)
+#define CMDQ_DCMD                                 BIT(12)
+
+/* Control register */
+#define CMDQ_HALT                                 BIT(0)
+#define CMDQ_CLEAR_ALL_TASKS                      BIT(8)
+
+/* Interrupt status, status enable & signal enable */
+#define CMDQ_IS_HAC                               BIT(0)
+#define CMDQ_IS_TCC                               BIT(1)
+#define CMDQ_IS_RED                               BIT(2)
+#define CMDQ_IS_TCL                               BIT(3)
+#define CMDQ_IS_MASK                              (CMDQ_IS_HAC | CMDQ_IS_TCC | \
+                                                   CMDQ_IS_RED | CMDQ_IS_TCL)
+
+/* Task error info */
+#define CMDQ_TERRI_RESP_TASK(x)                   (((x) >> 8) & 0x1F)
+#define CMDQ_TERRI_RESP_VALID                     BIT(15)
+#define CMDQ_TERRI_DATA_TASK(x)                   (((x) >> 24) & 0x1F)
+#define CMDQ_TERRI_DATA_VALID                     BIT(31)
+
+/*
+ * Descriptor attributes, common to task, transfer & link descriptors
+ */
+#define CMDQ_DESC_VALID                           BIT(0)
+#define CMDQ_DESC_END                             BIT(1)
+#define CMDQ_DESC_INT                             BIT(2)
+#define CMDQ_DESC_ACT(x)                          (((x) & 0x7) << 3)
+#define CMDQ_DESC_ACT_MASK                        CMDQ_DESC_ACT(0x7)
+#define CMDQ_ACT_TRAN                             0x4
+#define CMDQ_ACT_TASK                             0x5
+#define CMDQ_ACT_LINK                             0x6
+
+/* Task descriptor, lower word; the upper word is the block address */
+#define CMDQ_TASK_FORCED_PROG                     BIT(6)
+#define CMDQ_TASK_DATA_DIR_READ                   BIT(12)
+#define CMDQ_TASK_PRIORITY                        BIT(13)
+#define CMDQ_TASK_REL_WRITE                       BIT(15)
+#define CMDQ_TASK_BLK_COUNT(x)                    (((x) & 0xFFFF) << 16)
+
+/* Transfer descriptor, lower word; followed by the data address */
+#define CMDQ_TRAN_LEN(x)                          (((x) & 0xFFFF) << 16)
+#define CMDQ_TRAN_LINE_SZ                         65536
+
+/*
+ * Engine limits: a task moves at most CMDQ_MAX_TASK_BLKS blocks, so each
+ * slot needs CMDQ_TRAN_DESC_PER_SLOT transfer descriptors
+ */
+#define CMDQ_MAX_SLOTS                            32
+#define CMDQ_MAX_TASK_BLKS                        2048
+#define CMDQ_TRAN_DESC_PER_SLOT                   ((CMDQ_MAX_TASK_BLKS * 512) / CMDQ_TRAN_LINE_SZ)
+
+/*
+ * Command queue engine state. Register access goes through read/write,
+ * which cmdq_host_init() points at the engine's registers.
+ */
+struct cmdq_host {
+	addr_t base;             /* Base address of the engine registers */
+	uint32_t num_slots;      /* Tasks that may be queued at once */
+	uint32_t max_task_blks;  /* Blocks per task */
+	bool dma64;              /* 64 bit descriptors */
+	uint32_t slot_sz;        /* Task + link descriptor size */
+	uint32_t tran_desc_sz;   /* Transfer descriptor size */
+	uint8_t *task_desc;      /* Task descriptor list, one entry per slot */
+	uint8_t *tran_desc;      /* Transfer descriptors, CMDQ_TRAN_DESC_PER_SLOT per slot */
+	uint32_t (*read)(struct cmdq_host *cq, uint32_t reg);
+	void (*write)(struct cmdq_host *cq, uint32_t val, uint32_t reg);
+	/* Error interrupt status of the host the engine sits in, may be NULL.
+	 * Task data errors only show up there & in TERRI. */
+	uint32_t (*host_err)(struct cmdq_host *cq);
+	void *priv;              /* For use by read/write & host_err */
+};
+
+#define CMDQ_READ32(cq, r)                        ((cq)->read((cq), (r)))
+#define CMDQ_WRITE32(cq, v, r)                    ((cq)->write((cq), (v), (r)))
+
+/* API: Allocate the descriptor lists for an engine queueing up to depth tasks */
+int cmdq_host_init(struct cmdq_host *cq, addr_t base, uint32_t depth, bool dma64);
+/* API: Point the engine at the descriptor lists & turn it on */
+void cmdq_enable(struct cmdq_host *cq, uint32_t rca);
+/* API: Halt the engine & turn it off */
+void cmdq_disable(struct cmdq_host *cq);
+/* API: Queue num_blocks blocks at blk_addr as tasks & wait for all of them */
+uint32_t cmdq_transfer(struct cmdq_host *cq, void *data, uint32_t blk_addr,
+					   uint32_t num_blocks, bool read);
+#endif
@@ -438,3 +438,21 @@ int mdss_hdmi_off(void)
 {
 	return NO_ERROR;
 }
+
+int mdp_dsi_cmd_update_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb, uint32_t start, uint32_t end)
+{
+	return ERR_NOT_SUPPORTED;
+}
+
+int mdp_dsi_cmd_reset_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb)
+{
+	return NO_ERROR;
+}
+
+int mdp_set_scanout(struct msm_panel_info *pinfo, struct fbcon_config *fb,
+		void *base)
+{
+	return ERR_NOT_SUPPORTED;
+}
@@ -41,6 +41,7 @@
 #include <scm.h>
 
 #define MDSS_MDP_MAX_PREFILL_FETCH	25
+#define MDSS_CMD_DONE_TIMEOUT		100	/* ms */
 
 int restore_secure_cfg(uint32_t id);
 
@@ -1227,6 +1228,150 @@ int mdp_dma_on(struct msm_panel_info *pinfo)
 	return NO_ERROR;
 }
 
+static bool mdss_cmd_kick_pending;
+static bool mdss_cmd_roi_partial;
+
+static int mdss_cmd_wait_done(void)
+{
+	uint32_t timeout = MDSS_CMD_DONE_TIMEOUT;
+
+	if (!mdss_cmd_kick_pending)
+		return NO_ERROR;
+
+	while (!(readl(MDP_INTR_STATUS) & MDP_INTR_PP_0_DONE)) {
+		if (!timeout--) {
+			dprintf(CRITICAL, "cmd mode transfer did not complete\n");
+			return ERR_TIMED_OUT;
+		}
+		mdelay(1);
+	}
+
+	writel(MDP_INTR_PP_0_DONE, MDP_INTR_CLEAR);
+	mdss_cmd_kick_pending = false;
+
+	return NO_ERROR;
+}
+
+static int mdss_cmd_kick(struct msm_panel_info *pinfo)
+{
+	writel(readl(MDP_INTR_EN) | MDP_INTR_PP_0_DONE, MDP_INTR_EN);
+	writel(MDP_INTR_PP_0_DONE, MDP_INTR_CLEAR);
+	mdss_cmd_kick_pending = true;
+
+	return mdp_dma_on(pinfo);
+}
+
+/*
+ * Point the single source pipe at lines start..end of the framebuffer at
+ * base and shrink the mixer and the DSI stream to match.
+ */
+static int mdss_cmd_set_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb, void *base, uint32_t start, uint32_t end)
+{
+	uint32_t left_pipe, right_pipe;
+	uint32_t width, size;
+	int ret;
+
+	ret = mdss_cmd_wait_done();
+	if (ret)
+		return ret;
+
+	mdp_select_pipe_type(pinfo, &left_pipe, &right_pipe);
+
+	width = fb->width - pinfo->border_left - pinfo->border_right;
+	size = ((end - start + 1) << 16) | width;
+
+	writel((uint32_t) base + start * fb->stride * fb->bpp / 8,
+		left_pipe + PIPE_SSPP_SRC0_ADDR);
+	writel(size, left_pipe + PIPE_SSPP_SRC_IMG_SIZE);
+	writel(size, left_pipe + PIPE_SSPP_SRC_SIZE);
+	writel(size, left_pipe + PIPE_SSPP_SRC_OUT_SIZE);
+	writel(pinfo->border_left, left_pipe + PIPE_SSPP_SRC_XY);
+	writel(pinfo->border_left, left_pipe + PIPE_SSPP_OUT_XY);
+	writel(((end - start + 1) << 16) | fb->width,
+		MDP_VP_0_MIXER_0_BASE + LAYER_0_OUT_SIZE);
+
+	mdss_cmd_roi_partial = (start != 0 || end != fb->height - 1);
+
+	return mdss_dsi_cmd_set_rows(pinfo, start, end);
+}
+
+static bool mdss_cmd_rows_supported(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb)
+{
+	return pinfo->type == MIPI_CMD_PANEL && !pinfo->lcdc.dual_pipe &&
+		!pinfo->lcdc.split_display && !pinfo->mipi.dual_dsi &&
+		pinfo->compression_mode == COMPRESSION_NONE &&
+		!pinfo->border_top && !pinfo->border_bottom &&
+		!pinfo->orientation && fb->height == pinfo->yres;
+}
+
+/*
+ * Partial update for command mode panels: only lines start..end are
+ * fetched and sent over DSI, everything else stays in the panel's RAM.
+ */
+int mdp_dsi_cmd_update_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb, uint32_t start, uint32_t end)
+{
+	int ret;
+
+	if (!mdss_cmd_rows_supported(pinfo, fb) || start > end ||
+			end >= fb->height)
+		return ERR_NOT_SUPPORTED;
+
+	ret = mdss_cmd_set_rows(pinfo, fb, fb->base, start, end);
+	if (ret)
+		return ret;
+
+	return mdss_cmd_kick(pinfo);
+}
+
+/* Restore the full frame geometry, before handing the display over */
+int mdp_dsi_cmd_reset_rows(struct msm_panel_info *pinfo,
+		struct fbcon_config *fb)
+{
+	int ret = NO_ERROR;
+
+	if (mdss_cmd_roi_partial)
+		ret = mdss_cmd_set_rows(pinfo, fb, fb->base, 0, fb->height - 1);
+	if (!ret)
+		ret = mdss_cmd_wait_done();
+
+	return ret;
+}
+
+/* Scan out from base, which lies inside the memory fb was set up with */
+int mdp_set_scanout(struct msm_panel_info *pinfo, struct fbcon_config *fb,
+		void *base)
+{
+	uint32_t left_pipe, right_pipe;
+	uint32_t ctl0_reg_val, ctl1_reg_val;
+	int ret;
+
+	if (mdss_cmd_rows_supported(pinfo, fb)) {
+		ret = mdss_cmd_set_rows(pinfo, fb, base, 0, fb->height - 1);
+		if (ret)
+			return ret;
+		return mdss_cmd_kick(pinfo);
+	}
+
+	if (pinfo->type != MIPI_VIDEO_PANEL)
+		return ERR_NOT_SUPPORTED;
+
+	/* the right pipe fetches through SRC_XY, so both share the base */
+	mdp_select_pipe_type(pinfo, &left_pipe, &right_pipe);
+	writel((uint32_t) base, left_pipe + PIPE_SSPP_SRC0_ADDR);
+	if (pinfo->lcdc.dual_pipe)
+		writel((uint32_t) base, right_pipe + PIPE_SSPP_SRC0_ADDR);
+
+	mdss_mdp_set_flush(pinfo, &ctl0_reg_val, &ctl1_reg_val);
+	writel(ctl0_reg_val, MDP_CTL_0_BASE + CTL_FLUSH);
+	if (pinfo->lcdc.dual_pipe && !pinfo->lcdc.dst_split)
+		writel(ctl1_reg_val, MDP_CTL_1_BASE + CTL_FLUSH);
+
+	return NO_ERROR;
+}
+
 int mdp_edp_on(struct msm_panel_info *pinfo)
 {
 	uint32_t ctl0_reg_val, ctl1_reg_val;
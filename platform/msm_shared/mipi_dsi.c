@@ -804,6 +804,32 @@ int mdss_dsi_cmd_mode_config(struct msm_panel_info *pinfo,
 	return 0;
 }
 
+/*
+ * Limit the next command mode transfer to lines start..end: the stream
+ * is shortened to the band and the panel gets a matching page address.
+ */
+int mdss_dsi_cmd_set_rows(struct msm_panel_info *pinfo, uint32_t start,
+	uint32_t end)
+{
+	int ret = NO_ERROR;
+#if (DISPLAY_TYPE_MDSS == 1)
+	uint32_t ctl_base = pinfo->mipi.ctl_base;
+	uint32_t total = ((end - start + 1) << 16) | pinfo->xres;
+	char page_addr[] = {
+		0x05, 0x00, 0x39, 0xC0,
+		0x2b, start >> 8, start & 0xff, end >> 8,
+		end & 0xff, 0xFF, 0xFF, 0xFF,
+	};
+	struct mipi_dsi_cmd cmd = {sizeof(page_addr), page_addr, 0};
+
+	writel(total, ctl_base + COMMAND_MODE_MDP_STREAM0_TOTAL);
+	writel(total, ctl_base + COMMAND_MODE_MDP_STREAM1_TOTAL);
+
+	ret = mdss_dsi_cmds_tx(&pinfo->mipi, &cmd, 1, pinfo->mipi.broadcast);
+#endif
+	return ret;
+}
+
 int mipi_dsi_on(struct msm_panel_info *pinfo)
 {
 	int ret = NO_ERROR;
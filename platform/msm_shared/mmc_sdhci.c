@@ -28,6 +28,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <debug.h>
 #include <reg.h>
 #include <mmc_sdhci.h>
@@ -1092,6 +1093,7 @@ static uint8_t mmc_host_init(struct mmc_device *dev)
 
 	host->base = cfg->sdhc_base;
 	host->sdhc_event = &sdhc_event;
+	host->irq = cfg->sdhc_irq;
 	host->caps.hs200_support = cfg->hs200_support;
 	host->caps.hs400_support = cfg->hs400_support;
 
@@ -1472,6 +1474,50 @@ uint32_t mmc_sd_set_hs(struct sdhci_host *host, struct mmc_card *card)
 	return 0;
 }
 
+/* Task data errors are raised in the host's error status */
+static uint32_t mmc_cmdq_host_err(struct cmdq_host *cq)
+{
+	struct sdhci_host *host = cq->priv;
+
+	if (!(REG_READ16(host, SDHCI_NRML_INT_STS_REG) & SDHCI_ERR_INT_STAT_MASK))
+		return 0;
+
+	return REG_READ16(host, SDHCI_ERR_INT_STS_REG);
+}
+
+/*
+ * Function: mmc cmdq init
+ * Arg     : mmc device structure
+ * Return  : None
+ * Flow    : If both the target's host & the card support command
+ *           queueing, set up the engine for the card's queue depth.
+ *           The card is only switched to cmdq mode around the transfers
+ *           that use it, so every other command works as before.
+ */
+static void mmc_cmdq_init(struct mmc_device *dev)
+{
+	struct mmc_card *card = &dev->card;
+	uint32_t depth;
+
+	card->cmdq_depth = 0;
+
+	if (!dev->config.cmdq_base || card->type != MMC_TYPE_MMCHC ||
+		!(card->ext_csd[MMC_EXT_CSD_CMDQ_SUPPORT] & MMC_CMDQ_SUPPORTED))
+		return;
+
+	depth = (card->ext_csd[MMC_EXT_CSD_CMDQ_DEPTH] & MMC_CMDQ_DEPTH_MASK) + 1;
+
+	if (cmdq_host_init(&dev->cmdq, dev->config.cmdq_base, depth, dev->host.caps.adma_64bit))
+		return;
+
+	dev->cmdq.host_err = mmc_cmdq_host_err;
+	dev->cmdq.priv = &dev->host;
+
+	card->cmdq_depth = dev->cmdq.num_slots;
+
+	dprintf(INFO, "eMMC command queue depth: %u\n", card->cmdq_depth);
+}
+
 /*
  * Function: mmc_init_card
  * Arg     : mmc device structure
@@ -1692,6 +1738,7 @@ static uint32_t mmc_card_init(struct mmc_device *dev)
 			}
 		}
 
+		mmc_cmdq_init(dev);
 	}
 	return mmc_return;
 }
@@ -1738,6 +1785,7 @@ struct mmc_device *mmc_init(struct mmc_config_data *data)
 	memcpy((void*)&dev->config, (void*)data, sizeof(struct mmc_config_data));
 
 	memset((struct mmc_card *)&dev->card, 0, sizeof(struct mmc_card));
+	memset((struct sdhci_host *)&dev->host, 0, sizeof(struct sdhci_host));
 
 	/* Initialize the host & clock */
 	dprintf(SPEW, " Initializing MMC host data structure and clock!\n");
@@ -1835,6 +1883,70 @@ static uint32_t mmc_stop_command(struct mmc_device *dev)
 	return mmc_parse_response(cmd.resp[0]);
 }
 
+/*
+ * Function: mmc cmdq transfer
+ * Arg     : mmc device structure, data, block address, number of blocks
+ *           & direction
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : 1. Put the card in cmdq mode & enable the engine
+ *           2. Queue the transfer as tasks, wait for all of them
+ *           3. Disable the engine, reset the host after a task error
+ *           4. Put the card back in legacy mode
+ */
+static uint32_t mmc_cmdq_transfer(struct mmc_device *dev, void *data,
+								  uint64_t blk_addr, uint32_t num_blocks, bool read)
+{
+	struct sdhci_host *host = &dev->host;
+	struct mmc_card *card = &dev->card;
+	uint32_t mmc_ret;
+
+	mmc_ret = mmc_switch_cmd(host, card, MMC_ACCESS_WRITE, MMC_EXT_CSD_CMDQ_MODE_EN,
+							 MMC_CMDQ_MODE_ENABLE);
+	if (mmc_ret) {
+		dprintf(CRITICAL, "Failed to enable cmdq mode on the card\n");
+		return mmc_ret;
+	}
+
+	/* The engine uses the host's block size register */
+	REG_WRITE16(host, SDHCI_MMC_BLK_SZ, SDHCI_BLKSZ_REG);
+
+	cmdq_enable(&dev->cmdq, card->rca);
+	mmc_ret = cmdq_transfer(&dev->cmdq, data, blk_addr, num_blocks, read);
+	cmdq_disable(&dev->cmdq);
+
+	/* Clear a data error the tasks hit, the engine has dropped them */
+	if (mmc_ret) {
+		REG_WRITE16(host, REG_READ16(host, SDHCI_ERR_INT_STS_REG), SDHCI_ERR_INT_STS_REG);
+		sdhci_reset(host, (SOFT_RESET_CMD | SOFT_RESET_DATA));
+	}
+
+	if (mmc_switch_cmd(host, card, MMC_ACCESS_WRITE, MMC_EXT_CSD_CMDQ_MODE_EN,
+					   MMC_CMDQ_MODE_DISABLE)) {
+		dprintf(CRITICAL, "Failed to disable cmdq mode on the card\n");
+		mmc_ret = 1;
+	}
+
+	if (read)
+		arch_invalidate_cache_range((addr_t) data, num_blocks * SDHCI_MMC_BLK_SZ);
+
+	return mmc_ret;
+}
+
+/*
+ * Function: mmc sdhci max trans size
+ * Arg     : mmc device structure
+ * Return  : Size in bytes
+ * Flow    : Without the command queue a transfer is one command, limited
+ *           by the 16 bit block count; the queue splits transfers itself
+ */
+uint32_t mmc_sdhci_max_trans_size(struct mmc_device *dev)
+{
+	if (dev->card.cmdq_depth)
+		return UINT_MAX & ~(MMC_BLK_SZ - 1);
+
+	return SDHCI_ADMA_MAX_TRANS_SZ;
+}
+
 /*
  * Function: mmc sdhci read
  * Arg     : mmc device structure, block address, number of blocks & destination
@@ -1848,6 +1960,9 @@ uint32_t mmc_sdhci_read(struct mmc_device *dev, void *dest,
 	struct mmc_command cmd;
 	struct mmc_card *card = &dev->card;
 
+	if (card->cmdq_depth && num_blocks >= MMC_CMDQ_MIN_BLKS)
+		return mmc_cmdq_transfer(dev, dest, blk_addr, num_blocks, true);
+
 	memset((struct mmc_command *)&cmd, 0, sizeof(struct mmc_command));
 
 	/* CMD17/18 Format:
@@ -1917,6 +2032,9 @@ uint32_t mmc_sdhci_write(struct mmc_device *dev, void *src,
 	struct mmc_command cmd;
 	struct mmc_card *card = &dev->card;
 
+	if (card->cmdq_depth && num_blocks >= MMC_CMDQ_MIN_BLKS)
+		return mmc_cmdq_transfer(dev, src, blk_addr, num_blocks, false);
+
 	memset((struct mmc_command *)&cmd, 0, sizeof(struct mmc_command));
 
 	/* CMD24/25 Format:
@@ -111,7 +111,7 @@ uint32_t mmc_write(uint64_t data_addr, uint32_t data_len, void *in)
 	uint32_t val = 0;
 	int ret = 0;
 	uint32_t block_size = 0;
-	uint32_t write_size = SDHCI_ADMA_MAX_TRANS_SZ;
+	uint32_t write_size;
 	uint8_t *sptr = (uint8_t *)in;
 	void *dev;
 
@@ -132,11 +132,8 @@ uint32_t mmc_write(uint64_t data_addr, uint32_t data_len, void *in)
 
 	if (platform_boot_dev_isemmc())
 	{
-		/* TODO: This function is aware of max data that can be
-		 * tranferred using sdhci adma mode, need to have a cleaner
-		 * implementation to keep this function independent of sdhci
-		 * limitations
-		 */
+		/* Split the data into the largest transfers the card & host take */
+		write_size = mmc_sdhci_max_trans_size((struct mmc_device *)dev);
 		while (data_len > write_size) {
 			val = mmc_sdhci_write((struct mmc_device *)dev, (void *)sptr, (data_addr / block_size), (write_size / block_size));
 			if (val)
@@ -179,7 +176,7 @@ uint32_t mmc_read(uint64_t data_addr, uint32_t *out, uint32_t data_len)
 {
 	uint32_t ret = 0;
 	uint32_t block_size;
-	uint32_t read_size = SDHCI_ADMA_MAX_TRANS_SZ;
+	uint32_t read_size;
 	void *dev;
 	uint8_t *sptr = (uint8_t *)out;
 
@@ -199,11 +196,8 @@ uint32_t mmc_read(uint64_t data_addr, uint32_t *out, uint32_t data_len)
 
 	if (platform_boot_dev_isemmc())
 	{
-		/* TODO: This function is aware of max data that can be
-		 * tranferred using sdhci adma mode, need to have a cleaner
-		 * implementation to keep this function independent of sdhci
-		 * limitations
-		 */
+		/* Split the data into the largest transfers the card & host take */
+		read_size = mmc_sdhci_max_trans_size((struct mmc_device *)dev);
 		while (data_len > read_size) {
 			ret = mmc_sdhci_read((struct mmc_device *)dev, (void *)sptr, (data_addr / block_size), (read_size / block_size));
 			if (ret)
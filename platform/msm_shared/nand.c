@@ -33,6 +33,7 @@
 #include <dev/flash.h>
 #include <lib/ptable.h>
 #include <nand.h>
+#include <nand_bbt.h>
 
 #include "dmov.h"
 
@@ -76,7 +77,9 @@ static unsigned NAND_CFG0_RAW, NAND_CFG1_RAW;
 static unsigned ECC_BCH_CFG;
 
 static uint32_t enable_bch_ecc;
-static unsigned int *bbtbl;
+static struct nand_bbt bbt;
+
+static int flash_block_isbad(dmov_s * cmdlist, unsigned *ptrlist, unsigned page);
 
 #define CFG1_WIDE_FLASH (1U << 1)
 
@@ -529,7 +532,7 @@ flash_nand_erase_block(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
 		return -1;
 
 	/* Check for bad block and erase only if block is not marked bad */
-	isbad = flash_nand_block_isbad(cmdlist, ptrlist, page);
+	isbad = flash_block_isbad(cmdlist, ptrlist, page);
 
 	if (isbad) {
 		dprintf(INFO, "skipping @ %d (bad block)\n",
@@ -617,7 +620,7 @@ flash_nand_erase_block_interleave(dmov_s * cmdlist, unsigned *ptrlist,
 		return -1;
 
 	/* Check for bad block and erase only if block is not marked bad */
-	isbad = flash_nand_block_isbad(cmdlist, ptrlist, page);
+	isbad = flash_block_isbad(cmdlist, ptrlist, page);
 
 	if (isbad) {
 		dprintf(INFO, "skipping @ %d (bad block)\n", page >> 6);
@@ -807,33 +810,12 @@ _flash_nand_read_page(dmov_s * cmdlist, unsigned *ptrlist,
 	unsigned n;
 	int isbad = 0;
 	unsigned cwperpage;
-	unsigned block = 0;
 	cwperpage = (flash_pagesize >> 9);
 
-	/* Find the block no for the page */
-	block = page / num_pages_per_blk;
-
-	/* Check the bad block table for each block
-	 * -1: indicates the block needs to be checked if good or bad
-	 * 1 : The block is bad
-	 * 0 : The block is good
-	 */
-	if (bbtbl[block] == -1) {
-		isbad = flash_nand_block_isbad(cmdlist, ptrlist, page);
-		if (isbad) {
-			/* Found bad , set the bad table entry */
-			bbtbl[block] = 1;
-			return -2;
-		} else {
-			/* Found good block , set the table entry &
-			 *  continue reading the data
-			 */
-			bbtbl[block] = 0;
-		}
-	} else if (bbtbl[block] == 1) {
-		/* If the block is already identified as bad, return error */
+	/* Check for bad block and read only from a good block */
+	isbad = flash_block_isbad(cmdlist, ptrlist, page);
+	if (isbad)
 		return -2;
-	}
 
 	data->cmd = NAND_CMD_PAGE_READ_ECC;
 	data->addr0 = page << 16;
@@ -966,7 +948,7 @@ flash_nand_read_page_interleave(dmov_s * cmdlist, unsigned *ptrlist,
 	cwperpage = (flash_pagesize >> 9);
 
 	/* Check for bad block and read only from a good block */
-	isbad = flash_nand_block_isbad(cmdlist, ptrlist, page);
+	isbad = flash_block_isbad(cmdlist, ptrlist, page);
 	if (isbad)
 		return -2;
 
@@ -2033,7 +2015,7 @@ flash_onenand_erase_block(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
 		return -1;
 
 	/* Check for bad block and erase only if block is not marked bad */
-	isbad = flash_onenand_block_isbad(cmdlist, ptrlist, page);
+	isbad = flash_block_isbad(cmdlist, ptrlist, page);
 	if (isbad) {
 		dprintf(INFO, "skipping @ %d (bad block)\n",
 			page / num_pages_per_blk);
@@ -2329,7 +2311,7 @@ _flash_onenand_read_page(dmov_s * cmdlist, unsigned *ptrlist,
 	unsigned ecc_status;
 	if (raw_mode != 1) {
 		int isbad = 0;
-		isbad = flash_onenand_block_isbad(cmdlist, ptrlist, page);
+		isbad = flash_block_isbad(cmdlist, ptrlist, page);
 		if (isbad)
 			return -2;
 	}
@@ -3126,6 +3108,9 @@ flash_onenand_mark_badblock(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
 static int
 flash_mark_badblock(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
 {
+	/* Skip the block from now on, even if the marker can't be written */
+	nand_bbt_set(&bbt, page / num_pages_per_blk, NAND_BBT_BAD);
+
 	switch (flash_info.type) {
 	case FLASH_8BIT_NAND_DEVICE:
 	case FLASH_16BIT_NAND_DEVICE:
@@ -3291,6 +3276,28 @@ _flash_block_isbad(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
 	}
 }
 
+/* Check the bad block table, the flash is only asked once per block */
+static int
+flash_block_isbad(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
+{
+	unsigned block = page / num_pages_per_blk;
+	int isbad;
+
+	switch (nand_bbt_get(&bbt, block)) {
+	case NAND_BBT_GOOD:
+		return 0;
+	case NAND_BBT_BAD:
+		return 1;
+	default:
+		break;
+	}
+
+	isbad = _flash_block_isbad(cmdlist, ptrlist, page);
+	nand_bbt_set(&bbt, block, isbad ? NAND_BBT_BAD : NAND_BBT_GOOD);
+
+	return isbad;
+}
+
 static int
 _flash_write_page(dmov_s * cmdlist, unsigned *ptrlist,
 		  unsigned page, const void *_addr, const void *_spareaddr)
@@ -3321,7 +3328,6 @@ static struct ptable *flash_ptable = NULL;
 
 void flash_init(void)
 {
-	int i = 0;
 	ASSERT(flash_ptable == NULL);
 
 	flash_ptrlist = memalign(32, 1024);
@@ -3342,12 +3348,9 @@ void flash_init(void)
 			ASSERT(0);
 		}
 	}
-	/* Create a bad block table */
-	bbtbl =
-	    (unsigned int *)malloc(sizeof(unsigned int) *
-				   flash_info.num_blocks);
-	for (i = 0; i < flash_info.num_blocks; i++)
-		bbtbl[i] = -1;
+	/* Create a bad block table, filled in as the blocks are used */
+	if (nand_bbt_init(&bbt, flash_info.num_blocks))
+		ASSERT(0);
 }
 
 struct ptable *flash_get_ptable(void)
@@ -3414,8 +3417,8 @@ flash_read_ext(struct ptentry *ptn, unsigned extra_per_page,
 		while (start_block_count
 		       && (start_block < (ptn->start + ptn->length))) {
 			isbad =
-			    _flash_block_isbad(flash_cmdlist, flash_ptrlist,
-					       start_block * num_pages_per_blk);
+			    flash_block_isbad(flash_cmdlist, flash_ptrlist,
+					      start_block * num_pages_per_blk);
 			if (isbad)
 				page += num_pages_per_blk;
 			else
@@ -31,6 +31,7 @@
 #include <crc32.h>
 #include "mmc.h"
 #include "partition_parser.h"
+#include <boot_stats.h>
 #define GPT_HEADER_SIZE 92
 #define GPT_LBA 1
 #define PARTITION_ENTRY_SIZE 128
@@ -85,7 +86,7 @@ struct partition_entry *partition_entries;
 static unsigned gpt_partitions_exist = 0;
 static unsigned partition_count;
 
-unsigned int partition_read_table()
+static unsigned int partition_read_table_entries()
 {
 	unsigned int ret;
 	uint32_t block_size;
@@ -117,6 +118,18 @@ unsigned int partition_read_table()
 	return 0;
 }
 
+unsigned int partition_read_table()
+{
+	unsigned int ret;
+	int span;
+
+	span = bs_profile_begin("partition-table");
+	ret = partition_read_table_entries();
+	bs_profile_end(span);
+
+	return ret;
+}
+
 /*
  * Read MBR from MMC card and fill partition table.
  */
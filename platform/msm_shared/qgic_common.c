@@ -86,7 +86,9 @@ enum handler_return gic_platform_irq(struct arm_iframe *frame)
 	if (num >= NR_IRQS)
 		return 0;
 
+	ktrace_log(KTRACE_IRQ_ENTER, num, 0);
 	ret = handler[num].func(handler[num].arg);
+	ktrace_log(KTRACE_IRQ_EXIT, num, ret);
 
 	/* End of interrupt */
 	qgic_write_eoi(num);
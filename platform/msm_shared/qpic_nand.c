@@ -27,6 +27,7 @@
  */
 
 #include <qpic_nand.h>
+#include <nand_bbt.h>
 #include <bam.h>
 #include <dev/flash.h>
 #include <lib/ptable.h>
@@ -63,10 +64,38 @@ static struct bam_desc cmd_desc_fifo[QPIC_BAM_CMD_FIFO_SIZE] __attribute__ ((ali
 static struct bam_desc data_desc_fifo[QPIC_BAM_DATA_FIFO_SIZE] __attribute__ ((aligned(BAM_DESC_SIZE)));
 
 static struct bam_instance bam;
-static uint8_t *bbtbl;
+static struct nand_bbt bbt;
 
 static uint8_t* rdwr_buf;
 
+/* Pages the controller did not detect as erased, that had their ecc bytes
+ * read back raw to count the bit flips.
+ */
+static uint32_t erased_page_fallbacks;
+
+/* Page reads are double buffered: the next page is queued on the BAM
+ * while the current one completes. Each slot holds the command elements,
+ * status & spare bytes of one page in flight.
+ */
+#define QPIC_NAND_READ_SLOTS             2
+#define QPIC_NAND_READ_CE_PER_PAGE       (8 + 6 * QPIC_NAND_MAX_CWS_IN_PAGE)
+
+struct qpic_nand_read_slot {
+	struct cmd_element ce[QPIC_NAND_READ_CE_PER_PAGE];
+	uint32_t flash_sts[QPIC_NAND_MAX_CWS_IN_PAGE];
+	uint32_t buffer_sts[QPIC_NAND_MAX_CWS_IN_PAGE];
+	uint32_t erased_cw_sts[QPIC_NAND_MAX_CWS_IN_PAGE];
+	uint32_t page;
+	uint32_t cmd_start;    /* BAM FIFO offsets of the page's descriptors */
+	uint32_t cmd_end;
+	uint32_t data_start;
+	uint32_t data_end;
+	unsigned char *spare;  /* Spare bytes of the page */
+	unsigned char *buf;    /* Bounce buffer, for memory the BAM can't reach */
+};
+
+static struct qpic_nand_read_slot read_slots[QPIC_NAND_READ_SLOTS] __attribute__ ((aligned(16)));
+
 static struct flash_id supported_flash[] = {
 	/* Flash ID  Flash ID2 ID Mask     ID Mask2  Density(MB)    Wid Pgsz    Blksz              oobsz   8-bit ECCf */
 	{0x1590AC2C, 0x56,     0xFFFFFFFF, 0xFF,     0x20000000,    0,  2048,   0x00020000,        0x40,   0},
@@ -869,9 +898,9 @@ nand_result_t qpic_nand_block_isbad(unsigned page)
 	unsigned nand_ret = NANDC_RESULT_SUCCESS;
 	uint32_t blk = page / flash.num_pages_per_blk;
 
-	if (bbtbl[blk] == NAND_BAD_BLK_VALUE_IS_GOOD)
+	if (nand_bbt_get(&bbt, blk) == NAND_BBT_GOOD)
 		return NANDC_RESULT_SUCCESS;
-	else if (bbtbl[blk] == NAND_BAD_BLK_VALUE_IS_BAD)
+	else if (nand_bbt_get(&bbt, blk) == NAND_BBT_BAD)
 		return NANDC_RESULT_BAD_BLOCK;
 	else
 	{
@@ -910,17 +939,17 @@ nand_result_t qpic_nand_block_isbad(unsigned page)
 		{
 			if (bad_block[0] != 0xFF && bad_block[1] != 0xFF)
 			{
-				bbtbl[blk] = NAND_BAD_BLK_VALUE_IS_BAD;
+				nand_bbt_set(&bbt, blk, NAND_BBT_BAD);
 				nand_ret = NANDC_RESULT_BAD_BLOCK;
 			}
 		}
 		else if (bad_block[0] != 0xFF)
 		{
-			bbtbl[blk] = NAND_BAD_BLK_VALUE_IS_BAD;
+			nand_bbt_set(&bbt, blk, NAND_BBT_BAD);
 			nand_ret = NANDC_RESULT_BAD_BLOCK;
 		}
 		else
-			bbtbl[blk] = NAND_BAD_BLK_VALUE_IS_GOOD;
+			nand_bbt_set(&bbt, blk, NAND_BBT_GOOD);
 
 		return nand_ret;
 	}
@@ -1232,6 +1261,9 @@ qpic_nand_mark_badblock(uint32_t page)
 	if (page & flash.num_pages_per_blk_mask)
 		page = page - (page & flash.num_pages_per_blk_mask);
 
+	/* Skip the block from now on, even if the marker can't be written */
+	nand_bbt_set(&bbt, page / flash.num_pages_per_blk, NAND_BBT_BAD);
+
 	return qpic_nand_write_page(page, NAND_CFG_RAW, empty_buf, 0);
 }
 
@@ -1331,18 +1363,13 @@ qpic_nand_init(struct qpic_nand_init_config *config)
 		return;
 	}
 
-	/* Create a bad block table */
-	bbtbl = (uint8_t *) malloc(sizeof(uint8_t) * flash.num_blocks);
-
-	if (bbtbl == NULL)
+	/* Create a bad block table, filled in as the blocks are used */
+	if (nand_bbt_init(&bbt, flash.num_blocks))
 	{
 		dprintf(CRITICAL, "Failed to allocate memory for bad block table\n");
 		return;
 	}
 
-	for (i = 0; i < flash.num_blocks; i++)
-		bbtbl[i] = NAND_BAD_BLK_VALUE_NOT_READ;
-
 	/* Set aside contiguous memory for reads/writes.
 	 * This is needed as the BAM transfers only work with
 	 * physically contiguous buffers.
@@ -1357,6 +1384,18 @@ qpic_nand_init(struct qpic_nand_init_config *config)
 		return;
 	}
 
+	for (i = 0; i < QPIC_NAND_READ_SLOTS; i++)
+	{
+		read_slots[i].spare = (unsigned char *)malloc(flash.spare_size);
+		read_slots[i].buf = (unsigned char *)malloc(flash.page_size);
+
+		if (read_slots[i].spare == NULL || read_slots[i].buf == NULL)
+		{
+			dprintf(CRITICAL, "Failed to allocate memory for page reads\n");
+			return;
+		}
+	}
+
 }
 
 unsigned
@@ -1404,26 +1443,34 @@ flash_set_ptable(struct ptable *new_ptable)
 	flash_ptable = new_ptable;
 }
 
-static int find_num_zeros_per_cw(uint8_t *ecc_buf, uint32_t ecc_bytes)
+/* Number of set bits in val, a word at a time. */
+static inline uint32_t qpic_nand_popcount(uint32_t val)
+{
+	val = val - ((val >> 1) & 0x55555555);
+	val = (val & 0x33333333) + ((val >> 2) & 0x33333333);
+	val = (val + (val >> 4)) & 0x0F0F0F0F;
+
+	return (val * 0x01010101) >> 24;
+}
+
+/* Count the zero bits in the ecc bytes of a codeword, padded with 1's
+ * up to a word. Stops counting once there are more than the threshold.
+ */
+static int find_num_zeros_per_cw(uint32_t *ecc_buf, uint32_t ecc_words)
 {
-	uint8_t val;
 	uint32_t i;
 	int num_zeros = 0;
 
-	for (i = 0; i < ecc_bytes; i++)
+	for (i = 0; i < ecc_words; i++)
 	{
-		val = ecc_buf[i];
-		while (val)
-		{
-			if ((val & 1) == 0)
-				num_zeros++;
-			if (num_zeros > THRESHOLD_BIT_FLIPS)
-				goto out;
-			val >>= 1;
-		}
+		if (ecc_buf[i] == 0xFFFFFFFF)
+			continue;
+
+		num_zeros += qpic_nand_popcount(~ecc_buf[i]);
+		if (num_zeros > THRESHOLD_BIT_FLIPS)
+			break;
 	}
 
-out:
 	return num_zeros;
 }
 
@@ -1435,6 +1482,7 @@ static int qpic_nand_read_erased_page(uint32_t page)
 	uint32_t buffer_sts[QPIC_NAND_MAX_CWS_IN_PAGE];
 	uint32_t addr_loc_0;
 	uint32_t total_ecc_bytes = 0;
+	uint32_t ecc_stride;
 	struct cmd_element *cmd_list_ptr = ce_array;
 	struct cmd_element *cmd_list_ptr_start = ce_array;
 	uint32_t num_cmd_desc = 0;
@@ -1450,11 +1498,17 @@ static int qpic_nand_read_erased_page(uint32_t page)
 	uint32_t *buffer_temp = NULL;
 #endif
 
-	total_ecc_bytes = (ecc_parity_bytes * flash.cws_per_page);
+	erased_page_fallbacks++;
+
+	/* Each CW's ecc bytes start on a word, the padding is left as 1's
+	 * so the zero bits can be counted a word at a time.
+	 */
+	ecc_stride = ROUNDUP(ecc_parity_bytes, sizeof(uint32_t));
+	total_ecc_bytes = (ecc_stride * flash.cws_per_page);
 	ecc_buf = memalign(16, total_ecc_bytes);
 	ASSERT(ecc_buf);
 
-	memset(ecc_buf, 0, total_ecc_bytes);
+	memset(ecc_buf, 0xFF, total_ecc_bytes);
 
 	ecc_temp = ecc_buf;
 #if DEBUG_QPIC_NAND
@@ -1556,7 +1610,7 @@ static int qpic_nand_read_erased_page(uint32_t page)
 					flags);
 		num_cmd_desc++;
 
-		ecc_temp += ecc_parity_bytes;
+		ecc_temp += ecc_stride;
 
 		/* Notify BAM HW about the newly added descriptors */
 		bam_sys_gen_event(&bam, CMD_PIPE_INDEX, num_cmd_desc);
@@ -1571,7 +1625,7 @@ static int qpic_nand_read_erased_page(uint32_t page)
 
 	for (i = 0; i < flash.cws_per_page; i++)
 	{
-		num_zeros = find_num_zeros_per_cw(ecc_temp, ecc_parity_bytes);
+		num_zeros = find_num_zeros_per_cw((uint32_t *)ecc_temp, ecc_stride / sizeof(uint32_t));
 
 		if (num_zeros > THRESHOLD_BIT_FLIPS)
 		{
@@ -1579,7 +1633,7 @@ static int qpic_nand_read_erased_page(uint32_t page)
 			goto qpic_nand_read_page_error;
 		}
 
-		ecc_temp += ecc_parity_bytes;
+		ecc_temp += ecc_stride;
 	}
 
 qpic_nand_read_page_error:
@@ -1598,29 +1652,26 @@ qpic_nand_read_page_error:
 	return nand_ret;
 }
 
-/* Note: No support for raw reads. */
-static int
-qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* spareaddr)
+/* Queue the command and data descriptors to read a page into slot, with ECC.
+ * The BAM starts on them right away, behind any page queued before; use
+ * qpic_nand_finish_read_page() to wait for the page & check its status.
+ * Note: No support for raw reads.
+ */
+static void
+qpic_nand_queue_read_page(struct qpic_nand_read_slot *slot, uint32_t page,
+						  unsigned char* buffer, unsigned char* spareaddr)
 {
 	struct cfg_params params;
 	uint32_t ecc;
-	uint32_t flash_sts[QPIC_NAND_MAX_CWS_IN_PAGE] = {0};
-	uint32_t buffer_sts[QPIC_NAND_MAX_CWS_IN_PAGE] = {0};
-	uint32_t erased_cw_sts[QPIC_NAND_MAX_CWS_IN_PAGE] = {0};
 	uint32_t addr_loc_0;
 	uint32_t addr_loc_1;
-	struct cmd_element *cmd_list_ptr = ce_array;
-	struct cmd_element *cmd_list_ptr_start = ce_array;
+	struct cmd_element *cmd_list_ptr = slot->ce;
+	struct cmd_element *cmd_list_ptr_start = slot->ce;
 	uint32_t num_cmd_desc = 0;
 	uint32_t num_data_desc = 0;
-	uint32_t status;
 	uint32_t i;
-	int nand_ret = NANDC_RESULT_SUCCESS;
 	uint8_t flags = 0;
 	uint32_t *cmd_list_temp = NULL;
-#if DEBUG_QPIC_NAND
-    uint8_t *buffer_temp = buffer;
-#endif
 
 	/* UD bytes in last CW is 512 - cws_per_page *4.
 	 * Since each of the CW read earlier reads 4 spare bytes.
@@ -1628,6 +1679,10 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 	uint16_t ud_bytes_in_last_cw = USER_DATA_BYTES_PER_CW - ((flash.cws_per_page - 1) << 2);
 	uint16_t oob_bytes = DATA_BYTES_IN_IMG_PER_CW - ud_bytes_in_last_cw;
 
+	slot->page = page;
+	slot->cmd_start = bam_fifo_offset(&bam, CMD_PIPE_INDEX);
+	slot->data_start = bam_fifo_offset(&bam, DATA_PRODUCER_PIPE_INDEX);
+
 	params.addr0 = page << 16;
 	params.addr1 = (page >> 16) & 0xff;
 	params.cfg0 = cfg0;
@@ -1646,13 +1701,26 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 	addr_loc_1 |= NAND_RD_LOC_SIZE(oob_bytes);
 	addr_loc_1 |= NAND_RD_LOC_LAST_BIT(1);
 
-	status = qpic_nand_block_isbad(page);
+	/* Reset and then activate the erased CW/page detection controller, in one
+	 * desc that also locks the pipe for the page. Nothing waits for it, the
+	 * CW descs behind it are processed in order.
+	 */
+	bam_add_cmd_element(cmd_list_ptr, NAND_ERASED_CW_DETECT_CFG,
+						NAND_ERASED_CW_DETECT_CFG_RESET_CTRL, CE_WRITE_TYPE);
+	cmd_list_ptr++;
+	bam_add_cmd_element(cmd_list_ptr, NAND_ERASED_CW_DETECT_CFG,
+						NAND_ERASED_CW_DETECT_CFG_ACTIVATE_CTRL | NAND_ERASED_CW_DETECT_ERASED_CW_ECC_MASK,
+						CE_WRITE_TYPE);
+	cmd_list_ptr++;
 
-	if (status)
-		return status;
+	bam_add_one_desc(&bam,
+					 CMD_PIPE_INDEX,
+					 (unsigned char*)PA((addr_t)cmd_list_ptr_start),
+					 PA((uint32_t)cmd_list_ptr - (uint32_t)cmd_list_ptr_start),
+					 BAM_DESC_CMD_FLAG | BAM_DESC_LOCK_FLAG);
+	bam_sys_gen_event(&bam, CMD_PIPE_INDEX, 1);
 
-	/* Reset and Configure erased CW/page detection controller */
-	qpic_nand_erased_status_reset(ce_array, BAM_DESC_LOCK_FLAG);
+	cmd_list_ptr_start = cmd_list_ptr;
 
 	/* Queue up the command and data descriptors for all the codewords in a page
 	 * and do a single bam transfer at the end.*/
@@ -1729,27 +1797,28 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 		/* Enqueue the desc for the above commands */
 		bam_add_one_desc(&bam,
 					 CMD_PIPE_INDEX,
-					 (unsigned char*)cmd_list_ptr_start,
+					 (unsigned char*)PA((addr_t)cmd_list_ptr_start),
 					 PA((uint32_t)cmd_list_ptr - (uint32_t)cmd_list_ptr_start),
 					 BAM_DESC_NWD_FLAG | BAM_DESC_CMD_FLAG);
 		num_cmd_desc++;
 
-		bam_add_cmd_element(cmd_list_ptr, NAND_FLASH_STATUS, (uint32_t)PA((addr_t)&(flash_sts[i])), CE_READ_TYPE);
+		bam_add_cmd_element(cmd_list_ptr, NAND_FLASH_STATUS, (uint32_t)PA((addr_t)&(slot->flash_sts[i])), CE_READ_TYPE);
 
 		cmd_list_temp = (uint32_t *)cmd_list_ptr;
 
 		cmd_list_ptr++;
 
-		bam_add_cmd_element(cmd_list_ptr, NAND_BUFFER_STATUS, (uint32_t)PA((addr_t)&(buffer_sts[i])), CE_READ_TYPE);
+		bam_add_cmd_element(cmd_list_ptr, NAND_BUFFER_STATUS, (uint32_t)PA((addr_t)&(slot->buffer_sts[i])), CE_READ_TYPE);
 		cmd_list_ptr++;
 
 		/* Read erased CW status */
-		bam_add_cmd_element(cmd_list_ptr, NAND_ERASED_CW_DETECT_STATUS, (uint32_t)PA((addr_t)&erased_cw_sts[i]), CE_READ_TYPE);
+		bam_add_cmd_element(cmd_list_ptr, NAND_ERASED_CW_DETECT_STATUS, (uint32_t)PA((addr_t)&(slot->erased_cw_sts[i])), CE_READ_TYPE);
 		cmd_list_ptr++;
 
 		if (i == flash.cws_per_page - 1)
 		{
-			flags = BAM_DESC_CMD_FLAG | BAM_DESC_UNLOCK_FLAG;
+			/* The status of the last CW completes the page */
+			flags = BAM_DESC_CMD_FLAG | BAM_DESC_UNLOCK_FLAG | BAM_DESC_INT_FLAG;
 		}
 		else
 			flags = BAM_DESC_CMD_FLAG;
@@ -1768,26 +1837,62 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 		bam_sys_gen_event(&bam, CMD_PIPE_INDEX, num_cmd_desc);
 	}
 
-	qpic_nand_wait_for_data(DATA_PRODUCER_PIPE_INDEX);
+	slot->cmd_end = bam_fifo_offset(&bam, CMD_PIPE_INDEX);
+	slot->data_end = bam_fifo_offset(&bam, DATA_PRODUCER_PIPE_INDEX);
+}
+
+/* Wait till the BAM is done with all the descriptors of the page in slot.
+ * Returns NANDC_RESULT_FAILURE if either pipe flagged an error.
+ */
+static int
+qpic_nand_wait_for_page(struct qpic_nand_read_slot *slot)
+{
+	int ret = NANDC_RESULT_SUCCESS;
+
+	if (bam_wait_for_offset(&bam, DATA_PRODUCER_PIPE_INDEX, slot->data_start, slot->data_end))
+		ret = NANDC_RESULT_FAILURE;
+	if (bam_wait_for_offset(&bam, CMD_PIPE_INDEX, slot->cmd_start, slot->cmd_end))
+		ret = NANDC_RESULT_FAILURE;
+
+	if (ret)
+		dprintf(CRITICAL, "BAM failed reading page: 0x%08x\n", slot->page);
+
+	return ret;
+}
+
+/* Wait for the page queued in slot & check its status.
+ * next is the page queued behind it, if any. It has to be drained before
+ * an erased page can be checked for bit flips, that takes the BAM on its own.
+ */
+static int
+qpic_nand_finish_read_page(struct qpic_nand_read_slot *slot,
+						   struct qpic_nand_read_slot *next)
+{
+	uint32_t i;
+	int nand_ret = NANDC_RESULT_SUCCESS;
+
+	nand_ret = qpic_nand_wait_for_page(slot);
+	if (nand_ret)
+		return nand_ret;
 
 	/* Check flash read status & errors */
 	for (i = 0; i < flash.cws_per_page ; i ++)
 	{
 #if DEBUG_QPIC_NAND
 		dprintf(INFO, "FLASH STATUS: 0x%08x, BUFFER STATUS: 0x%08x, ERASED CW STATUS: 0x%08x\n",
-				flash_sts[i], buffer_sts[i], erased_cw_sts[i]);
+				slot->flash_sts[i], slot->buffer_sts[i], slot->erased_cw_sts[i]);
 #endif
 
 		/* If MPU or flash op erros are set, look for erased cw status.
 		 * If erased CW status is not set then look for bit flips to confirm
 		 * if the page is and erased page or a bad page
 		 */
-		if (flash_sts[i] & (NAND_FLASH_OP_ERR | NAND_FLASH_MPU_ERR))
+		if (slot->flash_sts[i] & (NAND_FLASH_OP_ERR | NAND_FLASH_MPU_ERR))
 		{
-			if ((erased_cw_sts[i] & NAND_ERASED_CW) != NAND_ERASED_CW)
+			if ((slot->erased_cw_sts[i] & NAND_ERASED_CW) != NAND_ERASED_CW)
 			{
 #if DEBUG_QPIC_NAND
-			dprintf(CRITICAL, "Page: 0x%08x, addr0: 0x%08x, addr1: 0x%08x\n", page, params.addr0, params.addr1);
+			dprintf(CRITICAL, "Page: 0x%08x\n", slot->page);
 #endif
 			/*
 			 * Depending on the process technology used there could be bit flips on
@@ -1801,19 +1906,23 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 			 * bit flips then we should ignore the uncorrectable ECC error and consider
 			 * the page as an erased page.
 			 */
-#if DEBUG_QPIC_NAND
-				for(i = 0; i < 4096; i += 8)
+				/* The controller flags the page erased once all its CWs were,
+				 * which spares the raw read of the ecc bytes. Not after an MPU
+				 * error though, the page was never read.
+				 */
+				if (!(slot->flash_sts[i] & NAND_FLASH_MPU_ERR) &&
+					(slot->erased_cw_sts[flash.cws_per_page - 1] &
+					 BIT(NAND_ERASED_CW_DETECT_STATUS_PAGE_ALL_ERASED)))
+					goto qpic_nand_read_page_error;
+
+				if (next)
 				{
-					printf("DATA: %x %x %x %x %x %x %x %x",
-									buffer_temp[i], buffer_temp[i+1], buffer_temp[i+2], buffer_temp[i+3],
-									buffer_temp[i+4], buffer_temp[i+5], buffer_temp[i+6], buffer_temp[i+7]);
-					i += 8;
-					printf("DATA: %x %x %x %x %x %x %x %x\n",
-									buffer_temp[i], buffer_temp[i+1], buffer_temp[i+2], buffer_temp[i+3],
-									buffer_temp[i+4], buffer_temp[i+5], buffer_temp[i+6], buffer_temp[i+7]);
+					nand_ret = qpic_nand_wait_for_page(next);
+					if (nand_ret)
+						goto qpic_nand_read_page_error;
 				}
-#endif
-				nand_ret = qpic_nand_read_erased_page(page);
+
+				nand_ret = qpic_nand_read_erased_page(slot->page);
 				goto qpic_nand_read_page_error;
 				}
 		}
@@ -1823,6 +1932,79 @@ qpic_nand_read_page_error:
 	return nand_ret;
 }
 
+/* Read num_pages pages from good blocks, starting at page.
+ * The pages are read run at a time from the start of consecutive blocks:
+ * page n is page + (n / run) * pages per block + n % run. A run of
+ * num_pages reads them all from one block.
+ * Page n is read to buffer + n * stride, and the first extra spare bytes
+ * of it, if any, right after it. The spare bytes of the page read last
+ * are also copied to spareaddr, if given.
+ * The next page is queued on the BAM before waiting for the current one,
+ * so the controller never waits on the CPU to set up a page.
+ * If bounce is set, the BAM reads into the slot buffers, which are copied
+ * to buffer.
+ * Stops at the first page that fails & returns its error, *done is the
+ * number of pages read before it.
+ */
+static int
+qpic_nand_read_pages(uint32_t page, uint32_t num_pages, uint32_t run,
+					 unsigned char* buffer, uint32_t stride,
+					 unsigned char* spareaddr, uint32_t extra,
+					 bool bounce, uint32_t *done)
+{
+	struct qpic_nand_read_slot *slot;
+	struct qpic_nand_read_slot *next;
+	uint16_t oob_bytes = (flash.cws_per_page << 2);
+	unsigned char *dst;
+	uint32_t i;
+	int nand_ret = NANDC_RESULT_SUCCESS;
+
+	*done = 0;
+
+	if (!num_pages)
+		return nand_ret;
+
+	slot = &read_slots[0];
+	qpic_nand_queue_read_page(slot, page, bounce ? slot->buf : buffer, slot->spare);
+
+	for (i = 0; i < num_pages; i++)
+	{
+		slot = &read_slots[i % QPIC_NAND_READ_SLOTS];
+		next = NULL;
+
+		/* Keep the next page coming while this one completes */
+		if (i + 1 < num_pages)
+		{
+			next = &read_slots[(i + 1) % QPIC_NAND_READ_SLOTS];
+			qpic_nand_queue_read_page(next,
+									  page + ((i + 1) / run) * flash.num_pages_per_blk + (i + 1) % run,
+									  bounce ? next->buf : buffer + (i + 1) * stride,
+									  next->spare);
+		}
+
+		nand_ret = qpic_nand_finish_read_page(slot, next);
+		if (nand_ret)
+		{
+			/* Drop the page read ahead */
+			if (next)
+				qpic_nand_wait_for_page(next);
+			break;
+		}
+
+		dst = buffer + i * stride;
+		if (bounce)
+			memcpy(dst, slot->buf, flash.page_size);
+		if (extra)
+			memcpy(dst + flash.page_size, slot->spare, extra);
+		if (spareaddr)
+			memcpy(spareaddr, slot->spare, oob_bytes);
+
+		(*done)++;
+	}
+
+	return nand_ret;
+}
+
 /**
  * qpic_nand_read() - read data
  * @start_page: number of page to begin reading from
@@ -1840,28 +2022,106 @@ qpic_nand_read_page_error:
 nand_result_t qpic_nand_read(uint32_t start_page, uint32_t num_pages,
 		unsigned char* buffer, unsigned char* spareaddr)
 {
-	unsigned i = 0, ret = 0;
+	uint32_t page = start_page;
+	uint32_t num, done;
+	unsigned ret = 0;
 
 	if (!buffer) {
 		dprintf(CRITICAL, "qpic_nand_read: buffer = null\n");
 		return NANDC_RESULT_PARAM_INVALID;
 	}
-	while (i < num_pages) {
-		ret = qpic_nand_read_page(start_page + i, buffer + flash.page_size * i,
-				spareaddr);
-		i++;
+	while (num_pages) {
+		/* Check each block once, then read on to the end of it */
+		num = flash.num_pages_per_blk - (page & flash.num_pages_per_blk_mask);
+		num = MIN(num, num_pages);
+
+		ret = qpic_nand_block_isbad(page);
+		done = 0;
+		if (!ret)
+			ret = qpic_nand_read_pages(page, num, num, buffer, flash.page_size,
+					spareaddr, 0, false, &done);
+
+		page += done;
+		buffer += flash.page_size * done;
+		num_pages -= done;
+
 		if (ret == NANDC_RESULT_BAD_PAGE)
-			qpic_nand_mark_badblock(start_page + i);
+			qpic_nand_mark_badblock(page);
 		if (ret) {
 			dprintf(CRITICAL,
 					"qpic_nand_read: reading page %d failed with %d err\n",
-					start_page + i, ret);
+					page, ret);
 			return ret;
 		}
 	}
 	return NANDC_RESULT_SUCCESS;
 }
 
+/**
+ * qpic_nand_read_heads() - read the first pages of a row of blocks
+ * @start_page: first page of the first block to read
+ * @num_blocks: number of blocks to read
+ * @num_pages: number of pages to read from the start of each block
+ * @buffer: buffer where to store the read data, @num_pages pages per block
+ * @results: where to store the nand_result_t of each block
+ *
+ * This function reads the head pages of all the good blocks among
+ * @num_blocks in one pipelined operation, instead of one qpic_nand_read()
+ * per block. A bad block, or one whose pages can't be read, gets its error
+ * in @results and doesn't stop the others; its part of @buffer is left
+ * undefined. Note that it's in the caller responsibility to make sure the
+ * read blocks are all from same partition.
+ *
+ * Returns nand_result_t
+ */
+nand_result_t qpic_nand_read_heads(uint32_t start_page, uint32_t num_blocks,
+		uint32_t num_pages, unsigned char* buffer, int *results)
+{
+	uint32_t blk = 0;
+	uint32_t page, run, done;
+	int ret;
+
+	if (!buffer || !results || !num_pages ||
+			num_pages > flash.num_pages_per_blk ||
+			(start_page & flash.num_pages_per_blk_mask)) {
+		dprintf(CRITICAL, "qpic_nand_read_heads: invalid params\n");
+		return NANDC_RESULT_PARAM_INVALID;
+	}
+
+	while (blk < num_blocks) {
+		page = start_page + blk * flash.num_pages_per_blk;
+		ret = qpic_nand_block_isbad(page);
+		if (ret) {
+			results[blk++] = ret;
+			continue;
+		}
+
+		/* Read the good blocks that follow along with this one */
+		for (run = 1; blk + run < num_blocks; run++)
+			if (qpic_nand_block_isbad(page + run * flash.num_pages_per_blk))
+				break;
+
+		ret = qpic_nand_read_pages(page, run * num_pages, num_pages,
+				buffer + blk * num_pages * flash.page_size, flash.page_size,
+				NULL, 0, false, &done);
+
+		for (run = done / num_pages; run; run--)
+			results[blk++] = NANDC_RESULT_SUCCESS;
+
+		if (ret) {
+			page = start_page + blk * flash.num_pages_per_blk +
+				done % num_pages;
+			if (ret == NANDC_RESULT_BAD_PAGE)
+				qpic_nand_mark_badblock(page);
+			dprintf(CRITICAL,
+					"qpic_nand_read_heads: reading page %d failed with %d err\n",
+					page, ret);
+			results[blk++] = ret;
+		}
+	}
+	return NANDC_RESULT_SUCCESS;
+}
+
 /**
  * qpic_nand_write() - read data
  * @start_page: number of page to begin writing to
@@ -1943,7 +2203,6 @@ flash_read_ext(struct ptentry *ptn,
 	uint32_t count =
 		(bytes + flash.page_size - 1 + extra_per_page) / (flash.page_size +
 									 extra_per_page);
-	uint32_t *spare = (unsigned *)flash_spare_bytes;
 	uint32_t errors = 0;
 	unsigned char *image = data;
 	int result = 0;
@@ -1953,6 +2212,14 @@ flash_read_ext(struct ptentry *ptn,
 	uint32_t start_block_count = 0;
 	uint32_t isbad = 0;
 	uint32_t current_page;
+	uint32_t num_pages;
+	uint32_t done;
+#if CONTIGUOUS_MEMORY
+	bool bounce = false;
+#else
+	/* Read through the slot buffers, the BAM needs contiguous memory */
+	bool bounce = true;
+#endif
 
 	/* Verify first byte is at page boundary. */
 	if (offset & (flash.page_size - 1))
@@ -1989,19 +2256,8 @@ flash_read_ext(struct ptentry *ptn,
 			return NANDC_RESULT_SUCCESS;
 		}
 
-#if CONTIGUOUS_MEMORY
-		result = qpic_nand_read_page(page, image, (unsigned char *) spare);
-#else
-		result = qpic_nand_read_page(page, rdwr_buf, (unsigned char *) spare);
-#endif
-		if (result == NANDC_RESULT_BAD_PAGE)
-		{
-			/* bad page, go to next page. */
-			page++;
-			errors++;
-			continue;
-		}
-		else if (result == NANDC_RESULT_BAD_BLOCK)
+		result = qpic_nand_block_isbad(page);
+		if (result)
 		{
 			/* bad block, go to next block same offset. */
 			page += flash.num_pages_per_blk;
@@ -2009,20 +2265,30 @@ flash_read_ext(struct ptentry *ptn,
 			continue;
 		}
 
-#ifndef CONTIGUOUS_MEMORY
-		/* Copy the read page into correct location. */
-		memcpy(image, rdwr_buf, flash.page_size);
-#endif
-		page++;
-		image += flash.page_size;
-		/* Copy spare bytes to image */
-		if(extra_per_page)
+		/* Read on to the end of the block, or of the partition */
+		num_pages = flash.num_pages_per_blk - (page & flash.num_pages_per_blk_mask);
+		num_pages = MIN(num_pages, MIN(count, lastpage - page));
+
+		result = qpic_nand_read_pages(page, num_pages, num_pages, image,
+					      flash.page_size + extra_per_page,
+					      NULL, extra_per_page, bounce, &done);
+
+		page += done;
+		image += (flash.page_size + extra_per_page) * done;
+		count -= done;
+
+		if (result == NANDC_RESULT_BAD_PAGE)
 		{
-			memcpy(image, spare, extra_per_page);
-			image += extra_per_page;
+			/* bad page, go to next page. */
+			page++;
+			errors++;
+		}
+		else if (result)
+		{
+			dprintf(CRITICAL, "flash_read_image: reading page %d failed with %d err\n",
+					page, result);
+			return result;
 		}
-
-		count -= 1;
 	}
 
 	/* could not find enough valid pages before we hit the end */
@@ -2170,3 +2436,11 @@ uint32_t nand_device_base()
 {
 	return nand_base;
 }
+
+/* Api to return the number of pages that had to be checked for bit flips
+ * in software, as the controller did not detect them as erased.
+ */
+uint32_t qpic_nand_erased_page_fallbacks()
+{
+	return erased_page_fallbacks;
+}
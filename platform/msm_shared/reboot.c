@@ -139,6 +139,8 @@ void reboot_device(unsigned reboot_reason)
 			dprintf(CRITICAL , "Failed to halt pmic arbiter: %d\n", ret);
 	}
 
+	debug_log_flush();
+
 	/* Drop PS_HOLD for MSM */
 	writel(0x00, MPM2_MPM_PS_HOLD);
 
@@ -154,6 +156,8 @@ void shutdown_device()
 	/* Configure PMIC for shutdown. */
 	pmic_reset_configure(PON_PSHOLD_SHUTDOWN);
 
+	debug_log_flush();
+
 	/* Drop PS_HOLD for MSM */
 	writel(0x00, MPM2_MPM_PS_HOLD);
 
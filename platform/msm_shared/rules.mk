@@ -38,6 +38,7 @@ ifeq ($(ENABLE_SDHCI_SUPPORT),1)
 OBJS += \
 	$(LOCAL_DIR)/sdhci.o \
 	$(LOCAL_DIR)/sdhci_msm.o \
+	$(LOCAL_DIR)/sdhci_cmdq.o \
 	$(LOCAL_DIR)/mmc_sdhci.o \
 	$(LOCAL_DIR)/mmc_wrapper.o
 else
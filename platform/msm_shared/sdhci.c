@@ -30,6 +30,8 @@
 #include <platform/irqs.h>
 #include <platform/interrupts.h>
 #include <platform/timer.h>
+#include <platform.h>
+#include <kernel/thread.h>
 #include <kernel/event.h>
 #include <target.h>
 #include <string.h>
@@ -138,6 +140,78 @@ static void sdhci_error_status_enable(struct sdhci_host *host)
 	REG_WRITE16(host, SDHCI_ERR_INT_SIG_EN, SDHCI_ERR_INT_SIG_EN_REG);
 }
 
+/*
+ * Function: sdhci irq handler
+ * Arg     : Host structure
+ * Return  : INT_RESCHEDULE to run the waiting thread
+ * Flow:   : Mask the interrupt signals & wake up the thread waiting
+ *           for the command, it reads & clears the status itself
+ */
+static enum handler_return sdhci_irq_handler(void *arg)
+{
+	struct sdhci_host *host = (struct sdhci_host *) arg;
+
+	REG_WRITE16(host, 0, SDHCI_NRML_INT_SIG_EN_REG);
+	REG_WRITE16(host, 0, SDHCI_ERR_INT_SIG_EN_REG);
+
+	event_signal(&host->irq_event, false);
+
+	return INT_RESCHEDULE;
+}
+
+/*
+ * Function: sdhci irq init
+ * Arg     : Host structure
+ * Return  : None
+ * Flow:   : Register the host controller irq, its signals stay masked
+ *           until a command waits for them
+ */
+static void sdhci_irq_init(struct sdhci_host *host)
+{
+	if (!host->irq)
+		return;
+
+	REG_WRITE16(host, 0, SDHCI_NRML_INT_SIG_EN_REG);
+	REG_WRITE16(host, 0, SDHCI_ERR_INT_SIG_EN_REG);
+
+	event_init(&host->irq_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	register_int_handler(host->irq, (int_handler)sdhci_irq_handler, (void *)host);
+	unmask_interrupt(host->irq);
+}
+
+/*
+ * Function: sdhci wait int
+ * Arg     : Host structure, the normal & error status that end the wait,
+ *           time waited so far & time allowed in us
+ * Return  : Time waited so far in us
+ * Flow:   : Sleep until the controller raises one of the given interrupts
+ *           or the time runs out, so other threads can run meanwhile.
+ *           Busy wait for 1 us if there is no irq, or if interrupts are
+ *           off as in early boot.
+ *           Status the caller waits past must not be given: it stays
+ *           pending & would raise the irq again on every wait.
+ */
+static uint64_t sdhci_wait_int(struct sdhci_host *host, uint16_t nrml, uint16_t err,
+			       uint64_t waited, uint64_t max)
+{
+	bigtime_t start;
+
+	if (!host->irq || in_critical_section()) {
+		udelay(1);
+		return waited + 1;
+	}
+
+	start = current_time_hires();
+
+	/* Status already pending raises the irq as soon as it is unmasked */
+	REG_WRITE16(host, nrml, SDHCI_NRML_INT_SIG_EN_REG);
+	REG_WRITE16(host, err, SDHCI_ERR_INT_SIG_EN_REG);
+
+	event_wait_timeout(&host->irq_event, MAX((max - waited) / 1000, 1));
+
+	return MIN(waited + MAX((uint64_t) (current_time_hires() - start), 1), max);
+}
+
 /*
  * Function: sdhci clock supply
  * Arg     : Host structure
@@ -332,8 +406,11 @@ void sdhci_set_uhs_mode(struct sdhci_host *host, uint32_t mode)
  */
 static void sdhci_set_adma_mode(struct sdhci_host *host)
 {
-	/* Select 32 Bit ADMA2 type */
-	REG_WRITE8(host, SDHCI_ADMA_32BIT, SDHCI_HOST_CTRL1_REG);
+	/* Select 64 Bit ADMA2 type if the host can address it, 32 Bit otherwise */
+	if (host->caps.adma_64bit)
+		REG_WRITE8(host, SDHCI_ADMA_64BIT, SDHCI_HOST_CTRL1_REG);
+	else
+		REG_WRITE8(host, SDHCI_ADMA_32BIT, SDHCI_HOST_CTRL1_REG);
 }
 
 /*
@@ -435,8 +512,20 @@ static uint8_t sdhci_cmd_complete(struct sdhci_host *host, struct mmc_command *c
 	uint32_t int_status;
 	uint32_t trans_complete = 0;
 	uint32_t err_status;
+	uint16_t cmd_errs;
+	uint16_t trans_errs;
 	uint64_t max_trans_retry = (cmd->cmd_timeout ? cmd->cmd_timeout : SDHCI_MAX_TRANS_RETRY);
 
+	/* The errors that end the waits below, the ones they go on past stay masked */
+	if (host->tuning_in_progress) {
+		cmd_errs = SDHCI_CMD_TIMEOUT_MASK | SDHCI_CMD_CRC_MASK |
+			   SDHCI_CMD_END_BIT_MASK | SDHCI_CMD_IDX_MASK;
+		trans_errs = SDHCI_DAT_TIMEOUT_MASK | SDHCI_DAT_CRC_MASK;
+	} else {
+		cmd_errs = SDHCI_ERR_INT_SIG_EN & ~SDHCI_DAT_TIMEOUT_MASK;
+		trans_errs = cmd_errs;
+	}
+
 	do {
 		int_status = REG_READ16(host, SDHCI_NRML_INT_STS_REG);
 
@@ -466,8 +555,8 @@ static uint8_t sdhci_cmd_complete(struct sdhci_host *host, struct mmc_command *c
 			}
 		}
 
-		retry++;
-		udelay(1);
+		retry = sdhci_wait_int(host, SDHCI_INT_STS_CMD_COMPLETE, cmd_errs,
+				       retry, SDHCI_MAX_CMD_RETRY);
 		if (retry == SDHCI_MAX_CMD_RETRY) {
 			dprintf(CRITICAL, "Error: Command never completed\n");
 			ret = 1;
@@ -535,8 +624,8 @@ static uint8_t sdhci_cmd_complete(struct sdhci_host *host, struct mmc_command *c
 				}
 			}
 
-			retry++;
-			udelay(1);
+			retry = sdhci_wait_int(host, SDHCI_INT_STS_TRANS_COMPLETE, trans_errs,
+					       retry, max_trans_retry);
 			if (retry == max_trans_retry) {
 				dprintf(CRITICAL, "Error: Transfer never completed\n");
 				ret = 1;
@@ -591,110 +680,90 @@ err:
 
 /*
  * Function: sdhci prep desc table
- * Arg     : Pointer data & length
- * Return  : Pointer to desc table
- * Flow:   : Prepare the adma table as per the sd spec v 3.0
+ * Arg     : Host structure, pointer data & length
+ * Return  : Physical address of the desc table
+ * Flow:   : Prepare the adma table as per the sd spec v 3.0, in the
+ *           descriptor table preallocated for the host
  */
-static struct desc_entry *sdhci_prep_desc_table(void *data, uint32_t len)
+static addr_t sdhci_prep_desc_table(struct sdhci_host *host, void *data, uint32_t len)
 {
-	struct desc_entry *sg_list;
-	uint32_t sg_len = 0;
-	uint32_t remain = 0;
+	struct desc_entry *sg_list = host->adma_desc;
+	struct desc_entry_64 *sg_list_64 = host->adma_desc;
+	uint64_t addr = (addr_t)data;
+	uint32_t sg_len;
+	uint32_t line;
+	uint16_t att;
 	uint32_t i;
-	uint32_t table_len = 0;
-
-	if (len <= SDHCI_ADMA_DESC_LINE_SZ) {
-		/* Allocate only one descriptor */
-		sg_list = (struct desc_entry *) memalign(lcm(4, CACHE_LINE), ROUNDUP(sizeof(struct desc_entry), CACHE_LINE));
-
-		if (!sg_list) {
-			dprintf(CRITICAL, "Error allocating memory\n");
-			ASSERT(0);
-		}
-
-		sg_list[0].addr = (uint32_t)data;
-		sg_list[0].len = (len < SDHCI_ADMA_DESC_LINE_SZ) ? len : (SDHCI_ADMA_DESC_LINE_SZ & 0xffff);
-		sg_list[0].tran_att = SDHCI_ADMA_TRANS_VALID | SDHCI_ADMA_TRANS_DATA
-							  | SDHCI_ADMA_TRANS_END;
+	uint32_t table_len;
 
+	/* Number of entries in desc table, one for each 64 KB of data */
+	sg_len = (len + SDHCI_ADMA_DESC_LINE_SZ - 1) / SDHCI_ADMA_DESC_LINE_SZ;
+	if (!sg_len)
 		sg_len = 1;
-		table_len = sizeof(struct desc_entry);
-	} else {
-		/* Calculate the number of entries in desc table */
-		sg_len = len / SDHCI_ADMA_DESC_LINE_SZ;
-		remain = len - (sg_len * SDHCI_ADMA_DESC_LINE_SZ);
-
-		/* Allocate sg_len + 1 entries if there are remaining bytes at the end */
-		if (remain)
-			sg_len++;
-
-		table_len = (sg_len * sizeof(struct desc_entry));
 
-		sg_list = (struct desc_entry *) memalign(lcm(4, CACHE_LINE), ROUNDUP(table_len, CACHE_LINE));
+	ASSERT(sg_len <= host->adma_desc_cnt);
 
-		if (!sg_list) {
-			dprintf(CRITICAL, "Error allocating memory\n");
-			ASSERT(0);
+	/*
+	 * Prepare sglist in the format:
+	 *  ___________________________________________________
+	 * |Transfer Len | Transfer ATTR | Data Address        |
+	 * | (16 bit)    | (16 bit)      | (32 or 64 bit)      |
+	 * |_____________|_______________|_____________________|
+	 *
+	 * Length attribute is 16 bit value & max transfer size for one
+	 * descriptor line is 65536 bytes, As per SD Spec3.0 'len = 0'
+	 * implies 65536 bytes. Truncate the length to limit to 16 bit
+	 * range. The last entry gets the Valid & End attributes.
+	 */
+	for (i = 0; i < sg_len; i++) {
+		line = MIN(len, SDHCI_ADMA_DESC_LINE_SZ);
+		att = SDHCI_ADMA_TRANS_VALID | SDHCI_ADMA_TRANS_DATA;
+		if (i == sg_len - 1)
+			att |= SDHCI_ADMA_TRANS_END;
+
+		if (host->caps.adma_64bit) {
+			sg_list_64[i].addr = (uint32_t)addr;
+			sg_list_64[i].addr_hi = (uint32_t)(addr >> 32);
+			sg_list_64[i].len = (line & 0xffff);
+			sg_list_64[i].tran_att = att;
+		} else {
+			sg_list[i].addr = (uint32_t)addr;
+			sg_list[i].len = (line & 0xffff);
+			sg_list[i].tran_att = att;
 		}
 
-		memset((void *) sg_list, 0, table_len);
-
-		/*
-		 * Prepare sglist in the format:
-		 *  ___________________________________________________
-		 * |Transfer Len | Transfer ATTR | Data Address        |
-		 * | (16 bit)    | (16 bit)      | (32 bit)            |
-		 * |_____________|_______________|_____________________|
-		 */
-		for (i = 0; i < (sg_len - 1); i++) {
-				sg_list[i].addr = (uint32_t)data;
-				/*
-				 * Length attribute is 16 bit value & max transfer size for one
-				 * descriptor line is 65536 bytes, As per SD Spec3.0 'len = 0'
-				 * implies 65536 bytes. Truncate the length to limit to 16 bit
-				 * range.
-				 */
-				sg_list[i].len = (SDHCI_ADMA_DESC_LINE_SZ & 0xffff);
-				sg_list[i].tran_att = SDHCI_ADMA_TRANS_VALID | SDHCI_ADMA_TRANS_DATA;
-				data += SDHCI_ADMA_DESC_LINE_SZ;
-				len -= SDHCI_ADMA_DESC_LINE_SZ;
-			}
+		DBG("\n %s: sg_list: addr: 0x%llx len: 0x%x attr: 0x%04x\n", __func__, addr, line, att);
 
-			/* Fill the last entry of the table with Valid & End
-			 * attributes
-			 */
-			sg_list[sg_len - 1].addr = (uint32_t)data;
-			sg_list[sg_len - 1].len = (len < SDHCI_ADMA_DESC_LINE_SZ) ? len : (SDHCI_ADMA_DESC_LINE_SZ & 0xffff);
-			sg_list[sg_len - 1].tran_att = SDHCI_ADMA_TRANS_VALID | SDHCI_ADMA_TRANS_DATA |
-										   SDHCI_ADMA_TRANS_END;
-		}
+		addr += line;
+		len -= line;
+	}
 
-	arch_clean_invalidate_cache_range((addr_t)sg_list, table_len);
+	if (host->caps.adma_64bit)
+		table_len = sg_len * sizeof(struct desc_entry_64);
+	else
+		table_len = sg_len * sizeof(struct desc_entry);
 
-	for (i = 0; i < sg_len; i++)
-	{
-		DBG("\n %s: sg_list: addr: 0x%08x len: 0x%04x attr: 0x%04x\n", __func__, sg_list[i].addr,
-			(sg_list[i].len ? sg_list[i].len : SDHCI_ADMA_DESC_LINE_SZ), sg_list[i].tran_att);
-	}
+	/* Only the lines holding this transfer's entries need to reach memory */
+	arch_clean_invalidate_cache_range((addr_t)host->adma_desc, table_len);
 
-	return sg_list;
+	return (addr_t)host->adma_desc;
 }
 
 /*
  * Function: sdhci adma transfer
  * Arg     : Host structure & command stucture
- * Return  : Pointer to desc table
+ * Return  : None
  * Flow    : 1. Prepare descriptor table
  *           2. Write adma register
  *           3. Write block size & block count register
  */
-static struct desc_entry *sdhci_adma_transfer(struct sdhci_host *host,
-											  struct mmc_command *cmd)
+static void sdhci_adma_transfer(struct sdhci_host *host,
+								struct mmc_command *cmd)
 {
 	uint32_t num_blks = 0;
 	uint32_t sz;
 	void *data;
-	struct desc_entry *adma_addr;
+	uint64_t adma_addr;
 
 
 	num_blks = cmd->data.num_blocks;
@@ -714,10 +783,12 @@ static struct desc_entry *sdhci_adma_transfer(struct sdhci_host *host,
 		sz = num_blks * SDHCI_MMC_BLK_SZ;
 
 	/* Prepare adma descriptor table */
-	adma_addr = sdhci_prep_desc_table(data, sz);
+	adma_addr = sdhci_prep_desc_table(host, data, sz);
 
 	/* Write adma address to adma register */
 	REG_WRITE32(host, (uint32_t) adma_addr, SDHCI_ADM_ADDR_REG);
+	if (host->caps.adma_64bit)
+		REG_WRITE32(host, (uint32_t) (adma_addr >> 32), SDHCI_ADM_ADDR_HI_REG);
 
 	/* Write the block size */
 	if (cmd->data.blk_sz)
@@ -729,8 +800,6 @@ static struct desc_entry *sdhci_adma_transfer(struct sdhci_host *host,
 	 * Set block count in block count register
 	 */
 	REG_WRITE16(host, num_blks, SDHCI_BLK_CNT_REG);
-
-	return adma_addr;
 }
 
 /*
@@ -750,7 +819,6 @@ uint32_t sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 	uint16_t trans_mode = 0;
 	uint16_t present_state;
 	uint32_t flags;
-	struct desc_entry *sg_list = NULL;
 
 	DBG("\n %s: START: cmd:%04d, arg:0x%08x, resp_type:0x%04x, data_present:%d\n",
 				__func__, cmd->cmd_index, cmd->argument, cmd->resp_type, cmd->data_present);
@@ -846,7 +914,7 @@ uint32_t sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 
 	/* Check if data needs to be processed */
 	if (cmd->data_present)
-		sg_list = sdhci_adma_transfer(host, cmd);
+		sdhci_adma_transfer(host, cmd);
 
 	/* Write the argument 1 */
 	REG_WRITE32(host, cmd->argument, SDHCI_ARGUMENT_REG);
@@ -910,10 +978,6 @@ uint32_t sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 	DBG("\n %s: END: cmd:%04d, arg:0x%08x, resp:0x%08x 0x%08x 0x%08x 0x%08x\n",
 				__func__, cmd->cmd_index, cmd->argument, cmd->resp[0], cmd->resp[1], cmd->resp[2], cmd->resp[3]);
 err:
-	/* Free the scatter/gather list */
-	if (sg_list)
-		free(sg_list);
-
 	return ret;
 }
 
@@ -928,6 +992,7 @@ err:
  *           4. Set initial bus width
  *           5. Set Adma mode
  *           6. Enable the error status
+ *           7. Register the host controller irq
  */
 void sdhci_init(struct sdhci_host *host)
 {
@@ -955,6 +1020,31 @@ void sdhci_init(struct sdhci_host *host)
 	if (caps[0] & SDHCI_BLK_ADMA_MASK)
 		host->caps.adma_support = 1;
 
+	/*
+	 * 64 bit adma only when the descriptors & data can live above 4 GB,
+	 * which takes a 64 bit system bus & addresses wider than 32 bits.
+	 * Otherwise the wider descriptors are just more to write & clean.
+	 */
+	if ((caps[0] & SDHCI_64BIT_SYS_BUS_MASK) && sizeof(addr_t) > sizeof(uint32_t))
+		host->caps.adma_64bit = 1;
+	else
+		host->caps.adma_64bit = 0;
+
+	/*
+	 * Allocate the descriptor table once, big enough for the largest
+	 * transfer a single command can do, rather than for every command.
+	 * Drop the table of an earlier init, its entry size may differ.
+	 */
+	if (host->adma_desc)
+		free(host->adma_desc);
+
+	host->adma_desc_cnt = SDHCI_ADMA_MAX_DESC;
+	host->adma_desc = memalign(lcm(4, CACHE_LINE),
+				   ROUNDUP(host->adma_desc_cnt * (host->caps.adma_64bit ?
+					   sizeof(struct desc_entry_64) : sizeof(struct desc_entry)),
+					   CACHE_LINE));
+	ASSERT(host->adma_desc);
+
 	/* Supported voltage */
 	if (caps[0] & SDHCI_3_3_VOL_MASK)
 		host->caps.voltage = SDHCI_VOL_3_3;
@@ -998,4 +1088,7 @@ void sdhci_init(struct sdhci_host *host)
 	 * Enable error status
 	 */
 	sdhci_error_status_enable(host);
+
+	/* Wait for commands on the irq, if the target gave one */
+	sdhci_irq_init(host);
 }
@@ -0,0 +1,320 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <arch/ops.h>
+#include <platform/timer.h>
+#include <stdlib.h>
+#include <string.h>
+#include <reg.h>
+#include <debug.h>
+#include <sdhci.h>
+#include <sdhci_cmdq.h>
+
+static uint32_t cmdq_readl(struct cmdq_host *cq, uint32_t reg)
+{
+	return readl(cq->base + reg);
+}
+
+static void cmdq_writel(struct cmdq_host *cq, uint32_t val, uint32_t reg)
+{
+	writel(val, cq->base + reg);
+}
+
+/*
+ * Task, transfer & link descriptors all start with a 32 bit attribute
+ * word followed by a 32 or 64 bit address (or block address for tasks);
+ * 64 bit descriptors are padded to 128 bits.
+ */
+static void cmdq_write_desc(struct cmdq_host *cq, uint8_t *desc, uint32_t attr, uint64_t addr)
+{
+	uint32_t *d = (uint32_t *) desc;
+
+	d[0] = attr;
+	d[1] = (uint32_t) addr;
+	if (cq->dma64) {
+		d[2] = (uint32_t) (addr >> 32);
+		d[3] = 0;
+	}
+}
+
+/*
+ * Function: cmdq host init
+ * Arg     : Engine, register base, queue depth & descriptor size
+ * Return  : 0 on Success, 1 on Failure
+ * Flow    : Allocate the task descriptor list & the transfer descriptors
+ *           for every slot, once
+ */
+int cmdq_host_init(struct cmdq_host *cq, addr_t base, uint32_t depth, bool dma64)
+{
+	uint32_t task_len;
+	uint32_t tran_len;
+
+	cq->base = base;
+	cq->num_slots = MIN(depth, CMDQ_MAX_SLOTS);
+	cq->max_task_blks = CMDQ_MAX_TASK_BLKS;
+	cq->dma64 = dma64;
+	cq->slot_sz = dma64 ? 32 : 16;
+	cq->tran_desc_sz = dma64 ? 16 : 8;
+	cq->read = cmdq_readl;
+	cq->write = cmdq_writel;
+	cq->host_err = NULL;
+
+	if (!cq->num_slots)
+		return 1;
+
+	task_len = ROUNDUP(cq->num_slots * cq->slot_sz, CACHE_LINE);
+	tran_len = ROUNDUP(cq->num_slots * CMDQ_TRAN_DESC_PER_SLOT * cq->tran_desc_sz, CACHE_LINE);
+
+	/* The task descriptor list base has to be 1 KB aligned */
+	cq->task_desc = memalign(lcm(1024, CACHE_LINE), task_len);
+	cq->tran_desc = memalign(lcm(4, CACHE_LINE), tran_len);
+	if (!cq->task_desc || !cq->tran_desc) {
+		dprintf(CRITICAL, "Error allocating cmdq descriptors\n");
+		free(cq->task_desc);
+		free(cq->tran_desc);
+		cq->task_desc = NULL;
+		cq->tran_desc = NULL;
+		return 1;
+	}
+
+	memset(cq->task_desc, 0, task_len);
+
+	return 0;
+}
+
+/*
+ * Function: cmdq enable
+ * Arg     : Engine & relative card address
+ * Return  : None
+ * Flow    : Program the task descriptor list & the card's RCA (for the
+ *           queue status polling the engine does on its own), then
+ *           enable the engine. Completions are polled, no irqs.
+ */
+void cmdq_enable(struct cmdq_host *cq, uint32_t rca)
+{
+	uint32_t cfg = cq->dma64 ? CMDQ_TASK_DESC_SZ_128 : 0;
+
+	CMDQ_WRITE32(cq, cfg, CMDQ_CFG_REG);
+
+	CMDQ_WRITE32(cq, (uint32_t) (addr_t) cq->task_desc, CMDQ_TDLBA_REG);
+	CMDQ_WRITE32(cq, (uint32_t) ((uint64_t) (addr_t) cq->task_desc >> 32), CMDQ_TDLBAU_REG);
+
+	CMDQ_WRITE32(cq, rca, CMDQ_SSC2_REG);
+
+	CMDQ_WRITE32(cq, CMDQ_IS_MASK, CMDQ_ISTE_REG);
+	CMDQ_WRITE32(cq, 0, CMDQ_ISGE_REG);
+	CMDQ_WRITE32(cq, CMDQ_IS_MASK, CMDQ_IS_REG);
+
+	CMDQ_WRITE32(cq, cfg | CMDQ_ENABLE, CMDQ_CFG_REG);
+
+	/* The engine may come up halted */
+	if (CMDQ_READ32(cq, CMDQ_CTL_REG) & CMDQ_HALT)
+		CMDQ_WRITE32(cq, 0, CMDQ_CTL_REG);
+}
+
+/*
+ * Function: cmdq halt
+ * Arg     : Engine
+ * Return  : 0 on Success, 1 on Failure
+ * Flow    : Ask the engine to halt & wait till it has
+ */
+static uint32_t cmdq_halt(struct cmdq_host *cq)
+{
+	uint32_t retry = 0;
+
+	CMDQ_WRITE32(cq, CMDQ_HALT, CMDQ_CTL_REG);
+
+	while (!(CMDQ_READ32(cq, CMDQ_CTL_REG) & CMDQ_HALT)) {
+		retry++;
+		udelay(1);
+		if (retry == SDHCI_MAX_CMD_RETRY) {
+			dprintf(CRITICAL, "Error: cmdq engine never halted\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Function: cmdq recover
+ * Arg     : Engine
+ * Return  : None
+ * Flow    : Halt the engine & drop every queued task after an error
+ */
+static void cmdq_recover(struct cmdq_host *cq)
+{
+	uint32_t retry = 0;
+
+	if (cmdq_halt(cq))
+		return;
+
+	CMDQ_WRITE32(cq, CMDQ_HALT | CMDQ_CLEAR_ALL_TASKS, CMDQ_CTL_REG);
+
+	while (!(CMDQ_READ32(cq, CMDQ_IS_REG) & CMDQ_IS_TCL)) {
+		retry++;
+		udelay(1);
+		if (retry == SDHCI_MAX_CMD_RETRY) {
+			dprintf(CRITICAL, "Error: cmdq tasks were never cleared\n");
+			break;
+		}
+	}
+
+	CMDQ_WRITE32(cq, CMDQ_IS_MASK, CMDQ_IS_REG);
+	CMDQ_WRITE32(cq, CMDQ_READ32(cq, CMDQ_TCN_REG), CMDQ_TCN_REG);
+}
+
+/*
+ * Function: cmdq disable
+ * Arg     : Engine
+ * Return  : None
+ * Flow    : Halt the engine & turn it off, so the host can be used for
+ *           regular commands again
+ */
+void cmdq_disable(struct cmdq_host *cq)
+{
+	cmdq_halt(cq);
+	CMDQ_WRITE32(cq, 0, CMDQ_CFG_REG);
+}
+
+/*
+ * Function: cmdq prep slot
+ * Arg     : Engine, slot & the task's data
+ * Return  : None
+ * Flow    : Fill in the transfer descriptors for the data, & the task
+ *           descriptor with a link to them
+ */
+static void cmdq_prep_slot(struct cmdq_host *cq, uint32_t slot, void *data,
+						   uint32_t blk_addr, uint32_t num_blocks, bool read)
+{
+	uint8_t *task = cq->task_desc + (slot * cq->slot_sz);
+	uint8_t *tran = cq->tran_desc + (slot * CMDQ_TRAN_DESC_PER_SLOT * cq->tran_desc_sz);
+	uint64_t addr = (addr_t) data;
+	uint32_t len = num_blocks * SDHCI_MMC_BLK_SZ;
+	uint32_t line;
+	uint32_t attr;
+	uint32_t n = 0;
+
+	while (len) {
+		line = MIN(len, CMDQ_TRAN_LINE_SZ);
+		attr = CMDQ_DESC_VALID | CMDQ_DESC_ACT(CMDQ_ACT_TRAN) | CMDQ_TRAN_LEN(line);
+		if (line == len)
+			attr |= CMDQ_DESC_END;
+
+		cmdq_write_desc(cq, tran + (n * cq->tran_desc_sz), attr, addr);
+
+		addr += line;
+		len -= line;
+		n++;
+	}
+
+	attr = CMDQ_DESC_VALID | CMDQ_DESC_END | CMDQ_DESC_INT |
+		   CMDQ_DESC_ACT(CMDQ_ACT_TASK) | CMDQ_TASK_BLK_COUNT(num_blocks);
+	if (read)
+		attr |= CMDQ_TASK_DATA_DIR_READ;
+
+	cmdq_write_desc(cq, task, attr, blk_addr);
+	cmdq_write_desc(cq, task + (cq->slot_sz / 2),
+					CMDQ_DESC_VALID | CMDQ_DESC_ACT(CMDQ_ACT_LINK), (addr_t) tran);
+
+	arch_clean_invalidate_cache_range((addr_t) tran, n * cq->tran_desc_sz);
+	arch_clean_invalidate_cache_range((addr_t) task, cq->slot_sz);
+}
+
+/*
+ * Function: cmdq transfer
+ * Arg     : Engine, data, block address, number of blocks & direction
+ * Return  : 0 on Success, 1 on Failure
+ * Flow    : 1. Split the transfer into tasks of up to max_task_blks
+ *           2. Queue a task in every free slot & ring their doorbells at once
+ *           3. Reap completed tasks, refill their slots & go again
+ *           On a response error, or a data error the host reports, the
+ *           engine is halted & all tasks are cleared; the caller resets
+ *           the host. The caller takes care of the data cache, as for
+ *           any DMA.
+ */
+uint32_t cmdq_transfer(struct cmdq_host *cq, void *data, uint32_t blk_addr,
+					   uint32_t num_blocks, bool read)
+{
+	uint32_t all = (cq->num_slots == 32) ? ~0U : ((1U << cq->num_slots) - 1);
+	uint32_t busy = 0;
+	uint32_t ring;
+	uint32_t done;
+	uint32_t slot;
+	uint32_t blks;
+	uint32_t retry = 0;
+	uint32_t host_err;
+	uint8_t *buf = data;
+
+	while (num_blocks || busy) {
+		ring = 0;
+		while (num_blocks && (busy | ring) != all) {
+			slot = __builtin_ctz(~(busy | ring));
+			blks = MIN(num_blocks, cq->max_task_blks);
+
+			cmdq_prep_slot(cq, slot, buf, blk_addr, blks, read);
+
+			ring |= (1U << slot);
+			buf += blks * SDHCI_MMC_BLK_SZ;
+			blk_addr += blks;
+			num_blocks -= blks;
+		}
+
+		if (ring) {
+			CMDQ_WRITE32(cq, ring, CMDQ_TDBR_REG);
+			busy |= ring;
+		}
+
+		host_err = cq->host_err ? cq->host_err(cq) : 0;
+		if ((CMDQ_READ32(cq, CMDQ_IS_REG) & CMDQ_IS_RED) || host_err) {
+			dprintf(CRITICAL, "Error: cmdq task failed, TERRI: 0x%08x, host errors: 0x%04x\n",
+					CMDQ_READ32(cq, CMDQ_TERRI_REG), host_err);
+			cmdq_recover(cq);
+			return 1;
+		}
+
+		done = CMDQ_READ32(cq, CMDQ_TCN_REG) & busy;
+		if (done) {
+			CMDQ_WRITE32(cq, done, CMDQ_TCN_REG);
+			CMDQ_WRITE32(cq, CMDQ_IS_TCC, CMDQ_IS_REG);
+			busy &= ~done;
+			retry = 0;
+			continue;
+		}
+
+		retry++;
+		udelay(1);
+		if (retry == SDHCI_MAX_TRANS_RETRY) {
+			dprintf(CRITICAL, "Error: cmdq tasks never completed: 0x%08x\n", busy);
+			cmdq_recover(cq);
+			return 1;
+		}
+	}
+
+	return 0;
+}
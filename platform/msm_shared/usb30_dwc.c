@@ -185,6 +185,9 @@ static void dwc_print_ep_details(dwc_dev_t *dev, uint8_t ep_index)
 	ERR("bytes_queued = %d \n", dev->ep[ep_index].bytes_queued);
 	ERR("state        = %d, %s \n", dev->ep[ep_index].state, ep_state_lookup[dev->ep[ep_index].state]);
 	ERR("ep req len   = %d trbctl = %d\n", dev->ep[ep_index].req.len, dev->ep[ep_index].req.trbctl);
+	ERR("requests     = %u trbs = %u errors = %u events = %u\n",
+		dev->ep[ep_index].stats.requests, dev->ep[ep_index].stats.trbs,
+		dev->ep[ep_index].stats.errors, dev->ep[ep_index].stats.events);
 	ERR("\n");
 }
 
@@ -243,10 +246,16 @@ dwc_dev_t* dwc_init(dwc_config_t *config)
 	return dev;
 }
 
-/* interrupt handler */
+/* interrupt handler:
+ * Events are drained in batches: all the events pending in the event buffer
+ * are made visible with one cache invalidate, handled, then given back to
+ * the h/w with one write. Events that arrive meanwhile make the next batch.
+ */
 static enum handler_return dwc_irq_handler_ee1(void* context)
 {
 	dwc_dev_t *dev;
+	uint16_t   count;      /* number of bytes of events in the batch */
+	uint16_t   processed;  /* number of bytes of the batch processed */
 	uint16_t   event_size; /* number of bytes used by the event */
 	uint32_t   event[3] = {0x0, 0x0, 0x0};
 
@@ -254,39 +263,74 @@ static enum handler_return dwc_irq_handler_ee1(void* context)
 	dev = (dwc_dev_t *) context;
 
 	/* while there are events to be processed */
-	while((event_size = dwc_event_get_next(dev, event)))
+	while((count = dwc_event_get_count(dev)))
 	{
-		/* device event? */
-		if(DWC_EVENT_IS_DEVICE_EVENT(*event))
-		{
-			/* handle device events */
-			dwc_event_handler_device(dev, event);
-		}
-		else
+		dev->event_buf.batches++;
+
+		for (processed = 0; processed < count; processed += event_size)
 		{
-			/* endpoint event */
-			uint8_t ep_phy_num = DWC_EVENT_EP_EVENT_EP_NUM(*event);
+			event_size = dwc_event_get_next(dev, event);
+			dev->event_buf.events++;
 
-			if ((ep_phy_num == 0) ||
-				(ep_phy_num == 1))
+			/* device event? */
+			if(DWC_EVENT_IS_DEVICE_EVENT(*event))
 			{
-				/* handle control ep event */
-				dwc_event_handler_ep_ctrl(dev, event);
+				/* handle device events */
+				dwc_event_handler_device(dev, event);
 			}
 			else
 			{
-				/* handle non-control ep event. only bulk ep is supported.*/
-				dwc_event_handler_ep_bulk(dev, event);
+				/* endpoint event */
+				uint8_t ep_phy_num = DWC_EVENT_EP_EVENT_EP_NUM(*event);
+
+				if (DWC_EP_PHY_TO_INDEX(ep_phy_num) < DWC_MAX_NUM_OF_EP)
+				{
+					dev->ep[DWC_EP_PHY_TO_INDEX(ep_phy_num)].stats.events++;
+				}
+
+				if ((ep_phy_num == 0) ||
+					(ep_phy_num == 1))
+				{
+					/* handle control ep event */
+					dwc_event_handler_ep_ctrl(dev, event);
+				}
+				else
+				{
+					/* handle non-control ep event. only bulk ep is supported.*/
+					dwc_event_handler_ep_bulk(dev, event);
+				}
 			}
 		}
 
 		/* update number of bytes processed */
-		dwc_event_processed(dev, event_size);
+		dwc_event_processed(dev, count);
 	}
 
 	return INT_NO_RESCHEDULE;
 }
 
+/* print the event & per ep transfer statistics */
+void dwc_print_stats(dwc_dev_t *dev)
+{
+	uint8_t i;
+	dwc_ep_stats_t *stats;
+
+	dprintf(INFO, "dwc: %u events in %u batches\n",
+			dev->event_buf.events, dev->event_buf.batches);
+
+	for (i = 0; i < DWC_MAX_NUM_OF_EP; i++)
+	{
+		stats = &dev->ep[i].stats;
+
+		if (!stats->events && !stats->requests)
+			continue;
+
+		dprintf(INFO, "dwc: ep_phy_num %u: %u requests, %u trbs, %llu bytes, "
+				"%u events, %u errors\n", i, stats->requests, stats->trbs,
+				stats->bytes, stats->events, stats->errors);
+	}
+}
+
 /*====================== DWC Event configuration/handling functions========== */
 
 /* handles all device specific events */
@@ -1275,6 +1319,8 @@ static void dwc_event_handler_ep_bulk_state_start_transfer(dwc_dev_t *dev,
 				}
 				else
 				{
+					ep->stats.errors++;
+
 					/* start transfer failed. inform client */
 					if (ep->req.callback)
 					{
@@ -1320,6 +1366,8 @@ static void dwc_event_handler_ep_bulk_state_xfer_in_prog(dwc_dev_t *dev,
 				/* transfer was cancelled for some reason. */
 				DBG("\n transfer was cancelled on ep_phy_num = %d\n", ep_phy_num);
 
+				ep->stats.errors++;
+
 				/* inform client that transfer failed. */
 				if (ep->req.callback)
 				{
@@ -1362,6 +1410,12 @@ static void dwc_event_handler_ep_bulk_state_xfer_in_prog(dwc_dev_t *dev,
 			DBG("\n\n ******DATA TRANSFER COMPLETED (ep_phy_num = %d) ********"
 				"bytes_remaining = %d\n\n", ep_phy_num, bytes_remaining);
 
+			ep->stats.bytes += ep->bytes_queued - bytes_remaining;
+			if (status)
+			{
+				ep->stats.errors++;
+			}
+
 			if (ep->req.callback)
 			{
 				ep->req.callback(ep->req.context,
@@ -1897,6 +1951,9 @@ static int dwc_request_queue(dwc_dev_t     *dev,
 		ASSERT(0);
 	}
 
+	ep->stats.requests++;
+	ep->stats.trbs += ep->trb_queued;
+
 	/* flush the trb data to main memory */
 	arch_clean_invalidate_cache_range((addr_t) ep->trb,
 									  sizeof(dwc_trb_t)*ep->trb_queued);
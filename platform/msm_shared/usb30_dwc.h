@@ -247,6 +247,8 @@ typedef struct {
    uint16_t  buf_size;  /* size of buf. */
    uint16_t  max_index; /* max index value. initialized once. used to track rollover. */
    uint16_t  index;     /* index into the buf for reading next event */
+   uint32_t  batches;   /* number of times the pending events were drained */
+   uint32_t  events;    /* number of events handled */
 } dwc_event_buf_t;
 
 /* device command */
@@ -339,6 +341,16 @@ typedef void (*dwc_transfer_callback_t)(void *context, uint32_t actual, int stat
  */
 #define DWC_ZLP_BUF_SIZE    512
 
+/* transfer statistics of an endpoint */
+typedef struct
+{
+	uint32_t requests;  /* transfer requests queued */
+	uint32_t trbs;      /* TRBs queued for them */
+	uint32_t errors;    /* transfers that failed or were cancelled */
+	uint32_t events;    /* ep events handled */
+	uint64_t bytes;     /* bytes transferred */
+} dwc_ep_stats_t;
+
 /* Structure to keep all information about an endpoint */
 typedef struct
 {
@@ -364,6 +376,8 @@ typedef struct
 
 	dwc_ep_state_t      state;         /* data transfer state of the ep. */
 
+	dwc_ep_stats_t      stats;         /* transfer statistics. */
+
 } dwc_ep_t;
 
 
@@ -452,6 +466,7 @@ void dwc_device_set_addr(dwc_dev_t *dev, uint16_t addr);
 void dwc_device_set_configuration(dwc_dev_t *dev);
 void dwc_device_set_periodic_param(dwc_dev_t *dev, uint32_t val);
 void dwc_device_add_ep(dwc_dev_t *dev, dwc_ep_t *new_ep);
+void dwc_print_stats(dwc_dev_t *dev);
 
 /* data transfer apis */
 int dwc_transfer_request(dwc_dev_t *dwc,
@@ -457,21 +457,19 @@ static void dwc_event_update_index(uint16_t *index, uint16_t max_count)
 	}
 }
 
-/* Returns next event from event queue and the size of event
+/* Returns the number of bytes of events pending in the event buffer.
  * Event buffer is a circular buffer that the hardware populates when any of
  * the enabled event occurs. An interrupt is generated if interrupt is enabled
  * for that event.
- * This api returns the next valid event from the event buffer and updates event
- * buffer index.
- * Most events are 4 byte long
- * Note: caller must provide at least 12 bytes buffer in case the
- * next event is the special 12 byte event.
+ * The cached copy of all the pending events is invalidated here in one go,
+ * so they can be read with dwc_event_get_next() without touching the cache
+ * or the h/w again.
  */
-uint16_t dwc_event_get_next(dwc_dev_t *dev, uint32_t *event)
+uint16_t dwc_event_get_count(dwc_dev_t *dev)
 {
 	uint16_t count;
-	uint16_t event_size = 0;
-	uint32_t *buf;
+	uint32_t start;
+	uint8_t *buf;
 
 	/* read the number of valid event data in event buffer. */
 	count = REG_READI(dev, GEVNTCOUNT, 0);
@@ -479,7 +477,7 @@ uint16_t dwc_event_get_next(dwc_dev_t *dev, uint32_t *event)
 	if(count == 0)
 	{
 		/* no events in buffer. */
-		return event_size;
+		return count;
 	}
 
 	/* each event is at least 4 bytes long.
@@ -488,10 +486,41 @@ uint16_t dwc_event_get_next(dwc_dev_t *dev, uint32_t *event)
 	ASSERT(count >= 4);
 
 	/* get event buffer for this device */
-	buf = dev->event_buf.buf;
+	buf   = (uint8_t *) dev->event_buf.buf;
+	start = dev->event_buf.index * 4;
 
 	/* invalidate cached event buf data */
-	arch_invalidate_cache_range((addr_t) (buf + dev->event_buf.index), 4);
+	if (start + count <= dev->event_buf.buf_size)
+	{
+		arch_invalidate_cache_range((addr_t) (buf + start), count);
+	}
+	else
+	{
+		/* pending events wrap around the end of the buffer */
+		arch_invalidate_cache_range((addr_t) (buf + start),
+									dev->event_buf.buf_size - start);
+		arch_invalidate_cache_range((addr_t) buf,
+									start + count - dev->event_buf.buf_size);
+	}
+
+	return count;
+}
+
+/* Returns next event from event queue and the size of event
+ * This api returns the next valid event from the event buffer and updates event
+ * buffer index. Must only be called for the events counted by
+ * dwc_event_get_count().
+ * Most events are 4 byte long
+ * Note: caller must provide at least 12 bytes buffer in case the
+ * next event is the special 12 byte event.
+ */
+uint16_t dwc_event_get_next(dwc_dev_t *dev, uint32_t *event)
+{
+	uint16_t event_size = 0;
+	uint32_t *buf;
+
+	/* get event buffer for this device */
+	buf = dev->event_buf.buf;
 
 	/* read next event */
 	*event = buf[dev->event_buf.index];
@@ -508,22 +537,16 @@ uint16_t dwc_event_get_next(dwc_dev_t *dev, uint32_t *event)
 	}
 
 	/* check for that special 12 byte event */
-	if( DWC_EVENT_IS_DEVICE_EVENT(*event) &
+	if( DWC_EVENT_IS_DEVICE_EVENT(*event) &&
 		(DWC_EVENT_DEVICE_EVENT_ID(*event) == DWC_EVENT_DEVICE_EVENT_ID_VENDOR_DEVICE_TEST_LMP))
 	{
-		/* invalidate cached event buf data */
-		arch_invalidate_cache_range((addr_t) (buf + dev->event_buf.index), 4);
-
 		*(event + 1) = buf[dev->event_buf.index];
 		event_size += 4;
-		dwc_event_update_index(&dev->event_buf.index, dev->event_buf.buf_size);
+		dwc_event_update_index(&dev->event_buf.index, dev->event_buf.max_index);
 
-		/* invalidate cached event buf data */
-		arch_invalidate_cache_range((addr_t) (buf + dev->event_buf.index), 4);
-
-		*(event + 1) = buf[dev->event_buf.index];
+		*(event + 2) = buf[dev->event_buf.index];
 		event_size += 4;
-		dwc_event_update_index(&dev->event_buf.index, dev->event_buf.buf_size);
+		dwc_event_update_index(&dev->event_buf.index, dev->event_buf.max_index);
 	}
 
 	return event_size;
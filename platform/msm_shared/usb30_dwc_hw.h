@@ -42,6 +42,7 @@ void dwc_ep_disable(dwc_dev_t *dev, uint8_t ep_phy_num);
 void dwc_ep_disable_non_control(dwc_dev_t *dev);
 
 void dwc_event_init(dwc_dev_t *dev);
+uint16_t dwc_event_get_count(dwc_dev_t *dev);
 uint16_t dwc_event_get_next(dwc_dev_t *dev, uint32_t *event);
 void dwc_event_processed(dwc_dev_t *dev, uint16_t count);
 void dwc_event_device_enable(dwc_dev_t *dev, uint32_t events);
@@ -1433,5 +1433,7 @@ int usb30_udc_stop(void)
 {
 	dwc_device_run(udc_dev->dwc, 0);
 
+	dwc_print_stats(udc_dev->dwc);
+
 	return 0;
 }
@@ -15,6 +15,7 @@ endif
 DEFINES += WITH_DEBUG_UART=1
 DEFINES += WITH_DEBUG_LOG_BUF=1
 DEFINES += DEVICE_TREE=1
+DEFINES += UBI_FASTMAP_SCAN=1
 DEFINES += CONTIGUOUS_MEMORY=1
 
 DEFINES += SPMI_CORE_V2=1
@@ -29,3 +30,9 @@ ENABLE_SMD_SUPPORT := 1
 ifeq ($(ENABLE_SMD_SUPPORT),1)
 DEFINES += SMD_SUPPORT=1
 endif
+
+# Unit test FW, off in product builds. For a test build set
+# ENABLE_UNITTEST_FW := 1 in local.mk or on the make command line.
+ifeq ($(ENABLE_UNITTEST_FW),1)
+DEFINES += UNITTEST_FW_SUPPORT=1
+endif
@@ -20,6 +20,7 @@ MODULES += app/aboot
 DEFINES += WITH_DEBUG_UART=1
 #DEFINES += WITH_DEBUG_FBCON=1
 DEFINES += DEVICE_TREE=1
+DEFINES += UBI_FASTMAP_SCAN=1
 DEFINES += SPMI_CORE_V2=1
 DEFINES += BAM_V170=1
 DEFINES += USE_BOOTDEV_CMDLINE=1
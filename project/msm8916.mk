@@ -16,6 +16,7 @@ EMMC_BOOT := 1
 
 #DEFINES += WITH_DEBUG_DCC=1
 DEFINES += WITH_DEBUG_LOG_BUF=1
+#DEFINES += WITH_DEBUG_LOG_DEFERRED=1
 DEFINES += WITH_DEBUG_UART=1
 #DEFINES += WITH_DEBUG_FBCON=1
 DEFINES += ENABLE_FBCON_LOGGING=1
@@ -5,5 +5,6 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 TARGET := qemu-arm
 MODULES += \
 	app/tests \
-	app/shell
+	app/shell \
+	app/stringtests
  
@@ -163,7 +163,7 @@ static void target_mmc_sdhci_init()
 	static uint32_t mmc_clks[] = {
 		MMC_CLK_200MHZ, MMC_CLK_96MHZ, MMC_CLK_50MHZ };
 
-	struct mmc_config_data config;
+	struct mmc_config_data config = {0};
 	unsigned int i;
 
 	memset(&config, 0, sizeof config);
@@ -87,6 +87,9 @@ static uint32_t mmc_sdhci_base[] =
 static uint32_t  mmc_sdc_pwrctl_irq[] =
         { SDCC1_PWRCTL_IRQ, SDCC2_PWRCTL_IRQ };
 
+static uint32_t  mmc_sdc_irq[] =
+        { SDCC1_IRQ, SDCC2_IRQ };
+
 void target_early_init(void)
 {
 #if WITH_DEBUG_UART
@@ -96,7 +99,7 @@ void target_early_init(void)
 
 void target_sdc_init()
 {
-	struct mmc_config_data config;
+	struct mmc_config_data config = {0};
 
 	/* Set drive strength & pull ctrl values */
 	set_sdc_power_ctrl();
@@ -109,6 +112,7 @@ void target_sdc_init()
 	config.sdhc_base    = mmc_sdhci_base[config.slot - 1];
 	config.pwrctl_base  = mmc_pwrctl_base[config.slot - 1];
 	config.pwr_irq      = mmc_sdc_pwrctl_irq[config.slot - 1];
+	config.sdhc_irq     = mmc_sdc_irq[config.slot - 1];
 	config.hs400_support = 0;
 
 	if (!(dev = mmc_init(&config))) {
@@ -118,6 +122,7 @@ void target_sdc_init()
 		config.sdhc_base    = mmc_sdhci_base[config.slot - 1];
 		config.pwrctl_base  = mmc_pwrctl_base[config.slot - 1];
 		config.pwr_irq      = mmc_sdc_pwrctl_irq[config.slot - 1];
+		config.sdhc_irq     = mmc_sdc_irq[config.slot - 1];
 
 		if (!(dev = mmc_init(&config))) {
 			dprintf(CRITICAL, "mmc init failed!");
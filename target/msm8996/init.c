@@ -93,6 +93,10 @@ static uint32_t mmc_sdhci_base[] =
 static uint32_t  mmc_sdc_pwrctl_irq[] =
 	{ SDCC1_PWRCTL_IRQ, SDCC2_PWRCTL_IRQ };
 
+/* Only the eMMC slot has a command queue engine */
+static uint32_t mmc_cmdq_base[] =
+	{ MSM_SDC1_CMDQ_BASE, 0 };
+
 struct mmc_device *dev;
 struct ufs_dev ufs_device;
 
@@ -237,6 +241,7 @@ void target_sdc_init()
 	config.sdhc_base = mmc_sdhci_base[config.slot - 1];
 	config.pwrctl_base = mmc_pwrctl_base[config.slot - 1];
 	config.pwr_irq     = mmc_sdc_pwrctl_irq[config.slot - 1];
+	config.cmdq_base   = mmc_cmdq_base[config.slot - 1];
 
 	if (!(dev = mmc_init(&config)))
 	{
@@ -246,6 +251,7 @@ void target_sdc_init()
 		config.sdhc_base = mmc_sdhci_base[config.slot - 1];
 		config.pwrctl_base = mmc_pwrctl_base[config.slot - 1];
 		config.pwr_irq     = mmc_sdc_pwrctl_irq[config.slot - 1];
+		config.cmdq_base   = mmc_cmdq_base[config.slot - 1];
 
 		if (!(dev = mmc_init(&config)))
 		{